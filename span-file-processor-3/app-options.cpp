@@ -0,0 +1,518 @@
+#include "app-options.h"
+#include "batch-load.h"
+#include "span-summary.h"
+#include "logger.h"
+#include <iostream>
+#include <thread>
+
+extern Logger logger;
+
+static bool readIntArg(int argc, char* argv[], int& i, int& value) {
+    if (i + 1 >= argc) {
+        logger.log(std::string("Missing value for ") + argv[i], LogLevel::ERRORS);
+        return false;
+    }
+    try {
+        value = std::stoi(argv[++i]);
+    }
+    catch (const std::exception&) {
+        logger.log(std::string("Invalid value for ") + argv[i - 1] + ": " + argv[i], LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+static bool readDoubleArg(int argc, char* argv[], int& i, double& value) {
+    if (i + 1 >= argc) {
+        logger.log(std::string("Missing value for ") + argv[i], LogLevel::ERRORS);
+        return false;
+    }
+    try {
+        value = std::stod(argv[++i]);
+    }
+    catch (const std::exception&) {
+        logger.log(std::string("Invalid value for ") + argv[i - 1] + ": " + argv[i], LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+bool parseCommandLine(int argc, char* argv[], AppOptions& opts) {
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--parse-threads") {
+            if (!readIntArg(argc, argv, i, opts.parseThreads))
+                return false;
+        }
+        else if (arg == "--batch-size") {
+            if (!readIntArg(argc, argv, i, opts.batchSize))
+                return false;
+        }
+        else if (arg == "--queue-depth") {
+            if (!readIntArg(argc, argv, i, opts.queueDepth))
+                return false;
+        }
+        else if (arg == "--connections") {
+            if (!readIntArg(argc, argv, i, opts.connections))
+                return false;
+        }
+        else if (arg == "--commit-rows") {
+            if (!readIntArg(argc, argv, i, opts.commitRows))
+                return false;
+        }
+        else if (arg == "--commit-bytes") {
+            if (!readIntArg(argc, argv, i, opts.commitBytes))
+                return false;
+        }
+        else if (arg == "--partition") {
+            if (i + 1 >= argc || (std::string(argv[i + 1]) != "pfid" && std::string(argv[i + 1]) != "segment")) {
+                logger.log("--partition expects pfid or segment", LogLevel::ERRORS);
+                return false;
+            }
+            opts.partition = argv[++i];
+        }
+        else if (arg == "--delta") {
+            opts.delta = true;
+        }
+        else if (arg == "--digest-index") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for --digest-index", LogLevel::ERRORS);
+                return false;
+            }
+            opts.digestIndexPath = argv[++i];
+        }
+        else if (arg == "--sink") {
+            if (i + 1 >= argc || (std::string(argv[i + 1]) != "odbc" && std::string(argv[i + 1]) != "columnar" &&
+                std::string(argv[i + 1]) != "null")) {
+                logger.log("--sink expects odbc, columnar or null", LogLevel::ERRORS);
+                return false;
+            }
+            opts.sink = argv[++i];
+        }
+        else if (arg == "--output") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for --output", LogLevel::ERRORS);
+                return false;
+            }
+            opts.outputPath = argv[++i];
+        }
+        else if (arg == "--generate") {
+            opts.generate = true;
+        }
+        else if (arg == "--gen-portfolios") {
+            if (!readIntArg(argc, argv, i, opts.generator.portfolios))
+                return false;
+        }
+        else if (arg == "--gen-series") {
+            if (!readIntArg(argc, argv, i, opts.generator.seriesPerPortfolio))
+                return false;
+        }
+        else if (arg == "--gen-options") {
+            if (!readIntArg(argc, argv, i, opts.generator.optionsPerSeries))
+                return false;
+        }
+        else if (arg == "--gen-risk-points") {
+            if (!readIntArg(argc, argv, i, opts.generator.riskPoints))
+                return false;
+        }
+        else if (arg == "--gen-seed") {
+            int seed = 0;
+            if (!readIntArg(argc, argv, i, seed))
+                return false;
+            opts.generator.seed = (uint64_t)(unsigned)seed;
+        }
+        else if (arg == "--gen-priced") {
+            opts.generator.pricedOptions = true;
+        }
+        else if (arg == "--bench-suite") {
+            opts.benchSuite = true;
+        }
+        else if (arg == "--bench-iterations") {
+            if (!readIntArg(argc, argv, i, opts.benchIterations))
+                return false;
+        }
+        else if (arg == "--report" || arg == "--report-label") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            (arg == "--report" ? opts.reportPath : opts.reportLabel) = argv[++i];
+        }
+        else if (arg == "--async-log") {
+            opts.asyncLog = true;
+        }
+        else if (arg == "--log-overflow") {
+            std::string value = i + 1 < argc ? argv[i + 1] : "";
+            if (value == "block")
+                opts.logOverflow = LogOverflow::Block;
+            else if (value == "drop")
+                opts.logOverflow = LogOverflow::Drop;
+            else if (value == "count")
+                opts.logOverflow = LogOverflow::Count;
+            else {
+                logger.log("--log-overflow expects block, drop or count", LogLevel::ERRORS);
+                return false;
+            }
+            ++i;
+        }
+        else if (arg == "--log-queue") {
+            if (!readIntArg(argc, argv, i, opts.logQueue))
+                return false;
+        }
+        else if (arg == "--bench-log") {
+            opts.benchLog = true;
+        }
+        else if (arg == "--self-test") {
+            opts.selfTest = true;
+        }
+        else if (arg == "--watch") {
+            opts.watch = true;
+        }
+        else if (arg == "--batch") {
+            opts.batch = true;
+        }
+        else if (arg == "--from" || arg == "--to") {
+            if (i + 1 >= argc || !parseBatchDate(argv[i + 1], arg == "--from" ? opts.fromDate : opts.toDate)) {
+                logger.log(arg + " expects a date as YYYYMMDD or YYYY-MM-DD", LogLevel::ERRORS);
+                return false;
+            }
+            ++i;
+        }
+        else if (arg == "--batch-threads") {
+            if (!readIntArg(argc, argv, i, opts.batchThreads))
+                return false;
+        }
+        else if (arg == "--split-mb") {
+            if (!readIntArg(argc, argv, i, opts.splitMb))
+                return false;
+        }
+        else if (arg == "--watch-polling") {
+            opts.watchPolling = true;
+        }
+        else if (arg == "--archive") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            opts.archivePath = argv[++i];
+        }
+        else if (arg == "--poll-ms") {
+            if (!readIntArg(argc, argv, i, opts.pollMs))
+                return false;
+        }
+        else if (arg == "--snapshot") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            opts.snapshotPath = argv[++i];
+        }
+        else if (arg == "--bench-snapshot") {
+            opts.benchSnapshot = true;
+        }
+        else if (arg == "--schema") {
+            if (i + 1 >= argc || !parseOutputSchema(argv[i + 1], opts.schema)) {
+                logger.log("--schema expects wide or normalized", LogLevel::ERRORS);
+                return false;
+            }
+            ++i;
+        }
+        else if (arg == "--bench-schema") {
+            opts.benchSchema = true;
+        }
+        else if (arg == "--load-sections") {
+            opts.loadSections = true;
+        }
+        else if (arg == "--checkpoint" || arg == "--quarantine") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            (arg == "--checkpoint" ? opts.checkpointPath : opts.quarantinePath) = argv[++i];
+        }
+        else if (arg == "--positions" || arg == "--scan-output") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            (arg == "--positions" ? opts.positionsPath : opts.scanOutputPath) = argv[++i];
+        }
+        else if (arg == "--scan-threads") {
+            if (!readIntArg(argc, argv, i, opts.scanThreads))
+                return false;
+        }
+        else if (arg == "--diff" || arg == "--diff-output") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            (arg == "--diff" ? opts.diffBasePath : opts.diffOutputPath) = argv[++i];
+        }
+        else if (arg == "--diff-tolerance") {
+            if (!readDoubleArg(argc, argv, i, opts.diffTolerance))
+                return false;
+        }
+        else if (arg == "--diff-rel-tolerance") {
+            if (!readDoubleArg(argc, argv, i, opts.diffRelTolerance))
+                return false;
+        }
+        else if (arg == "--diff-scalar") {
+            opts.diffScalar = true;
+        }
+        else if (arg == "--summary") {
+            if (i + 1 >= argc || !parseSummaryKinds(argv[i + 1], opts.summaryKinds)) {
+                logger.log("--summary expects portfolio, expiry, series or all, comma separated", LogLevel::ERRORS);
+                return false;
+            }
+            ++i;
+        }
+        else if (arg == "--summary-output") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            opts.summaryOutputPath = argv[++i];
+        }
+        else if (arg == "--validate-risk") {
+            opts.validateRisk = true;
+        }
+        else if (arg == "--validate-output") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            opts.validateOutputPath = argv[++i];
+        }
+        else if (arg == "--validate-tolerance") {
+            if (!readDoubleArg(argc, argv, i, opts.validateTolerance))
+                return false;
+        }
+        else if (arg == "--validate-rel-tolerance") {
+            if (!readDoubleArg(argc, argv, i, opts.validateRelTolerance))
+                return false;
+        }
+        else if (arg == "--validate-threads") {
+            if (!readIntArg(argc, argv, i, opts.validateThreads))
+                return false;
+        }
+        else if (arg == "--validate-scalar") {
+            opts.validateScalar = true;
+        }
+        else if (arg == "--bench-validate") {
+            opts.benchValidate = true;
+        }
+        else if (arg == "--scan-scalar") {
+            opts.scanScalar = true;
+        }
+        else if (arg == "--bench-scan") {
+            opts.benchScan = true;
+        }
+        else if (arg == "--bench-accounts") {
+            if (!readIntArg(argc, argv, i, opts.benchAccounts))
+                return false;
+        }
+        else if (arg == "--metrics-json" || arg == "--metrics-prom") {
+            if (i + 1 >= argc) {
+                logger.log("Missing value for " + arg, LogLevel::ERRORS);
+                return false;
+            }
+            (arg == "--metrics-json" ? opts.metricsJsonPath : opts.metricsPromPath) = argv[++i];
+        }
+        else if (arg == "--risk-format") {
+            if (i + 1 >= argc || !parseRiskEncoding(argv[i + 1], opts.riskEncoding)) {
+                logger.log("--risk-format expects legacy, text or binary", LogLevel::ERRORS);
+                return false;
+            }
+            ++i;
+        }
+        else if (arg == "--streaming") {
+            opts.streaming = true;
+        }
+        else if (arg == "--unordered") {
+            opts.unordered = true;
+        }
+        else if (arg == "--bench-parse") {
+            opts.benchParse = true;
+        }
+        else if (arg == "--bench-store") {
+            opts.benchStore = true;
+        }
+        else if (arg == "--bench-risk") {
+            opts.benchRisk = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0) {
+            logger.log("Unknown option " + arg, LogLevel::ERRORS);
+            return false;
+        }
+        else if (positional == 0) {
+            opts.configPath = arg;
+            ++positional;
+        }
+        else if (positional == 1) {
+            opts.spanFilePath = arg;
+            ++positional;
+        }
+        else {
+            logger.log("Unexpected argument " + arg, LogLevel::ERRORS);
+            return false;
+        }
+    }
+
+    if (positional != 2 && !(opts.selfTest && positional == 0)) {
+        logger.log("Less command line arguments", LogLevel::ERRORS);
+        return false;
+    }
+    if (opts.outputPath.empty())
+        opts.outputPath = opts.spanFilePath + ".spcol";
+    if (opts.batchSize <= 0)
+        opts.batchSize = 1;
+    if (opts.queueDepth <= 0)
+        opts.queueDepth = 1;
+    if (opts.connections < 0)
+        opts.connections = 0;
+    if (opts.commitRows < 0)
+        opts.commitRows = 0;
+    if (opts.commitBytes < 0)
+        opts.commitBytes = 0;
+    if (opts.logQueue < 2)
+        opts.logQueue = 2;
+    if (opts.benchIterations <= 0)
+        opts.benchIterations = 1;
+    if (opts.generator.portfolios < 0)
+        opts.generator.portfolios = 0;
+    if (opts.generator.seriesPerPortfolio < 0)
+        opts.generator.seriesPerPortfolio = 0;
+    if (opts.generator.optionsPerSeries < 0)
+        opts.generator.optionsPerSeries = 0;
+    if (opts.generator.riskPoints < 0)
+        opts.generator.riskPoints = 0;
+    if (opts.archivePath.empty())
+        opts.archivePath = opts.spanFilePath + "/archive";
+    if (opts.pollMs < 50)
+        opts.pollMs = 50;
+    if (opts.benchAccounts < 0)
+        opts.benchAccounts = 0;
+    if (opts.quarantinePath.empty() && !opts.checkpointPath.empty())
+        opts.quarantinePath = opts.spanFilePath + ".quarantine";
+    if (opts.diffOutputPath.empty() && !opts.diffBasePath.empty())
+        opts.diffOutputPath = opts.spanFilePath + ".diff.csv";
+    if (opts.summaryOutputPath.empty() && opts.summaryKinds && opts.sink != "odbc")
+        opts.summaryOutputPath = opts.batch ? "span-batch.summary" : opts.spanFilePath + ".summary";
+    if (opts.validateOutputPath.empty() && opts.validateRisk)
+        opts.validateOutputPath = opts.batch ? "span-batch.validation.csv" : opts.spanFilePath + ".validation.csv";
+    if (opts.validateTolerance < 0)
+        opts.validateTolerance = 0;
+    if (opts.validateRelTolerance < 0)
+        opts.validateRelTolerance = 0;
+    if (opts.validateThreads <= 0)
+        opts.validateThreads = (int)std::thread::hardware_concurrency();
+    if (opts.validateThreads <= 0)
+        opts.validateThreads = 1;
+    if (opts.diffTolerance < 0)
+        opts.diffTolerance = 0;
+    if (opts.diffRelTolerance < 0)
+        opts.diffRelTolerance = 0;
+    if (opts.scanOutputPath.empty() && !opts.positionsPath.empty())
+        opts.scanOutputPath = opts.positionsPath + ".scan.csv";
+    if (opts.scanThreads <= 0)
+        opts.scanThreads = (int)std::thread::hardware_concurrency();
+    if (opts.scanThreads <= 0)
+        opts.scanThreads = 1;
+    if (opts.batchThreads <= 0)
+        opts.batchThreads = (int)std::thread::hardware_concurrency();
+    if (opts.batchThreads <= 0)
+        opts.batchThreads = 1;
+    if (opts.splitMb <= 0)
+        opts.splitMb = 1;
+    if (opts.parseThreads <= 0)
+        opts.parseThreads = (int)std::thread::hardware_concurrency();
+    if (opts.parseThreads <= 0)
+        opts.parseThreads = 1;
+    return true;
+}
+
+void printUsage() {
+    std::cout << "usage: span-file-processor-3 <db-config.ini> <span-file> [options]\n"
+        << "  <span-file> may be plain text, gzip or zip; archives are decompressed in memory\n"
+        << "  --parse-threads N   parse portfolio blocks on N threads (0 = all cores)\n"
+        << "  --unordered         do not restore file order after parallel parsing\n"
+        << "  --batch-size N      rows sent per SQLExecute (default 1000)\n"
+        << "  --streaming         insert while parsing through bounded queues\n"
+        << "  --queue-depth N     portfolio blocks in flight when streaming (default 64)\n"
+        << "  --connections N     load through a staging table on N connections, all-or-nothing\n"
+        << "  --commit-rows N     rows per transaction on each connection (default 50000)\n"
+        << "  --commit-bytes N    also commit after N parameter bytes (default off)\n"
+        << "  --partition K       split records across connections by pfid or segment\n"
+        << "  --delta             skip portfolio blocks unchanged since the last delta load, MERGE the rest and\n"
+        << "                      delete contracts no longer in the file\n"
+        << "  --digest-index P    block digest file for --delta (default span-digests.idx)\n"
+        << "  --sink S            write to odbc (SpanRecords6), a columnar file or null (default odbc)\n"
+        << "  --output P          columnar file path (default <span-file>.spcol)\n"
+        << "  --load-sections     odbc: also insert combined commodities, spreads and currency conversions (see section-inserter.h)\n"
+        << "  --checkpoint P      odbc: commit every --commit-rows rows and journal the position to P; rerun to resume\n"
+        << "  --quarantine P      append malformed blocks to P and go on (default <span-file>.quarantine with --checkpoint)\n"
+        << "  --risk-format F     risk array as legacy text, lossless text or binary (RiskArrayBin)\n"
+        << "  --schema S          odbc: wide (SpanRecords6) or normalized portfolio/series/option tables (see span-schema.h)\n"
+        << "  --bench-parse       time parsing at 1, 2, 4 ... N threads and exit\n"
+        << "  --bench-store       compare record layout footprint and exit\n"
+        << "  --bench-risk        compare risk-array encodings and exit\n"
+        << "  --bench-schema      compare parameter bytes of the wide and normalized schemas and exit\n"
+        << "  --bench-suite       run parse/insert micro benchmarks and end-to-end loads, write a JSON report and exit\n"
+        << "  --bench-iterations N  best of N runs per benchmark (default 3)\n"
+        << "  --report P          bench-suite report path (default bench-report.json)\n"
+        << "  --report-label T    label stored in the report, e.g. a build id\n"
+        << "  --bench-log         compare sync and async logging throughput under contention and exit\n"
+        << "  --self-test         check the risk-array codecs and the gzip/zip reader and exit;\n"
+        << "                      takes no <db-config.ini> or <span-file>\n"
+        << "  --async-log         write the log from a background thread\n"
+        << "  --log-overflow P    full async log queue: block, drop or count (drop and log the count)\n"
+        << "  --log-queue N       async log queue slots (default 8192)\n"
+        << "  --watch             keep running and load every file dropped into the <span-file> directory\n"
+        << "  --archive D         move loaded files to D, failed ones to D/failed (default <span-file>/archive)\n"
+        << "  --poll-ms N         watch: rescan the directory every N ms (default 2000)\n"
+        << "  --watch-polling     watch: rescan only, without inotify or change notifications\n"
+        << "  --batch             load every file of the <span-file> directory or pattern (quote it, e.g. \"hist/*.spn\")\n"
+        << "  --from D, --to D    batch: only files whose name carries a date in D..D (YYYYMMDD or YYYY-MM-DD)\n"
+        << "  --batch-threads N   batch: work-stealing workers (0 = all cores), sharing --connections connections (default 4)\n"
+        << "  --split-mb N        batch: load files with more than N MB of SPAN text as chunks on several workers,\n"
+        << "                      published together (default 64)\n"
+        << "  --snapshot P        also write the records to P as an indexed snapshot for SpanSnapshot readers\n"
+        << "  --bench-snapshot    snapshot open time and lookup latency against re-parsing the XML, and exit\n"
+        << "  --positions P       compute SPAN scan risk of the positions in P (account,pfId,contractId,optContractId,quantity) and exit\n"
+        << "  --scan-output P     scan risk per account (default <positions>.scan.csv)\n"
+        << "  --scan-threads N    accounts computed on N threads (0 = all cores)\n"
+        << "  --scan-scalar       use the portable kernel even where AVX2 is available\n"
+        << "  --bench-scan        scan-risk throughput in accounts/s, scalar and AVX2, and exit\n"
+        << "  --bench-accounts N  synthetic accounts for --bench-scan without --positions (default 100000)\n"
+        << "  --diff B            list contracts of <span-file> whose risk array, volatility, value ... moved since the\n"
+        << "                      earlier publication B, and those added or removed, and exit\n"
+        << "  --diff-output P     diff CSV (default <span-file>.diff.csv)\n"
+        << "  --diff-tolerance X  values within X of each other are equal (default 1e-6)\n"
+        << "  --diff-rel-tolerance X  plus X times the newer value (default 0)\n"
+        << "  --diff-scalar       compare risk arrays with the portable kernel even where AVX2 is available\n"
+        << "  --summary K         also aggregate the records while loading: portfolio (per pfCode), expiry (per pfCode\n"
+        << "                      and expiry), series (per option series) or all, comma separated; odbc writes the\n"
+        << "                      summary tables of summary-inserter.h, the other sinks CSV files\n"
+        << "  --summary-output B  summary CSV files B.portfolio.csv ... (default <span-file>.summary, span-batch.summary\n"
+        << "                      for --batch; with --sink odbc only when given; --watch writes <archive>/<file>.summary)\n"
+        << "  --validate-risk     reprice every option with Black-76 under the 16 SPAN scenarios while loading and\n"
+        << "                      flag published risk arrays off by more than the tolerance (needs the underlying's\n"
+        << "                      <p> and the series <t>)\n"
+        << "  --validate-output P flagged options (default <span-file>.validation.csv, span-batch.validation.csv for\n"
+        << "                      --batch; --watch writes <archive>/<file>.validation.csv)\n"
+        << "  --validate-tolerance X  absolute tolerance per risk-array point (default 0.01)\n"
+        << "  --validate-rel-tolerance X  plus X times the published value (default 0)\n"
+        << "  --validate-threads N  option blocks repriced on N threads (0 = all cores)\n"
+        << "  --validate-scalar   use the portable pricer even where AVX2 is available\n"
+        << "  --bench-validate    repricing throughput in options/s, scalar and AVX2, and exit\n"
+        << "  --metrics-json P    per-stage counters and latency histograms of the load (default span-metrics.json)\n"
+        << "  --metrics-prom P    also write them in Prometheus text format, e.g. for a node exporter textfile collector\n"
+        << "  --generate          write a synthetic SPAN file to <span-file>, then run as usual\n"
+        << "  --gen-portfolios N  portfolios per segment (default 1000)\n"
+        << "  --gen-series N      futures / option series per portfolio (default 3)\n"
+        << "  --gen-options N     options per series (default 10)\n"
+        << "  --gen-risk-points N values per risk array (default 16)\n"
+        << "  --gen-seed N        generator seed (default 1)\n"
+        << "  --gen-priced        options on the generated futures with Black-76 prices and risk arrays\n";
+}
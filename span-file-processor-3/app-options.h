@@ -0,0 +1,87 @@
+#pragma once
+#ifndef APP_OPTIONS_H
+#define APP_OPTIONS_H
+
+#include "risk-codec.h"
+#include "span-schema.h"
+#include "span-generator.h"
+#include "logger.h"
+#include <string>
+
+// Command line: span-file-processor-3 <db-config.ini> <span-file> [options]
+struct AppOptions {
+    std::string configPath;
+    std::string spanFilePath;
+
+    int parseThreads = 1;       // --parse-threads N (0 = all cores)
+    bool unordered = false;     // --unordered: keep records in worker completion order
+    bool benchParse = false;    // --bench-parse: time parsing at 1..N threads, no DB
+    bool benchStore = false;    // --bench-store: record layout footprint, no DB
+    int batchSize = 1000;       // --batch-size N: rows per SQLExecute parameter array
+    bool streaming = false;     // --streaming: overlap read, parse and insert
+    int queueDepth = 64;        // --queue-depth N: portfolio blocks in flight when streaming
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;  // --risk-format legacy|text|binary
+    bool benchRisk = false;     // --bench-risk: risk-array encode/decode cost and size, no DB
+    int connections = 0;        // --connections N: staged all-or-nothing load over N connections (0 = one autocommit connection)
+    int commitRows = 50000;     // --commit-rows N: rows per transaction on each pooled connection
+    int commitBytes = 0;        // --commit-bytes N: parameter bytes per transaction (0 = rows only)
+    std::string partition = "pfid";  // --partition pfid|segment: how records are split across connections
+    bool delta = false;         // --delta: load only portfolio blocks changed since the last delta load
+    std::string digestIndexPath = "span-digests.idx";  // --digest-index PATH
+    std::string sink = "odbc";  // --sink odbc|columnar|null
+    std::string outputPath;     // --output PATH: columnar file (default <span-file>.spcol)
+    bool generate = false;      // --generate: write a synthetic SPAN file to <span-file> first
+    GeneratorOptions generator; // --gen-portfolios/--gen-series/--gen-options/--gen-risk-points/--gen-seed/--gen-priced
+    bool benchSuite = false;    // --bench-suite: parse and load micro/end-to-end benchmarks
+    int benchIterations = 3;    // --bench-iterations N: best of N
+    std::string reportPath = "bench-report.json";  // --report PATH
+    std::string reportLabel;    // --report-label TEXT
+    bool asyncLog = false;      // --async-log: log through the background writer thread
+    LogOverflow logOverflow = LogOverflow::Block;  // --log-overflow block|drop|count
+    int logQueue = 8192;        // --log-queue N: async ring slots
+    bool benchLog = false;      // --bench-log: sync vs async logger under contention, no DB
+    bool selfTest = false;      // --self-test: codec round trips and corrupt-input checks, no DB or input file
+    std::string metricsJsonPath = "span-metrics.json";  // --metrics-json PATH: per-stage counters of a load ("" = off)
+    bool watch = false;         // --watch: <span-file> is an inbox directory, load every file dropped into it
+    std::string archivePath;    // --archive DIR: where loaded files go (default <inbox>/archive)
+    int pollMs = 2000;          // --poll-ms N: inbox rescan interval
+    bool watchPolling = false;  // --watch-polling: rescan only, no inotify / change notifications
+    std::string snapshotPath;   // --snapshot PATH: also write an indexed, memory-mappable snapshot of the records
+    bool benchSnapshot = false; // --bench-snapshot: snapshot open/lookup cost vs re-parsing, no DB
+    std::string positionsPath;  // --positions PATH: compute scan risk of these positions instead of loading
+    std::string scanOutputPath; // --scan-output PATH (default <positions>.scan.csv)
+    int scanThreads = 0;        // --scan-threads N: accounts in parallel (0 = all cores)
+    bool scanScalar = false;    // --scan-scalar: do not use the AVX2 kernel
+    bool benchScan = false;     // --bench-scan: scan-risk accounts/s, scalar vs AVX2, no DB
+    int benchAccounts = 100000; // --bench-accounts N: synthetic accounts when --positions is not given
+    std::string metricsPromPath;  // --metrics-prom PATH: same counters as a Prometheus text file
+    bool loadSections = false;  // --load-sections: also insert ccDef / spread / currency records into their tables
+    std::string checkpointPath; // --checkpoint PATH: resumable load, journal of the last committed block
+    std::string quarantinePath; // --quarantine PATH: malformed blocks go here instead of stopping the load
+    OutputSchema schema = OutputSchema::Wide;  // --schema wide|normalized: SpanRecords6 or portfolio/series/option tables
+    bool benchSchema = false;   // --bench-schema: parameter bytes of each output schema, no DB
+    bool batch = false;         // --batch: <span-file> is a directory or file pattern, load every file in it
+    std::string fromDate;       // --from DATE: batch files dated on or after DATE (YYYYMMDD or YYYY-MM-DD, from the name)
+    std::string toDate;         // --to DATE: and on or before DATE
+    int batchThreads = 0;       // --batch-threads N: work-stealing workers (0 = all cores)
+    int splitMb = 64;           // --split-mb N: batch files with more SPAN text than this load as chunks on several workers
+    std::string diffBasePath;   // --diff BASE: list contracts of <span-file> changed, added or removed since BASE, no DB
+    std::string diffOutputPath; // --diff-output PATH (default <span-file>.diff.csv)
+    double diffTolerance = 1e-6;    // --diff-tolerance X: absolute tolerance of value comparisons
+    double diffRelTolerance = 0.0;  // --diff-rel-tolerance X: plus X times the newer value
+    bool diffScalar = false;    // --diff-scalar: do not use the AVX2 risk-array comparison
+    unsigned summaryKinds = 0;  // --summary KINDS: SummaryKind bits of the aggregates computed while loading (0 = none)
+    std::string summaryOutputPath;  // --summary-output BASE: summary CSV files BASE.<kind>.csv
+    bool validateRisk = false;  // --validate-risk: reprice options with Black-76 and check their published risk arrays
+    std::string validateOutputPath; // --validate-output PATH: options out of tolerance (default <span-file>.validation.csv)
+    double validateTolerance = 0.01;    // --validate-tolerance X: absolute tolerance per risk-array point
+    double validateRelTolerance = 0.0;  // --validate-rel-tolerance X: plus X times the published value
+    int validateThreads = 0;    // --validate-threads N: option blocks in parallel (0 = all cores)
+    bool validateScalar = false;    // --validate-scalar: do not use the AVX2 pricer
+    bool benchValidate = false; // --bench-validate: options repriced per second, scalar vs AVX2, no DB
+};
+
+bool parseCommandLine(int argc, char* argv[], AppOptions& opts);
+void printUsage();
+
+#endif // APP_OPTIONS_H
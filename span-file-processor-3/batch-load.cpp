@@ -0,0 +1,386 @@
+#include "batch-load.h"
+#include "work-stealing-pool.h"
+#include "span-input.h"
+#include "span-tokenizer.h"
+#include "parallel-parser.h"
+#include "logger.h"
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+
+extern Logger logger;
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+bool allDigits(std::string_view text) {
+    return !text.empty() && std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit((unsigned char)c) != 0; });
+}
+
+// YYYYMMDD with a plausible year, month and day
+bool validDate(std::string_view date) {
+    if (date.size() != 8 || !allDigits(date))
+        return false;
+    int year = std::stoi(std::string(date.substr(0, 4)));
+    int month = std::stoi(std::string(date.substr(4, 2)));
+    int day = std::stoi(std::string(date.substr(6, 2)));
+    return year >= 1900 && year <= 2999 && month >= 1 && month <= 12 && day >= 1 && day <= 31;
+}
+
+// '*' matches any run of characters, '?' any one character
+bool wildcardMatch(std::string_view pattern, std::string_view name) {
+    size_t p = 0, n = 0, star = std::string_view::npos, resume = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = n;
+        }
+        else if (star != std::string_view::npos) {
+            p = star + 1;
+            n = ++resume;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+        ++p;
+    return p == pattern.size();
+}
+
+// Hidden and partial files, and what this program writes next to its inputs
+bool skippedName(const std::string& name) {
+    auto endsWith = [&](const char* suffix) {
+        size_t n = std::char_traits<char>::length(suffix);
+        return name.size() >= n && name.compare(name.size() - n, n, suffix) == 0;
+    };
+    return name.empty() || name[0] == '.' || endsWith(".tmp") || endsWith(".part") || endsWith(".partial") ||
+        endsWith(".spcol") || endsWith(".snap") || endsWith(".quarantine");
+}
+
+double megaBytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// Progress of one file; its chunks finish on any worker
+struct FileJob {
+    BatchFile file;
+    std::shared_ptr<SpanInput> input;   // keeps the text the chunks point into
+    std::atomic<int> remaining{ 1 };    // chunk tasks, plus the task that splits the file
+    Clock::time_point start, end;
+    size_t textBytes = 0;
+    std::string target;                 // BatchStaging::begin's, for a split file
+    bool staged = false;
+
+    std::mutex mutex;                   // guards the totals below
+    InsertStats stats;
+    size_t records = 0;
+    size_t chunks = 0;
+    size_t failedChunks = 0;
+    std::string error;
+
+    bool failed() const { return failedChunks > 0 || !error.empty(); }
+};
+
+class BatchRun {
+public:
+    BatchRun(const BatchOptions& opts, const BatchWrite& write, const BatchStaging& staging)
+        : opts(opts), write(write), staging(staging), pool(opts.threads) {}
+
+    void submit(const std::shared_ptr<FileJob>& job) {
+        pool.submit([this, job] { loadFile(job); });
+    }
+    void wait() { pool.wait(); }
+    uint64_t steals() const { return pool.steals(); }
+
+private:
+    void loadFile(const std::shared_ptr<FileJob>& job);
+    void loadChunk(FileJob& job, std::string_view text);
+    void finishPart(const std::shared_ptr<FileJob>& job);
+
+    const BatchOptions& opts;
+    const BatchWrite& write;
+    const BatchStaging& staging;
+    WorkStealingPool pool;
+};
+
+void BatchRun::loadFile(const std::shared_ptr<FileJob>& job) {
+    job->start = Clock::now();
+    auto input = std::make_shared<SpanInput>();
+    std::string_view data;
+    bool opened = false;
+    try {
+        opened = input->open(job->file.path) && input->text(data);
+    }
+    catch (const std::exception& e) {
+        job->error = e.what();
+    }
+    if (!opened) {
+        if (job->error.empty())
+            job->error = "cannot open or decompress the file";
+        finishPart(job);
+        return;
+    }
+    job->input = input;
+    job->textBytes = data.size();
+    metrics.fileBytes.add(input->fileBytes());
+    metrics.textBytes.add(input->textBytes());
+
+    if (data.size() <= opts.splitBytes) {
+        loadChunk(*job, data);
+        finishPart(job);
+        return;
+    }
+
+    if (staging.begin) {
+        if (!staging.begin(job->file, job->target)) {
+            job->error = "cannot stage its chunks";
+            finishPart(job);
+            return;
+        }
+        job->staged = true;
+    }
+
+    // Cut where the first block at or after every splitBytes starts; blocks
+    // never nest, so a search from inside a block finds the one after it
+    for (size_t begin = 0; begin < data.size(); ) {
+        size_t end = data.size();
+        size_t pos = begin + opts.splitBytes;
+        std::string_view block;
+        if (pos < data.size() && nextPortfolioBlock(data, pos, block))
+            end = (size_t)(block.data() - data.data());
+        std::string_view chunk = data.substr(begin, end - begin);
+        job->remaining.fetch_add(1);
+        metrics.batchChunks.add();
+        pool.submit([this, job, chunk] {
+            loadChunk(*job, chunk);
+            finishPart(job);
+        });
+        begin = end;
+    }
+    finishPart(job);
+}
+
+void BatchRun::loadChunk(FileJob& job, std::string_view text) {
+    SpanRecordStore records;
+    InsertStats stats;
+    std::string error;
+    bool ok = false;
+    try {
+        parseSpanParallel(text, 1, true, records);
+        ok = write(records, job.target, stats);
+        if (!ok)
+            error = "write failed, see above";
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(job.mutex);
+    job.chunks++;
+    job.records += records.size();
+    job.stats.batches += stats.batches;
+    job.stats.bytes += stats.bytes;
+    if (ok) {
+        job.stats.rowsInserted += stats.rowsInserted;
+        job.stats.rowsFailed += stats.rowsFailed;
+    }
+    else {
+        // The chunk's transaction was rolled back
+        job.failedChunks++;
+        if (job.error.empty())
+            job.error = error;
+    }
+}
+
+void BatchRun::finishPart(const std::shared_ptr<FileJob>& job) {
+    if (job->remaining.fetch_sub(1) != 1)
+        return;
+    job->input.reset();
+    if (job->staged && !staging.end(job->target, !job->failed())) {
+        // The staged rows were dropped with their table
+        job->stats.rowsInserted = 0;
+        if (job->error.empty())
+            job->error = "publishing its chunks failed";
+    }
+    job->end = Clock::now();
+    double secs = std::chrono::duration<double>(job->end - job->start).count();
+    if (job->failed()) {
+        metrics.filesFailed.add();
+        std::string committed = job->staged ? "none of " + std::to_string(job->chunks) + " staged chunks published" :
+            std::to_string(job->chunks - job->failedChunks) + " of " + std::to_string(job->chunks) + " chunks committed";
+        logger.log("batch: failed " + job->file.path + ": " + job->error + " (" + committed + ")", LogLevel::ERRORS);
+        return;
+    }
+    metrics.filesLoaded.add();
+    logger.log("batch: loaded " + job->file.path + ", " + std::to_string(job->records) + " records in " +
+        std::to_string(job->chunks) + " chunks, " + std::to_string(secs) + " s", LogLevel::INFO);
+}
+
+} // namespace
+
+bool parseBatchDate(const std::string& text, std::string& date) {
+    std::string digits = text;
+    if (text.size() == 10 && text[4] == '-' && text[7] == '-')
+        digits = text.substr(0, 4) + text.substr(5, 2) + text.substr(8, 2);
+    if (!validDate(digits))
+        return false;
+    date = digits;
+    return true;
+}
+
+std::string fileNameDate(const std::string& name) {
+    size_t i = 0;
+    while (i < name.size()) {
+        if (!std::isdigit((unsigned char)name[i])) {
+            ++i;
+            continue;
+        }
+        size_t j = i;
+        while (j < name.size() && std::isdigit((unsigned char)name[j]))
+            ++j;
+        std::string_view run(name.data() + i, j - i);
+        if (run.size() == 8 && validDate(run))
+            return std::string(run);
+        std::string date;
+        if (run.size() == 4 && j + 6 <= name.size() && parseBatchDate(name.substr(i, 10), date) &&
+            (j + 6 == name.size() || !std::isdigit((unsigned char)name[j + 6])))
+            return date;
+        i = j;
+    }
+    return std::string();
+}
+
+bool listBatchFiles(const BatchOptions& opts, std::vector<BatchFile>& files) {
+    files.clear();
+    std::error_code ec;
+    const fs::path pattern(opts.pattern);
+    fs::path dir = pattern;
+    std::string namePattern = "*";
+    if (!fs::is_directory(pattern, ec)) {
+        dir = pattern.parent_path();
+        if (dir.empty())
+            dir = ".";
+        namePattern = pattern.filename().string();
+    }
+
+    std::vector<fs::path> candidates;
+    if (namePattern.find_first_of("*?") == std::string::npos) {
+        if (!fs::is_regular_file(pattern, ec)) {
+            logger.log("batch: " + opts.pattern + " is not a file or directory", LogLevel::ERRORS);
+            return false;
+        }
+        candidates.push_back(pattern);
+    }
+    else {
+        fs::directory_iterator it(dir, ec), end;
+        if (ec) {
+            logger.log("batch: cannot list " + dir.string() + ": " + ec.message(), LogLevel::ERRORS);
+            return false;
+        }
+        for (; it != end; it.increment(ec)) {
+            std::error_code fileEc;
+            std::string name = it->path().filename().string();
+            if (it->is_regular_file(fileEc) && !skippedName(name) && wildcardMatch(namePattern, name))
+                candidates.push_back(it->path());
+        }
+    }
+
+    const bool ranged = !opts.fromDate.empty() || !opts.toDate.empty();
+    size_t outside = 0, undated = 0;
+    for (const fs::path& path : candidates) {
+        BatchFile file;
+        file.path = path.string();
+        file.date = fileNameDate(path.filename().string());
+        file.bytes = (size_t)fs::file_size(path, ec);
+        if (ranged && file.date.empty()) {
+            ++undated;
+            continue;
+        }
+        if ((!opts.fromDate.empty() && file.date < opts.fromDate) || (!opts.toDate.empty() && file.date > opts.toDate)) {
+            ++outside;
+            continue;
+        }
+        files.push_back(file);
+    }
+    std::sort(files.begin(), files.end(), [](const BatchFile& a, const BatchFile& b) {
+        return a.date != b.date ? a.date < b.date : a.path < b.path;
+    });
+
+    logger.log("batch: " + std::to_string(files.size()) + " of " + std::to_string(candidates.size()) + " files in " + opts.pattern +
+        (ranged ? ", " + std::to_string(outside) + " outside " + (opts.fromDate.empty() ? "..." : opts.fromDate) + "-" +
+            (opts.toDate.empty() ? "..." : opts.toDate) + ", " + std::to_string(undated) + " without a date in the name" : ""),
+        undated ? LogLevel::WARNING : LogLevel::INFO);
+    return true;
+}
+
+bool runBatchLoad(const BatchOptions& opts, const BatchWrite& write, const BatchStaging& staging) {
+    std::vector<BatchFile> files;
+    if (!listBatchFiles(opts, files))
+        return false;
+    if (files.empty()) {
+        logger.log("batch: nothing to load", LogLevel::WARNING);
+        return true;
+    }
+
+    std::vector<std::shared_ptr<FileJob>> jobs;
+    for (const BatchFile& file : files) {
+        jobs.push_back(std::make_shared<FileJob>());
+        jobs.back()->file = file;
+    }
+
+    auto start = Clock::now();
+    uint64_t steals = 0;
+    {
+        BatchRun run(opts, write, staging);
+        // Newest first: each worker runs its own deque from the back, so it
+        // starts on its oldest date and thieves take the newest
+        for (auto it = jobs.rbegin(); it != jobs.rend(); ++it)
+            run.submit(*it);
+        run.wait();
+        steals = run.steals();
+    }
+    double wallSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Per file, then the whole batch; file seconds overlap, the total is wall time
+    std::cout << "file  date  text-MB  chunks  records  rows  rejected  seconds  MB/s  status\n";
+    size_t failed = 0, textBytes = 0, records = 0, rows = 0, rejected = 0;
+    for (const auto& job : jobs) {
+        double secs = std::chrono::duration<double>(job->end - job->start).count();
+        std::string line = job->file.path + "  " + (job->file.date.empty() ? "-" : job->file.date) + "  " +
+            std::to_string(megaBytes(job->textBytes)) + "  " + std::to_string(job->chunks) + "  " + std::to_string(job->records) + "  " +
+            std::to_string(job->stats.rowsInserted) + "  " + std::to_string(job->stats.rowsFailed) + "  " + std::to_string(secs) + "  " +
+            std::to_string(secs > 0 ? megaBytes(job->textBytes) / secs : 0.0) + "  " + (job->failed() ? "failed" : "ok");
+        std::cout << line << "\n";
+        logger.log("batch-file " + line, LogLevel::INFO);
+        failed += job->failed() ? 1 : 0;
+        textBytes += job->textBytes;
+        records += job->records;
+        rows += job->stats.rowsInserted;
+        rejected += job->stats.rowsFailed;
+    }
+    std::string total = std::to_string(jobs.size()) + " files, " + std::to_string(failed) + " failed, " +
+        std::to_string(megaBytes(textBytes)) + " MB, " + std::to_string(records) + " records, " + std::to_string(rows) + " rows, " +
+        std::to_string(rejected) + " rejected in " + std::to_string(wallSecs) + " s (" +
+        std::to_string(wallSecs > 0 ? megaBytes(textBytes) / wallSecs : 0.0) + " MB/s, " +
+        std::to_string(wallSecs > 0 ? records / wallSecs : 0.0) + " records/s) on " + std::to_string(opts.threads) + " workers, " +
+        std::to_string(steals) + " tasks stolen";
+    std::cout << "batch: " << total << "\n";
+    logger.log("batch: " + total, failed ? LogLevel::ERRORS : LogLevel::INFO);
+    return failed == 0 && rejected == 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef BATCH_LOAD_H
+#define BATCH_LOAD_H
+
+#include "record-sink.h"
+#include "span-record-store.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BatchOptions {
+    std::string pattern;        // a directory, a file, or a file name pattern with * and ? (dir/cme.2024*.spn)
+    std::string fromDate;       // YYYYMMDD, inclusive; empty for no bound
+    std::string toDate;
+    int threads = 1;            // work-stealing workers
+    size_t splitBytes = 64u << 20;  // SPAN texts larger than this are loaded in chunks of about this size
+};
+
+// One input of the batch; date is the business date in its name
+struct BatchFile {
+    std::string path;
+    std::string date;           // YYYYMMDD, empty if the name has none
+    size_t bytes = 0;
+};
+
+// Writes the records of one chunk and commits them; called on the pool
+// threads, concurrently. target is "" or, for a staged file, what
+// BatchStaging::begin named. stats are the chunk's.
+using BatchWrite = std::function<bool(const SpanRecordStore& records, const std::string& target, InsertStats& stats)>;
+
+// Makes a file that is loaded in chunks all or nothing: begin runs before its
+// first chunk and names the target its chunks are committed to, end runs after
+// the last one and publishes the target when every chunk committed (publish)
+// or discards it. Without it each chunk is committed where it lands.
+struct BatchStaging {
+    std::function<bool(const BatchFile& file, std::string& target)> begin;
+    std::function<bool(const std::string& target, bool publish)> end;
+};
+
+// Normalizes YYYYMMDD or YYYY-MM-DD to YYYYMMDD; false for anything else
+bool parseBatchDate(const std::string& text, std::string& date);
+
+// First YYYYMMDD or YYYY-MM-DD date in a file name, "" if there is none
+std::string fileNameDate(const std::string& name);
+
+// The files opts.pattern names, within the date range, in date then name
+// order. Directories contribute their regular files, minus hidden and
+// partial ones and the outputs this program writes next to its inputs.
+// Without a date range, files without a date in the name are included.
+bool listBatchFiles(const BatchOptions& opts, std::vector<BatchFile>& files);
+
+// Loads every listed file on a WorkStealingPool of opts.threads workers. A
+// file is parsed by the worker that opened it unless its SPAN text is larger
+// than opts.splitBytes; then it is cut at portfolio block boundaries into
+// chunk tasks the other workers steal. Each chunk is written with write, so
+// a chunk is one transaction; with staging a split file's chunks are only
+// published together. Logs and prints a line per file and a total.
+// False if a file failed or had rejected rows.
+bool runBatchLoad(const BatchOptions& opts, const BatchWrite& write, const BatchStaging& staging = BatchStaging());
+
+#endif // BATCH_LOAD_H
@@ -0,0 +1,322 @@
+#include "bench-suite.h"
+#include "span-parser.h"
+#include "parallel-parser.h"
+#include "span-pipeline.h"
+#include "span-record-store.h"
+#include "span-schema.h"
+#include "span-tokenizer.h"
+#include "record-sink.h"
+#include "column-file.h"
+#include "process-memory.h"
+#include "logger.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#if SPAN_WITH_ODBC
+#include "span-inserter.h"
+#include "normalized-inserter.h"
+#include "connection-pool.h"
+#endif
+
+extern Logger logger;
+
+namespace {
+
+struct BenchResult {
+    std::string name;
+    size_t ops = 0;             // calls, records or rows per run
+    size_t bytes = 0;           // input bytes per run, 0 if not meaningful
+    double seconds = 0.0;       // best run
+    bool skipped = false;
+    std::string note;
+};
+
+template <class F>
+double bestOf(int iterations, F run) {
+    double best = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || secs < best)
+            best = secs;
+    }
+    return best;
+}
+
+std::string jsonString(std::string_view text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+            out += buf;
+        }
+        else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string jsonNumber(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.6g", value);
+    return buf;
+}
+
+// Every <ra>...</ra> element of the blocks, as extractRiskArray sees a contract
+std::vector<std::string_view> riskElements(const std::vector<std::string_view>& blocks) {
+    std::vector<std::string_view> elements;
+    for (std::string_view block : blocks) {
+        size_t pos = 0;
+        while ((pos = block.find("<ra>", pos)) != std::string_view::npos) {
+            size_t end = block.find("</ra>", pos);
+            if (end == std::string_view::npos)
+                break;
+            elements.push_back(block.substr(pos, end + 5 - pos));
+            pos = end + 5;
+        }
+    }
+    return elements;
+}
+
+bool writeReport(const std::vector<BenchResult>& results, std::string_view data, size_t records, const BenchSuiteOptions& opts) {
+    std::ofstream out(opts.reportPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        logger.log("Failed to create " + opts.reportPath, LogLevel::ERRORS);
+        return false;
+    }
+    out << "{\n"
+        << "  \"label\": " << jsonString(opts.label) << ",\n"
+        << "  \"input\": " << jsonString(opts.input) << ",\n"
+        << "  \"inputBytes\": " << data.size() << ",\n"
+        << "  \"records\": " << records << ",\n"
+        << "  \"iterations\": " << opts.iterations << ",\n"
+        << "  \"parseThreads\": " << opts.parseThreads << ",\n"
+        << "  \"riskFormat\": " << jsonString(riskEncodingName(opts.riskEncoding)) << ",\n"
+        << "  \"peakMemoryBytes\": " << peakResidentBytes() << ",\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    { \"name\": " << jsonString(r.name);
+        if (r.skipped) {
+            out << ", \"skipped\": true";
+        }
+        else {
+            out << ", \"ops\": " << r.ops << ", \"seconds\": " << jsonNumber(r.seconds)
+                << ", \"nsPerOp\": " << jsonNumber(r.ops ? r.seconds * 1e9 / r.ops : 0.0)
+                << ", \"opsPerSec\": " << jsonNumber(r.seconds > 0 ? r.ops / r.seconds : 0.0);
+            if (r.bytes)
+                out << ", \"mbPerSec\": " << jsonNumber(r.seconds > 0 ? r.bytes / (1024.0 * 1024.0) / r.seconds : 0.0);
+        }
+        if (!r.note.empty())
+            out << ", \"note\": " << jsonString(r.note);
+        out << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    out.close();
+    if (!out) {
+        logger.log("Failed to write " + opts.reportPath, LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+}
+
+bool runBenchSuite(std::string_view data, const BenchSuiteOptions& opts) {
+    int iterations = opts.iterations > 0 ? opts.iterations : 1;
+    std::vector<BenchResult> results;
+
+    std::vector<std::string_view> blocks;
+    std::string_view block;
+    size_t pos = 0;
+    while (nextPortfolioBlock(data, pos, block))
+        blocks.push_back(block);
+    size_t blockBytes = 0;
+    for (std::string_view b : blocks)
+        blockBytes += b.size();
+
+    // Header tags parseSpanXmlBlock reads from every portfolio block
+    static const char* headerTags[] = { "pfId", "pfCode", "currency", "cvf", "valueMeth", "priceMeth", "setlMeth" };
+    {
+        BenchResult r;
+        r.name = "extractTag";
+        r.ops = blocks.size() * (sizeof(headerTags) / sizeof(headerTags[0]));
+        size_t found = 0;
+        r.seconds = bestOf(iterations, [&] {
+            for (std::string_view b : blocks)
+                for (const char* tag : headerTags)
+                    found += extractTag(b, tag).size();
+        });
+        r.note = "portfolio header tags; " + std::to_string(found / iterations) + " value bytes";
+        results.push_back(r);
+    }
+
+    std::vector<std::string_view> elements = riskElements(blocks);
+    {
+        BenchResult r;
+        r.name = "extractRiskArray";
+        r.ops = elements.size();
+        size_t values = 0;
+        r.seconds = bestOf(iterations, [&] {
+            for (std::string_view ra : elements)
+                values += extractRiskArray(ra).a.size();
+        });
+        r.note = std::to_string(values / iterations) + " risk values";
+        results.push_back(r);
+    }
+
+    SpanRecordStore store;
+    {
+        BenchResult r;
+        r.name = "parseSpanXmlBlock";
+        r.bytes = blockBytes;
+        r.seconds = bestOf(iterations, [&] {
+            store.clear();
+            for (std::string_view b : blocks)
+                parseSpanXmlBlock(b, store);
+        });
+        r.ops = store.size();
+        r.note = "records into SpanRecordStore, one thread";
+        results.push_back(r);
+    }
+    size_t records = store.size();
+
+    {
+        BenchResult r;
+        r.name = "insertSpanRecords";
+        r.ops = records;
+#if SPAN_WITH_ODBC
+        if (opts.hDbc) {
+            // Same inserter as the real load, into a temp copy of SpanRecords6
+            const std::wstring table = L"#SpanRecords6_Bench";
+            InserterOptions io;
+            io.batchSize = opts.batchSize;
+            io.riskEncoding = opts.riskEncoding;
+            io.table = table;
+            bool ok = executeSql(opts.hDbc, L"SELECT TOP 0 * INTO " + table + L" FROM SpanRecords6");
+            r.seconds = bestOf(iterations, [&] {
+                if (!ok || !executeSql(opts.hDbc, L"TRUNCATE TABLE " + table)) {
+                    ok = false;
+                    return;
+                }
+                SpanInserter inserter;
+                ok = inserter.open(opts.hDbc, io) && inserter.addAll(store) && inserter.flush() && inserter.stats().rowsFailed == 0;
+            });
+            executeSql(opts.hDbc, L"DROP TABLE " + table);
+            r.skipped = !ok;
+            r.note = std::string(riskEncodingName(opts.riskEncoding)) + " risk format, batch size " + std::to_string(opts.batchSize) +
+                (ok ? "" : "; insert failed, see log");
+        }
+        else
+#endif
+        {
+            r.skipped = true;
+            r.note = "no database connection";
+        }
+        results.push_back(r);
+    }
+
+    {
+        // Same records in the normalized schema; bytes are parameter bytes of each schema
+        const SchemaFootprint fp = measureSchemas(store, opts.riskEncoding);
+        BenchResult r;
+        r.name = "insertNormalized";
+        r.ops = records;
+        const std::string footprint = std::to_string(fp.portfolioRows) + " portfolios, " + std::to_string(fp.seriesRows) +
+            " series; " + std::to_string(fp.normalizedBytes) + " parameter bytes vs " + std::to_string(fp.wideBytes) + " wide (" +
+            std::to_string(fp.wideBytes ? 100.0 * (1.0 - (double)fp.normalizedBytes / fp.wideBytes) : 0.0) + "% less)";
+#if SPAN_WITH_ODBC
+        if (opts.hDbc) {
+            const std::wstring prefix = L"#Bench";
+            InserterOptions io;
+            io.batchSize = opts.batchSize;
+            io.riskEncoding = opts.riskEncoding;
+            const wchar_t* tables[] = { L"SpanPortfolios", L"SpanSeries", L"SpanOptions" };
+            bool ok = true;
+            for (const wchar_t* t : tables)
+                ok = ok && executeSql(opts.hDbc, L"SELECT TOP 0 * INTO " + prefix + t + L" FROM " + t);
+            r.seconds = bestOf(iterations, [&] {
+                for (const wchar_t* t : tables)
+                    ok = ok && executeSql(opts.hDbc, L"TRUNCATE TABLE " + prefix + t);
+                if (!ok)
+                    return;
+                NormalizedInserter inserter;
+                ok = inserter.open(opts.hDbc, io, prefix) && inserter.addAll(store) && inserter.flush() &&
+                    inserter.stats().rowsFailed == 0;
+            });
+            for (const wchar_t* t : tables)
+                executeSql(opts.hDbc, L"DROP TABLE " + prefix + t);
+            r.skipped = !ok;
+            r.note = footprint + (ok ? "" : "; insert failed, see log");
+        }
+        else
+#endif
+        {
+            r.skipped = true;
+            r.note = footprint + "; no database connection";
+        }
+        results.push_back(r);
+    }
+    store.clear();
+    store.shrinkToFit();
+
+    // End-to-end: whole file through the parallel parser into a sink
+    auto endToEnd = [&](const char* name, bool streaming, bool columnar) {
+        BenchResult r;
+        r.name = name;
+        r.bytes = data.size();
+        r.ops = records;
+        bool ok = true;
+        r.seconds = bestOf(iterations, [&] {
+            NullSink nullSink;
+            ColumnFileSink fileSink(opts.scratchPath);
+            RecordSink& sink = columnar ? (RecordSink&)fileSink : (RecordSink&)nullSink;
+            if (streaming) {
+                PipelineOptions pipeline;
+                pipeline.parseThreads = opts.parseThreads;
+                PipelineStats stats;
+                ok = runStreamingLoad(data, sink, pipeline, stats) && ok;
+            }
+            else {
+                SpanRecordStore all;
+                parseSpanParallel(data, opts.parseThreads, true, all);
+                ok = sink.write(all) && sink.finish() && ok;
+            }
+        });
+        if (columnar)
+            std::remove(opts.scratchPath.c_str());
+        r.note = std::to_string(opts.parseThreads) + " parse threads" + (ok ? "" : "; sink failed, see log");
+        results.push_back(r);
+    };
+    endToEnd("load-null-collect", false, false);
+    endToEnd("load-null-streaming", true, false);
+    endToEnd("load-columnar-collect", false, true);
+
+    std::cout << "benchmark  ops  best-seconds  ns/op  ops/s  MB/s\n";
+    for (const BenchResult& r : results) {
+        std::string line = r.name + "  ";
+        if (r.skipped)
+            line += "skipped (" + r.note + ")";
+        else
+            line += std::to_string(r.ops) + "  " + std::to_string(r.seconds) + "  " +
+                std::to_string(r.ops ? r.seconds * 1e9 / r.ops : 0.0) + "  " +
+                std::to_string(r.seconds > 0 ? r.ops / r.seconds : 0.0) + "  " +
+                (r.bytes ? std::to_string(r.seconds > 0 ? r.bytes / (1024.0 * 1024.0) / r.seconds : 0.0) : std::string("-"));
+        std::cout << line << "\n";
+        logger.log("bench-suite " + line, LogLevel::INFO);
+    }
+
+    bool ok = writeReport(results, data, records, opts);
+    if (ok)
+        std::cout << "report written to " << opts.reportPath << "\n";
+    return ok;
+}
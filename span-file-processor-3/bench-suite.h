@@ -0,0 +1,36 @@
+#pragma once
+#ifndef BENCH_SUITE_H
+#define BENCH_SUITE_H
+
+#include "build-config.h"
+#include "risk-codec.h"
+#include <string>
+#include <string_view>
+#if SPAN_WITH_ODBC
+#include <windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+#endif
+
+struct BenchSuiteOptions {
+    int iterations = 3;         // best of N for every measurement
+    int parseThreads = 1;       // for the end-to-end runs
+    std::string label;          // copied into the report, e.g. a build or commit id
+    std::string reportPath = "bench-report.json";
+    std::string scratchPath = "bench-suite.spcol";  // columnar sink output, removed afterwards
+    std::string input;          // file name or generator parameters, for the report
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;
+    size_t batchSize = 1000;
+#if SPAN_WITH_ODBC
+    SQLHDBC hDbc = nullptr;     // insert benchmark into a temp table; skipped if null
+#endif
+};
+
+// Micro benchmarks of the parse hot path (extractTag, extractRiskArray,
+// parseSpanXmlBlock), the insert path in both output schemas and end-to-end loads through the null and
+// columnar sinks. Prints a table and writes the results as JSON to
+// opts.reportPath so runs can be compared across builds.
+bool runBenchSuite(std::string_view data, const BenchSuiteOptions& opts);
+
+#endif // BENCH_SUITE_H
@@ -0,0 +1,15 @@
+#pragma once
+#ifndef BUILD_CONFIG_H
+#define BUILD_CONFIG_H
+
+// SQL Server output needs the Windows ODBC headers. Elsewhere the parser and
+// the file/null sinks build on their own; define SPAN_WITH_ODBC=1 to force it.
+#ifndef SPAN_WITH_ODBC
+#ifdef _WIN32
+#define SPAN_WITH_ODBC 1
+#else
+#define SPAN_WITH_ODBC 0
+#endif
+#endif
+
+#endif // BUILD_CONFIG_H
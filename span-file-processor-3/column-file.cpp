@@ -0,0 +1,565 @@
+#include "column-file.h"
+#include "logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+extern Logger logger;
+
+static bool hostIsLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+static uint64_t align64(uint64_t offset) {
+    return (offset + 63) & ~(uint64_t)63;
+}
+
+void ColumnFileSink::TextColumn::add(std::string_view value) {
+    // Portfolio-level fields repeat for every record of a block
+    if (!dict.empty() && dict[last] == value) {
+        codes.push_back(last);
+        return;
+    }
+    auto it = ids.find(std::string(value));
+    if (it == ids.end()) {
+        it = ids.emplace(std::string(value), (uint32_t)dict.size()).first;
+        dict.emplace_back(value);
+    }
+    last = it->second;
+    codes.push_back(last);
+}
+
+bool ColumnFileSink::write(const SpanRecordStore& records) {
+    for (size_t i = 0; i < records.size(); ++i) {
+        SpanRecordRef r = records.ref(i);
+        segment.add(r.segment);
+        pfId.push_back(r.pfId);
+        pfCode.add(r.pfCode);
+        currency.add(r.currency);
+        cvf.push_back(r.cvf);
+        svf.push_back(r.svf);
+        valueMeth.add(r.valueMeth);
+        priceMeth.add(r.priceMeth);
+        setlMeth.add(r.setlMeth);
+        contractId.push_back(r.contractId);
+        expiry.add(r.expiry);
+        volatility.push_back(r.volatility);
+        settleDate.add(r.settleDate);
+        intraRate.push_back(r.intraRate);
+        priceScan.push_back(r.priceScan);
+        volScan.push_back(r.volScan);
+        optContractId.push_back(r.optContractId);
+        optionType.add(r.optionType);
+        strikePrice.push_back(r.strikePrice);
+        optionValue.push_back(r.optionValue);
+        riskR.push_back(r.riskR);
+        riskCount.push_back((int32_t)r.riskCount);
+        riskD.push_back(r.riskD);
+        riskValues.insert(riskValues.end(), r.riskValues, r.riskValues + r.riskCount);
+    }
+    sections.append(records.sections());
+    counters.rowsInserted += records.size();
+    counters.batches++;
+    return true;
+}
+
+namespace {
+
+// Sequential writer that keeps track of the file offset and pads sections
+class SectionWriter {
+public:
+    explicit SectionWriter(FILE* f) : f(f) {}
+
+    bool put(const void* data, size_t size) {
+        if (size && std::fwrite(data, 1, size, f) != size)
+            return false;
+        offset += size;
+        return true;
+    }
+    bool pad() {
+        static const char zeros[64] = {};
+        return put(zeros, (size_t)(align64(offset) - offset));
+    }
+    uint64_t position() const { return offset; }
+
+private:
+    FILE* f;
+    uint64_t offset = 0;
+};
+
+}
+
+static const double powersOf10[10] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+// Integer code of v at scale, if it fits in 32 bits and divides back to v
+// (a -0 comes back as 0)
+static bool scaledCode(double v, double scale, int32_t& code) {
+    double scaled = v * scale;
+    if (!(std::fabs(scaled) < 2147483647.0))    // also NaN
+        return false;
+    code = (int32_t)std::llround(scaled);
+    return code / scale == v;
+}
+
+// Fewest decimals (0 to 9) at which every value has a code, or -1
+static int scaleRiskValues(const std::vector<double>& values, std::vector<int32_t>& codes) {
+    int decimals = 0;
+    int32_t code;
+    for (double v : values) {
+        while (!scaledCode(v, powersOf10[decimals], code)) {
+            if (++decimals == 10)
+                return -1;
+        }
+    }
+    // Values that passed at fewer decimals still divide back exactly, but may no longer fit
+    codes.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (!scaledCode(values[i], powersOf10[decimals], codes[i]))
+            return -1;
+    }
+    return decimals;
+}
+
+// Rank of every dictionary word in byte order, so text keys compare as integers
+static std::vector<uint32_t> dictionaryRanks(const std::vector<std::string>& dict) {
+    std::vector<uint32_t> order(dict.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return dict[a] < dict[b]; });
+    std::vector<uint32_t> rank(dict.size());
+    for (uint32_t r = 0; r < order.size(); ++r)
+        rank[order[r]] = r;
+    return rank;
+}
+
+// In the order of indexNames in finish(): pfCode, contractId, optContractId, option
+void ColumnFileSink::sortIndexes(std::vector<std::vector<uint32_t>>& indexes) const {
+    const size_t rows = pfId.size();
+    std::vector<uint32_t> identity(rows);
+    for (uint32_t i = 0; i < rows; ++i)
+        identity[i] = i;
+    indexes.assign(4, identity);
+
+    const std::vector<uint32_t> pfRank = dictionaryRanks(pfCode.dict);
+    const std::vector<uint32_t> expiryRank = dictionaryRanks(expiry.dict);
+    const std::vector<uint32_t> typeRank = dictionaryRanks(optionType.dict);
+    auto pf = [&](uint32_t row) { return pfRank[pfCode.codes[row]]; };
+
+    std::stable_sort(indexes[0].begin(), indexes[0].end(), [&](uint32_t a, uint32_t b) { return pf(a) < pf(b); });
+    std::stable_sort(indexes[1].begin(), indexes[1].end(), [&](uint32_t a, uint32_t b) { return contractId[a] < contractId[b]; });
+    std::stable_sort(indexes[2].begin(), indexes[2].end(), [&](uint32_t a, uint32_t b) { return optContractId[a] < optContractId[b]; });
+    std::stable_sort(indexes[3].begin(), indexes[3].end(), [&](uint32_t a, uint32_t b) {
+        if (pf(a) != pf(b))
+            return pf(a) < pf(b);
+        uint32_t ea = expiryRank[expiry.codes[a]], eb = expiryRank[expiry.codes[b]];
+        if (ea != eb)
+            return ea < eb;
+        if (strikePrice[a] != strikePrice[b])
+            return strikePrice[a] < strikePrice[b];
+        return typeRank[optionType.codes[a]] < typeRank[optionType.codes[b]];
+    });
+}
+
+bool ColumnFileSink::finish() {
+    if (!hostIsLittleEndian()) {
+        logger.log("Columnar output is little-endian only", LogLevel::ERRORS);
+        return false;
+    }
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        logger.log("Failed to create columnar file " + path, LogLevel::ERRORS);
+        return false;
+    }
+
+    const size_t rows = pfId.size();
+    uint32_t stride = 0;
+    for (int32_t n : riskCount)
+        stride = (uint32_t)n > stride ? (uint32_t)n : stride;
+
+    // Risk values as int16 or int32 codes where that loses nothing, else doubles
+    std::vector<int32_t> riskCodes;
+    const int decimals = scaleRiskValues(riskValues, riskCodes);
+    uint32_t riskWidth = 8;
+    if (decimals >= 0) {
+        riskWidth = 2;
+        for (int32_t code : riskCodes) {
+            if (code < -32767 || code > 32767) {
+                riskWidth = 4;
+                break;
+            }
+        }
+    }
+
+    struct Column {
+        const char* name;
+        ColumnType type;
+        const void* data;
+        const TextColumn* text;
+    };
+    const Column columns[] = {
+        { "segment", ColumnType::Text, nullptr, &segment },
+        { "pfId", ColumnType::Int32, pfId.data(), nullptr },
+        { "pfCode", ColumnType::Text, nullptr, &pfCode },
+        { "currency", ColumnType::Text, nullptr, &currency },
+        { "cvf", ColumnType::Float64, cvf.data(), nullptr },
+        { "svf", ColumnType::Float64, svf.data(), nullptr },
+        { "valueMeth", ColumnType::Text, nullptr, &valueMeth },
+        { "priceMeth", ColumnType::Text, nullptr, &priceMeth },
+        { "setlMeth", ColumnType::Text, nullptr, &setlMeth },
+        { "contractId", ColumnType::Int32, contractId.data(), nullptr },
+        { "expiry", ColumnType::Text, nullptr, &expiry },
+        { "volatility", ColumnType::Float64, volatility.data(), nullptr },
+        { "settleDate", ColumnType::Text, nullptr, &settleDate },
+        { "intraRate", ColumnType::Float64, intraRate.data(), nullptr },
+        { "priceScan", ColumnType::Float64, priceScan.data(), nullptr },
+        { "volScan", ColumnType::Float64, volScan.data(), nullptr },
+        { "optContractId", ColumnType::Int32, optContractId.data(), nullptr },
+        { "optionType", ColumnType::Text, nullptr, &optionType },
+        { "strikePrice", ColumnType::Float64, strikePrice.data(), nullptr },
+        { "optionValue", ColumnType::Float64, optionValue.data(), nullptr },
+        { "riskR", ColumnType::Int32, riskR.data(), nullptr },
+        { "riskCount", ColumnType::Int32, riskCount.data(), nullptr },
+        { "riskD", ColumnType::Float64, riskD.data(), nullptr },
+        { "risk", ColumnType::Risk, nullptr, nullptr },
+    };
+    const uint32_t dataColumns = (uint32_t)(sizeof(columns) / sizeof(columns[0]));
+    const char* const indexNames[] = { "ix.pfCode", "ix.contractId", "ix.optContract", "ix.option" };
+    std::vector<std::vector<uint32_t>> indexes;
+    if (withIndexes)
+        sortIndexes(indexes);
+    struct Table {
+        const char* name;
+        const void* data;
+        size_t count;
+        uint32_t recordSize;
+    };
+    const Table tables[] = {
+        { "tb.curConv", sections.conversions.data(), sections.conversions.size(), (uint32_t)sizeof(CurrencyConversion) },
+        { "tb.ccDef", sections.commodities.data(), sections.commodities.size(), (uint32_t)sizeof(CombinedCommodity) },
+        { "tb.pfLink", sections.links.data(), sections.links.size(), (uint32_t)sizeof(CommodityLink) },
+        { "tb.spread", sections.spreads.data(), sections.spreads.size(), (uint32_t)sizeof(SpreadDef) },
+        { "tb.spreadLeg", sections.legs.data(), sections.legs.size(), (uint32_t)sizeof(SpreadLeg) },
+    };
+    const uint32_t tableCount = (uint32_t)(sizeof(tables) / sizeof(tables[0]));
+    const uint32_t columnCount = dataColumns + (uint32_t)indexes.size() + tableCount;
+
+    ColumnFileHeader header = {};
+    std::memcpy(header.magic, columnFileMagic, sizeof(header.magic));
+    header.version = columnFileVersion;
+    header.columnCount = columnCount;
+    header.rowCount = rows;
+    header.riskStride = stride;
+    header.riskDecimals = decimals >= 0 ? (uint32_t)decimals : 0;
+    std::vector<ColumnEntry> entries(columnCount);
+
+    // Header and directory are rewritten once the offsets are known
+    SectionWriter out(f);
+    bool ok = out.put(&header, sizeof(header)) && out.put(entries.data(), entries.size() * sizeof(ColumnEntry));
+
+    for (uint32_t c = 0; ok && c < dataColumns; ++c) {
+        const Column& col = columns[c];
+        ColumnEntry& e = entries[c];
+        std::strncpy(e.name, col.name, sizeof(e.name) - 1);
+        e.type = col.type;
+        ok = out.pad();
+        e.offset = out.position();
+
+        if (col.type == ColumnType::Int32) {
+            ok = ok && out.put(col.data, rows * sizeof(int32_t));
+        }
+        else if (col.type == ColumnType::Float64) {
+            ok = ok && out.put(col.data, rows * sizeof(double));
+        }
+        else if (col.type == ColumnType::Risk) {
+            e.codeWidth = riskWidth;
+            std::vector<unsigned char> row((size_t)stride * riskWidth);
+            size_t next = 0;
+            for (size_t i = 0; ok && i < rows; ++i) {
+                size_t n = (size_t)riskCount[i];
+                std::fill(row.begin(), row.end(), (unsigned char)0);
+                unsigned char* p = row.data();
+                for (size_t k = 0; k < n; ++k, ++next, p += riskWidth) {
+                    if (riskWidth == 8) {
+                        std::memcpy(p, &riskValues[next], sizeof(double));
+                    }
+                    else if (riskWidth == 4) {
+                        std::memcpy(p, &riskCodes[next], sizeof(int32_t));
+                    }
+                    else {
+                        int16_t code = (int16_t)riskCodes[next];
+                        std::memcpy(p, &code, sizeof(code));
+                    }
+                }
+                ok = out.put(row.data(), row.size());
+            }
+        }
+        else {
+            const TextColumn& text = *col.text;
+            e.codeWidth = text.dict.size() <= 0x100 ? 1 : text.dict.size() <= 0x10000 ? 2 : 4;
+            std::vector<unsigned char> codes(rows * e.codeWidth);
+            for (size_t i = 0; i < rows; ++i) {
+                uint32_t code = text.codes[i];
+                for (uint32_t b = 0; b < e.codeWidth; ++b)
+                    codes[i * e.codeWidth + b] = (unsigned char)(code >> (8 * b));
+            }
+            ok = ok && out.put(codes.data(), codes.size());
+
+            std::vector<uint32_t> offsets;
+            offsets.reserve(text.dict.size() + 2);
+            offsets.push_back((uint32_t)text.dict.size());
+            uint32_t at = 0;
+            for (const auto& word : text.dict) {
+                offsets.push_back(at);
+                at += (uint32_t)word.size();
+            }
+            offsets.push_back(at);
+            ok = ok && out.pad();
+            e.dictOffset = out.position();
+            ok = ok && out.put(offsets.data(), offsets.size() * sizeof(uint32_t));
+            for (const auto& word : text.dict)
+                ok = ok && out.put(word.data(), word.size());
+            e.dictSize = out.position() - e.dictOffset;
+            e.size = codes.size();
+            continue;
+        }
+        e.size = out.position() - e.offset;
+    }
+    for (size_t i = 0; ok && i < indexes.size(); ++i) {
+        ColumnEntry& e = entries[dataColumns + i];
+        std::strncpy(e.name, indexNames[i], sizeof(e.name) - 1);
+        e.type = ColumnType::Index;
+        ok = out.pad();
+        e.offset = out.position();
+        ok = ok && out.put(indexes[i].data(), rows * sizeof(uint32_t));
+        e.size = out.position() - e.offset;
+    }
+    for (uint32_t t = 0; ok && t < tableCount; ++t) {
+        ColumnEntry& e = entries[dataColumns + indexes.size() + t];
+        std::strncpy(e.name, tables[t].name, sizeof(e.name) - 1);
+        e.type = ColumnType::Table;
+        e.codeWidth = tables[t].recordSize;
+        ok = out.pad();
+        e.offset = out.position();
+        ok = ok && out.put(tables[t].data, tables[t].count * tables[t].recordSize);
+        e.size = out.position() - e.offset;
+    }
+
+    fileBytes = (size_t)out.position();
+    ok = ok && std::fseek(f, 0, SEEK_SET) == 0 &&
+        std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+        std::fwrite(entries.data(), sizeof(ColumnEntry), entries.size(), f) == entries.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) {
+        logger.log("Failed to write columnar file " + path, LogLevel::ERRORS);
+        return false;
+    }
+    logger.log("wrote " + std::to_string(rows) + " records and " + std::to_string(sections.size()) + " section records to " + path +
+        " (" + std::to_string(fileBytes) + " bytes, risk stride " + std::to_string(stride) +
+        (riskWidth == 8 ? std::string(" as doubles") : " as int" + std::to_string(riskWidth * 8) + " codes, " + std::to_string(decimals) + " decimals") +
+        (withIndexes ? ", with indexes)" : ")"), LogLevel::INFO);
+    return true;
+}
+
+void ColumnFileSink::abort() {
+    std::remove(path.c_str());
+}
+
+TextColumnView::TextColumnView(const unsigned char* codes, uint32_t codeWidth, const char* dict)
+    : codes(codes), codeWidth(codeWidth) {
+    std::memcpy(&count, dict, sizeof(count));
+    offsets = (const uint32_t*)(dict + sizeof(uint32_t));
+    chars = (const char*)(offsets + count + 1);
+}
+
+uint32_t TextColumnView::code(size_t row) const {
+    const unsigned char* p = codes + row * codeWidth;
+    uint32_t code = 0;
+    for (uint32_t b = 0; b < codeWidth; ++b)
+        code |= (uint32_t)p[b] << (8 * b);
+    return code;
+}
+
+std::string_view TextColumnView::word(uint32_t code) const {
+    return std::string_view(chars + offsets[code], offsets[code + 1] - offsets[code]);
+}
+
+std::string_view TextColumnView::at(size_t row) const {
+    return word(code(row));
+}
+
+bool ColumnFile::open(const std::string& path) {
+    header = nullptr;
+    entries = nullptr;
+    risk = nullptr;
+    if (!hostIsLittleEndian() || !file.open(path))
+        return false;
+
+    std::string_view data = file.view();
+    auto fail = [&](const char* why) {
+        logger.log("Columnar file " + path + ": " + why, LogLevel::ERRORS);
+        file.close();
+        return false;
+    };
+    if (data.size() < sizeof(ColumnFileHeader))
+        return fail("too short");
+    const ColumnFileHeader* h = (const ColumnFileHeader*)data.data();
+    if (std::memcmp(h->magic, columnFileMagic, sizeof(h->magic)) != 0 || h->version < 1 || h->version > columnFileVersion)
+        return fail("not a version 1 to 4 columnar file");
+    if (sizeof(ColumnFileHeader) + (uint64_t)h->columnCount * sizeof(ColumnEntry) > data.size())
+        return fail("truncated directory");
+
+    // Before version 4 the risk block is always doubles
+    const uint32_t riskBytes = h->version >= 4 ? 0 : (uint32_t)sizeof(double);
+    if (h->version >= 4 && h->riskDecimals > 9)
+        return fail("bad risk decimals");
+
+    const ColumnEntry* e = (const ColumnEntry*)(data.data() + sizeof(ColumnFileHeader));
+    for (uint32_t c = 0; c < h->columnCount; ++c) {
+        uint64_t expected = 0;
+        uint32_t width = riskBytes ? riskBytes : e[c].codeWidth;
+        switch (e[c].type) {
+        case ColumnType::Int32: expected = h->rowCount * sizeof(int32_t); break;
+        case ColumnType::Float64: expected = h->rowCount * sizeof(double); break;
+        case ColumnType::Risk:
+            if (width != 2 && width != 4 && width != 8)
+                return fail("bad risk value width");
+            expected = h->rowCount * h->riskStride * width;
+            break;
+        case ColumnType::Text: expected = h->rowCount * e[c].codeWidth; break;
+        case ColumnType::Index: expected = h->rowCount * sizeof(uint32_t); break;
+        case ColumnType::Table:
+            if (!e[c].codeWidth || e[c].size % e[c].codeWidth)
+                return fail("bad table record size");
+            expected = e[c].size;
+            break;
+        }
+        if (e[c].size != expected || e[c].offset > data.size() || e[c].size > data.size() - e[c].offset)
+            return fail("column out of bounds");
+        if (e[c].type != ColumnType::Text)
+            continue;
+        if (e[c].codeWidth != 1 && e[c].codeWidth != 2 && e[c].codeWidth != 4)
+            return fail("bad code width");
+        if (e[c].dictOffset > data.size() || e[c].dictSize > data.size() - e[c].dictOffset || e[c].dictSize < sizeof(uint32_t))
+            return fail("dictionary out of bounds");
+        uint32_t words;
+        std::memcpy(&words, data.data() + e[c].dictOffset, sizeof(words));
+        if (((uint64_t)words + 2) * sizeof(uint32_t) > e[c].dictSize)
+            return fail("dictionary out of bounds");
+    }
+    header = h;
+    entries = e;
+    risk = find("risk", ColumnType::Risk);
+    riskWidth = riskBytes ? riskBytes : risk ? risk->codeWidth : 0;
+    riskScale = h->version >= 4 ? powersOf10[h->riskDecimals] : 1.0;
+    return true;
+}
+
+const ColumnEntry* ColumnFile::find(std::string_view name, ColumnType type) const {
+    if (!header)
+        return nullptr;
+    for (uint32_t c = 0; c < header->columnCount; ++c) {
+        const ColumnEntry& e = entries[c];
+        if (e.type == type && name == std::string_view(e.name, strnlen(e.name, sizeof(e.name))))
+            return &e;
+    }
+    return nullptr;
+}
+
+const int32_t* ColumnFile::int32Column(std::string_view name) const {
+    const ColumnEntry* e = find(name, ColumnType::Int32);
+    return e ? (const int32_t*)(file.view().data() + e->offset) : nullptr;
+}
+
+const double* ColumnFile::float64Column(std::string_view name) const {
+    const ColumnEntry* e = find(name, ColumnType::Float64);
+    return e ? (const double*)(file.view().data() + e->offset) : nullptr;
+}
+
+bool ColumnFile::textColumn(std::string_view name, TextColumnView& view) const {
+    const ColumnEntry* e = find(name, ColumnType::Text);
+    if (!e)
+        return false;
+    const char* base = file.view().data();
+    view = TextColumnView((const unsigned char*)(base + e->offset), e->codeWidth, base + e->dictOffset);
+    return true;
+}
+
+bool ColumnFile::riskRow(size_t row, double* out) const {
+    if (!risk)
+        return false;
+    const uint32_t stride = riskStride();
+    const char* p = file.view().data() + risk->offset + (uint64_t)row * stride * riskWidth;
+    for (uint32_t k = 0; k < stride; ++k, p += riskWidth) {
+        if (riskWidth == 8) {
+            std::memcpy(&out[k], p, sizeof(double));
+        }
+        else if (riskWidth == 4) {
+            int32_t code;
+            std::memcpy(&code, p, sizeof(code));
+            out[k] = code / riskScale;
+        }
+        else {
+            int16_t code;
+            std::memcpy(&code, p, sizeof(code));
+            out[k] = code / riskScale;
+        }
+    }
+    return true;
+}
+
+const uint32_t* ColumnFile::index(std::string_view name) const {
+    const ColumnEntry* e = find(name, ColumnType::Index);
+    return e ? (const uint32_t*)(file.view().data() + e->offset) : nullptr;
+}
+
+SpanRecord ColumnFile::record(size_t row) const {
+    SpanRecord rec;
+    TextColumnView text;
+    auto str = [&](const char* name) {
+        return textColumn(name, text) ? std::string(text.at(row)) : std::string();
+    };
+    auto i32 = [&](const char* name) {
+        const int32_t* col = int32Column(name);
+        return col ? col[row] : 0;
+    };
+    auto f64 = [&](const char* name) {
+        const double* col = float64Column(name);
+        return col ? col[row] : 0.0;
+    };
+
+    rec.segment = str("segment");
+    rec.pfId = i32("pfId");
+    rec.pfCode = str("pfCode");
+    rec.currency = str("currency");
+    rec.cvf = f64("cvf");
+    rec.svf = f64("svf");
+    rec.valueMeth = str("valueMeth");
+    rec.priceMeth = str("priceMeth");
+    rec.setlMeth = str("setlMeth");
+    rec.contractId = i32("contractId");
+    rec.expiry = str("expiry");
+    rec.volatility = f64("volatility");
+    rec.settleDate = str("settleDate");
+    rec.intraRate = f64("intraRate");
+    rec.priceScan = f64("priceScan");
+    rec.volScan = f64("volScan");
+    rec.optContractId = i32("optContractId");
+    rec.optionType = str("optionType");
+    rec.strikePrice = f64("strikePrice");
+    rec.optionValue = f64("optionValue");
+    rec.riskArray.r = i32("riskR");
+    rec.riskArray.d = f64("riskD");
+    int32_t n = i32("riskCount");
+    if (n > 0) {
+        rec.riskArray.a.resize(riskStride());
+        if (riskRow(row, rec.riskArray.a.data()))
+            rec.riskArray.a.resize((size_t)n);
+        else
+            rec.riskArray.a.clear();
+    }
+    return rec;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#ifndef COLUMN_FILE_H
+#define COLUMN_FILE_H
+
+#include "record-sink.h"
+#include "mapped-file.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Columnar SPAN record file, meant to be memory-mapped and read in place.
+// Little-endian; every section starts on a 64-byte boundary.
+//
+//   ColumnFileHeader
+//   ColumnEntry[columnCount]
+//   column data ...
+//
+// Int32/Float64 columns are plain arrays of rowCount values. Text columns are
+// dictionary encoded: rowCount codes of codeWidth (1, 2 or 4) bytes, then a
+// dictionary of uint32 count, uint32 offsets[count + 1] and the characters.
+// The risk column is a fixed-stride block of rowCount * riskStride values,
+// shorter arrays zero-padded; riskCount holds each row's real length.
+//
+// Version 2 adds optional Index sections, rowCount uint32 row numbers in key
+// order (ties in file order), named after their key:
+//   ix.pfCode         pfCode
+//   ix.contractId     contractId
+//   ix.optContract    optContractId
+//   ix.option         pfCode, expiry, strikePrice, optionType
+// Text keys sort by their bytes as unsigned char.
+//
+// Version 3 adds the section records (span-sections.h) as Table sections of
+// their own length: count records of codeWidth bytes each, stored as the structs
+//   tb.curConv        CurrencyConversion
+//   tb.ccDef          CombinedCommodity
+//   tb.pfLink         CommodityLink
+//   tb.spread         SpreadDef
+//   tb.spreadLeg      SpreadLeg
+//
+// Version 4 compresses the risk block when every risk value is a decimal of at
+// most 9 places, as parsed from SPAN text: the block then holds int16 or int32
+// codes (the Risk entry's codeWidth, 2 or 4) with value = code / 10^riskDecimals,
+// which gives back the parsed doubles exactly (a -0 as 0). Otherwise it holds
+// doubles (codeWidth 8). Versions 1 to 3 always hold doubles and still open.
+
+const char columnFileMagic[8] = { 'S', 'P', 'A', 'N', 'C', 'O', 'L', 0 };
+const uint32_t columnFileVersion = 4;
+
+enum class ColumnType : uint32_t { Int32 = 1, Float64 = 2, Text = 3, Risk = 4, Index = 5, Table = 6 };
+
+struct ColumnFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t columnCount;
+    uint64_t rowCount;
+    uint32_t riskStride;
+    uint32_t riskDecimals;      // version 4, scaled risk block
+};
+
+struct ColumnEntry {
+    char name[16];
+    ColumnType type;
+    uint32_t codeWidth;         // Text: bytes per code, Table: bytes per record, Risk: bytes per value (version 4)
+    uint64_t offset;
+    uint64_t size;
+    uint64_t dictOffset;        // Text: dictionary section
+    uint64_t dictSize;
+};
+
+// Accumulates records column by column and writes the file in finish().
+// Columns are held in memory until then (dictionary codes for text fields).
+// withIndexes adds the lookup indexes, making the file a snapshot for SpanSnapshot.
+class ColumnFileSink : public RecordSink {
+public:
+    explicit ColumnFileSink(const std::string& path, bool withIndexes = false) : path(path), withIndexes(withIndexes) {}
+
+    bool write(const SpanRecordStore& records) override;
+    bool finish() override;
+    void abort() override;      // removes path, so no earlier file passes for this load's output
+    InsertStats stats() const override { return counters; }
+
+    size_t bytesWritten() const { return fileBytes; }
+
+private:
+    struct TextColumn {
+        std::unordered_map<std::string, uint32_t> ids;
+        std::vector<std::string> dict;
+        std::vector<uint32_t> codes;
+        uint32_t last = 0;
+
+        void add(std::string_view value);
+    };
+
+    void sortIndexes(std::vector<std::vector<uint32_t>>& indexes) const;
+
+    std::string path;
+    bool withIndexes = false;
+    InsertStats counters;
+    size_t fileBytes = 0;
+
+    TextColumn segment, pfCode, currency, valueMeth, priceMeth, setlMeth, expiry, settleDate, optionType;
+    std::vector<int32_t> pfId, contractId, optContractId, riskR, riskCount;
+    std::vector<double> cvf, svf, volatility, intraRate, priceScan, volScan, strikePrice, optionValue, riskD;
+    std::vector<double> riskValues;
+    SpanSections sections;
+};
+
+// Dictionary-coded text column of a mapped ColumnFile
+class TextColumnView {
+public:
+    TextColumnView() = default;
+    TextColumnView(const unsigned char* codes, uint32_t codeWidth, const char* dict);
+
+    std::string_view at(size_t row) const;
+    uint32_t code(size_t row) const;
+    uint32_t dictionarySize() const { return count; }
+    std::string_view word(uint32_t code) const;
+
+private:
+    const unsigned char* codes = nullptr;
+    uint32_t codeWidth = 0;
+    uint32_t count = 0;
+    const uint32_t* offsets = nullptr;
+    const char* chars = nullptr;
+};
+
+// Read-only access to a columnar file through a memory mapping; no copies
+class ColumnFile {
+public:
+    bool open(const std::string& path);
+
+    size_t rows() const { return header ? (size_t)header->rowCount : 0; }
+    uint32_t riskStride() const { return header ? header->riskStride : 0; }
+
+    // nullptr if the column does not exist or has another type
+    const int32_t* int32Column(std::string_view name) const;
+    const double* float64Column(std::string_view name) const;
+    bool textColumn(std::string_view name, TextColumnView& view) const;
+    // Decodes row's riskStride risk values into out; false without a risk column
+    bool riskRow(size_t row, double* out) const;
+    // Row numbers of an Index section, nullptr if the file has none of that name
+    const uint32_t* index(std::string_view name) const;
+    // Records of a Table section; nullptr (count 0) if absent or not of T's size
+    template <typename T>
+    const T* table(std::string_view name, size_t& count) const {
+        const ColumnEntry* e = find(name, ColumnType::Table);
+        count = e && e->codeWidth == sizeof(T) ? (size_t)(e->size / sizeof(T)) : 0;
+        return count ? (const T*)(file.view().data() + e->offset) : nullptr;
+    }
+
+    SpanRecord record(size_t row) const;
+
+private:
+    const ColumnEntry* find(std::string_view name, ColumnType type) const;
+
+    MappedFile file;
+    const ColumnFileHeader* header = nullptr;
+    const ColumnEntry* entries = nullptr;
+    const ColumnEntry* risk = nullptr;
+    uint32_t riskWidth = 0;     // bytes per risk value
+    double riskScale = 1.0;     // 10^riskDecimals
+};
+
+#endif // COLUMN_FILE_H
@@ -0,0 +1,302 @@
+#include "compressed-input.h"
+#include "span-tokenizer.h"
+#include <chrono>
+#include <cstring>
+
+static uint32_t le16(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t le32(const unsigned char* p) {
+    return le16(p) | (le16(p + 2) << 16);
+}
+
+InputFormat detectInputFormat(std::string_view data) {
+    const unsigned char* p = (const unsigned char*)data.data();
+    if (data.size() >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+        return InputFormat::Gzip;
+    if (data.size() >= 4 && le32(p) == 0x04034b50)
+        return InputFormat::Zip;
+    return InputFormat::Plain;
+}
+
+const char* inputFormatName(InputFormat format) {
+    switch (format) {
+    case InputFormat::Gzip: return "gzip";
+    case InputFormat::Zip: return "zip";
+    default: return "plain";
+    }
+}
+
+// Inflates one deflate stream and checks the CRC and size the container recorded
+static bool inflateChecked(const unsigned char* in, size_t size, size_t chunkSize, const InflateOutput& out,
+    size_t& consumed, uint32_t& crc, uint64_t& length, std::string& error) {
+    crc = 0;
+    length = 0;
+    bool stopped = false;
+    InflateOutput counted = [&](const char* p, size_t n) {
+        crc = crc32Update(crc, p, n);
+        length += n;
+        if (!out(p, n)) {
+            stopped = true;
+            return false;
+        }
+        return true;
+    };
+    Inflater inflater;
+    if (inflater.inflate(in, size, chunkSize, counted, consumed))
+        return true;
+    if (!stopped)
+        error = "corrupt deflate data: " + inflater.error();
+    return false;
+}
+
+static bool decompressGzip(const unsigned char* d, size_t size, size_t chunkSize, const InflateOutput& out, std::string& error) {
+    size_t pos = 0;
+    if (size == 0) {
+        error = "gzip: empty file";
+        return false;
+    }
+    while (pos < size) {
+        if (d[pos] != 0x1f || size - pos < 18 || d[pos + 1] != 0x8b) {
+            // Some writers pad the file with zeros after the last member
+            while (pos < size && d[pos] == 0)
+                ++pos;
+            if (pos == size)
+                break;
+            error = "gzip: bad member header at offset " + std::to_string(pos);
+            return false;
+        }
+        if (d[pos + 2] != 8) {
+            error = "gzip: unsupported compression method";
+            return false;
+        }
+        unsigned flags = d[pos + 3];
+        size_t p = pos + 10;
+        if (flags & 4) {
+            if (p + 2 > size) {
+                error = "gzip: truncated header";
+                return false;
+            }
+            p += 2 + le16(d + p);
+        }
+        for (unsigned bit : { 8u, 16u }) {          // file name, comment
+            if (!(flags & bit))
+                continue;
+            while (p < size && d[p])
+                ++p;
+            ++p;
+        }
+        if (flags & 2)
+            p += 2;
+        if (p >= size) {
+            error = "gzip: truncated header";
+            return false;
+        }
+
+        size_t consumed = 0;
+        uint32_t crc = 0;
+        uint64_t length = 0;
+        if (!inflateChecked(d + p, size - p, chunkSize, out, consumed, crc, length, error))
+            return false;
+        p += consumed;
+        if (size - p < 8) {
+            error = "gzip: truncated trailer";
+            return false;
+        }
+        if (le32(d + p) != crc || le32(d + p + 4) != (uint32_t)length) {
+            error = "gzip: CRC or length mismatch";
+            return false;
+        }
+        pos = p + 8;
+    }
+    return true;
+}
+
+static bool decompressZip(const unsigned char* d, size_t size, size_t chunkSize, const InflateOutput& out, std::string& error) {
+    // End of central directory: 22 bytes plus up to 64 KB of comment at the end
+    size_t eocd = std::string::npos;
+    size_t lowest = size > 22 + 65535 ? size - 22 - 65535 : 0;
+    for (size_t i = size >= 22 ? size - 22 + 1 : 0; i-- > lowest;) {
+        if (le32(d + i) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd == std::string::npos) {
+        error = "zip: no end of central directory";
+        return false;
+    }
+    uint32_t entries = le16(d + eocd + 10);
+    uint32_t dirOffset = le32(d + eocd + 16);
+    if (entries == 0xffff || dirOffset == 0xffffffff) {
+        error = "zip: ZIP64 archives are not supported";
+        return false;
+    }
+
+    size_t p = dirOffset;
+    for (uint32_t e = 0; e < entries; ++e) {
+        if (p + 46 > size || le32(d + p) != 0x02014b50) {
+            error = "zip: bad central directory entry";
+            return false;
+        }
+        uint32_t flags = le16(d + p + 8);
+        uint32_t method = le16(d + p + 10);
+        uint32_t crc = le32(d + p + 16);
+        uint32_t compressed = le32(d + p + 20);
+        uint32_t uncompressed = le32(d + p + 24);
+        uint32_t nameLen = le16(d + p + 28);
+        uint32_t extraLen = le16(d + p + 30);
+        uint32_t commentLen = le16(d + p + 32);
+        uint32_t local = le32(d + p + 42);
+        std::string name((const char*)d + p + 46, p + 46 + nameLen <= size ? nameLen : 0);
+        p += 46 + nameLen + extraLen + commentLen;
+
+        if (!name.empty() && name.back() == '/')
+            continue;                               // directory
+        if (compressed == 0xffffffff || uncompressed == 0xffffffff || local == 0xffffffff) {
+            error = "zip: ZIP64 entry " + name + " is not supported";
+            return false;
+        }
+        if (flags & 1) {
+            error = "zip: entry " + name + " is encrypted";
+            return false;
+        }
+        if ((size_t)local + 30 > size || le32(d + local) != 0x04034b50) {
+            error = "zip: bad local header for " + name;
+            return false;
+        }
+        size_t dataStart = (size_t)local + 30 + le16(d + local + 26) + le16(d + local + 28);
+        if (dataStart + compressed > size) {
+            error = "zip: entry " + name + " is truncated";
+            return false;
+        }
+
+        uint32_t actualCrc = 0;
+        uint64_t length = 0;
+        if (method == 0) {
+            for (size_t off = 0; off < compressed; off += chunkSize) {
+                size_t n = compressed - off < chunkSize ? compressed - off : chunkSize;
+                if (!out((const char*)d + dataStart + off, n))
+                    return false;
+            }
+            actualCrc = crc32Update(0, d + dataStart, compressed);
+            length = compressed;
+        }
+        else if (method == 8) {
+            size_t consumed = 0;
+            if (!inflateChecked(d + dataStart, compressed, chunkSize, out, consumed, actualCrc, length, error))
+                return false;
+        }
+        else {
+            error = "zip: entry " + name + " uses unsupported method " + std::to_string(method);
+            return false;
+        }
+        if (actualCrc != crc || length != uncompressed) {
+            error = "zip: CRC or length mismatch in " + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool decompressSpan(std::string_view data, InputFormat format, size_t chunkSize, const InflateOutput& out, std::string& error) {
+    error.clear();
+    const unsigned char* d = (const unsigned char*)data.data();
+    if (chunkSize == 0)
+        chunkSize = 1;
+    if (format == InputFormat::Gzip)
+        return decompressGzip(d, data.size(), chunkSize, out, error);
+    if (format == InputFormat::Zip)
+        return decompressZip(d, data.size(), chunkSize, out, error);
+    for (size_t off = 0; off < data.size(); off += chunkSize)
+        if (!out(data.data() + off, data.size() - off < chunkSize ? data.size() - off : chunkSize))
+            return false;
+    return true;
+}
+
+CompressedBlockReader::CompressedBlockReader(std::string_view data, InputFormat format, size_t chunkSize, size_t chunksInFlight)
+    : chunks(chunksInFlight) {
+    worker = std::thread([this, data, format, chunkSize] {
+        auto start = std::chrono::steady_clock::now();
+        std::string pending;
+        pending.reserve(chunkSize);
+        std::string error;
+        bool ok = decompressSpan(data, format, chunkSize, [&](const char* p, size_t n) {
+            if (stop)
+                return false;
+            inflated += n;
+            pending.append(p, n);
+            if (pending.size() < chunkSize)
+                return true;
+            if (!chunks.push(std::move(pending)))
+                return false;
+            pending = std::string();
+            pending.reserve(chunkSize);
+            return true;
+        }, error);
+        if (ok && !pending.empty())
+            chunks.push(std::move(pending));
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!ok && !error.empty())
+            errorText = error;
+        chunks.close();
+    });
+}
+
+CompressedBlockReader::~CompressedBlockReader() {
+    close();
+}
+
+void CompressedBlockReader::close() {
+    stop = true;
+    chunks.close();
+    if (worker.joinable())
+        worker.join();
+}
+
+// Where a block that nextPortfolioBlock could not finish may start: the first
+// opening tag at or after from, or a '<' too close to the end to tell
+static size_t unfinishedBlockStart(std::string_view text, size_t from) {
+    for (size_t lt = text.find('<', from); lt != std::string_view::npos; lt = text.find('<', lt + 1)) {
+        if (text.size() - lt < spanBlockTagMaxSize)
+            return lt;
+        for (const SpanBlockTag& tag : spanBlockTags)
+            if (text.compare(lt, tag.open.size(), tag.open) == 0)
+                return lt;
+    }
+    return text.size();
+}
+
+bool CompressedBlockReader::next(std::string_view& block, std::shared_ptr<const std::string>& owner, size_t& endOffset) {
+    for (;;) {
+        size_t carryFrom = 0;
+        if (buffer) {
+            std::string_view text(*buffer);
+            size_t start = pos;
+            if (nextPortfolioBlock(text, pos, block)) {
+                owner = buffer;
+                endOffset = bufferStart + pos;
+                return true;
+            }
+            carryFrom = unfinishedBlockStart(text, start);
+        }
+
+        std::string chunk;
+        if (!chunks.pop(chunk)) {
+            buffer.reset();
+            return false;
+        }
+        if (buffer && carryFrom < buffer->size()) {
+            std::string joined;
+            joined.reserve(buffer->size() - carryFrom + chunk.size());
+            joined.append(*buffer, carryFrom, std::string::npos);
+            joined += chunk;
+            chunk = std::move(joined);
+        }
+        if (buffer)
+            bufferStart += carryFrom;
+        buffer = std::make_shared<const std::string>(std::move(chunk));
+        pos = 0;
+    }
+}
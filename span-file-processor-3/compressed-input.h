@@ -0,0 +1,67 @@
+#pragma once
+#ifndef COMPRESSED_INPUT_H
+#define COMPRESSED_INPUT_H
+
+#include "inflate.h"
+#include "bounded-queue.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+enum class InputFormat { Plain, Gzip, Zip };
+
+// By magic number: 1f 8b is gzip, "PK\3\4" zip, anything else plain text
+InputFormat detectInputFormat(std::string_view data);
+const char* inputFormatName(InputFormat format);
+
+// Decompresses a gzip file (every member, CRC and size checked) or a zip
+// archive (every stored or deflated entry in central directory order, CRC
+// checked) and hands the text to out in pieces of about chunkSize bytes.
+// ZIP64 and encrypted entries are rejected. False with error set on bad input,
+// false with error empty if out stopped.
+bool decompressSpan(std::string_view data, InputFormat format, size_t chunkSize, const InflateOutput& out, std::string& error);
+
+// Inflates a compressed SPAN file on its own thread into a bounded queue of
+// chunks and cuts complete portfolio blocks out of them, so the text never
+// goes to disk and at most chunksInFlight chunks are buffered. A block that
+// spans chunks is carried over into the next buffer. Blocks point into a
+// shared buffer that next() hands out with them and that stays alive as long
+// as someone holds it.
+class CompressedBlockReader {
+public:
+    CompressedBlockReader(std::string_view data, InputFormat format, size_t chunkSize = 4 << 20, size_t chunksInFlight = 4);
+    ~CompressedBlockReader();
+
+    // Stops the decompression thread (if still running) and waits for it
+    void close();
+
+    CompressedBlockReader(const CompressedBlockReader&) = delete;
+    CompressedBlockReader& operator=(const CompressedBlockReader&) = delete;
+
+    // Next complete <phyPf>/<futPf>/<oofPf> block; false at the end or on error.
+    // endOffset is the offset just past the block in the decompressed text.
+    bool next(std::string_view& block, std::shared_ptr<const std::string>& owner, size_t& endOffset);
+
+    // Valid once next() returned false or after close()
+    bool failed() const { return !errorText.empty(); }
+    const std::string& error() const { return errorText; }
+
+    uint64_t decompressedBytes() const { return inflated; }
+    double decompressSeconds() const { return seconds; }
+
+private:
+    BoundedQueue<std::string> chunks;
+    std::thread worker;
+    std::atomic<bool> stop{ false };
+    std::string errorText;
+    std::atomic<uint64_t> inflated{ 0 };
+    double seconds = 0.0;
+
+    std::shared_ptr<const std::string> buffer;
+    size_t bufferStart = 0;         // offset of buffer in the decompressed text
+    size_t pos = 0;
+};
+
+#endif // COMPRESSED_INPUT_H
@@ -0,0 +1,127 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "connection-pool.h"
+#include "span-parser.h"
+#include "logger.h"
+#include "metrics.h"
+
+extern Logger logger;
+
+static bool sqlOk(SQLRETURN ret) {
+    return ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO;
+}
+
+bool ConnectionPool::open(const std::wstring& connStr, int count, bool autocommit) {
+    close();
+    if (count <= 0)
+        count = 1;
+
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &hEnv);
+    if (!sqlOk(ret)) {
+        logger.log("hEnv SQLAllocHandle failed.", LogLevel::ERRORS);
+        hEnv = SQL_NULL_HANDLE;
+        return false;
+    }
+    ret = SQLSetEnvAttr(hEnv, SQL_ATTR_ODBC_VERSION, (void*)SQL_OV_ODBC3, 0);
+    if (!sqlOk(ret)) {
+        logger.log("hEnv SQLSetEnvAttr failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_ENV, hEnv, "SQLSetEnvAttr");
+        close();
+        return false;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        SQLHDBC hDbc = SQL_NULL_HANDLE;
+        ret = SQLAllocHandle(SQL_HANDLE_DBC, hEnv, &hDbc);
+        if (!sqlOk(ret)) {
+            logger.log("hDbc SQLAllocHandle failed.", LogLevel::ERRORS);
+            handleError(SQL_HANDLE_ENV, hEnv, "SQLAllocHandle");
+            close();
+            return false;
+        }
+
+        SQLWCHAR outstr[1024];
+        SQLSMALLINT outstrlen;
+        ret = SQLDriverConnectW(hDbc, NULL, (SQLWCHAR*)connStr.c_str(),
+            SQL_NTS, outstr, sizeof(outstr) / sizeof(SQLWCHAR), &outstrlen, SQL_DRIVER_NOPROMPT);
+        if (!sqlOk(ret)) {
+            logger.log("SQLDriverConnectW failed for pool connection " + std::to_string(i), LogLevel::ERRORS);
+            handleError(SQL_HANDLE_DBC, hDbc, "SQLDriverConnectW");
+            SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
+            close();
+            return false;
+        }
+        connections.push_back(hDbc);
+
+        if (!autocommit) {
+            ret = SQLSetConnectAttr(hDbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_OFF, SQL_IS_UINTEGER);
+            if (!sqlOk(ret)) {
+                logger.log("SQLSetConnectAttr(AUTOCOMMIT_OFF) failed.", LogLevel::ERRORS);
+                handleError(SQL_HANDLE_DBC, hDbc, "SQLSetConnectAttr");
+                close();
+                return false;
+            }
+        }
+    }
+    logger.log("Opened " + std::to_string(count) + " pooled connections", LogLevel::INFO);
+    return true;
+}
+
+void ConnectionPool::close() {
+    for (SQLHDBC hDbc : connections) {
+        // Anything not committed explicitly is discarded
+        SQLEndTran(SQL_HANDLE_DBC, hDbc, SQL_ROLLBACK);
+        SQLDisconnect(hDbc);
+        SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
+    }
+    connections.clear();
+    if (hEnv != SQL_NULL_HANDLE) {
+        SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
+        hEnv = SQL_NULL_HANDLE;
+    }
+}
+
+bool ConnectionPool::commit(int i) {
+    ScopedTimer timer(metrics.commitNs);
+    metrics.roundTrips.add();
+    SQLRETURN ret = SQLEndTran(SQL_HANDLE_DBC, connections[i], SQL_COMMIT);
+    if (!sqlOk(ret)) {
+        handleError(SQL_HANDLE_DBC, connections[i], "SQLEndTran");
+        return false;
+    }
+    return true;
+}
+
+bool ConnectionPool::rollback(int i) {
+    ScopedTimer timer(metrics.commitNs);
+    metrics.roundTrips.add();
+    SQLRETURN ret = SQLEndTran(SQL_HANDLE_DBC, connections[i], SQL_ROLLBACK);
+    if (!sqlOk(ret)) {
+        handleError(SQL_HANDLE_DBC, connections[i], "SQLEndTran");
+        return false;
+    }
+    return true;
+}
+
+bool executeSql(SQLHDBC hDbc, const std::wstring& sql) {
+    SQLHSTMT hStmt = SQL_NULL_HANDLE;
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt);
+    if (!sqlOk(ret)) {
+        handleError(SQL_HANDLE_DBC, hDbc, "SQLAllocHandle");
+        return false;
+    }
+    {
+        ScopedTimer timer(metrics.statementNs);
+        ret = SQLExecDirectW(hStmt, (SQLWCHAR*)sql.c_str(), SQL_NTS);
+    }
+    metrics.roundTrips.add();
+    bool ok = sqlOk(ret) || ret == SQL_NO_DATA;
+    if (!ok) {
+        logger.log("Statement failed: " + std::string(sql.begin(), sql.end()), LogLevel::ERRORS);
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLExecDirectW");
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+    return ok;
+}
+
+#endif // SPAN_WITH_ODBC
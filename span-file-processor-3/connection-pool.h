@@ -0,0 +1,39 @@
+#pragma once
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <string>
+#include <vector>
+#include <windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+
+// N connections to the same server on one ODBC environment. Connections are
+// opened in manual-commit mode unless autocommit is requested.
+class ConnectionPool {
+public:
+    ConnectionPool() = default;
+    ~ConnectionPool() { close(); }
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    bool open(const std::wstring& connStr, int count, bool autocommit = false);
+    void close();
+
+    int size() const { return (int)connections.size(); }
+    SQLHDBC connection(int i) const { return connections[i]; }
+
+    bool commit(int i);
+    bool rollback(int i);
+
+private:
+    SQLHENV hEnv = SQL_NULL_HANDLE;
+    std::vector<SQLHDBC> connections;
+};
+
+// Runs one statement on hDbc with SQLExecDirectW
+bool executeSql(SQLHDBC hDbc, const std::wstring& sql);
+
+#endif // CONNECTION_POOL_H
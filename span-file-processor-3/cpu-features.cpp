@@ -0,0 +1,24 @@
+#include "cpu-features.h"
+
+bool cpuHasAvx2() {
+#if SPAN_HAVE_X86 && defined(_MSC_VER)
+    static const bool available = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)    // OS saves the ymm registers
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return available;
+#elif SPAN_HAVE_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
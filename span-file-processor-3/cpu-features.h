@@ -0,0 +1,25 @@
+#pragma once
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// SIMD kernels are compiled with a per-function target where the compiler
+// supports it, so the rest of the program keeps the baseline instruction set.
+// Mark an AVX2 kernel SPAN_TARGET_AVX2 inside #if SPAN_HAVE_X86 and call it
+// only when cpuHasAvx2().
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define SPAN_HAVE_X86 1
+#define SPAN_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SPAN_HAVE_X86 1
+#define SPAN_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#else
+#define SPAN_HAVE_X86 0
+#endif
+
+// Whether AVX2 kernels are compiled in and the CPU and OS support them
+bool cpuHasAvx2();
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,174 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "delta-load.h"
+#include "digest-index.h"
+#include "load-checkpoint.h"
+#include "connection-pool.h"
+#include "span-parser.h"
+#include "span-record-store.h"
+#include "span-tokenizer.h"
+#include "logger.h"
+#include <vector>
+
+extern Logger logger;
+
+static const wchar_t* deltaTable = L"#SpanRecords6_Delta";
+static const wchar_t* scopeTable = L"#SpanRecords6_DeltaScope";    // (Segment, PfId) whose rows the merge may delete
+
+// Segment column value of a block key (see blockKey)
+static const wchar_t* keySegment(uint64_t key) {
+    switch ((char)(key >> 32)) {
+    case 'p': return L"phypf";
+    case 'f': return L"futpf";
+    default: return L"oofpf";
+    }
+}
+
+// One INSERT per 1000 keys, the VALUES row limit
+static bool insertScope(SQLHDBC hDbc, const std::vector<uint64_t>& keys) {
+    for (size_t first = 0; first < keys.size(); first += 1000) {
+        std::wstring sql = std::wstring(L"INSERT INTO ") + scopeTable + L" (Segment, PfId) VALUES ";
+        for (size_t k = first; k < keys.size() && k < first + 1000; ++k)
+            sql += std::wstring(k == first ? L"(N'" : L", (N'") + keySegment(keys[k]) + L"', " +
+                std::to_wstring((int32_t)(uint32_t)keys[k]) + L")";
+        if (!executeSql(hDbc, sql))
+            return false;
+    }
+    return true;
+}
+
+// MERGE from the staged rows; key columns are matched, everything else updated,
+// and rows of the scoped portfolios missing from the staged rows deleted
+static std::wstring buildMergeSql(RiskEncoding encoding) {
+    std::wstring columns = spanInsertColumns(encoding);
+    std::vector<std::wstring> names;
+    size_t start = 0;
+    while (start < columns.size()) {
+        size_t comma = columns.find(L',', start);
+        if (comma == std::wstring::npos)
+            comma = columns.size();
+        std::wstring name = columns.substr(start, comma - start);
+        name.erase(0, name.find_first_not_of(L' '));
+        names.push_back(name);
+        start = comma + 1;
+    }
+
+    std::wstring updates, sourceValues;
+    for (const auto& name : names) {
+        sourceValues += (sourceValues.empty() ? L"s." : L", s.") + name;
+        if (name == L"PfId" || name == L"ContractId" || name == L"OptContractId")
+            continue;
+        updates += (updates.empty() ? L"" : L", ") + name + L" = s." + name;
+    }
+    return std::wstring(L"MERGE SpanRecords6 AS t USING ") + deltaTable + L" AS s "
+        L"ON t.PfId = s.PfId AND t.ContractId = s.ContractId AND t.OptContractId = s.OptContractId "
+        L"WHEN MATCHED THEN UPDATE SET " + updates + L" "
+        L"WHEN NOT MATCHED BY TARGET THEN INSERT (" + columns + L") VALUES (" + sourceValues + L") "
+        L"WHEN NOT MATCHED BY SOURCE AND EXISTS (SELECT 1 FROM " + scopeTable + L" AS d "
+        L"WHERE d.Segment = t.Segment AND d.PfId = t.PfId) THEN DELETE;";
+}
+
+bool runDeltaLoad(std::string_view data, SQLHDBC hDbc, const DeltaOptions& opts, DeltaStats& stats) {
+    stats = DeltaStats();
+
+    DigestIndex previous;
+    previous.load(opts.indexPath);
+
+    // Hash every block; parse only the ones whose digest differs
+    DigestIndex current;
+    SpanRecordStore store;
+    std::vector<uint64_t> scope;            // changed and removed blocks
+    std::string_view block;
+    size_t pos = 0;
+    for (size_t index = 0; nextPortfolioBlock(data, pos, block); ++index) {
+        stats.blocks++;
+        DigestEntry entry;
+        entry.digest = blockDigest(block);
+
+        uint64_t key = 0;
+        bool keyed = blockKey(block, key);
+        if (keyed) {
+            const DigestEntry* old = previous.find(key);
+            if (old && old->digest == entry.digest) {
+                stats.blocksSkipped++;
+                stats.rowsSkipped += old->rows;
+                current.set(key, *old);
+                continue;
+            }
+        }
+
+        size_t before = store.size();
+        try {
+            parseSpanXmlBlock(block, store);
+        }
+        catch (const std::exception& e) {
+            if (!opts.quarantine) {
+                logger.log("delta: block " + std::to_string(index) + " is malformed (" + e.what() +
+                    "), nothing merged, digest index left unchanged", LogLevel::ERRORS);
+                return false;
+            }
+            opts.quarantine->add(index, pos, block, e.what());
+            stats.blocksQuarantined++;
+            // The old entry stays, so the block is parsed again next time and its rows are not taken for removed
+            if (keyed && previous.find(key))
+                current.set(key, *previous.find(key));
+            continue;
+        }
+        entry.rows = (uint32_t)(store.size() - before);
+        stats.blocksChanged++;
+        if (keyed) {
+            current.set(key, entry);
+            scope.push_back(key);
+        }
+    }
+
+    // Blocks of the last load that this file no longer has
+    for (const auto& indexed : previous.all()) {
+        if (current.find(indexed.first))
+            continue;
+        scope.push_back(indexed.first);
+        stats.blocksRemoved++;
+    }
+
+    logger.log("delta: " + std::to_string(stats.blocks) + " blocks, " + std::to_string(stats.blocksSkipped) + " unchanged (" +
+        std::to_string(stats.rowsSkipped) + " rows skipped), " + std::to_string(stats.blocksChanged) + " changed (" +
+        std::to_string(store.size()) + " rows to merge), " + std::to_string(stats.blocksQuarantined) + " quarantined, " +
+        std::to_string(stats.blocksRemoved) + " removed", LogLevel::INFO);
+
+    if (!store.empty() || !scope.empty()) {
+        bool ok = executeSql(hDbc, std::wstring(L"SELECT TOP 0 * INTO ") + deltaTable + L" FROM SpanRecords6") &&
+            executeSql(hDbc, std::wstring(L"SELECT TOP 0 Segment, PfId INTO ") + scopeTable + L" FROM SpanRecords6") &&
+            insertScope(hDbc, scope);
+        if (ok) {
+            InserterOptions io;
+            io.batchSize = opts.batchSize;
+            io.riskEncoding = opts.riskEncoding;
+            io.table = deltaTable;
+
+            SpanInserter inserter;
+            ok = inserter.open(hDbc, io) && inserter.addAll(store) && inserter.flush();
+            stats.insert = inserter.stats();
+            if (ok && stats.insert.rowsFailed) {
+                logger.log("delta: " + std::to_string(stats.insert.rowsFailed) + " rows rejected, nothing merged", LogLevel::ERRORS);
+                ok = false;
+            }
+        }
+        ok = ok && executeSql(hDbc, buildMergeSql(opts.riskEncoding)) &&
+            executeSql(hDbc, std::wstring(L"DROP TABLE ") + deltaTable) &&
+            executeSql(hDbc, std::wstring(L"DROP TABLE ") + scopeTable);
+        SQLRETURN ret = SQLEndTran(SQL_HANDLE_DBC, hDbc, ok ? SQL_COMMIT : SQL_ROLLBACK);
+        if (ok && ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            handleError(SQL_HANDLE_DBC, hDbc, "SQLEndTran");
+            ok = false;
+        }
+        if (!ok) {
+            logger.log("delta: merge into SpanRecords6 failed, digest index left unchanged", LogLevel::ERRORS);
+            return false;
+        }
+        stats.rowsMerged = store.size();
+    }
+
+    return current.save(opts.indexPath);
+}
+
+#endif // SPAN_WITH_ODBC
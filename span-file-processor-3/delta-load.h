@@ -0,0 +1,44 @@
+#pragma once
+#ifndef DELTA_LOAD_H
+#define DELTA_LOAD_H
+
+#include "span-inserter.h"
+#include <string>
+#include <string_view>
+#include <windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+
+class BlockQuarantine;
+
+struct DeltaOptions {
+    std::string indexPath = "span-digests.idx";
+    size_t batchSize = 1000;
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;
+    BlockQuarantine* quarantine = nullptr;  // changed blocks that fail to parse; without it they fail the load
+};
+
+struct DeltaStats {
+    size_t blocks = 0;
+    size_t blocksSkipped = 0;
+    size_t rowsSkipped = 0;         // rows those blocks produced in the load that indexed them
+    size_t blocksChanged = 0;
+    size_t blocksQuarantined = 0;   // keep their old digest index entry, so the next load parses them again
+    size_t blocksRemoved = 0;       // indexed by the last load, gone from this file
+    size_t rowsMerged = 0;
+    InsertStats insert;
+};
+
+// Loads only the portfolio blocks whose raw text changed since the last
+// successful delta load. Unchanged blocks are neither parsed nor sent.
+// Changed records are staged in a temp table and MERGEd into SpanRecords6 on
+// (PfId, ContractId, OptContractId) in one transaction on hDbc, which must be
+// in manual-commit mode. The same MERGE deletes the rows of a changed block's
+// (Segment, PfId) that the block no longer has, and all rows of blocks the
+// last load indexed but this file lacks. Quarantined blocks keep their rows.
+// The digest index is rewritten only after the commit, and not at all when a
+// changed block fails to parse without a quarantine.
+bool runDeltaLoad(std::string_view data, SQLHDBC hDbc, const DeltaOptions& opts, DeltaStats& stats);
+
+#endif // DELTA_LOAD_H
@@ -0,0 +1,176 @@
+#include "digest-index.h"
+#include "span-parser.h"
+#include "span-tokenizer.h"
+#include "logger.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+extern Logger logger;
+
+static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v |= (uint64_t)(unsigned char)p[i] << (8 * i);
+    return v;
+}
+
+static uint32_t read32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= (uint32_t)(unsigned char)p[i] << (8 * i);
+    return v;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+static uint64_t mergeRound(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * prime1 + prime4;
+}
+
+uint64_t blockDigest(std::string_view block) {
+    const char* p = block.data();
+    const char* end = p + block.size();
+    uint64_t h;
+
+    if (block.size() >= 32) {
+        uint64_t v1 = prime1 + prime2;
+        uint64_t v2 = prime2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - prime1;
+        const char* limit = end - 32;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    }
+    else {
+        h = prime5;
+    }
+    h += (uint64_t)block.size();
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= round64(0, read64(p));
+        h = rotl(h, 27) * prime1 + prime4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * prime1;
+        h = rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (uint64_t)(unsigned char)*p * prime5;
+        h = rotl(h, 11) * prime1;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+bool blockKey(std::string_view block, uint64_t& key) {
+    // Blocks start with <phyPf>, <futPf> or <oofPf>; the second character tells them apart.
+    // Section blocks (<ccDef> ...) have no key of their own.
+    if (block.size() < 2 || (block[1] != 'p' && block[1] != 'f' && block[1] != 'o'))
+        return false;
+    try {
+        int pfId = parseInt(extractTag(block, "pfId"));
+        key = ((uint64_t)(unsigned char)block[1] << 32) | (uint32_t)pfId;
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool DigestIndex::load(const std::string& path) {
+    entries.clear();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        logger.log("No digest index at " + path + ", every block counts as changed", LogLevel::INFO);
+        return true;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != "span-digest-index 1") {
+        logger.log("Digest index " + path + " has an unknown format, ignoring it", LogLevel::WARNING);
+        return false;
+    }
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        uint64_t key;
+        DigestEntry entry;
+        if (!(in >> std::hex >> key >> entry.digest >> std::dec >> entry.rows)) {
+            logger.log("Digest index " + path + " is corrupt, ignoring it", LogLevel::WARNING);
+            entries.clear();
+            return false;
+        }
+        entries[key] = entry;
+    }
+    return true;
+}
+
+// Written next to the target and renamed over it, so a crash never leaves half an index
+bool DigestIndex::save(const std::string& path) const {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        if (!file.is_open()) {
+            logger.log("Failed to write digest index " + tmp, LogLevel::ERRORS);
+            return false;
+        }
+        file << "span-digest-index 1\n";
+        char line[64];
+        for (const auto& e : entries) {
+            std::snprintf(line, sizeof(line), "%llx %llx %u\n", (unsigned long long)e.first,
+                (unsigned long long)e.second.digest, (unsigned)e.second.rows);
+            file << line;
+        }
+        if (!file.good()) {
+            logger.log("Failed to write digest index " + tmp, LogLevel::ERRORS);
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        logger.log("Failed to replace digest index " + path + ": " + ec.message(), LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+const DigestEntry* DigestIndex::find(uint64_t key) const {
+    auto it = entries.find(key);
+    return it == entries.end() ? nullptr : &it->second;
+}
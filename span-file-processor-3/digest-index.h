@@ -0,0 +1,38 @@
+#pragma once
+#ifndef DIGEST_INDEX_H
+#define DIGEST_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// 64-bit content hash of a raw portfolio block (xxHash64, seed 0)
+uint64_t blockDigest(std::string_view block);
+
+// Identity of a portfolio block across files: segment tag and pfId.
+// Returns false if the block has no readable <pfId>.
+bool blockKey(std::string_view block, uint64_t& key);
+
+struct DigestEntry {
+    uint64_t digest = 0;
+    uint32_t rows = 0;          // records the block produced when it was loaded
+};
+
+// Block digests of the last successful load, kept in a small text file:
+// a "span-digest-index 1" line, then "<key> <digest> <rows>" in hex/decimal
+class DigestIndex {
+public:
+    bool load(const std::string& path);     // a missing file is an empty index
+    bool save(const std::string& path) const;
+
+    const DigestEntry* find(uint64_t key) const;
+    void set(uint64_t key, const DigestEntry& entry) { entries[key] = entry; }
+    size_t size() const { return entries.size(); }
+    const std::unordered_map<uint64_t, DigestEntry>& all() const { return entries; }
+
+private:
+    std::unordered_map<uint64_t, DigestEntry> entries;
+};
+
+#endif // DIGEST_INDEX_H
@@ -0,0 +1,24 @@
+#pragma once
+#ifndef FIXED_TEXT_H
+#define FIXED_TEXT_H
+
+#include <cstring>
+#include <string_view>
+
+// Short inline text with a fixed capacity. Longer values keep their first N
+// characters and are flagged, the inserter rejects them like an oversize column.
+template <size_t N>
+struct FixedText {
+    char chars[N];
+    unsigned char length = 0;
+    bool truncated = false;
+
+    void assign(std::string_view value) {
+        truncated = value.size() > N;
+        length = (unsigned char)(truncated ? N : value.size());
+        std::memcpy(chars, value.data(), length);
+    }
+    std::string_view view() const { return std::string_view(chars, length); }
+};
+
+#endif // FIXED_TEXT_H
@@ -0,0 +1,356 @@
+#include "inflate.h"
+#include <cstring>
+
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static const size_t historySize = 32768;
+static const int fastBits = 10;
+
+bool Inflater::fail(const char* why) {
+    if (message.empty())
+        message = why;
+    return false;
+}
+
+// Tops up the bit buffer; false if the input ends before n bits are available
+bool Inflater::need(int n) {
+    if (bitCount <= 56 && inputSize - inputPos >= 8) {
+        // Whole-word refill; bitCount ends up in 56..63 (assumes little-endian)
+        uint64_t word;
+        std::memcpy(&word, input + inputPos, 8);
+        bitBuf |= word << bitCount;
+        inputPos += (size_t)(63 - bitCount) >> 3;
+        bitCount |= 56;
+        return bitCount >= n;
+    }
+    while (bitCount <= 56 && inputPos < inputSize) {
+        bitBuf |= (uint64_t)input[inputPos++] << bitCount;
+        bitCount += 8;
+    }
+    return bitCount >= n;
+}
+
+uint32_t Inflater::bits(int n) {
+    uint32_t value = (uint32_t)(bitBuf & ((1ULL << n) - 1));
+    bitBuf >>= n;
+    bitCount -= n;
+    return value;
+}
+
+bool Inflater::buildHuffman(Huffman& h, const uint8_t* lengths, int n) {
+    std::memset(h.count, 0, sizeof(h.count));
+    for (int i = 0; i < n; ++i)
+        h.count[lengths[i]]++;
+
+    int left = 1;
+    for (int len = 1; len < 16; ++len) {
+        left <<= 1;
+        left -= h.count[len];
+        if (left < 0)
+            return fail("over-subscribed huffman code");
+    }
+
+    uint16_t offsets[16];
+    uint16_t nextCode[16];
+    offsets[1] = 0;
+    nextCode[1] = 0;
+    for (int len = 1; len < 15; ++len) {
+        offsets[len + 1] = offsets[len] + h.count[len];
+        nextCode[len + 1] = (uint16_t)((nextCode[len] + h.count[len]) << 1);
+    }
+    for (int i = 0; i < n; ++i)
+        if (lengths[i])
+            h.symbol[offsets[lengths[i]]++] = (uint16_t)i;
+
+    // Deflate sends codes most significant bit first, the buffer is read LSB first
+    std::memset(h.fast, 0, sizeof(h.fast));
+    for (int i = 0; i < n; ++i) {
+        int len = lengths[i];
+        if (len == 0)
+            continue;
+        uint32_t code = nextCode[len]++;
+        if (len > fastBits)
+            continue;
+        uint32_t reversed = 0;
+        for (int b = 0; b < len; ++b)
+            reversed |= ((code >> b) & 1) << (len - 1 - b);
+        for (uint32_t k = reversed; k < (1u << fastBits); k += 1u << len)
+            h.fast[k] = (uint16_t)((len << 9) | i);
+    }
+    return true;
+}
+
+// Next symbol, -1 on an invalid or truncated code
+int Inflater::decode(const Huffman& h) {
+    need(15);
+    uint16_t entry = h.fast[bitBuf & ((1u << fastBits) - 1)];
+    if (entry) {
+        int len = entry >> 9;
+        if (len > bitCount)
+            return -1;
+        bits(len);
+        return entry & 511;
+    }
+
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16 && len <= bitCount; ++len) {
+        code |= (int)((bitBuf >> (len - 1)) & 1);
+        int count = h.count[len];
+        if (code - first < count) {
+            bits(len);
+            return h.symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+// Hands out everything not yet emitted; unless final, keeps the last 32 KB as history
+bool Inflater::emitPending(bool final) {
+    char* w = window.data();
+    if (windowEnd > emitted && !(*output)(w + emitted, windowEnd - emitted)) {
+        stopped = true;
+        return false;
+    }
+    if (final || windowEnd <= historySize) {
+        emitted = windowEnd;
+        return true;
+    }
+    std::memmove(w, w + windowEnd - historySize, historySize);
+    windowEnd = historySize;
+    emitted = historySize;
+    return true;
+}
+
+bool Inflater::storedBlock() {
+    bits(bitCount & 7);
+    if (!need(32))
+        return fail("truncated stored block");
+    uint32_t len = bits(16);
+    uint32_t nlen = bits(16);
+    if (len != (~nlen & 0xffff))
+        return fail("stored block length mismatch");
+
+    // Bytes still in the bit buffer first, then straight from the input
+    while (len && bitCount >= 8) {
+        if (windowEnd >= flushAt && !emitPending(false))
+            return false;
+        window[windowEnd++] = (char)bits(8);
+        --len;
+    }
+    // The rest is copied from the input directly; drop the look-ahead bits the
+    // word refill left above bitCount so the next refill starts clean
+    bitBuf &= (1ULL << bitCount) - 1;
+    if (inputSize - inputPos < len)
+        return fail("truncated stored block");
+    while (len) {
+        size_t room = flushAt > windowEnd ? flushAt - windowEnd : 0;
+        if (room == 0) {
+            if (!emitPending(false))
+                return false;
+            continue;
+        }
+        size_t n = len < room ? len : room;
+        std::memcpy(window.data() + windowEnd, input + inputPos, n);
+        windowEnd += n;
+        inputPos += n;
+        len -= (uint32_t)n;
+    }
+    return true;
+}
+
+bool Inflater::dynamicTables() {
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    if (!need(14))
+        return fail("truncated block header");
+    int nlen = (int)bits(5) + 257;
+    int ndist = (int)bits(5) + 1;
+    int ncode = (int)bits(4) + 4;
+    if (nlen > 286 || ndist > 30)
+        return fail("bad code counts");
+
+    uint8_t lengths[320] = {};
+    for (int i = 0; i < ncode; ++i) {
+        if (!need(3))
+            return fail("truncated block header");
+        lengths[order[i]] = (uint8_t)bits(3);
+    }
+    Huffman lenCode;
+    if (!buildHuffman(lenCode, lengths, 19))
+        return false;
+
+    std::memset(lengths, 0, sizeof(lengths));
+    int index = 0;
+    while (index < nlen + ndist) {
+        int symbol = decode(lenCode);
+        if (symbol < 0)
+            return fail("bad code length code");
+        if (symbol < 16) {
+            lengths[index++] = (uint8_t)symbol;
+            continue;
+        }
+        uint8_t value = 0;
+        int repeat;
+        if (!need(7))
+            return fail("truncated block header");
+        if (symbol == 16) {
+            if (index == 0)
+                return fail("repeat with no previous length");
+            value = lengths[index - 1];
+            repeat = 3 + (int)bits(2);
+        }
+        else if (symbol == 17)
+            repeat = 3 + (int)bits(3);
+        else
+            repeat = 11 + (int)bits(7);
+        if (index + repeat > nlen + ndist)
+            return fail("too many code lengths");
+        while (repeat--)
+            lengths[index++] = value;
+    }
+    if (lengths[256] == 0)
+        return fail("no end-of-block code");
+
+    return buildHuffman(litTable, lengths, nlen) && buildHuffman(distTable, lengths + nlen, ndist);
+}
+
+bool Inflater::codes(const Huffman& lit, const Huffman& dist) {
+    char* w = window.data();
+    for (;;) {
+        if (windowEnd >= flushAt && !emitPending(false))
+            return false;
+
+        int symbol = decode(lit);
+        if (symbol < 0)
+            return fail("bad literal/length code");
+        if (symbol < 256) {
+            w[windowEnd++] = (char)symbol;
+            continue;
+        }
+        if (symbol == 256)
+            return true;
+
+        symbol -= 257;
+        if (symbol >= 29)
+            return fail("bad length symbol");
+        if (!need(lengthExtra[symbol]))
+            return fail("truncated length");
+        size_t len = lengthBase[symbol] + bits(lengthExtra[symbol]);
+
+        int ds = decode(dist);
+        if (ds < 0 || ds >= 30)
+            return fail("bad distance code");
+        if (!need(distExtra[ds]))
+            return fail("truncated distance");
+        size_t distance = distBase[ds] + bits(distExtra[ds]);
+        if (distance > windowEnd)
+            return fail("distance too far back");
+
+        // Byte by byte when the match overlaps what it copies
+        const char* from = w + windowEnd - distance;
+        if (distance >= len)
+            std::memcpy(w + windowEnd, from, len);
+        else
+            for (size_t i = 0; i < len; ++i)
+                w[windowEnd + i] = from[i];
+        windowEnd += len;
+    }
+}
+
+bool Inflater::inflate(const unsigned char* in, size_t size, size_t chunkSize, const InflateOutput& out, size_t& consumed) {
+    input = in;
+    inputSize = size;
+    inputPos = 0;
+    bitBuf = 0;
+    bitCount = 0;
+    output = &out;
+    stopped = false;
+    message.clear();
+    consumed = 0;
+
+    flushAt = (chunkSize > historySize ? chunkSize : historySize) + historySize;
+    // Room for one maximum match past the flush point
+    window.resize(flushAt + 258);
+    windowEnd = 0;
+    emitted = 0;
+
+    bool last = false;
+    while (!last) {
+        if (!need(3))
+            return fail("truncated deflate stream");
+        last = bits(1) != 0;
+        uint32_t type = bits(2);
+
+        bool ok;
+        if (type == 0) {
+            ok = storedBlock();
+        }
+        else if (type == 1) {
+            uint8_t lengths[320];
+            int i = 0;
+            for (; i < 144; ++i) lengths[i] = 8;
+            for (; i < 256; ++i) lengths[i] = 9;
+            for (; i < 280; ++i) lengths[i] = 7;
+            for (; i < 288; ++i) lengths[i] = 8;
+            for (i = 0; i < 30; ++i) lengths[288 + i] = 5;
+            ok = buildHuffman(litTable, lengths, 288) && buildHuffman(distTable, lengths + 288, 30) && codes(litTable, distTable);
+        }
+        else if (type == 2) {
+            ok = dynamicTables() && codes(litTable, distTable);
+        }
+        else {
+            ok = fail("invalid block type");
+        }
+        if (!ok)
+            return stopped ? fail("output stopped") : false;
+    }
+    if (!emitPending(true))
+        return fail("output stopped");
+
+    // Unused whole bytes in the bit buffer belong to whatever follows the stream
+    consumed = inputPos - (size_t)(bitCount / 8);
+    return true;
+}
+
+// Slicing-by-8: eight table lookups per 8 input bytes instead of one per byte
+uint32_t crc32Update(uint32_t crc, const void* data, size_t size) {
+    static const struct Tables {
+        uint32_t v[8][256];
+        Tables() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                v[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+                for (int t = 1; t < 8; ++t)
+                    v[t][i] = (v[t - 1][i] >> 8) ^ v[0][v[t - 1][i] & 0xff];
+        }
+    } tables;
+    const auto& t = tables.v;
+
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+            t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        p += 8;
+        size -= 8;
+    }
+    while (size--)
+        crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Called with each piece of decompressed output; return false to stop
+using InflateOutput = std::function<bool(const char* data, size_t size)>;
+
+// Raw DEFLATE (RFC 1951) decoder over a complete input buffer, no zlib needed.
+// Output goes to the callback in pieces of about chunkSize bytes; only the last
+// 32 KB are kept back for back-references, so memory does not grow with the
+// output size. Codes up to 10 bits come from a lookup table, longer ones are
+// decoded canonically.
+class Inflater {
+public:
+    // Decodes one deflate stream. consumed is the number of input bytes up to
+    // the end of the final block (rounded up to a byte). False on corrupt or
+    // truncated data (see error()) or when out returned false.
+    bool inflate(const unsigned char* in, size_t size, size_t chunkSize, const InflateOutput& out, size_t& consumed);
+
+    const std::string& error() const { return message; }
+
+private:
+    struct Huffman {
+        uint16_t count[16];
+        uint16_t symbol[320];
+        uint16_t fast[1 << 10];     // (length << 9) | symbol, 0 = longer code
+    };
+
+    bool fail(const char* why);
+    bool need(int bits);
+    uint32_t bits(int n);
+    bool buildHuffman(Huffman& h, const uint8_t* lengths, int n);
+    int decode(const Huffman& h);
+    bool storedBlock();
+    bool dynamicTables();
+    bool codes(const Huffman& lit, const Huffman& dist);
+    bool emitPending(bool final);
+
+    const unsigned char* input = nullptr;
+    size_t inputSize = 0;
+    size_t inputPos = 0;
+    uint64_t bitBuf = 0;
+    int bitCount = 0;
+
+    std::vector<char> window;       // kept history + output not yet emitted
+    size_t windowEnd = 0;
+    size_t emitted = 0;             // window[0, emitted) already went to output
+    size_t flushAt = 0;
+    const InflateOutput* output = nullptr;
+    bool stopped = false;
+
+    Huffman litTable, distTable;
+    std::string message;
+};
+
+// CRC-32 (IEEE, as in gzip and zip); pass the previous value to continue
+uint32_t crc32Update(uint32_t crc, const void* data, size_t size);
+
+#endif // INFLATE_H
@@ -0,0 +1,140 @@
+#include "load-checkpoint.h"
+#include "digest-index.h"
+#include "logger.h"
+#include "metrics.h"
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <system_error>
+
+extern Logger logger;
+
+uint64_t inputFingerprint(std::string_view fileData) {
+    const size_t head = 1 << 20;
+    return blockDigest(fileData.substr(0, head)) ^ ((uint64_t)fileData.size() * 0x9E3779B185EBCA87ULL);
+}
+
+bool loadCheckpoint(const std::string& path, LoadCheckpoint& checkpoint) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    if (!std::getline(file, line) || line != "span-checkpoint 1") {
+        logger.log("Checkpoint journal " + path + " has an unknown format, ignoring it", LogLevel::WARNING);
+        return false;
+    }
+    LoadCheckpoint cp;
+    int fields = 0;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string key;
+        if (!(in >> key))
+            continue;
+        bool read = key == "fileBytes" ? (bool)(in >> cp.fileBytes) :
+            key == "fingerprint" ? (bool)(in >> std::hex >> cp.fingerprint) :
+            key == "offset" ? (bool)(in >> cp.offset) :
+            key == "blocks" ? (bool)(in >> cp.blocks) :
+            key == "rows" ? (bool)(in >> cp.rows) :
+            key == "quarantineBytes" ? (bool)(in >> cp.quarantineBytes) : false;
+        if (!read) {
+            logger.log("Checkpoint journal " + path + " is corrupt, ignoring it", LogLevel::WARNING);
+            return false;
+        }
+        ++fields;
+    }
+    if (fields != 6) {
+        logger.log("Checkpoint journal " + path + " is incomplete, ignoring it", LogLevel::WARNING);
+        return false;
+    }
+    checkpoint = cp;
+    return true;
+}
+
+// Written next to the target and renamed over it, like the digest index
+bool saveCheckpoint(const std::string& path, const LoadCheckpoint& checkpoint) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        if (!file.is_open()) {
+            logger.log("Failed to write checkpoint journal " + tmp, LogLevel::ERRORS);
+            return false;
+        }
+        char fingerprint[24];
+        std::snprintf(fingerprint, sizeof(fingerprint), "%llx", (unsigned long long)checkpoint.fingerprint);
+        file << "span-checkpoint 1\n"
+             << "fileBytes " << checkpoint.fileBytes << "\n"
+             << "fingerprint " << fingerprint << "\n"
+             << "offset " << checkpoint.offset << "\n"
+             << "blocks " << checkpoint.blocks << "\n"
+             << "rows " << checkpoint.rows << "\n"
+             << "quarantineBytes " << checkpoint.quarantineBytes << "\n";
+        file.flush();
+        if (!file.good()) {
+            logger.log("Failed to write checkpoint journal " + tmp, LogLevel::ERRORS);
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        logger.log("Failed to replace checkpoint journal " + path + ": " + ec.message(), LogLevel::ERRORS);
+        return false;
+    }
+    metrics.checkpoints.add();
+    return true;
+}
+
+void removeCheckpoint(const std::string& path) {
+    std::remove(path.c_str());
+}
+
+bool BlockQuarantine::open(const std::string& filePath, const std::string& inputName, uint64_t keepBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    path = filePath;
+    input = inputName;
+    blocks = 0;
+    std::error_code ec;
+    uint64_t size = std::filesystem::exists(path, ec) ? (uint64_t)std::filesystem::file_size(path, ec) : 0;
+    if (!ec && size > keepBytes)
+        std::filesystem::resize_file(path, keepBytes, ec);
+    if (ec) {
+        logger.log("Failed to truncate quarantine file " + path + ": " + ec.message(), LogLevel::ERRORS);
+        return false;
+    }
+    file.open(path, std::ios::binary | std::ios::app);
+    if (!file.is_open()) {
+        logger.log("Failed to open quarantine file " + path, LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+void BlockQuarantine::add(size_t index, size_t endOffset, std::string_view block, const char* error) {
+    size_t start = endOffset - block.size();
+    logger.log("Quarantined block " + std::to_string(index) + " at offset " + std::to_string(start) + ": " + error, LogLevel::ERRORS);
+    metrics.quarantinedBlocks.add();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ++blocks;
+    if (!file.is_open())
+        return;
+    file << "# " << input << " block " << index << " offset " << start << "-" << endOffset << ": " << error << "\n";
+    file.write(block.data(), (std::streamsize)block.size());
+    file << "\n";
+}
+
+size_t BlockQuarantine::count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return blocks;
+}
+
+uint64_t BlockQuarantine::bytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open())
+        return 0;
+    file.flush();
+    std::error_code ec;
+    uint64_t size = (uint64_t)std::filesystem::file_size(path, ec);
+    return ec ? 0 : size;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef LOAD_CHECKPOINT_H
+#define LOAD_CHECKPOINT_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Identity of an input file: its size plus a hash of its first megabyte, so a
+// journal is never applied to a different (or rewritten) file
+uint64_t inputFingerprint(std::string_view fileData);
+
+// Position of the last committed transaction of a checkpointed load. offset
+// is in the SPAN text, i.e. after decompression for archives; every block
+// ending at or before it is in the database.
+struct LoadCheckpoint {
+    uint64_t fileBytes = 0;
+    uint64_t fingerprint = 0;
+    size_t offset = 0;
+    size_t blocks = 0;          // blocks before offset, quarantined ones included
+    size_t rows = 0;            // rows committed up to offset
+    uint64_t quarantineBytes = 0;   // quarantine file size at the commit
+};
+
+// Checkpoint journal, a small text file: a "span-checkpoint 1" line, then
+// "<key> <value>" lines. Rewritten through a temporary file and rename after
+// every commit; removed when the load completes.
+// A crash between a commit and the rename replays that one commit interval.
+bool loadCheckpoint(const std::string& path, LoadCheckpoint& checkpoint);   // false if missing or unreadable
+bool saveCheckpoint(const std::string& path, const LoadCheckpoint& checkpoint);
+void removeCheckpoint(const std::string& path);
+
+// Malformed portfolio blocks set aside so the load can go on. Each entry is a
+// "# <input> block <index> offset <start>-<end>: <error>" line followed by
+// the raw block text. Entries are appended; add() may be called from any
+// parser thread.
+class BlockQuarantine {
+public:
+    // Opens path for appending, first cutting it back to keepBytes (to drop
+    // entries a resumed load will produce again)
+    bool open(const std::string& path, const std::string& input, uint64_t keepBytes = UINT64_MAX);
+    bool isOpen() const { return file.is_open(); }
+
+    void add(size_t index, size_t endOffset, std::string_view block, const char* error);
+
+    size_t count() const;
+    uint64_t bytes();           // file size so far, after flushing
+
+private:
+    mutable std::mutex mutex;
+    std::ofstream file;
+    std::string path;
+    std::string input;
+    size_t blocks = 0;
+};
+
+#endif // LOAD_CHECKPOINT_H
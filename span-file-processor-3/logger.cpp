@@ -0,0 +1,181 @@
+#include "logger.h"
+#include <chrono>
+
+bool Logger::startAsync(const AsyncLogOptions& options) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    if (asyncMode.load() || !logfile.is_open())
+        return asyncMode.load();
+
+    size_t capacity = 2;
+    while (capacity < options.capacity)
+        capacity <<= 1;
+    slots.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; ++i)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    mask = capacity - 1;
+    head.store(0);
+    tail = 0;
+    overflow = options.overflow;
+    droppedReported = dropped.load();
+    stopping = false;
+
+    writer = std::thread([this] { writerLoop(); });
+    asyncMode.store(true, std::memory_order_release);
+    return true;
+}
+
+void Logger::stopAsync() {
+    if (!asyncMode.exchange(false))
+        return;
+    // New calls now log synchronously; let the ones already in logAsync finish
+    while (producers.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCv.notify_one();
+    }
+    writer.join();
+    slots.reset();
+}
+
+void Logger::flush() {
+    if (!asyncMode.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (logfile.is_open())
+            logfile.flush();
+        return;
+    }
+    uint64_t target = logged.load();
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCv.notify_one();
+    flushedCv.wait(lock, [&] { return written.load() >= target || stopping.load(); });
+}
+
+LoggerStats Logger::stats() const {
+    LoggerStats s;
+    s.logged = logged.load();
+    s.dropped = dropped.load();
+    s.batches = batches.load();
+    return s;
+}
+
+// Bounded MPSC ring (per-slot sequence numbers): a slot is free for position
+// pos when its sequence equals pos and holds a message once it is pos + 1
+bool Logger::tryPush(std::string& message, LogLevel level, std::time_t time) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[pos & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            return false;                       // full
+        }
+        else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+    Slot& slot = slots[pos & mask];
+    slot.level = level;
+    slot.time = time;
+    slot.text = std::move(message);
+    slot.sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void Logger::wakeWriter() {
+    if (writerIdle.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCv.notify_one();
+    }
+}
+
+void Logger::logAsync(std::string&& message, LogLevel level) {
+    std::time_t now = std::time(nullptr);
+    if (!tryPush(message, level, now)) {
+        if (overflow != LogOverflow::Block) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        while (!tryPush(message, level, now)) {
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                wakeCv.notify_one();
+            }
+            std::this_thread::yield();
+        }
+    }
+    logged.fetch_add(1, std::memory_order_relaxed);
+    wakeWriter();
+}
+
+// Formats every published message (at most one ring's worth) into out
+size_t Logger::drain(std::string& out) {
+    size_t count = 0;
+    while (count <= mask) {
+        Slot& slot = slots[tail & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+            break;
+        out += '[';
+        out += timestamp(slot.time);
+        out += "] [";
+        out += levelToString(slot.level);
+        out += "] ";
+        out += slot.text;
+        out += '\n';
+        slot.text.clear();
+        slot.sequence.store(tail + mask + 1, std::memory_order_release);
+        ++tail;
+        ++count;
+    }
+    return count;
+}
+
+void Logger::writerLoop() {
+    std::string out;
+    for (;;) {
+        size_t count;
+        {
+            // Calls that were already on the synchronous path may still write
+            std::lock_guard<std::mutex> lock(logMutex);
+            out.clear();
+            count = drain(out);
+            uint64_t lost = dropped.load(std::memory_order_relaxed);
+            if (overflow == LogOverflow::Count && lost != droppedReported) {
+                out += '[';
+                out += timestamp(std::time(nullptr));
+                out += "] [WARN] logger queue full, dropped " + std::to_string(lost - droppedReported) + " messages\n";
+                droppedReported = lost;
+            }
+            if (!out.empty()) {
+                logfile.write(out.data(), (std::streamsize)out.size());
+                logfile.flush();
+            }
+        }
+        if (count) {
+            written.fetch_add(count);
+            batches.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            flushedCv.notify_all();
+            continue;
+        }
+
+        // Claimed slots may not be published yet; at shutdown wait for them
+        if (stopping && tail == head.load())
+            break;
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        writerIdle.store(true, std::memory_order_relaxed);
+        wakeCv.wait_for(lock, std::chrono::milliseconds(stopping ? 1 : 10), [&] {
+            return stopping || slots[tail & mask].sequence.load(std::memory_order_acquire) == tail + 1;
+        });
+        writerIdle.store(false, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    flushedCv.notify_all();
+}
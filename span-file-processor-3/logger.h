@@ -6,9 +6,37 @@
 #include <string>
 #include <ctime>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <thread>
 
 enum class LogLevel { INFO, WARNING, ERRORS };
 
+// What log() does when the async ring is full
+enum class LogOverflow {
+    Block,      // wait for the writer thread to make room
+    Drop,       // discard the message, counted in stats() only
+    Count       // discard, and the writer logs how many were lost
+};
+
+struct AsyncLogOptions {
+    size_t capacity = 8192;     // ring slots, rounded up to a power of two
+    LogOverflow overflow = LogOverflow::Block;
+};
+
+struct LoggerStats {
+    uint64_t logged = 0;        // messages accepted
+    uint64_t dropped = 0;       // messages lost to a full ring
+    uint64_t batches = 0;       // writes by the async writer thread
+};
+
+// Line-per-message log file. Synchronous by default: log() formats and writes
+// under a mutex and flushes every line. After startAsync() log() only moves
+// the message into a lock-free multi-producer ring; one writer thread formats
+// and writes whole batches and flushes once per batch. Timestamps are
+// formatted once per second in both modes.
 class Logger {
 public:
     Logger(const std::string& filename) {
@@ -16,25 +44,57 @@ public:
     }
 
     ~Logger() {
+        stopAsync();
         if (logfile.is_open())
             logfile.close();
     }
 
-    void log(const std::string& message, LogLevel level = LogLevel::INFO) {
-        std::lock_guard<std::mutex> lock(logMutex);
-        std::string levelStr = levelToString(level);
-        std::string timestamp = currentTime();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
 
-        std::string output = "[" + timestamp + "] [" + levelStr + "] " + message;
-        if (logfile.is_open())
-            logfile << output << std::endl; // log to file
+    void log(std::string message, LogLevel level = LogLevel::INFO) {
+        if (asyncMode.load(std::memory_order_acquire)) {
+            // producers lets stopAsync() wait for calls already past this check
+            producers.fetch_add(1, std::memory_order_acq_rel);
+            if (asyncMode.load(std::memory_order_acquire)) {
+                logAsync(std::move(message), level);
+                producers.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+            producers.fetch_sub(1, std::memory_order_release);
+        }
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (!logfile.is_open())
+            return;
+        logfile << '[' << timestamp(std::time(nullptr)) << "] [" << levelToString(level) << "] " << message << std::endl;
+        logged.fetch_add(1, std::memory_order_relaxed);
+        written.fetch_add(1, std::memory_order_relaxed);
     }
 
+    // Starts the writer thread; messages logged before stay in order
+    bool startAsync(const AsyncLogOptions& options = AsyncLogOptions());
+    // Returns once everything logged before the call is written and flushed
+    void flush();
+    // Drains the ring, joins the writer and goes back to synchronous logging
+    void stopAsync();
+
+    LoggerStats stats() const;
+
 private:
-    std::ofstream logfile;
-    std::mutex logMutex;
+    struct Slot {
+        std::atomic<size_t> sequence{ 0 };
+        LogLevel level = LogLevel::INFO;
+        std::time_t time = 0;
+        std::string text;
+    };
 
-    std::string levelToString(LogLevel level) {
+    void logAsync(std::string&& message, LogLevel level);
+    bool tryPush(std::string& message, LogLevel level, std::time_t time);
+    void writerLoop();
+    size_t drain(std::string& out);
+    void wakeWriter();
+
+    static const char* levelToString(LogLevel level) {
         switch (level) {
         case LogLevel::INFO:
             return "INFO";
@@ -47,16 +107,46 @@ private:
         }
     }
 
-    std::string currentTime() {
-        std::time_t now = std::time(nullptr);
-        char buf[20];
-        std::tm local_tm;
-
-        localtime_s(&local_tm, &now);  // Safer, thread-safe version
-        strftime(buf, sizeof(buf), "%F %T", &local_tm);
-        return buf;
+    // "%F %T" of now, reformatted only when the second changes (callers serialize)
+    const char* timestamp(std::time_t now) {
+        if (now != cachedSecond) {
+            std::tm local_tm;
+#ifdef _WIN32
+            localtime_s(&local_tm, &now);  // Safer, thread-safe version
+#else
+            localtime_r(&now, &local_tm);
+#endif
+            strftime(cachedTime, sizeof(cachedTime), "%F %T", &local_tm);
+            cachedSecond = now;
+        }
+        return cachedTime;
     }
+
+    std::ofstream logfile;
+    std::mutex logMutex;
+    std::time_t cachedSecond = -1;
+    char cachedTime[20] = {};
+
+    // Async mode
+    std::atomic<bool> asyncMode{ false };
+    std::atomic<int> producers{ 0 };
+    LogOverflow overflow = LogOverflow::Block;
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    std::atomic<size_t> head{ 0 };      // next slot producers claim
+    size_t tail = 0;                    // next slot the writer reads
+    std::thread writer;
+    std::atomic<bool> stopping{ false };
+    std::atomic<bool> writerIdle{ false };
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    std::condition_variable flushedCv;
+
+    std::atomic<uint64_t> logged{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> written{ 0 };     // sync and async lines on disk
+    std::atomic<uint64_t> batches{ 0 };
+    uint64_t droppedReported = 0;
 };
 
 #endif // LOGGER_H
-#pragma once
@@ -1,88 +1,1137 @@
+#include "build-config.h"
 #include "span-parser.h"
+#include "parallel-parser.h"
+#include "span-pipeline.h"
+#include "record-sink.h"
+#include "column-file.h"
+#include "bench-suite.h"
+#include "self-test.h"
+#include "span-generator.h"
+#include "process-memory.h"
+#include "span-record-store.h"
+#include "span-schema.h"
+#include "span-tokenizer.h"
+#include "span-input.h"
+#include "scan-risk.h"
+#include "span-diff.h"
+#include "span-summary.h"
+#include "risk-validation.h"
+#include "cpu-features.h"
+#include "span-snapshot.h"
+#include "watch-mode.h"
+#include "batch-load.h"
+#include "load-checkpoint.h"
+#include "app-options.h"
 #include "logger.h"
-#include <fstream>
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#if SPAN_WITH_ODBC
+#include "odbc-sink.h"
+#include "parallel-loader.h"
+#include "connection-pool.h"
+#include "delta-load.h"
+#include "summary-inserter.h"
 #include <windows.h>
 #include <sqlext.h>
 #include <sqltypes.h>
 #include <sql.h>
+#endif
 
 Logger logger("app.log");
+Metrics metrics;
 
-int main(int argc, char* argv[]) {
-    logger.log("Starting application");
-    if (argc != 3) {
-        logger.log("Less command line arguments", LogLevel::ERRORS);
-        return 1;
+// Parses the whole buffer at 1, 2, 4 ... maxThreads threads and reports scaling
+static void benchParse(std::string_view data, int maxThreads) {
+    double megaBytes = data.size() / (1024.0 * 1024.0);
+    double baseSecs = 0.0;
+
+    std::cout << "threads  records  seconds  MB/s  speedup\n";
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > maxThreads)
+            threads = maxThreads;
+
+        SpanRecordStore records;
+        auto start = std::chrono::steady_clock::now();
+        parseSpanParallel(data, threads, true, records);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1)
+            baseSecs = secs;
+
+        std::string line = std::to_string(threads) + "  " + std::to_string(records.size()) + "  " +
+            std::to_string(secs) + "  " + std::to_string(secs > 0 ? megaBytes / secs : 0.0) + "  " +
+            std::to_string(secs > 0 ? baseSecs / secs : 0.0);
+        std::cout << line << "\n";
+        logger.log("bench-parse " + line, LogLevel::INFO);
+
+        if (threads == maxThreads)
+            break;
     }
-    const std::string configPath = argv[1];
-    const std::string spanFilePath = argv[2];
+}
+
+// Parses the whole buffer into std::vector<SpanRecord> and into SpanRecordStore
+// and compares heap footprint and parse time
+static void benchStore(std::string_view data) {
+    std::vector<SpanRecord> vec;
+    auto start = std::chrono::steady_clock::now();
+    std::string_view block;
+    size_t pos = 0;
+    while (nextPortfolioBlock(data, pos, block))
+        parseSpanXmlBlock(block, vec);
+    double vecSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    SpanRecordStore store;
+    start = std::chrono::steady_clock::now();
+    pos = 0;
+    while (nextPortfolioBlock(data, pos, block))
+        parseSpanXmlBlock(block, store);
+    double storeSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto report = [](const char* name, size_t records, size_t bytes, size_t blocks, double secs) {
+        double n = records ? (double)records : 1.0;
+        std::string line = std::string(name) + "  " + std::to_string(records) + "  " + std::to_string(bytes / n) + "  " +
+            std::to_string(blocks / n) + "  " + std::to_string(secs);
+        std::cout << line << "\n";
+        logger.log("bench-store " + line, LogLevel::INFO);
+    };
+    // Compare exact footprints, not whatever slack vector growth left behind
+    vec.shrink_to_fit();
+    store.shrinkToFit();
+    std::cout << "layout  records  bytes/record  heap-blocks/record  parse-seconds\n";
+    report("vector<SpanRecord>", vec.size(), recordVectorBytes(vec), recordVectorHeapBlocks(vec), vecSecs);
+    report("SpanRecordStore", store.size(), store.bytesUsed(), store.heapBlocks(), storeSecs);
+}
+
+// Encodes (and decodes back) every risk array of the buffer in each RiskEncoding
+static void benchRisk(std::string_view data) {
+    SpanRecordStore store;
+    parseSpanParallel(data, 1, true, store);
+
+    std::cout << "encoding  records  encode-ns/record  wire-bytes/record  decode-ns/record  mismatches\n";
+    for (RiskEncoding encoding : { RiskEncoding::Legacy, RiskEncoding::Text, RiskEncoding::Binary }) {
+        std::vector<std::string> encoded(store.size());
+        size_t wireBytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < store.size(); ++i) {
+            const CompactRecord& rec = store.record(i);
+            std::string& out = encoded[i];
+            if (encoding == RiskEncoding::Binary)
+                appendRiskArrayBinary(rec.riskR, store.risk(rec), rec.riskCount, rec.riskD, out);
+            else if (encoding == RiskEncoding::Text)
+                appendRiskArrayLossless(rec.riskR, store.risk(rec), rec.riskCount, rec.riskD, out);
+            else
+                appendRiskArrayText(rec.riskR, store.risk(rec), rec.riskCount, rec.riskD, out);
+            // Legacy text is sent as SQL_WVARCHAR, two bytes per character
+            wireBytes += encoding == RiskEncoding::Legacy ? out.size() * 2 : out.size();
+        }
+        double encodeSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Legacy text cannot be decoded; the others must round-trip bit for bit
+        std::string decodeNs = "n/a";
+        std::string mismatches = "n/a";
+        if (encoding != RiskEncoding::Legacy) {
+            size_t bad = 0;
+            RiskArray ra;
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < store.size(); ++i) {
+                const CompactRecord& rec = store.record(i);
+                if (!decodeRiskArray(encoded[i], ra) || ra.r != rec.riskR || ra.a.size() != rec.riskCount ||
+                    std::memcmp(&ra.d, &rec.riskD, sizeof(double)) != 0 ||
+                    (rec.riskCount && std::memcmp(ra.a.data(), store.risk(rec), rec.riskCount * sizeof(double)) != 0))
+                    ++bad;
+            }
+            double decodeSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            decodeNs = std::to_string(store.size() ? decodeSecs * 1e9 / store.size() : 0.0);
+            mismatches = std::to_string(bad);
+        }
+
+        double n = store.size() ? (double)store.size() : 1.0;
+        std::string line = std::string(riskEncodingName(encoding)) + "  " + std::to_string(store.size()) + "  " +
+            std::to_string(encodeSecs * 1e9 / n) + "  " + std::to_string(wireBytes / n) + "  " + decodeNs + "  " + mismatches;
+        std::cout << line << "\n";
+        logger.log("bench-risk " + line, LogLevel::INFO);
+    }
+}
+
+// Parameter bytes and rows of the wide and normalized output schemas for the
+// records of the buffer; load times are compared by --bench-suite
+// (insertSpanRecords against insertNormalized)
+static void benchSchema(std::string_view data, RiskEncoding encoding) {
+    SpanRecordStore store;
+    parseSpanParallel(data, 1, true, store);
+    const SchemaFootprint fp = measureSchemas(store, encoding);
+
+    std::cout << "schema  tables  rows  parameter-bytes  bytes/record\n";
+    auto report = [&](const char* name, int tables, size_t rows, size_t bytes) {
+        std::string line = std::string(name) + "  " + std::to_string(tables) + "  " + std::to_string(rows) + "  " +
+            std::to_string(bytes) + "  " + std::to_string(store.size() ? (double)bytes / store.size() : 0.0);
+        std::cout << line << "\n";
+        logger.log("bench-schema " + line, LogLevel::INFO);
+    };
+    report("wide", 1, fp.wideRows, fp.wideBytes);
+    report("normalized", 3, fp.portfolioRows + fp.seriesRows + fp.optionRows, fp.normalizedBytes);
+    std::string line = std::to_string(fp.portfolioRows) + " portfolios, " + std::to_string(fp.seriesRows) + " series, " +
+        std::to_string(fp.optionRows) + " options; normalized sends " +
+        std::to_string(fp.wideBytes ? 100.0 * (1.0 - (double)fp.normalizedBytes / fp.wideBytes) : 0.0) + "% fewer bytes";
+    std::cout << line << "\n";
+    logger.log("bench-schema " + line, LogLevel::INFO);
+}
+
+// Logs from threads threads into a scratch file, synchronously and through the
+// async ring with each overflow policy. producer-calls/s is what log() callers
+// see, drained-calls/s includes writing everything out.
+static void benchLog(int threads) {
+    const int calls = 100000;
+    const char* path = "bench-log.tmp";
+    struct Mode {
+        const char* name;
+        bool async;
+        LogOverflow overflow;
+    };
+    const Mode modes[] = { { "sync", false, LogOverflow::Block }, { "async-block", true, LogOverflow::Block },
+        { "async-drop", true, LogOverflow::Drop }, { "async-count", true, LogOverflow::Count } };
+
+    std::cout << "mode  threads  calls  producer-calls/s  drained-calls/s  dropped\n";
+    for (const Mode& mode : modes) {
+        std::remove(path);
+        Logger bench(path);
+        if (mode.async) {
+            AsyncLogOptions async;
+            async.overflow = mode.overflow;
+            bench.startAsync(async);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t) {
+            producers.emplace_back([&bench, t, calls] {
+                for (int i = 0; i < calls; ++i)
+                    bench.log("bench message " + std::to_string(i) + " from thread " + std::to_string(t), LogLevel::INFO);
+            });
+        }
+        for (auto& p : producers)
+            p.join();
+        double producerSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bench.flush();
+        double drainedSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double total = (double)threads * calls;
+        std::string line = std::string(mode.name) + "  " + std::to_string(threads) + "  " + std::to_string((long long)total) + "  " +
+            std::to_string(producerSecs > 0 ? total / producerSecs : 0.0) + "  " +
+            std::to_string(drainedSecs > 0 ? total / drainedSecs : 0.0) + "  " + std::to_string(bench.stats().dropped);
+        std::cout << line << "\n";
+        logger.log("bench-log " + line, LogLevel::INFO);
+    }
+    std::remove(path);
+}
+
+// Bench suite over the input; the insert benchmark needs the database and
+// runs only with --sink odbc in ODBC builds
+static bool runBenchSuiteFor(std::string_view data, const AppOptions& opts) {
+    BenchSuiteOptions bench;
+    bench.iterations = opts.benchIterations;
+    bench.parseThreads = opts.parseThreads;
+    bench.label = opts.reportLabel;
+    bench.reportPath = opts.reportPath;
+    bench.scratchPath = opts.outputPath;
+    bench.riskEncoding = opts.riskEncoding;
+    bench.batchSize = (size_t)opts.batchSize;
+    bench.input = opts.spanFilePath;
+    if (opts.generate) {
+        const GeneratorOptions& g = opts.generator;
+        bench.input += " (generated: " + std::to_string(g.portfolios) + " portfolios, " + std::to_string(g.seriesPerPortfolio) +
+            " series, " + std::to_string(g.optionsPerSeries) + " options, " + std::to_string(g.riskPoints) + " risk points, seed " +
+            std::to_string(g.seed) + ")";
+    }
+
+#if SPAN_WITH_ODBC
     SQLHENV hEnv = nullptr;
     SQLHDBC hDbc = nullptr;
+    std::wstring connStr;
+    if (opts.sink == "odbc") {
+        if (readConnectionString(opts.configPath, connStr) && connectToMSSQL(hEnv, hDbc, connStr))
+            bench.hDbc = hDbc;
+        else
+            logger.log("bench-suite: no database connection, insert benchmark skipped", LogLevel::WARNING);
+    }
+    bool ok = runBenchSuite(data, bench);
+    if (bench.hDbc) {
+        SQLDisconnect(hDbc);
+        SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
+        SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
+    }
+    return ok;
+#else
+    return runBenchSuite(data, bench);
+#endif
+}
+
+// Parses the whole file into one store (collect-then-write)
+static void parseAll(std::string_view data, const AppOptions& opts, SpanRecordStore& records, BlockQuarantine* quarantine = nullptr) {
+    double megaBytes = data.size() / (1024.0 * 1024.0);
+    auto parseStart = std::chrono::steady_clock::now();
+    parseSpanParallel(data, opts.parseThreads, !opts.unordered, records, quarantine);
+    double parseSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+
+    logger.log("parsing of file records into SpanRecordStore is done.", LogLevel::INFO);
+    logger.log("parsed " + std::to_string(records.size()) + " records from " + std::to_string(megaBytes) +
+        " MB in " + std::to_string(parseSecs) + " s (" + std::to_string(parseSecs > 0 ? megaBytes / parseSecs : 0.0) + " MB/s, " +
+        std::to_string(opts.parseThreads) + " parse threads)", LogLevel::INFO);
+    const SpanSections& sections = records.sections();
+    logger.log("sections: " + std::to_string(sections.commodities.size()) + " combined commodities, " +
+        std::to_string(sections.links.size()) + " portfolio links, " + std::to_string(sections.spreads.size()) + " spreads, " +
+        std::to_string(sections.legs.size()) + " spread legs, " + std::to_string(sections.conversions.size()) + " currency conversions",
+        LogLevel::INFO);
+}
+
+// Scan risk of a positions file, or the scan-risk benchmark, over the parsed input
+static bool runScanRisk(std::string_view data, const AppOptions& opts) {
+    SpanRecordStore records;
+    parseAll(data, opts, records);
+    ScanRiskModel model;
+    model.build(records);
+    records.clear();
+
+    std::vector<ScanAccount> accounts;
+    if (!opts.positionsPath.empty()) {
+        size_t unmatched = 0;
+        if (!readPositions(opts.positionsPath, model, accounts, unmatched))
+            return false;
+    }
+    else {
+        makeSyntheticAccounts(model, (size_t)opts.benchAccounts, 20, 1, accounts);
+    }
+
+    if (opts.benchScan) {
+        benchScanRisk(model, accounts, opts.scanThreads);
+        return true;
+    }
+
+    bool simd = !opts.scanScalar && scanRiskAvx2Available();
+    std::vector<ScanResult> results;
+    auto start = std::chrono::steady_clock::now();
+    computeScanRisk(model, accounts, opts.scanThreads, simd, results);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    logger.log("scan risk of " + std::to_string(accounts.size()) + " accounts in " + std::to_string(secs) + " s (" +
+        std::to_string(secs > 0 ? accounts.size() / secs : 0.0) + " accounts/s, " + (simd ? "avx2" : "scalar") + ", " +
+        std::to_string(opts.scanThreads) + " threads)", LogLevel::INFO);
+    return writeScanResults(opts.scanOutputPath, accounts, results);
+}
+
+// Diffs <span-file> against the earlier publication --diff BASE
+static bool runSpanDiff(SpanInput& input, const AppOptions& opts) {
+    SpanInput base;
+    std::string_view oldData, newData;
+    if (!base.open(opts.diffBasePath) || !base.text(oldData) || !input.text(newData)) {
+        logger.log("Failed to open " + opts.diffBasePath, LogLevel::ERRORS);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SpanRecordStore older, newer;
+    parseSpanParallel(oldData, opts.parseThreads, true, older);
+    parseSpanParallel(newData, opts.parseThreads, true, newer);
+    double parseSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    DiffOptions diff;
+    diff.absTolerance = opts.diffTolerance;
+    diff.relTolerance = opts.diffRelTolerance;
+    diff.simd = !opts.diffScalar;
+    std::vector<DiffEntry> entries;
+    DiffStats stats;
+    start = std::chrono::steady_clock::now();
+    diffSpanStores(older, newer, diff, entries, stats);
+    double diffSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string line = opts.diffBasePath + " -> " + opts.spanFilePath + ": " + std::to_string(stats.changed) + " changed, " +
+        std::to_string(stats.added) + " added, " + std::to_string(stats.removed) + " removed, " + std::to_string(stats.unchanged) +
+        " unchanged (" + std::to_string(stats.duplicates) + " repeated keys); parse " + std::to_string(parseSecs) + " s (" +
+        std::to_string(opts.parseThreads) + " threads), join and compare " + std::to_string(diffSecs) + " s (" +
+        (diff.simd && cpuHasAvx2() ? "avx2" : "scalar") + ")";
+    std::cout << "diff " << line << "\n";
+    logger.log("diff " + line, LogLevel::INFO);
+    return writeSpanDiff(opts.diffOutputPath, older, newer, entries);
+}
+
+// --quarantine: malformed blocks of input are appended to the file and the load goes on
+static bool openQuarantine(const AppOptions& opts, const SpanInput& input, BlockQuarantine& quarantine) {
+    return opts.quarantinePath.empty() || quarantine.open(opts.quarantinePath, input.name());
+}
+
+static void logQuarantine(const AppOptions& opts, const BlockQuarantine& quarantine) {
+    if (quarantine.count())
+        logger.log("quarantined " + std::to_string(quarantine.count()) + " malformed blocks to " + opts.quarantinePath, LogLevel::WARNING);
+}
+
+static ValidationOptions validationOptions(const AppOptions& opts) {
+    ValidationOptions validation;
+    validation.absTolerance = opts.validateTolerance;
+    validation.relTolerance = opts.validateRelTolerance;
+    validation.threads = opts.validateThreads;
+    validation.simd = !opts.validateScalar;
+    return validation;
+}
 
+// --validate-risk: one line of counts and throughput, and the flagged options as CSV
+static bool reportValidation(const AppOptions& opts, const std::vector<ValidationIssue>& issues, const ValidationStats& stats,
+    int threads) {
+    char deviation[32];
+    std::snprintf(deviation, sizeof(deviation), "%.6g", stats.maxDeviation);
+    logger.log("risk validation: " + std::to_string(stats.options) + " options repriced in " + std::to_string(stats.seconds) + " s (" +
+        std::to_string(stats.seconds > 0 ? stats.options / stats.seconds : 0.0) + " options/s, " +
+        (!opts.validateScalar && cpuHasAvx2() ? "avx2" : "scalar") + ", " + std::to_string(threads) + " threads): " +
+        std::to_string(stats.flagged) + " flagged, " + std::to_string(stats.skipped) + " skipped, " +
+        std::to_string(stats.noUnderlying) + " without an underlying price, max deviation " + deviation,
+        stats.flagged ? LogLevel::WARNING : LogLevel::INFO);
+    return writeValidationIssues(opts.validateOutputPath, issues);
+}
+
+// Parses the file into a sink, streaming or collect-then-write
+static bool writeThroughSink(SpanInput& input, RecordSink& sink, const AppOptions& opts) {
+    BlockQuarantine quarantine;
+    if (!openQuarantine(opts, input, quarantine))
+        return false;
+
+    if (opts.streaming) {
+        PipelineOptions pipeline;
+        pipeline.parseThreads = opts.parseThreads;
+        pipeline.ordered = !opts.unordered;
+        pipeline.maxBlocksInFlight = (size_t)opts.queueDepth;
+        pipeline.quarantine = quarantine.isOpen() ? &quarantine : nullptr;
+
+        // --validate-risk checks each block on the writer thread, after the sink took it
+        ValidationSink validation(validationOptions(opts));
+        TeeSink validated(sink, validation);
+        PipelineStats stats;
+        bool ok = input.stream(opts.validateRisk ? (RecordSink&)validated : sink, pipeline, stats) && stats.insert.rowsFailed == 0;
+        logger.log("streamed " + std::to_string(stats.blocks) + " blocks, " + std::to_string(stats.records) + " records: wrote " +
+            std::to_string(stats.insert.rowsInserted) + " rows, " + std::to_string(stats.insert.rowsFailed) + " rejected, " +
+            std::to_string(stats.insert.batches) + " batches", LogLevel::INFO);
+        logQuarantine(opts, quarantine);
+        if (opts.validateRisk)
+            ok = reportValidation(opts, validation.issues(), validation.validationStats(), 1) && ok;
+        return ok;
+    }
+
+    std::string_view data;
+    if (!input.text(data))
+        return false;
+    SpanRecordStore records;
+    parseAll(data, opts, records, quarantine.isOpen() ? &quarantine : nullptr);
+    logQuarantine(opts, quarantine);
+
+    // --validate-risk reprices the options on its own threads while the sink writes
+    std::vector<ValidationIssue> issues;
+    ValidationStats validation;
+    std::thread validator;
+    if (opts.validateRisk)
+        validator = std::thread([&] { validateRiskArrays(records, validationOptions(opts), issues, validation); });
+    bool written;
+    {
+        ScopedTimer timer(metrics.sinkWriteNs);
+        written = sink.write(records);
+    }
+    bool ok = written && sink.finish() && sink.stats().rowsFailed == 0;
+    if (!written)
+        sink.abort();
+    if (validator.joinable()) {
+        validator.join();
+        ok = reportValidation(opts, issues, validation, opts.validateThreads) && ok;
+    }
+    return ok;
+}
+
+// Same, with --snapshot written and the --summary aggregates built from the same parsed blocks
+static bool loadIntoSink(SpanInput& input, RecordSink& sink, const AppOptions& opts, SpanSummary* summary = nullptr) {
+    if (summary) {
+        SummarySink aggregates(*summary);
+        TeeSink tee(sink, aggregates);
+        return loadIntoSink(input, tee, opts);
+    }
+    if (opts.snapshotPath.empty())
+        return writeThroughSink(input, sink, opts);
+    ColumnFileSink snapshot(opts.snapshotPath, true);
+    TeeSink tee(sink, snapshot);
+    return writeThroughSink(input, tee, opts);
+}
+
+// --summary as CSV files base.<kind>.csv
+static bool writeSummary(const SpanSummary& summary, const std::string& base) {
+    bool ok = writeSummaryFiles(base, summary);
+    logger.log("summary: " + std::to_string(summary.rowCount()) + " rows for " + std::to_string(summary.records()) + " records" +
+        (ok ? " written to " : " not written to ") + base + ".*.csv", ok ? LogLevel::INFO : LogLevel::ERRORS);
+    return ok;
+}
+
+#if SPAN_WITH_ODBC
+// --summary into the summary tables, uncommitted on a manual-commit connection
+static bool insertSummary(SQLHDBC hDbc, const SpanSummary& summary) {
+    InsertStats stats;
+    bool ok = insertSummaryTables(hDbc, summary, stats) && stats.rowsFailed == 0;
+    logger.log("summary: " + std::to_string(stats.rowsInserted) + " rows for " + std::to_string(summary.records()) + " records inserted, " +
+        std::to_string(stats.rowsFailed) + " rejected", ok ? LogLevel::INFO : LogLevel::ERRORS);
+    return ok;
+}
+
+// Streams the file on one manual-commit connection and commits after the
+// block that takes the uncommitted rows to --commit-rows, then journals the
+// position. A run with a journal for the same file resumes after its last
+// commit; a completed load removes the journal. Malformed blocks go to the
+// quarantine file.
+static bool loadWithCheckpoints(SpanInput& input, const std::wstring& connStr, const AppOptions& opts) {
+    const std::string& journal = opts.checkpointPath;
+    LoadCheckpoint fresh;
+    fresh.fileBytes = input.fileBytes();
+    fresh.fingerprint = inputFingerprint(input.fileView());
+
+    LoadCheckpoint checkpoint;
+    bool resume = loadCheckpoint(journal, checkpoint);
+    if (resume && (checkpoint.fileBytes != fresh.fileBytes || checkpoint.fingerprint != fresh.fingerprint)) {
+        logger.log("Checkpoint journal " + journal + " is for a different file, loading from the start", LogLevel::WARNING);
+        resume = false;
+    }
+
+    // A resumed run drops what the failed one quarantined after its last commit
+    BlockQuarantine quarantine;
+    if (!quarantine.open(opts.quarantinePath, input.name(), resume ? checkpoint.quarantineBytes : UINT64_MAX))
+        return false;
+    if (resume) {
+        logger.log("resuming " + input.name() + " from " + journal + " at offset " + std::to_string(checkpoint.offset) + ", block " +
+            std::to_string(checkpoint.blocks) + ", " + std::to_string(checkpoint.rows) + " rows already committed", LogLevel::INFO);
+    }
+    else {
+        checkpoint = fresh;
+        checkpoint.quarantineBytes = quarantine.bytes();
+    }
+
+    InserterOptions inserter;
+    inserter.batchSize = (size_t)opts.batchSize;
+    inserter.riskEncoding = opts.riskEncoding;
+    inserter.schema = opts.schema;
+    ConnectionPool pool;
+    OdbcSink sink;
+    if (!pool.open(connStr, 1) || !sink.open(pool.connection(0), inserter, opts.loadSections))
+        return false;
+
+    const size_t commitRows = (size_t)opts.commitRows;
+    size_t uncommitted = 0;
+    PipelineOptions pipeline;
+    pipeline.parseThreads = opts.parseThreads;
+    pipeline.ordered = true;        // a checkpoint covers every block before it
+    pipeline.maxBlocksInFlight = (size_t)opts.queueDepth;
+    pipeline.startOffset = checkpoint.offset;
+    pipeline.firstIndex = checkpoint.blocks;
+    pipeline.quarantine = &quarantine;
+    pipeline.onWritten = [&](const ParsedBlock& block) {
+        uncommitted += block.records.size();
+        if (commitRows == 0 || uncommitted < commitRows)
+            return true;
+        if (!sink.flush() || !pool.commit(0))
+            return false;
+        metrics.rowsPerCommit.record(uncommitted);
+        checkpoint.offset = block.endOffset;
+        checkpoint.blocks = block.index + 1;
+        checkpoint.rows += uncommitted;
+        checkpoint.quarantineBytes = quarantine.bytes();
+        uncommitted = 0;
+        return saveCheckpoint(journal, checkpoint);
+    };
+
+    PipelineStats stats;
+    bool ok = input.stream(sink, pipeline, stats) && pool.commit(0);
+    if (ok) {
+        metrics.rowsPerCommit.record(uncommitted);
+        removeCheckpoint(journal);
+        logger.log("checkpointed load complete: " + std::to_string(stats.records) + " records this run, " +
+            std::to_string(checkpoint.rows + uncommitted) + " in total", LogLevel::INFO);
+    }
+    else {
+        pool.rollback(0);
+        logger.log("checkpointed load stopped; " + std::to_string(checkpoint.rows) + " rows up to offset " +
+            std::to_string(checkpoint.offset) + " are committed, run again with --checkpoint " + journal + " to resume", LogLevel::ERRORS);
+    }
+    logQuarantine(opts, quarantine);
+    return ok && stats.insert.rowsFailed == 0;
+}
+
+// SQL Server loads: delta, checkpointed, staged over a connection pool, or one OdbcSink
+static bool loadIntoDatabase(SpanInput& input, const AppOptions& opts) {
     std::wstring connStr;
-    if (!readConnectionString(configPath, connStr)) {
+    if (!readConnectionString(opts.configPath, connStr)) {
         logger.log("Failed to read db-config.ini", LogLevel::ERRORS);
-        return 1;
+        return false;
     }
     logger.log("db-Connstr formed: " + std::string(connStr.begin(), connStr.end()), LogLevel::INFO);
 
-    std::ifstream file(spanFilePath);
-    if (!file.is_open()) {
-        logger.log("Failed to open SPAN file.", LogLevel::ERRORS);
-        return 1;
+    if (opts.delta && !opts.snapshotPath.empty())
+        logger.log("--snapshot is not written by --delta loads, which skip unchanged blocks", LogLevel::WARNING);
+    if (opts.delta && opts.loadSections)
+        logger.log("--load-sections is not supported by --delta loads, which only merge SpanRecords6", LogLevel::WARNING);
+    if (opts.delta && !opts.checkpointPath.empty())
+        logger.log("--checkpoint is not supported by --delta loads", LogLevel::WARNING);
+    if (opts.summaryKinds && (opts.delta || !opts.checkpointPath.empty()))
+        logger.log("--summary is not built by --delta or --checkpoint loads, which may not parse every block", LogLevel::WARNING);
+    if (opts.validateRisk && (opts.delta || !opts.checkpointPath.empty()))
+        logger.log("--validate-risk is not run by --delta or --checkpoint loads, which may not parse every block", LogLevel::WARNING);
+    if (!opts.delta && !opts.checkpointPath.empty() && (opts.connections > 0 || opts.unordered || !opts.snapshotPath.empty()))
+        logger.log("--checkpoint loads stream in file order on one connection; --connections/--unordered/--snapshot are ignored",
+            LogLevel::WARNING);
+    const bool normalized = opts.schema == OutputSchema::Normalized;
+    if (opts.delta && normalized)
+        logger.log("--delta loads MERGE into SpanRecords6; --schema normalized is ignored", LogLevel::WARNING);
+    else if (normalized && opts.connections > 0 && !opts.streaming && opts.checkpointPath.empty())
+        logger.log("--schema normalized loads through one connection, which assigns the surrogate keys; --connections is ignored",
+            LogLevel::WARNING);
+    if (opts.delta && (opts.streaming || opts.connections > 0))
+        logger.log("--delta loads through one connection; --streaming/--connections are ignored", LogLevel::WARNING);
+    else if (opts.streaming && opts.connections > 0)
+        logger.log("--connections applies to collect-then-insert loads; streaming uses one connection", LogLevel::WARNING);
+
+    if (opts.delta) {
+        DeltaOptions delta;
+        delta.indexPath = opts.digestIndexPath;
+        delta.batchSize = (size_t)opts.batchSize;
+        delta.riskEncoding = opts.riskEncoding;
+
+        BlockQuarantine quarantine;
+        if (!openQuarantine(opts, input, quarantine))
+            return false;
+        delta.quarantine = quarantine.isOpen() ? &quarantine : nullptr;
+
+        ConnectionPool pool;
+        DeltaStats stats;
+        std::string_view data;
+        bool ok = input.text(data) && pool.open(connStr, 1) && runDeltaLoad(data, pool.connection(0), delta, stats);
+        logQuarantine(opts, quarantine);
+        logger.log("delta load: skipped " + std::to_string(stats.blocksSkipped) + " of " + std::to_string(stats.blocks) + " blocks and " +
+            std::to_string(stats.rowsSkipped) + " rows, merged " + std::to_string(stats.rowsMerged) + " rows", LogLevel::INFO);
+        return ok;
     }
-    logger.log("span file opened", LogLevel::INFO);
 
+    if (!opts.checkpointPath.empty())
+        return loadWithCheckpoints(input, connStr, opts);
+
+    if (opts.connections > 0 && !opts.streaming && !normalized) {
+        std::string_view data;
+        BlockQuarantine quarantine;
+        if (!input.text(data) || !openQuarantine(opts, input, quarantine))
+            return false;
+        SpanRecordStore records;
+        parseAll(data, opts, records, quarantine.isOpen() ? &quarantine : nullptr);
+        logQuarantine(opts, quarantine);
+        SpanSummary summary(opts.summaryKinds);
+        if (opts.summaryKinds)
+            summary.add(records);
+
+        LoaderOptions loader;
+        loader.batchSize = (size_t)opts.batchSize;
+        loader.riskEncoding = opts.riskEncoding;
+        loader.commitRows = (size_t)opts.commitRows;
+        loader.commitBytes = (size_t)opts.commitBytes;
+        parsePartitionKey(opts.partition, loader.partition);
+        loader.sections = opts.loadSections;
+
+        if (!opts.snapshotPath.empty()) {
+            ColumnFileSink snapshot(opts.snapshotPath, true);
+            if (!snapshot.write(records) || !snapshot.finish())
+                return false;
+        }
+
+        std::vector<ValidationIssue> issues;
+        ValidationStats validation;
+        std::thread validator;
+        if (opts.validateRisk)
+            validator = std::thread([&] { validateRiskArrays(records, validationOptions(opts), issues, validation); });
+        ConnectionPool pool;
+        LoaderStats stats;
+        bool ok = pool.open(connStr, opts.connections) && loadSpanRecordsParallel(pool, records, loader, stats);
+        logger.log("parallel load over " + std::to_string(opts.connections) + " connections: " + std::to_string(stats.insert.rowsInserted) +
+            " rows staged, " + std::to_string(stats.insert.commits) + " commits, " + std::to_string(stats.sections.rowsInserted) +
+            " section records, " + (stats.published ? "published" : "not published"), LogLevel::INFO);
+        if (validator.joinable()) {
+            validator.join();
+            ok = reportValidation(opts, issues, validation, opts.validateThreads) && ok;
+        }
+        if (ok && opts.summaryKinds) {
+            ok = insertSummary(pool.connection(0), summary) && pool.commit(0);
+            if (!ok)
+                pool.rollback(0);
+            if (!opts.summaryOutputPath.empty())
+                ok = writeSummary(summary, opts.summaryOutputPath) && ok;
+        }
+        return ok;
+    }
+
+    SQLHENV hEnv = nullptr;
+    SQLHDBC hDbc = nullptr;
     if (!connectToMSSQL(hEnv, hDbc, connStr)) {
         logger.log("DB connection failed.", LogLevel::ERRORS);
-        return 1;
+        return false;
     }
     logger.log("Connected to database", LogLevel::INFO);
 
-    std::string line;
-    std::string block;
-    std::vector<SpanRecord> records;
-    bool insideBlock = false;
-
-    while (std::getline(file, line)) {
-        line.erase(line.begin(), std::find_if(line.begin(), line.end(), [](int ch) {
-            return !std::isspace(ch);
-            }));
-
-        if (!insideBlock && (line.find("<phyPf>") != std::string::npos ||
-            line.find("<futPf>") != std::string::npos ||
-            line.find("<oofPf>") != std::string::npos)) {
-            insideBlock = true;
-            block = line + "\n";
-            continue;
-        }
-
-        if (insideBlock) {
-            block += line + "\n";
-            if (line.find("</phyPf>") != std::string::npos ||
-                line.find("</futPf>") != std::string::npos ||
-                line.find("</oofPf>") != std::string::npos) {
-
-                parseSpanXmlBlock(block, records);
-                block.clear();
-                insideBlock = false;
+    InserterOptions inserter;
+    inserter.batchSize = (size_t)opts.batchSize;
+    inserter.riskEncoding = opts.riskEncoding;
+    inserter.schema = opts.schema;
+    OdbcSink sink;
+    SpanSummary summary(opts.summaryKinds);
+    bool ok = sink.open(hDbc, inserter, opts.loadSections) && loadIntoSink(input, sink, opts, opts.summaryKinds ? &summary : nullptr);
+    if (ok && opts.summaryKinds) {
+        ok = insertSummary(hDbc, summary);
+        if (!opts.summaryOutputPath.empty())
+            ok = writeSummary(summary, opts.summaryOutputPath) && ok;
+    }
+
+    SQLDisconnect(hDbc);
+    SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
+    SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
+    return ok;
+}
+
+// Watch mode keeps one connection in manual-commit mode and one prepared insert
+// open between files; each file is one transaction. After a failure the
+// connection is dropped, whatever the cause, and the next file reconnects.
+struct WarmDatabase {
+    std::wstring connStr;
+    InserterOptions inserter;
+    bool sections = false;
+    ConnectionPool pool;
+    OdbcSink sink;
+    bool ready = false;
+
+    bool connect() {
+        if (!ready) {
+            ready = pool.open(connStr, 1) && sink.open(pool.connection(0), inserter, sections);
+            if (!ready)
+                drop();
+        }
+        return ready;
+    }
+    void drop() {
+        sink.close();
+        pool.close();
+        ready = false;
+    }
+};
+#endif // SPAN_WITH_ODBC
+
+static void onStopSignal(int) {
+    stopWatch();
+}
+
+// Loads every file dropped into the inbox until SIGINT/SIGTERM; config and,
+// for SQL Server, the connection and prepared statement are set up once
+static bool runWatchMode(const AppOptions& opts) {
+    if (opts.delta || opts.connections > 0 || !opts.checkpointPath.empty())
+        logger.log("--watch loads each file in one transaction on one connection; --delta/--connections/--checkpoint are ignored",
+            LogLevel::WARNING);
+
+#if SPAN_WITH_ODBC
+    WarmDatabase db;
+    if (opts.sink == "odbc") {
+        if (!readConnectionString(opts.configPath, db.connStr)) {
+            logger.log("Failed to read db-config.ini", LogLevel::ERRORS);
+            return false;
+        }
+        db.inserter.batchSize = (size_t)opts.batchSize;
+        db.inserter.riskEncoding = opts.riskEncoding;
+        db.inserter.schema = opts.schema;
+        db.sections = opts.loadSections;
+        if (!db.connect())
+            return false;
+    }
+#endif
+
+    auto loadFile = [&](const std::string& path) {
+        SpanInput input;
+        SpanSummary summary(opts.summaryKinds);
+        SpanSummary* aggregates = opts.summaryKinds ? &summary : nullptr;
+        const std::string name = std::filesystem::path(path).filename().string();
+        // --validate-risk results also go next to the archived input
+        AppOptions fileOpts = opts;
+        fileOpts.validateOutputPath = (std::filesystem::path(opts.archivePath) / (name + ".validation.csv")).string();
+        bool ok = false;
+        try {
+            if (!input.open(path))
+                return false;
+#if SPAN_WITH_ODBC
+            if (opts.sink == "odbc") {
+                if (!db.connect())
+                    return false;
+                db.sink.resetStats();
+                ok = loadIntoSink(input, db.sink, fileOpts, aggregates) && (!aggregates || insertSummary(db.pool.connection(0), summary)) &&
+                    db.pool.commit(0);
+                if (!ok) {
+                    db.pool.rollback(0);
+                    db.drop();
+                }
+            }
+#endif
+            if (opts.sink == "null") {
+                NullSink sink;
+                ok = loadIntoSink(input, sink, fileOpts, aggregates);
+            }
+            else if (opts.sink == "columnar") {
+                ColumnFileSink sink((std::filesystem::path(opts.archivePath) / (name + ".spcol")).string());
+                ok = loadIntoSink(input, sink, fileOpts, aggregates);
             }
+            // Summary files go next to the archived input, one set per file
+            if (ok && aggregates && opts.sink != "odbc")
+                ok = writeSummary(summary, (std::filesystem::path(opts.archivePath) / (name + ".summary")).string());
+        }
+        catch (const std::exception& e) {
+            logger.log("Failed to load " + path + ": " + e.what(), LogLevel::ERRORS);
+#if SPAN_WITH_ODBC
+            if (db.ready) {
+                db.pool.rollback(0);
+                db.drop();
+            }
+#endif
+            ok = false;
+        }
+        metrics.fileBytes.add(input.fileBytes());
+        metrics.textBytes.add(input.textBytes());
+        return ok;
+    };
+
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    WatchOptions watch;
+    watch.inbox = opts.spanFilePath;
+    watch.archive = opts.archivePath;
+    watch.pollMs = opts.pollMs;
+    watch.polling = opts.watchPolling;
+    watch.metricsJsonPath = opts.metricsJsonPath;
+    watch.metricsPromPath = opts.metricsPromPath;
+    return runWatch(watch, loadFile);
+}
+
+// Loads every file of the --batch directory or pattern on a work-stealing
+// pool; for SQL Server the workers share a fixed set of connections
+static bool runBatchMode(const AppOptions& opts) {
+    if (opts.delta || !opts.checkpointPath.empty() || !opts.quarantinePath.empty() || opts.streaming || !opts.snapshotPath.empty())
+        logger.log("--batch commits each file on its own; --delta/--checkpoint/--quarantine/--streaming/--snapshot are ignored",
+            LogLevel::WARNING);
+
+    BatchOptions batch;
+    batch.pattern = opts.spanFilePath;
+    batch.fromDate = opts.fromDate;
+    batch.toDate = opts.toDate;
+    batch.threads = opts.batchThreads;
+    batch.splitBytes = (size_t)opts.splitMb << 20;
+
+    // Each chunk is summarized on its worker; committed chunks are merged into
+    // the batch's summary, staged ones once their file is published
+    SpanSummary summary(opts.summaryKinds);
+    std::map<std::string, SpanSummary> stagedSummaries;
+    std::mutex summaryMutex;
+    auto summarize = [&](const SpanRecordStore& records, const std::string& target) {
+        SpanSummary part(opts.summaryKinds);
+        part.add(records);
+        std::lock_guard<std::mutex> lock(summaryMutex);
+        if (target.empty())
+            summary.merge(part);
+        else
+            stagedSummaries.emplace(target, SpanSummary(opts.summaryKinds)).first->second.merge(part);
+    };
+    // Chunks are validated on their worker too, against the underlyings in the same chunk
+    std::vector<ValidationIssue> issues;
+    ValidationStats validation;
+    std::mutex validationMutex;
+    auto validate = [&](const SpanRecordStore& records) {
+        ValidationOptions single = validationOptions(opts);
+        single.threads = 1;
+        std::vector<ValidationIssue> found;
+        ValidationStats part;
+        validateRiskArrays(records, single, found, part);
+        std::lock_guard<std::mutex> lock(validationMutex);
+        issues.insert(issues.end(), found.begin(), found.end());
+        validation.add(part);
+    };
+
+    bool ok = false;
+    if (opts.sink == "null") {
+        ok = runBatchLoad(batch, [&](const SpanRecordStore& records, const std::string& target, InsertStats& stats) {
+            NullSink sink;
+            bool written = sink.write(records) && sink.finish();
+            stats = sink.stats();
+            if (written && opts.summaryKinds)
+                summarize(records, target);
+            if (written && opts.validateRisk)
+                validate(records);
+            return written;
+        });
+    }
+#if SPAN_WITH_ODBC
+    else if (opts.sink == "odbc") {
+        std::wstring connStr;
+        if (!readConnectionString(opts.configPath, connStr)) {
+            logger.log("Failed to read db-config.ini", LogLevel::ERRORS);
+            return false;
+        }
+        InserterOptions inserter;
+        inserter.batchSize = (size_t)opts.batchSize;
+        inserter.riskEncoding = opts.riskEncoding;
+        inserter.schema = opts.schema;
+        int connections = opts.connections > 0 ? opts.connections : std::min(opts.batchThreads, 4);
+        if (opts.schema == OutputSchema::Normalized && connections > 1) {
+            logger.log("--schema normalized assigns surrogate keys on one connection; the batch shares a single connection",
+                LogLevel::WARNING);
+            connections = 1;
+        }
+        OdbcSinkPool sinks;
+        if (!sinks.open(connStr, connections, inserter, opts.loadSections))
+            return false;
+        logger.log("batch: " + std::to_string(opts.batchThreads) + " workers share " + std::to_string(sinks.size()) + " connections",
+            LogLevel::INFO);
+
+        // A split file is staged and published whole. The staging table is a
+        // copy of SpanRecords6, so normalized and section loads keep a file in
+        // one transaction instead.
+        BatchStaging staging;
+        if (opts.schema == OutputSchema::Normalized || opts.loadSections) {
+            logger.log("batch: --schema normalized and --sections load each file in one transaction, --split-mb is ignored",
+                LogLevel::WARNING);
+            batch.splitBytes = SIZE_MAX;
+        }
+        else {
+            staging.begin = [&](const BatchFile& file, std::string& target) {
+                std::wstring table;
+                if (!sinks.beginStaging(table))
+                    return false;
+                target.assign(table.begin(), table.end());
+                logger.log("batch: staging the chunks of " + file.path + " in " + target, LogLevel::INFO);
+                return true;
+            };
+            staging.end = [&](const std::string& target, bool publish) {
+                bool published = sinks.endStaging(std::wstring(target.begin(), target.end()), publish);
+                std::lock_guard<std::mutex> lock(summaryMutex);
+                auto it = stagedSummaries.find(target);
+                if (it != stagedSummaries.end()) {
+                    if (published)
+                        summary.merge(it->second);
+                    stagedSummaries.erase(it);
+                }
+                return published;
+            };
         }
+        ok = runBatchLoad(batch, [&](const SpanRecordStore& records, const std::string& target, InsertStats& stats) {
+            bool written = sinks.write(records, std::wstring(target.begin(), target.end()), stats);
+            if (written && opts.summaryKinds)
+                summarize(records, target);
+            if (written && opts.validateRisk)
+                validate(records);
+            return written;
+        }, staging);
+        if (opts.summaryKinds) {
+            InsertStats stats;
+            bool inserted = sinks.writeSummary(summary, stats) && stats.rowsFailed == 0;
+            logger.log("summary: " + std::to_string(stats.rowsInserted) + " rows for " + std::to_string(summary.records()) +
+                " records inserted, " + std::to_string(stats.rowsFailed) + " rejected", inserted ? LogLevel::INFO : LogLevel::ERRORS);
+            ok = inserted && ok;
+        }
+    }
+#endif
+    else {
+        logger.log("--batch writes to --sink odbc or null", LogLevel::ERRORS);
+        return false;
     }
-    logger.log("parsing of file records into vector of SpanRecord is done.", LogLevel::INFO);
+    if (opts.summaryKinds && !opts.summaryOutputPath.empty())
+        ok = writeSummary(summary, opts.summaryOutputPath) && ok;
+    if (opts.validateRisk)
+        ok = reportValidation(opts, issues, validation, 1) && ok;
+    writeMetrics(metrics, opts.metricsJsonPath, opts.metricsPromPath);
+    return ok;
+}
 
+int main(int argc, char* argv[]) {
+    logger.log("Starting application");
+    AppOptions opts;
+    if (!parseCommandLine(argc, argv, opts)) {
+        printUsage();
+        return 1;
+    }
+    if (opts.selfTest) {
+        bool ok = runSelfTest();
+        logger.flush();
+        return ok ? 0 : 1;
+    }
+#if !SPAN_WITH_ODBC
+    bool benchOnly = opts.benchParse || opts.benchStore || opts.benchRisk || opts.benchSchema || opts.benchSuite || opts.benchLog ||
+        opts.benchScan || opts.benchSnapshot || opts.benchValidate || !opts.positionsPath.empty() || !opts.diffBasePath.empty();
+    if (opts.sink == "odbc" && !benchOnly) {
+        logger.log("Built without ODBC support, use --sink columnar or --sink null", LogLevel::ERRORS);
+        std::cerr << "Built without ODBC support, use --sink columnar or --sink null\n";
+        return 1;
+    }
+#endif
 
-    bool flag = insertSpanRecords(hDbc, records);
-    if (!flag)
-        logger.log("Failed to insert span Records", LogLevel::INFO);
-    else
-        logger.log("Span Records inserted successfully", LogLevel::INFO);
+    if (opts.asyncLog) {
+        AsyncLogOptions async;
+        async.capacity = (size_t)opts.logQueue;
+        async.overflow = opts.logOverflow;
+        logger.startAsync(async);
+    }
+    if (opts.benchLog) {
+        benchLog(opts.parseThreads > 1 ? opts.parseThreads : 4);
+        return 0;
+    }
 
-    std::cout << "Span Records inserted successfully";
-    SQLDisconnect(hDbc);
-    SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
-    SQLFreeHandle(SQL_HANDLE_ENV, hEnv);
+    if (opts.watch) {
+        bool ok = runWatchMode(opts);
+        logger.flush();
+        return ok ? 0 : 1;
+    }
+
+    if (opts.batch) {
+        bool ok = runBatchMode(opts);
+        logger.flush();
+        return ok ? 0 : 1;
+    }
 
+    if (opts.generate && !writeSpanFile(opts.spanFilePath, opts.generator))
+        return 1;
+
+    SpanInput input;
+    if (!input.open(opts.spanFilePath)) {
+        logger.log("Failed to open SPAN file.", LogLevel::ERRORS);
+        return 1;
+    }
+    logger.log("span file opened", LogLevel::INFO);
+
+    if (opts.benchSnapshot) {
+        std::string_view data;
+        if (!input.text(data))
+            return 1;
+        benchSnapshot(data, opts.snapshotPath.empty() ? opts.spanFilePath + ".snap" : opts.snapshotPath, opts.parseThreads, 100000);
+        logger.flush();
+        return 0;
+    }
+    if (!opts.diffBasePath.empty()) {
+        bool ok = runSpanDiff(input, opts);
+        logger.flush();
+        return ok ? 0 : 1;
+    }
+    if (opts.benchScan || !opts.positionsPath.empty()) {
+        std::string_view data;
+        if (!input.text(data))
+            return 1;
+        bool ok = runScanRisk(data, opts);
+        logger.flush();
+        return ok ? 0 : 1;
+    }
+    if (opts.benchValidate) {
+        std::string_view data;
+        if (!input.text(data))
+            return 1;
+        SpanRecordStore records;
+        parseAll(data, opts, records);
+        benchRiskValidation(records, opts.validateThreads);
+        logger.flush();
+        return 0;
+    }
+
+    if (opts.benchParse || opts.benchStore || opts.benchRisk || opts.benchSchema || opts.benchSuite) {
+        std::string_view data;
+        if (!input.text(data))
+            return 1;
+        if (opts.benchParse)
+            benchParse(data, opts.parseThreads);
+        else if (opts.benchStore)
+            benchStore(data);
+        else if (opts.benchRisk)
+            benchRisk(data);
+        else if (opts.benchSchema)
+            benchSchema(data, opts.riskEncoding);
+        else
+            return runBenchSuiteFor(data, opts) ? 0 : 1;
+        return 0;
+    }
+
+    if (!opts.checkpointPath.empty() && opts.sink != "odbc")
+        logger.log("--checkpoint applies to --sink odbc only and is ignored", LogLevel::WARNING);
+
+    auto loadStart = std::chrono::steady_clock::now();
+    bool flag = false;
+
+    // Without --quarantine a malformed block ends the load here instead of the process
+    try {
+        SpanSummary summary(opts.summaryKinds);
+        if (opts.sink == "null") {
+            NullSink sink;
+            flag = loadIntoSink(input, sink, opts, opts.summaryKinds ? &summary : nullptr);
+            if (flag && opts.summaryKinds)
+                flag = writeSummary(summary, opts.summaryOutputPath);
+        }
+        else if (opts.sink == "columnar") {
+            ColumnFileSink sink(opts.outputPath);
+            flag = loadIntoSink(input, sink, opts, opts.summaryKinds ? &summary : nullptr);
+            if (flag && opts.summaryKinds)
+                flag = writeSummary(summary, opts.summaryOutputPath);
+        }
+#if SPAN_WITH_ODBC
+        else {
+            flag = loadIntoDatabase(input, opts);
+        }
+#endif
+    }
+    catch (const std::exception& e) {
+        logger.log("Load of " + opts.spanFilePath + " stopped: " + e.what() + " (--quarantine P sets malformed blocks aside)",
+            LogLevel::ERRORS);
+    }
+
+    // Throughput of the SPAN text, i.e. after decompression for archives
+    double megaBytes = input.textBytes() / (1024.0 * 1024.0);
+    double loadSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    std::string mode = opts.delta && opts.sink == "odbc" ? "delta" : !opts.checkpointPath.empty() && opts.sink == "odbc" ? "checkpointed" :
+        opts.streaming ? "streaming" : "collect-then-insert";
+    logger.log("load finished (" + mode + ", " + opts.sink + " sink, " + inputFormatName(input.format()) + " input): " +
+        std::to_string(megaBytes) + " MB in " + std::to_string(loadSecs) + " s end-to-end (" +
+        std::to_string(loadSecs > 0 ? megaBytes / loadSecs : 0.0) + " MB/s), peak memory " +
+        std::to_string(peakResidentBytes() / (1024.0 * 1024.0)) + " MB", LogLevel::INFO);
+
+    metrics.fileBytes.add(input.fileBytes());
+    metrics.textBytes.add(input.textBytes());
+    // The block parse p99 of the slowest segment
+    uint64_t blocks = 0, records = 0, parseP99 = 0;
+    int slowest = 0;
+    for (int s = 0; s < segmentCount; ++s) {
+        blocks += metrics.blocks[s].get();
+        records += metrics.records[s].get();
+        uint64_t p99 = metrics.parseBlockNs[s].quantile(0.99);
+        if (p99 > parseP99) {
+            parseP99 = p99;
+            slowest = s;
+        }
+    }
+    logger.log("metrics: " + std::to_string(blocks) + " blocks, " + std::to_string(records) + " records, " +
+        std::to_string(metrics.roundTrips.get()) + " round trips, p99 block parse " +
+        std::to_string(parseP99 / 1000) + " us (" + segmentNames[slowest] + "), p99 execute " +
+        std::to_string(metrics.insertExecuteNs.quantile(0.99) / 1000) + " us", LogLevel::INFO);
+    writeMetrics(metrics, opts.metricsJsonPath, opts.metricsPromPath);
+
+    // flag stays false when the load threw
+    if (!flag) {
+        logger.log("Failed to insert span Records", LogLevel::ERRORS);
+        std::cerr << "Failed to insert span Records\n";
+        logger.flush();
+        return 1;
+    }
+
+    logger.log("Span Records inserted successfully", LogLevel::INFO);
+    std::cout << "Span Records inserted successfully";
+    logger.flush();
     return 0;
 }
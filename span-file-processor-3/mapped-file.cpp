@@ -0,0 +1,118 @@
+#include "mapped-file.h"
+#include <cstdint>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Release granularity; small enough to keep the resident set flat, large
+// enough that streaming loads make few calls
+static const size_t releaseChunk = 4 * 1024 * 1024;
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || (unsigned long long)fileSize.QuadPart > SIZE_MAX) {
+        close();
+        return false;
+    }
+    length = (size_t)fileSize.QuadPart;
+    if (length == 0)
+        return true;   // nothing to map, view() is empty
+
+    hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL) {
+        close();
+        return false;
+    }
+    data = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::releaseBefore(size_t offset) {
+    if (data == nullptr || offset > length)
+        return;
+    size_t end = offset / releaseChunk * releaseChunk;
+    if (end <= released)
+        return;
+    // VirtualUnlock on pages that are not locked removes them from the working set
+    VirtualUnlock((LPVOID)(data + released), end - released);
+    released = end;
+}
+
+void MappedFile::close() {
+    if (data)
+        UnmapViewOfFile(data);
+    if (hMapping != NULL)
+        CloseHandle(hMapping);
+    if (hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(hFile);
+    data = nullptr;
+    length = 0;
+    released = 0;
+    hMapping = NULL;
+    hFile = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    length = (size_t)st.st_size;
+    if (length == 0)
+        return true;
+
+    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    madvise(p, length, MADV_SEQUENTIAL);
+    data = (const char*)p;
+    return true;
+}
+
+void MappedFile::releaseBefore(size_t offset) {
+    if (data == nullptr || offset > length)
+        return;
+    size_t end = offset / releaseChunk * releaseChunk;
+    if (end <= released)
+        return;
+    madvise((void*)(data + released), end - released, MADV_DONTNEED);
+    released = end;
+}
+
+void MappedFile::close() {
+    if (data)
+        munmap((void*)data, length);
+    if (fd >= 0)
+        ::close(fd);
+    data = nullptr;
+    length = 0;
+    released = 0;
+    fd = -1;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Read-only memory mapping of a whole file, exposed as one contiguous view
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    std::string_view view() const { return std::string_view(data, length); }
+    size_t size() const { return length; }
+
+    // Drops pages before offset from this process's resident set once the
+    // caller is done with them; they are faulted back in if touched again
+    void releaseBefore(size_t offset);
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    size_t released = 0;
+#ifdef _WIN32
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif // MAPPED_FILE_H
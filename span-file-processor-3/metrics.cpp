@@ -0,0 +1,204 @@
+#include "metrics.h"
+#include "logger.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+extern Logger logger;
+
+const char* const segmentNames[segmentCount] = { "phypf", "futpf", "oofpf" };
+
+int segmentIndex(std::string_view segment) {
+    for (int i = 0; i < segmentCount; ++i)
+        if (segment == segmentNames[i])
+            return i;
+    return -1;
+}
+
+static int bitWidth(uint64_t value) {
+    int width = 0;
+    while (value) {
+        ++width;
+        value >>= 1;
+    }
+    return width;
+}
+
+static uint64_t bucketUpperBound(int i) {
+    return i >= 64 ? UINT64_MAX : (1ULL << i) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+    buckets[bitWidth(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    valueSum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t seen = valueMax.load(std::memory_order_relaxed);
+    while (value > seen && !valueMax.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t Histogram::quantile(double q) const {
+    uint64_t n = count();
+    if (n == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(q * (double)n);
+    if (rank >= n)
+        rank = n - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; ++i) {
+        seen += bucket(i);
+        if (seen > rank)
+            return bucketUpperBound(i) < max() ? bucketUpperBound(i) : max();
+    }
+    return max();
+}
+
+static std::string jsonHistogram(const Histogram& h, const char* unit) {
+    std::string out = std::string("{ \"unit\": \"") + unit + "\", \"count\": " + std::to_string(h.count()) +
+        ", \"sum\": " + std::to_string(h.sum()) + ", \"max\": " + std::to_string(h.max()) +
+        ", \"mean\": " + std::to_string(h.count() ? h.sum() / h.count() : 0) +
+        ", \"p50\": " + std::to_string(h.quantile(0.5)) + ", \"p90\": " + std::to_string(h.quantile(0.9)) +
+        ", \"p99\": " + std::to_string(h.quantile(0.99)) + ", \"buckets\": [";
+    bool first = true;
+    for (int i = 0; i < Histogram::bucketCount; ++i) {
+        if (!h.bucket(i))
+            continue;
+        out += std::string(first ? "" : ", ") + "[" + std::to_string(bucketUpperBound(i)) + ", " + std::to_string(h.bucket(i)) + "]";
+        first = false;
+    }
+    return out + "] }";
+}
+
+std::string Metrics::toJson() const {
+    std::string out = "{\n  \"counters\": {\n";
+    const std::pair<const char*, const Counter*> counters[] = {
+        { "fileBytes", &fileBytes }, { "textBytes", &textBytes }, { "decompressNs", &decompressNs },
+        { "roundTrips", &roundTrips }, { "rowsInserted", &rowsInserted }, { "rowsRejected", &rowsRejected },
+        { "filesLoaded", &filesLoaded }, { "filesFailed", &filesFailed },
+        { "sectionBlocks", &sectionBlocks }, { "sectionRecords", &sectionRecords },
+        { "quarantinedBlocks", &quarantinedBlocks }, { "checkpoints", &checkpoints },
+        { "batchChunks", &batchChunks }, { "tasksStolen", &tasksStolen } };
+    for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); ++i)
+        out += std::string("    \"") + counters[i].first + "\": " + std::to_string(counters[i].second->get()) +
+            (i + 1 < sizeof(counters) / sizeof(counters[0]) ? ",\n" : "\n");
+
+    out += "  },\n  \"segments\": {\n";
+    for (int s = 0; s < segmentCount; ++s)
+        out += std::string("    \"") + segmentNames[s] + "\": { \"blocks\": " + std::to_string(blocks[s].get()) +
+            ", \"records\": " + std::to_string(records[s].get()) + ", \"parseBlock\": " + jsonHistogram(parseBlockNs[s], "ns") +
+            (s + 1 < segmentCount ? " },\n" : " }\n");
+
+    out += "  },\n  \"histograms\": {\n";
+    const std::pair<const char*, const Histogram*> timings[] = {
+        { "sinkWrite", &sinkWriteNs }, { "insertPrepare", &insertPrepareNs }, { "insertExecute", &insertExecuteNs },
+        { "commit", &commitNs }, { "statement", &statementNs }, { "publish", &publishNs },
+        { "fileLatency", &fileLatencyNs } };
+    for (const auto& t : timings)
+        out += std::string("    \"") + t.first + "\": " + jsonHistogram(*t.second, "ns") + ",\n";
+    out += "    \"rowsPerBatch\": " + jsonHistogram(rowsPerBatch, "rows") + ",\n";
+    out += "    \"rowsPerCommit\": " + jsonHistogram(rowsPerCommit, "rows") + "\n";
+    return out + "  }\n}\n";
+}
+
+// scale converts the recorded unit to the exported one (1e-9 for ns -> seconds)
+static void promHistogram(std::string& out, const char* name, const char* help, const char* labels,
+    const Histogram& h, double scale, bool header) {
+    char buf[64];
+    if (header) {
+        out += std::string("# HELP ") + name + " " + help + "\n";
+        out += std::string("# TYPE ") + name + " histogram\n";
+    }
+    std::string sep = *labels ? std::string(labels) + "," : std::string();
+    int last = 0;
+    for (int i = 0; i < Histogram::bucketCount; ++i)
+        if (h.bucket(i))
+            last = i;
+    uint64_t cumulative = 0;
+    for (int i = 0; i <= last && i < 64; ++i) {
+        cumulative += h.bucket(i);
+        std::snprintf(buf, sizeof(buf), "%.9g", (double)bucketUpperBound(i) * scale);
+        out += std::string(name) + "_bucket{" + sep + "le=\"" + buf + "\"} " + std::to_string(cumulative) + "\n";
+    }
+    out += std::string(name) + "_bucket{" + sep + "le=\"+Inf\"} " + std::to_string(h.count()) + "\n";
+    std::snprintf(buf, sizeof(buf), "%.9g", (double)h.sum() * scale);
+    std::string braces = *labels ? std::string("{") + labels + "}" : std::string();
+    out += std::string(name) + "_sum" + braces + " " + buf + "\n";
+    out += std::string(name) + "_count" + braces + " " + std::to_string(h.count()) + "\n";
+}
+
+static void promCounter(std::string& out, const char* name, const char* help, uint64_t value, double scale = 1.0) {
+    out += std::string("# HELP ") + name + " " + help + "\n";
+    out += std::string("# TYPE ") + name + " counter\n";
+    if (scale == 1.0) {
+        out += std::string(name) + " " + std::to_string(value) + "\n";
+        return;
+    }
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.9g", (double)value * scale);
+    out += std::string(name) + " " + buf + "\n";
+}
+
+std::string Metrics::toPrometheus() const {
+    std::string out;
+    promCounter(out, "span_file_bytes_total", "Input file bytes read.", fileBytes.get());
+    promCounter(out, "span_text_bytes_total", "SPAN text bytes after decompression.", textBytes.get());
+    promCounter(out, "span_decompress_seconds_total", "Time spent decompressing archives.", decompressNs.get(), 1e-9);
+
+    out += "# HELP span_blocks_total Portfolio blocks parsed.\n# TYPE span_blocks_total counter\n";
+    for (int s = 0; s < segmentCount; ++s)
+        out += std::string("span_blocks_total{segment=\"") + segmentNames[s] + "\"} " + std::to_string(blocks[s].get()) + "\n";
+    out += "# HELP span_records_total Records produced by the parser.\n# TYPE span_records_total counter\n";
+    for (int s = 0; s < segmentCount; ++s)
+        out += std::string("span_records_total{segment=\"") + segmentNames[s] + "\"} " + std::to_string(records[s].get()) + "\n";
+    for (int s = 0; s < segmentCount; ++s) {
+        std::string label = std::string("segment=\"") + segmentNames[s] + "\"";
+        promHistogram(out, "span_parse_block_seconds", "Time to parse one portfolio block.", label.c_str(), parseBlockNs[s], 1e-9, s == 0);
+    }
+    promCounter(out, "span_section_blocks_total", "Combined commodity, spread and currency blocks parsed.", sectionBlocks.get());
+    promCounter(out, "span_section_records_total", "Typed records produced from section blocks.", sectionRecords.get());
+    promCounter(out, "span_quarantined_blocks_total", "Malformed blocks written to the quarantine file.", quarantinedBlocks.get());
+
+    promHistogram(out, "span_sink_write_seconds", "Time of one record sink write.", "", sinkWriteNs, 1e-9, true);
+    promHistogram(out, "span_insert_prepare_seconds", "Statement prepare, buffer setup and parameter binding.", "", insertPrepareNs, 1e-9, true);
+    promHistogram(out, "span_insert_execute_seconds", "One SQLExecute of a parameter array.", "", insertExecuteNs, 1e-9, true);
+    promHistogram(out, "span_insert_batch_rows", "Rows per SQLExecute.", "", rowsPerBatch, 1.0, true);
+    promHistogram(out, "span_commit_seconds", "Time of one commit.", "", commitNs, 1e-9, true);
+    promHistogram(out, "span_commit_rows", "Rows per commit.", "", rowsPerCommit, 1.0, true);
+    promCounter(out, "span_checkpoints_total", "Checkpoint journal writes after a commit.", checkpoints.get());
+    promHistogram(out, "span_statement_seconds", "Staging, publish and merge statements.", "", statementNs, 1e-9, true);
+    promHistogram(out, "span_publish_seconds", "Moving a staging table into SpanRecords6.", "", publishNs, 1e-9, true);
+    promCounter(out, "span_round_trips_total", "Database round trips.", roundTrips.get());
+    promCounter(out, "span_rows_inserted_total", "Rows the database accepted.", rowsInserted.get());
+    promCounter(out, "span_rows_rejected_total", "Rows the database rejected.", rowsRejected.get());
+    promCounter(out, "span_files_loaded_total", "Watch and batch modes: files loaded and committed.", filesLoaded.get());
+    promCounter(out, "span_files_failed_total", "Watch and batch modes: files that failed to load.", filesFailed.get());
+    promHistogram(out, "span_file_latency_seconds", "Watch mode: file arrival to committed rows.", "", fileLatencyNs, 1e-9, true);
+    promCounter(out, "span_batch_chunks_total", "Batch mode: chunks large files were split into.", batchChunks.get());
+    promCounter(out, "span_tasks_stolen_total", "Batch mode: tasks run by a worker other than the one they were queued on.", tasksStolen.get());
+    return out;
+}
+
+static bool writeText(const std::string& path, const std::string& text) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+    out.close();
+    if (!out) {
+        logger.log("Failed to write " + path, LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+bool writeMetrics(const Metrics& m, const std::string& jsonPath, const std::string& promPath) {
+    bool ok = jsonPath.empty() || writeText(jsonPath, m.toJson());
+    if (!promPath.empty()) {
+        std::string tmp = promPath + ".tmp";
+        // filesystem::rename replaces promPath on Windows too (MoveFileExW
+        // with MOVEFILE_REPLACE_EXISTING), so it never goes missing
+        std::error_code ec;
+        ok = writeText(tmp, m.toPrometheus()) && (std::filesystem::rename(tmp, promPath, ec), !ec) && ok;
+    }
+    return ok;
+}
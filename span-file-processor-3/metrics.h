@@ -0,0 +1,115 @@
+#pragma once
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Monotonic count; relaxed atomics, safe to bump from any thread
+class Counter {
+public:
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{ 0 };
+};
+
+// Distribution of integer values in power-of-two buckets: bucket i holds the
+// values with bit width i, i.e. 2^(i-1) <= v <= 2^i - 1 (bucket 0 holds 0).
+// record() is three relaxed atomic adds plus a rare max update.
+class Histogram {
+public:
+    static const int bucketCount = 65;
+
+    void record(uint64_t value);
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return valueSum.load(std::memory_order_relaxed); }
+    uint64_t max() const { return valueMax.load(std::memory_order_relaxed); }
+    uint64_t bucket(int i) const { return buckets[i].load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket the q-quantile falls into (0 if empty)
+    uint64_t quantile(double q) const;
+
+private:
+    std::atomic<uint64_t> buckets[bucketCount] = {};
+    std::atomic<uint64_t> total{ 0 };
+    std::atomic<uint64_t> valueSum{ 0 };
+    std::atomic<uint64_t> valueMax{ 0 };
+};
+
+// Records the lifetime of a scope into a histogram, in nanoseconds
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+const int segmentCount = 3;
+extern const char* const segmentNames[segmentCount];   // phypf, futpf, oofpf
+int segmentIndex(std::string_view segment);             // -1 if unknown
+
+// Counters for every stage of a run. Always on; exported once at the end as
+// JSON and, if asked for, as a Prometheus text file. *Ns histograms hold
+// nanoseconds and are exported in seconds to Prometheus.
+struct Metrics {
+    // Read
+    Counter fileBytes;              // bytes of the input file (compressed size for archives)
+    Counter textBytes;              // SPAN text bytes (after decompression)
+    Counter decompressNs;
+
+    // Parse, per segment
+    Counter blocks[segmentCount];
+    Counter records[segmentCount];
+    Histogram parseBlockNs[segmentCount];
+    Counter sectionBlocks;          // <ccDef>, <interSpreads> and <curConv> blocks
+    Counter sectionRecords;         // typed records from them (see span-sections.h)
+    Counter quarantinedBlocks;      // malformed blocks set aside (load-checkpoint.h)
+
+    // Write
+    Histogram sinkWriteNs;          // one RecordSink::write call
+    Histogram insertPrepareNs;      // SQLPrepare, buffer setup and parameter binding
+    Histogram insertExecuteNs;      // one SQLExecute of a parameter array
+    Histogram rowsPerBatch;
+    Histogram commitNs;
+    Histogram rowsPerCommit;
+    Histogram statementNs;          // executeSql: staging, publish, MERGE ...
+    Histogram publishNs;            // moving a staging table into SpanRecords6 (parallel-loader.h)
+    Counter roundTrips;             // prepare, execute, commit and direct statements
+    Counter rowsInserted;
+    Counter rowsRejected;
+    Counter checkpoints;            // checkpoint journal writes
+
+    // Watch and batch modes
+    Counter filesLoaded;
+    Counter filesFailed;
+    Histogram fileLatencyNs;        // file arrival in the inbox to its rows committed
+    Counter batchChunks;            // pieces of large files loaded as separate tasks (batch-load.h)
+    Counter tasksStolen;            // tasks a worker took from another's deque (work-stealing-pool.h)
+
+    std::string toJson() const;
+    std::string toPrometheus() const;
+};
+
+// Writes metrics.toJson() to jsonPath and, unless promPath is empty, the
+// Prometheus text to promPath (through a temporary file and rename, so a
+// node exporter textfile collector never reads half a file)
+bool writeMetrics(const Metrics& metrics, const std::string& jsonPath, const std::string& promPath);
+
+extern Metrics metrics;
+
+#endif // METRICS_H
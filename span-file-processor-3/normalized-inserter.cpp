@@ -0,0 +1,387 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "normalized-inserter.h"
+#include "logger.h"
+#include "metrics.h"
+#include <cstring>
+
+extern Logger logger;
+
+static bool sqlOk(SQLRETURN ret) {
+    return ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO;
+}
+
+static const SQLLEN initialRiskWidth = 1024;
+
+bool ParamBatch::open(SQLHDBC hDbc, const std::wstring& table, const std::vector<Column>& columnList, size_t rowCapacity,
+    RiskEncoding encoding) {
+    close();
+    columns = columnList;
+    capacity = rowCapacity ? rowCapacity : 1;
+    riskEncoding = encoding;
+    filled = 0;
+    batchBytes = 0;
+
+    if (!sqlOk(SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt))) {
+        logger.log("hStmt SQLAllocHandle failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_DBC, hDbc, "SQLAllocHandle");
+        hStmt = SQL_NULL_HANDLE;
+        return false;
+    }
+
+    std::wstring names, marks;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        names += (i ? L", " : L"") + std::wstring(columns[i].name);
+        marks += i ? L", ?" : L"?";
+    }
+    std::wstring sql = L"INSERT INTO " + table + L" (" + names + L") VALUES (" + marks + L")";
+    ScopedTimer prepareTimer(metrics.insertPrepareNs);
+    metrics.roundTrips.add();
+    if (!sqlOk(SQLPrepareW(hStmt, (SQLWCHAR*)sql.c_str(), SQL_NTS))) {
+        logger.log("hStmt SQLPrepareW failed for " + std::string(table.begin(), table.end()) + ".", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLPrepareW");
+        return false;
+    }
+
+    slots.assign(columns.size(), CharColumn());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        switch (columns[i].kind) {
+        case Kind::BigInt:
+            slots[i].init(0, sizeof(int64_t), capacity);
+            break;
+        case Kind::Int:
+            slots[i].init(0, sizeof(SQLINTEGER), capacity);
+            break;
+        case Kind::Double:
+            slots[i].init(0, sizeof(double), capacity);
+            break;
+        case Kind::Text:
+            slots[i].init(columns[i].size, (SQLLEN)columns[i].size + 1, capacity);
+            break;
+        case Kind::Risk:
+            slots[i].init(0, initialRiskWidth, capacity);
+            break;
+        }
+    }
+    paramStatus.assign(capacity, SQL_PARAM_UNUSED);
+
+    if (!sqlOk(SQLSetStmtAttr(hStmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0)) ||
+        !sqlOk(SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)capacity, 0)) ||
+        !sqlOk(SQLSetStmtAttr(hStmt, SQL_ATTR_PARAM_STATUS_PTR, paramStatus.data(), 0)) ||
+        !sqlOk(SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &paramsProcessed, 0))) {
+        logger.log("hStmt SQLSetStmtAttr failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLSetStmtAttr");
+        return false;
+    }
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (!bind(i))
+            return false;
+    }
+    return true;
+}
+
+bool ParamBatch::bind(size_t col) {
+    CharColumn& slot = slots[col];
+    SQLUSMALLINT param = (SQLUSMALLINT)(col + 1);
+    SQLRETURN ret;
+    switch (columns[col].kind) {
+    case Kind::BigInt:
+        ret = SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, SQL_C_SBIGINT, SQL_BIGINT, 0, 0, (SQLPOINTER)slot.data.data(), 0, NULL);
+        break;
+    case Kind::Int:
+        ret = SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, (SQLPOINTER)slot.data.data(), 0, NULL);
+        break;
+    case Kind::Double:
+        ret = SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)slot.data.data(), 0, NULL);
+        break;
+    case Kind::Text:
+        ret = SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_WVARCHAR, slot.columnSize, 0,
+            (SQLPOINTER)slot.data.data(), slot.width, slot.ind.data());
+        break;
+    default:
+        // Risk array, typed as in SpanInserter::bindRiskColumn
+        ret = SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, riskEncoding == RiskEncoding::Binary ? SQL_C_BINARY : SQL_C_CHAR,
+            riskEncoding == RiskEncoding::Binary ? SQL_VARBINARY : riskEncoding == RiskEncoding::Text ? SQL_VARCHAR : SQL_WVARCHAR,
+            0, 0, (SQLPOINTER)slot.data.data(), slot.width, slot.ind.data());
+        break;
+    }
+    if (!sqlOk(ret)) {
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLBindParameter", (int)param);
+        return false;
+    }
+    return true;
+}
+
+void ParamBatch::close() {
+    if (hStmt != SQL_NULL_HANDLE) {
+        SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+        hStmt = SQL_NULL_HANDLE;
+    }
+    filled = 0;
+    batchBytes = 0;
+}
+
+void ParamBatch::setBigInt(size_t col, int64_t value) {
+    std::memcpy(slots[col].slot(filled), &value, sizeof(value));
+}
+
+void ParamBatch::setInt(size_t col, int value) {
+    SQLINTEGER v = value;
+    std::memcpy(slots[col].slot(filled), &v, sizeof(v));
+}
+
+void ParamBatch::setDouble(size_t col, double value) {
+    std::memcpy(slots[col].slot(filled), &value, sizeof(value));
+}
+
+void ParamBatch::setText(size_t col, std::string_view value) {
+    CharColumn& slot = slots[col];
+    std::memcpy(slot.slot(filled), value.data(), value.size());
+    slot.slot(filled)[value.size()] = '\0';
+    slot.ind[filled] = (SQLLEN)value.size();
+}
+
+bool ParamBatch::widen(size_t col, size_t bytes) {
+    SQLLEN width = slots[col].width;
+    while (width <= (SQLLEN)bytes)
+        width *= 2;
+    slots[col].init(0, width, capacity);
+    return bind(col);
+}
+
+void ParamBatch::endRow(size_t rowBytes) {
+    batchBytes += rowBytes;
+    ++filled;
+}
+
+bool ParamBatch::execute(InsertStats& counters, size_t& inserted) {
+    inserted = 0;
+    if (filled == 0)
+        return true;
+    const size_t count = filled;
+    filled = 0;
+    if (count != capacity)
+        SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)count, 0);
+    for (size_t i = 0; i < count; ++i)
+        paramStatus[i] = SQL_PARAM_UNUSED;
+
+    SQLRETURN ret;
+    {
+        ScopedTimer timer(metrics.insertExecuteNs);
+        ret = SQLExecute(hStmt);
+    }
+    counters.batches++;
+    counters.bytes += batchBytes;
+    batchBytes = 0;
+    metrics.roundTrips.add();
+    metrics.rowsPerBatch.record(count);
+    if (count != capacity)
+        SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)capacity, 0);
+    if (!sqlOk(ret))
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLExecute");
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && ret != SQL_ERROR) {
+        logger.log("hStmt SQLExecute failed.", LogLevel::ERRORS);
+        return false;
+    }
+
+    // Unlike SpanInserter, rows of an aborted batch are not re-sent one by one
+    for (size_t i = 0; i < count; ++i) {
+        if (paramStatus[i] == SQL_PARAM_SUCCESS || paramStatus[i] == SQL_PARAM_SUCCESS_WITH_INFO ||
+            (paramStatus[i] != SQL_PARAM_ERROR && ret != SQL_ERROR))
+            ++inserted;
+    }
+    if (ret == SQL_ERROR && inserted == 0) {
+        logger.log("hStmt SQLExecute failed for the whole batch.", LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+// Largest key already in a table, 0 for an empty one
+static bool queryMaxKey(SQLHDBC hDbc, const std::wstring& sql, int64_t& value) {
+    value = 0;
+    SQLHSTMT hStmt = SQL_NULL_HANDLE;
+    if (!sqlOk(SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt))) {
+        handleError(SQL_HANDLE_DBC, hDbc, "SQLAllocHandle");
+        return false;
+    }
+    metrics.roundTrips.add();
+    bool ok = sqlOk(SQLExecDirectW(hStmt, (SQLWCHAR*)sql.c_str(), SQL_NTS));
+    if (ok) {
+        SQLRETURN ret = SQLFetch(hStmt);
+        if (ret == SQL_NO_DATA)
+            value = 0;
+        else
+            ok = sqlOk(ret) && sqlOk(SQLGetData(hStmt, 1, SQL_C_SBIGINT, &value, sizeof(value), NULL));
+    }
+    if (!ok)
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLExecDirectW");
+    SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+    return ok;
+}
+
+enum PortfolioColumn { PF_KEY, PF_SEGMENT, PF_ID, PF_CODE, PF_CURRENCY, PF_CVF, PF_SVF, PF_VALUEMETH, PF_PRICEMETH, PF_SETLMETH };
+enum SeriesColumn { SE_KEY, SE_PFKEY, SE_CONTRACTID, SE_EXPIRY, SE_VOLATILITY, SE_SETTLEDATE, SE_INTRARATE, SE_PRICESCAN, SE_VOLSCAN };
+enum OptionColumn { OP_SERIESKEY, OP_OPTCONTRACTID, OP_OPTIONTYPE, OP_STRIKE, OP_VALUE, OP_RISK };
+
+bool NormalizedInserter::open(SQLHDBC hDbc, const InserterOptions& opts, const std::wstring& prefix) {
+    close();
+    riskEncoding = opts.riskEncoding;
+
+    using K = ParamBatch::Kind;
+    const std::vector<ParamBatch::Column> pfColumns = { { L"PfKey", K::BigInt, 0 }, { L"Segment", K::Text, 10 },
+        { L"PfId", K::Int, 0 }, { L"PfCode", K::Text, 50 }, { L"Currency", K::Text, 10 }, { L"CVF", K::Double, 0 },
+        { L"SVF", K::Double, 0 }, { L"ValueMeth", K::Text, 20 }, { L"PriceMeth", K::Text, 20 }, { L"SetlMeth", K::Text, 20 } };
+    const std::vector<ParamBatch::Column> seriesColumns = { { L"SeriesKey", K::BigInt, 0 }, { L"PfKey", K::BigInt, 0 },
+        { L"ContractId", K::Int, 0 }, { L"Expiry", K::Text, 10 }, { L"Volatility", K::Double, 0 }, { L"SettleDate", K::Text, 10 },
+        { L"IntraRate", K::Double, 0 }, { L"PriceScan", K::Double, 0 }, { L"VolScan", K::Double, 0 } };
+    const std::vector<ParamBatch::Column> optionColumns = { { L"SeriesKey", K::BigInt, 0 }, { L"OptContractId", K::Int, 0 },
+        { L"OptionType", K::Text, 1 }, { L"StrikePrice", K::Double, 0 }, { L"OptionValue", K::Double, 0 },
+        { riskEncoding == RiskEncoding::Binary ? L"RiskArrayBin" : L"RiskArray", K::Risk, 0 } };
+
+    int64_t maxPf = 0, maxSeries = 0;
+    if (!queryMaxKey(hDbc, L"SELECT ISNULL(MAX(PfKey), 0) FROM " + prefix + L"SpanPortfolios", maxPf) ||
+        !queryMaxKey(hDbc, L"SELECT ISNULL(MAX(SeriesKey), 0) FROM " + prefix + L"SpanSeries", maxSeries)) {
+        logger.log("Failed to read the last surrogate keys of SpanPortfolios/SpanSeries", LogLevel::ERRORS);
+        return false;
+    }
+    nextPfKey = maxPf + 1;
+    nextSeriesKey = maxSeries + 1;
+
+    // There are far fewer headers than options, so their batches are smaller
+    const size_t batchSize = opts.batchSize ? opts.batchSize : 1;
+    const size_t headerBatch = batchSize / 8 ? batchSize / 8 : 1;
+    return portfolios.open(hDbc, prefix + L"SpanPortfolios", pfColumns, headerBatch, riskEncoding) &&
+        series.open(hDbc, prefix + L"SpanSeries", seriesColumns, headerBatch, riskEncoding) &&
+        options.open(hDbc, prefix + L"SpanOptions", optionColumns, batchSize, riskEncoding);
+}
+
+bool NormalizedInserter::addAll(const SpanRecordStore& store) {
+    int64_t pfKey = 0, seriesKey = 0;
+    bool pfOk = false, seriesOk = false;
+    for (size_t i = 0; i < store.size(); ++i) {
+        const CompactRecord& rec = store.record(i);
+
+        // A portfolio's records, and a series' records, are contiguous
+        if (i == 0 || rec.portfolio != store.record(i - 1).portfolio) {
+            const PortfolioHeader& pf = store.portfolio(rec.portfolio);
+            pfKey = nextPfKey++;
+            pfOk = portfolios.fits(PF_SEGMENT, pf.segment) && portfolios.fits(PF_CODE, pf.pfCode) &&
+                portfolios.fits(PF_CURRENCY, pf.currency) && portfolios.fits(PF_VALUEMETH, pf.valueMeth) &&
+                portfolios.fits(PF_PRICEMETH, pf.priceMeth) && portfolios.fits(PF_SETLMETH, pf.setlMeth);
+            if (!pfOk) {
+                logger.log("Rejected portfolio pfId=" + std::to_string(pf.pfId) + " '" + pf.pfCode +
+                    "' and its records: a value exceeds its column size", LogLevel::ERRORS);
+            } else {
+                portfolios.setBigInt(PF_KEY, pfKey);
+                portfolios.setText(PF_SEGMENT, pf.segment);
+                portfolios.setInt(PF_ID, pf.pfId);
+                portfolios.setText(PF_CODE, pf.pfCode);
+                portfolios.setText(PF_CURRENCY, pf.currency);
+                portfolios.setDouble(PF_CVF, pf.cvf);
+                portfolios.setDouble(PF_SVF, pf.svf);
+                portfolios.setText(PF_VALUEMETH, pf.valueMeth);
+                portfolios.setText(PF_PRICEMETH, pf.priceMeth);
+                portfolios.setText(PF_SETLMETH, pf.setlMeth);
+                portfolios.endRow(portfolioRowBytes(pf));
+                if (portfolios.full() && !sendPortfolios())
+                    return false;
+            }
+        }
+
+        if (i == 0 || rec.series != store.record(i - 1).series) {
+            seriesKey = nextSeriesKey++;
+            const bool fieldsOk = !rec.expiry.truncated && !rec.settleDate.truncated;
+            seriesOk = pfOk && fieldsOk;
+            if (pfOk && !fieldsOk) {
+                logger.log("Rejected series pfId=" + std::to_string(store.portfolio(rec.portfolio).pfId) + " contractId=" +
+                    std::to_string(rec.contractId) + " and its records: a value exceeds its column size", LogLevel::ERRORS);
+            } else if (seriesOk) {
+                series.setBigInt(SE_KEY, seriesKey);
+                series.setBigInt(SE_PFKEY, pfKey);
+                series.setInt(SE_CONTRACTID, rec.contractId);
+                series.setText(SE_EXPIRY, rec.expiry.view());
+                series.setDouble(SE_VOLATILITY, rec.volatility);
+                series.setText(SE_SETTLEDATE, rec.settleDate.view());
+                series.setDouble(SE_INTRARATE, rec.intraRate);
+                series.setDouble(SE_PRICESCAN, rec.priceScan);
+                series.setDouble(SE_VOLSCAN, rec.volScan);
+                series.endRow(seriesRowBytes(rec));
+                if (series.full() && !sendSeries())
+                    return false;
+            }
+        }
+
+        // Records of a rejected portfolio or series are rejected with it
+        if (!seriesOk || rec.optionType.truncated) {
+            counters.rowsFailed++;
+            metrics.rowsRejected.add();
+            continue;
+        }
+
+        riskText.clear();
+        appendRiskArray(riskEncoding, rec.riskR, store.risk(rec), rec.riskCount, rec.riskD, riskText);
+        if (!options.fits(OP_RISK, riskText)) {
+            // Send what is bound to the narrow buffers, then widen the slot
+            if (!sendOptions() || !options.widen(OP_RISK, riskText.size()))
+                return false;
+        }
+        options.setBigInt(OP_SERIESKEY, seriesKey);
+        options.setInt(OP_OPTCONTRACTID, rec.optContractId);
+        options.setText(OP_OPTIONTYPE, rec.optionType.view());
+        options.setDouble(OP_STRIKE, rec.strikePrice);
+        options.setDouble(OP_VALUE, rec.optionValue);
+        options.setText(OP_RISK, riskText);
+        options.endRow(optionRowBytes(rec, riskText.size()));
+        if (options.full() && !sendOptions())
+            return false;
+    }
+    return true;
+}
+
+bool NormalizedInserter::sendPortfolios() {
+    size_t inserted = 0;
+    const bool ok = portfolios.execute(counters, inserted);
+    portfolioRows += inserted;
+    return ok;
+}
+
+bool NormalizedInserter::sendSeries() {
+    if (!sendPortfolios())
+        return false;
+    size_t inserted = 0;
+    const bool ok = series.execute(counters, inserted);
+    seriesRows += inserted;
+    return ok;
+}
+
+bool NormalizedInserter::sendOptions() {
+    if (!sendSeries())
+        return false;
+    size_t inserted = 0;
+    const size_t count = options.rows();
+    const bool ok = options.execute(counters, inserted);
+    counters.rowsInserted += inserted;
+    counters.rowsFailed += count - inserted;
+    metrics.rowsInserted.add(inserted);
+    metrics.rowsRejected.add(count - inserted);
+    return ok;
+}
+
+bool NormalizedInserter::flush() {
+    return sendOptions();
+}
+
+void NormalizedInserter::discard() {
+    portfolios.clear();
+    series.clear();
+    options.clear();
+}
+
+void NormalizedInserter::close() {
+    portfolios.close();
+    series.close();
+    options.close();
+}
+
+#endif // SPAN_WITH_ODBC
@@ -0,0 +1,101 @@
+#pragma once
+#ifndef NORMALIZED_INSERTER_H
+#define NORMALIZED_INSERTER_H
+
+#include "span-inserter.h"
+#include "span-schema.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One prepared INSERT with column-wise parameter arrays, like SpanInserter's,
+// for a column list given at open()
+class ParamBatch {
+public:
+    enum class Kind { BigInt, Int, Double, Text, Risk };
+    struct Column {
+        const wchar_t* name;
+        Kind kind;
+        SQLULEN size;           // Text: declared column size
+    };
+
+    ParamBatch() = default;
+    ~ParamBatch() { close(); }
+
+    ParamBatch(const ParamBatch&) = delete;
+    ParamBatch& operator=(const ParamBatch&) = delete;
+
+    bool open(SQLHDBC hDbc, const std::wstring& table, const std::vector<Column>& columns, size_t capacity, RiskEncoding encoding);
+    void close();
+
+    size_t rows() const { return filled; }
+    bool full() const { return filled == capacity; }
+    void clear() { filled = 0; batchBytes = 0; }
+
+    // Setters fill the current row; a Text value must be no longer than its column
+    void setBigInt(size_t col, int64_t value);
+    void setInt(size_t col, int value);
+    void setDouble(size_t col, double value);
+    void setText(size_t col, std::string_view value);
+    bool fits(size_t col, std::string_view value) const { return (SQLLEN)value.size() < slots[col].width; }
+    // Risk column only, on an empty batch: re-binds a slot wider than bytes
+    bool widen(size_t col, size_t bytes);
+    void endRow(size_t rowBytes);
+
+    // Sends the filled rows and empties the batch; inserted is the number the
+    // server accepted. Adds the batch and its bytes to counters. False on a
+    // statement-level failure.
+    bool execute(InsertStats& counters, size_t& inserted);
+
+private:
+    bool bind(size_t col);
+
+    SQLHSTMT hStmt = SQL_NULL_HANDLE;
+    std::vector<Column> columns;
+    std::vector<CharColumn> slots;
+    std::vector<SQLUSMALLINT> paramStatus;
+    SQLULEN paramsProcessed = 0;
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;
+    size_t capacity = 0;
+    size_t filled = 0;
+    size_t batchBytes = 0;
+};
+
+// Writes records in the normalized schema (span-schema.h): a SpanPortfolios
+// row per portfolio, a SpanSeries row per series and a SpanOptions row per
+// record. Surrogate keys continue from the tables' MAX at open() and are
+// counted in memory, so one loader at a time may write to these tables.
+// Parent batches are always sent before their children, so the REFERENCES
+// constraints hold. stats() rows are SpanOptions rows, comparable to the
+// SpanRecords6 rows of a wide load; bytes and batches cover all three tables.
+class NormalizedInserter {
+public:
+    // prefix is prepended to the table names, e.g. "#Bench" for temp copies
+    bool open(SQLHDBC hDbc, const InserterOptions& options, const std::wstring& prefix = L"");
+    bool addAll(const SpanRecordStore& store);
+    bool flush();
+    void discard();                     // drops the rows not sent yet
+    void close();
+
+    const InsertStats& stats() const { return counters; }
+    void resetStats() { counters = InsertStats(); portfolioRows = seriesRows = 0; }
+    size_t portfoliosInserted() const { return portfolioRows; }
+    size_t seriesInserted() const { return seriesRows; }
+
+private:
+    bool sendPortfolios();
+    bool sendSeries();
+    bool sendOptions();
+
+    ParamBatch portfolios, series, options;
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;
+    int64_t nextPfKey = 1;
+    int64_t nextSeriesKey = 1;
+    size_t portfolioRows = 0;
+    size_t seriesRows = 0;
+    std::string riskText;
+    InsertStats counters;
+};
+
+#endif // NORMALIZED_INSERTER_H
@@ -0,0 +1,153 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "odbc-sink.h"
+#include "summary-inserter.h"
+#include "parallel-loader.h"
+#include "logger.h"
+#include "metrics.h"
+
+extern Logger logger;
+
+bool OdbcSink::open(SQLHDBC hDbc, const InserterOptions& options, bool sectionTables) {
+    batchSize = options.batchSize;
+    withSections = sectionTables;
+    pendingSections.clear();
+    normalized = options.schema == OutputSchema::Normalized;
+    sections.open(hDbc);
+    return normalized ? normalizedInserter.open(hDbc, options) : inserter.open(hDbc, options);
+}
+
+bool OdbcSink::flush() {
+    if (!(normalized ? normalizedInserter.flush() : inserter.flush()))
+        return false;
+    if (!withSections || pendingSections.empty())
+        return true;
+    bool ok = sections.write(pendingSections);
+    pendingSections.clear();
+    return ok;
+}
+
+bool OdbcSink::finish() {
+    bool ok = flush();
+    const InsertStats& counters = normalized ? normalizedInserter.stats() : inserter.stats();
+    logger.log("inserted " + std::to_string(counters.rowsInserted) + " rows, " + std::to_string(counters.rowsFailed) +
+        " rejected, " + std::to_string(counters.batches) + " round trips (batch size " + std::to_string(batchSize) + "), " +
+        std::to_string(counters.bytes / 1024) + " KB of parameters", LogLevel::INFO);
+    if (normalized)
+        logger.log("normalized schema: " + std::to_string(normalizedInserter.portfoliosInserted()) + " portfolios, " +
+            std::to_string(normalizedInserter.seriesInserted()) + " series", LogLevel::INFO);
+    if (withSections)
+        logger.log("inserted " + std::to_string(sections.stats().rowsInserted) + " section records, " +
+            std::to_string(sections.stats().rowsFailed) + " rejected, " + std::to_string(sections.stats().batches) + " round trips", LogLevel::INFO);
+    return ok;
+}
+
+bool OdbcSinkPool::open(const std::wstring& connStr, int count, const InserterOptions& options, bool sectionTables) {
+    close();
+    if (!pool.open(connStr, count))
+        return false;
+    this->options = options;
+    for (int i = 0; i < pool.size(); ++i) {
+        sinks.push_back(std::make_unique<OdbcSink>());
+        if (!sinks.back()->open(pool.connection(i), options, sectionTables)) {
+            close();
+            return false;
+        }
+        idleSinks.push_back(i);
+    }
+    return true;
+}
+
+void OdbcSinkPool::close() {
+    for (auto& sink : sinks)
+        sink->close();
+    sinks.clear();
+    idleSinks.clear();
+    pool.close();
+}
+
+int OdbcSinkPool::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this] { return !idleSinks.empty(); });
+    int i = idleSinks.back();
+    idleSinks.pop_back();
+    return i;
+}
+
+void OdbcSinkPool::release(int i) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idleSinks.push_back(i);
+    }
+    released.notify_one();
+}
+
+bool OdbcSinkPool::write(const SpanRecordStore& records, InsertStats& stats) {
+    const int i = acquire();
+    OdbcSink& sink = *sinks[i];
+    sink.resetStats();
+    bool ok = sink.write(records) && sink.flush() && pool.commit(i);
+    stats = sink.stats();
+    if (ok)
+        metrics.rowsPerCommit.record(stats.rowsInserted);
+    else
+        pool.rollback(i);
+    release(i);
+    return ok;
+}
+
+bool OdbcSinkPool::beginStaging(std::wstring& staging) {
+    const int i = acquire();
+    staging = uniqueStagingName();
+    bool ok = createStagingTable(pool.connection(i), staging) && pool.commit(i);
+    if (!ok) {
+        logger.log("Failed to create staging table.", LogLevel::ERRORS);
+        pool.rollback(i);
+    }
+    release(i);
+    return ok;
+}
+
+bool OdbcSinkPool::write(const SpanRecordStore& records, const std::wstring& staging, InsertStats& stats) {
+    if (staging.empty())
+        return write(records, stats);
+    const int i = acquire();
+    // A statement of its own; the sink's stays prepared for SpanRecords6
+    InserterOptions stagingOptions = options;
+    stagingOptions.table = staging;
+    SpanInserter inserter;
+    bool ok = inserter.open(pool.connection(i), stagingOptions) && inserter.addAll(records) && inserter.flush() && pool.commit(i);
+    stats = inserter.stats();
+    if (ok)
+        metrics.rowsPerCommit.record(stats.rowsInserted);
+    else
+        pool.rollback(i);
+    inserter.close();
+    release(i);
+    return ok;
+}
+
+bool OdbcSinkPool::endStaging(const std::wstring& staging, bool publish) {
+    const int i = acquire();
+    bool ok = publish && publishStagingTable(pool.connection(i), staging, options.riskEncoding) && pool.commit(i);
+    if (publish && !ok) {
+        logger.log("Publishing staged rows into SpanRecords6 failed, rolled back.", LogLevel::ERRORS);
+        pool.rollback(i);
+    }
+    if (!ok)
+        dropStagingTable(pool, i, staging);
+    release(i);
+    return ok;
+}
+
+bool OdbcSinkPool::writeSummary(const SpanSummary& summary, InsertStats& stats) {
+    const int i = acquire();
+    stats = InsertStats();
+    bool ok = insertSummaryTables(pool.connection(i), summary, stats) && pool.commit(i);
+    if (!ok)
+        pool.rollback(i);
+    release(i);
+    return ok;
+}
+
+#endif // SPAN_WITH_ODBC
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef ODBC_SINK_H
+#define ODBC_SINK_H
+
+#include "record-sink.h"
+#include "span-inserter.h"
+#include "normalized-inserter.h"
+#include "section-inserter.h"
+#include "span-summary.h"
+#include "connection-pool.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Writes records to SpanRecords6 through one SpanInserter, or with
+// OutputSchema::Normalized to the normalized tables through a
+// NormalizedInserter, and, withSections,
+// the section records to their tables (section-inserter.h). Section records
+// are few, so they are collected and sent in finish(), one statement per
+// table. Rejected section records count in stats().rowsFailed like rejected
+// portfolio rows.
+class OdbcSink : public RecordSink {
+public:
+    bool open(SQLHDBC hDbc, const InserterOptions& options, bool sectionTables = false);
+
+    bool write(const SpanRecordStore& records) override {
+        if (withSections)
+            pendingSections.append(records.sections());
+        return normalized ? normalizedInserter.addAll(records) : inserter.addAll(records);
+    }
+    bool finish() override;
+    // Drops the rows and section records not sent yet; what was sent is the
+    // connection's to roll back
+    void abort() override {
+        inserter.discard();
+        normalizedInserter.discard();
+        pendingSections.clear();
+    }
+
+    // Sends buffered rows and collected section records without committing,
+    // e.g. before a checkpoint commit on a manual-commit connection
+    bool flush();
+    InsertStats stats() const override {
+        InsertStats counters = normalized ? normalizedInserter.stats() : inserter.stats();
+        counters.rowsFailed += sections.stats().rowsFailed;
+        return counters;
+    }
+
+    // Between files of a resident load: the prepared statement stays, the counts restart
+    void resetStats() {
+        inserter.resetStats();
+        normalizedInserter.resetStats();
+        sections.resetStats();
+    }
+    void close() {
+        inserter.close();
+        normalizedInserter.close();
+    }
+
+private:
+    SpanInserter inserter;
+    NormalizedInserter normalizedInserter;
+    SectionInserter sections;
+    SpanSections pendingSections;
+    bool withSections = false;
+    bool normalized = false;
+    size_t batchSize = 0;
+};
+
+// OdbcSinks on count manual-commit connections, shared by any number of
+// threads: write() borrows an idle sink (waiting while all are busy), writes
+// and commits the records as one transaction and gives the sink back. The
+// prepared statements stay open between writes.
+class OdbcSinkPool {
+public:
+    bool open(const std::wstring& connStr, int count, const InserterOptions& options, bool sectionTables = false);
+    void close();
+
+    // stats are this write's; false after a rollback
+    bool write(const SpanRecordStore& records, InsertStats& stats);
+
+    // A file loaded in chunks goes through its own staging table
+    // (parallel-loader.h): beginStaging creates it, write(records, staging, ...)
+    // commits a chunk into it, and endStaging publishes all of them into
+    // SpanRecords6 in one transaction or, without publish, drops the table.
+    // Wide schema only, without section records.
+    bool beginStaging(std::wstring& staging);
+    bool write(const SpanRecordStore& records, const std::wstring& staging, InsertStats& stats);
+    bool endStaging(const std::wstring& staging, bool publish);
+
+    // Inserts the summary tables (summary-inserter.h) on an idle connection
+    // as one transaction
+    bool writeSummary(const SpanSummary& summary, InsertStats& stats);
+    int size() const { return pool.size(); }
+
+private:
+    int acquire();
+    void release(int i);
+
+    ConnectionPool pool;
+    InserterOptions options;
+    std::vector<std::unique_ptr<OdbcSink>> sinks;
+    std::vector<int> idleSinks;
+    std::mutex mutex;
+    std::condition_variable released;
+};
+
+#endif // ODBC_SINK_H
@@ -0,0 +1,193 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "parallel-loader.h"
+#include "section-inserter.h"
+#include "logger.h"
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+extern Logger logger;
+
+bool parsePartitionKey(const std::string& name, PartitionKey& key) {
+    if (name == "pfid")
+        key = PartitionKey::PfId;
+    else if (name == "segment")
+        key = PartitionKey::Segment;
+    else
+        return false;
+    return true;
+}
+
+static size_t partitionOf(const PortfolioHeader& pf, PartitionKey key, size_t parts) {
+    if (key == PartitionKey::Segment)
+        return std::hash<std::string>()(pf.segment) % parts;
+    return (size_t)(unsigned int)pf.pfId % parts;
+}
+
+std::wstring uniqueStagingName() {
+    static std::atomic<unsigned> sequence(0);
+#ifdef _WIN32
+    long long pid = _getpid();
+#else
+    long long pid = getpid();
+#endif
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return L"SpanRecords6_Staging_" + std::to_wstring(pid) + L"_" + std::to_wstring(ms) + L"_" + std::to_wstring(sequence++);
+}
+
+// T-SQL that gives staging the clustered and nonclustered indexes, key
+// constraints and check constraints of SpanRecords6, read from the catalog
+// since the DBA owns them. ALTER TABLE ... SWITCH needs the two to match.
+static std::wstring cloneIndexesSql(const std::wstring& staging) {
+    auto indexColumns = [](const wchar_t* included) {
+        return std::wstring(L"STUFF((SELECT N',' + QUOTENAME(c.name) + CASE WHEN ic.is_descending_key = 1 THEN N' DESC' ELSE N'' END "
+            L"FROM sys.index_columns ic JOIN sys.columns c ON c.object_id = ic.object_id AND c.column_id = ic.column_id "
+            L"WHERE ic.object_id = i.object_id AND ic.index_id = i.index_id AND ic.is_included_column = ") + included +
+            L" ORDER BY ic.key_ordinal, ic.index_column_id FOR XML PATH(''), TYPE).value('.', 'NVARCHAR(MAX)'), 1, 1, N'')";
+    };
+    return L"DECLARE @sql NVARCHAR(MAX) = N''; "
+        L"SELECT @sql += CASE WHEN i.is_primary_key = 1 THEN N'ALTER TABLE " + staging + L" ADD PRIMARY KEY ' + i.type_desc "
+        L"WHEN i.is_unique_constraint = 1 THEN N'ALTER TABLE " + staging + L" ADD UNIQUE ' + i.type_desc "
+        L"ELSE N'CREATE ' + CASE WHEN i.is_unique = 1 THEN N'UNIQUE ' ELSE N'' END + i.type_desc + N' INDEX ' + QUOTENAME(i.name) + N' ON " +
+        staging + L"' END + N' (' + " + indexColumns(L"0") + L" + N')' + ISNULL(N' INCLUDE (' + " + indexColumns(L"1") + L" + N')', N'') + "
+        L"ISNULL(N' WHERE ' + i.filter_definition, N'') + N'; ' "
+        L"FROM sys.indexes i WHERE i.object_id = OBJECT_ID(N'SpanRecords6') AND i.type IN (1, 2) AND i.is_hypothetical = 0 ORDER BY i.index_id; "
+        L"SELECT @sql += N'ALTER TABLE " + staging + L" WITH CHECK ADD CHECK ' + cc.definition + N'; ' "
+        L"FROM sys.check_constraints cc WHERE cc.parent_object_id = OBJECT_ID(N'SpanRecords6') AND cc.is_disabled = 0; "
+        L"EXEC sp_executesql @sql;";
+}
+
+bool createStagingTable(SQLHDBC hDbc, const std::wstring& staging) {
+    // Only a load into an empty SpanRecords6 can be switched in; for the
+    // others the indexes would just slow the staging inserts down
+    return executeSql(hDbc, L"IF OBJECT_ID(N'" + staging + L"', N'U') IS NOT NULL DROP TABLE " + staging) &&
+        executeSql(hDbc, L"SELECT TOP 0 * INTO " + staging + L" FROM SpanRecords6") &&
+        executeSql(hDbc, L"IF NOT EXISTS (SELECT 1 FROM SpanRecords6) BEGIN " + cloneIndexesSql(staging) + L" END");
+}
+
+bool publishStagingTable(SQLHDBC hDbc, const std::wstring& staging, RiskEncoding encoding) {
+    // Into an empty SpanRecords6 the staged rows are switched in, a metadata
+    // change. Otherwise, or if the tables don't match after all (a filegroup,
+    // a columnstore index), they are copied under one table lock.
+    std::wstring columns = spanInsertColumns(encoding);
+    std::wstring copy = L"INSERT INTO SpanRecords6 WITH (TABLOCK) (" + columns + L") SELECT " + columns + L" FROM " + staging + L";";
+    auto start = std::chrono::steady_clock::now();
+    bool ok = executeSql(hDbc,
+        L"IF NOT EXISTS (SELECT 1 FROM SpanRecords6 WITH (TABLOCKX, HOLDLOCK)) BEGIN "
+        L"BEGIN TRY ALTER TABLE " + staging + L" SWITCH TO SpanRecords6; END TRY "
+        L"BEGIN CATCH IF XACT_STATE() = -1 THROW; " + copy + L" END CATCH "
+        L"END ELSE " + copy) &&
+        executeSql(hDbc, L"DROP TABLE " + staging);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    metrics.publishNs.record((uint64_t)ns);
+    logger.log("publishing " + std::string(staging.begin(), staging.end()) + " took " + std::to_string(ns / 1e9) + " s",
+        ok ? LogLevel::INFO : LogLevel::ERRORS);
+    return ok;
+}
+
+void dropStagingTable(ConnectionPool& pool, int i, const std::wstring& staging) {
+    if (!executeSql(pool.connection(i), L"IF OBJECT_ID(N'" + staging + L"', N'U') IS NOT NULL DROP TABLE " + staging) ||
+        !pool.commit(i))
+        logger.log("Could not drop staging table " + std::string(staging.begin(), staging.end()), LogLevel::WARNING);
+}
+
+bool loadSpanRecordsParallel(ConnectionPool& pool, const SpanRecordStore& store, const LoaderOptions& opts, LoaderStats& stats) {
+    stats = LoaderStats();
+    const int parts = pool.size();
+    if (parts == 0)
+        return false;
+
+    const std::wstring staging = opts.stagingTable.empty() ? uniqueStagingName() : opts.stagingTable;
+    if (!createStagingTable(pool.connection(0), staging) || !pool.commit(0)) {
+        logger.log("Failed to create staging table.", LogLevel::ERRORS);
+        pool.rollback(0);
+        return false;
+    }
+
+    // Each connection's record indices, decided once up front
+    std::vector<std::vector<size_t>> partRecords(parts);
+    for (size_t i = 0; i < store.size(); ++i)
+        partRecords[partitionOf(store.portfolio(store.record(i).portfolio), opts.partition, (size_t)parts)].push_back(i);
+
+    stats.perConnection.resize(parts);
+    std::vector<char> workerOk(parts, 0);
+    std::atomic<bool> failed(false);
+
+    auto worker = [&](int part) {
+        InserterOptions io;
+        io.batchSize = opts.batchSize;
+        io.riskEncoding = opts.riskEncoding;
+        io.table = staging;
+        io.commitRows = opts.commitRows;
+        io.commitBytes = opts.commitBytes;
+
+        SpanInserter inserter;
+        bool ok = inserter.open(pool.connection(part), io);
+        for (size_t k = 0; ok && k < partRecords[part].size(); ++k) {
+            if (failed)
+                ok = false;
+            else
+                ok = inserter.add(store.ref(partRecords[part][k]));
+        }
+        ok = ok && inserter.commit();
+        stats.perConnection[part] = inserter.stats();
+        if (!ok || inserter.stats().rowsFailed)
+            failed = true;
+        workerOk[part] = ok;
+    };
+
+    std::vector<std::thread> threads;
+    for (int part = 1; part < parts; ++part)
+        threads.emplace_back(worker, part);
+    worker(0);
+    for (auto& t : threads)
+        t.join();
+
+    bool ok = !failed;
+    for (int part = 0; part < parts; ++part) {
+        const InsertStats& s = stats.perConnection[part];
+        stats.insert.rowsInserted += s.rowsInserted;
+        stats.insert.rowsFailed += s.rowsFailed;
+        stats.insert.batches += s.batches;
+        stats.insert.commits += s.commits;
+        if (!workerOk[part])
+            pool.rollback(part);
+        logger.log("connection " + std::to_string(part) + ": " + std::to_string(s.rowsInserted) + " rows staged, " +
+            std::to_string(s.rowsFailed) + " rejected, " + std::to_string(s.batches) + " round trips, " +
+            std::to_string(s.commits) + " commits", LogLevel::INFO);
+    }
+
+    if (!ok) {
+        logger.log("Load not published: " + std::to_string(stats.insert.rowsFailed) + " rows rejected or a connection failed", LogLevel::ERRORS);
+        dropStagingTable(pool, 0, staging);
+        return false;
+    }
+
+    // Publish: staged rows become visible in SpanRecords6 together or not at all
+    SectionInserter sections;
+    if (opts.sections)
+        sections.open(pool.connection(0));
+    ok = publishStagingTable(pool.connection(0), staging, opts.riskEncoding) &&
+        (!opts.sections || (sections.write(store.sections()) && sections.stats().rowsFailed == 0)) &&
+        pool.commit(0);
+    stats.sections = sections.stats();
+    if (!ok) {
+        logger.log("Publishing staged rows into SpanRecords6 failed, rolled back.", LogLevel::ERRORS);
+        pool.rollback(0);
+        dropStagingTable(pool, 0, staging);
+        return false;
+    }
+    stats.published = true;
+    return true;
+}
+
+#endif // SPAN_WITH_ODBC
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef PARALLEL_LOADER_H
+#define PARALLEL_LOADER_H
+
+#include "span-inserter.h"
+#include "span-record-store.h"
+#include "connection-pool.h"
+#include <string>
+#include <vector>
+
+enum class PartitionKey { PfId, Segment };
+
+bool parsePartitionKey(const std::string& name, PartitionKey& key);
+
+struct LoaderOptions {
+    size_t batchSize = 1000;
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;
+    size_t commitRows = 50000;      // per connection
+    size_t commitBytes = 0;
+    PartitionKey partition = PartitionKey::PfId;
+    std::wstring stagingTable;      // empty: uniqueStagingName()
+    bool sections = false;          // also insert the section records (section-inserter.h) when publishing
+};
+
+struct LoaderStats {
+    InsertStats insert;                     // summed over connections
+    std::vector<InsertStats> perConnection;
+    InsertStats sections;                   // with LoaderOptions::sections
+    bool published = false;
+};
+
+// Loads one file's records all-or-nothing. Records are split across the pool's
+// connections by pfId or segment and inserted into a staging table cloned from
+// SpanRecords6 and named for this run so concurrent loads don't share it, each connection committing every commitRows/commitBytes. Only
+// when every row made it are the staged rows moved into SpanRecords6 in one
+// transaction (publishStagingTable); otherwise the staging table is dropped and SpanRecords6 is
+// untouched. Section records are inserted by the publishing transaction.
+bool loadSpanRecordsParallel(ConnectionPool& pool, const SpanRecordStore& store, const LoaderOptions& opts, LoaderStats& stats);
+
+// Staging tables: SpanRecords6_Staging_<pid>_<ms>_<n>, unique to the run and
+// to the table within it
+std::wstring uniqueStagingName();
+// (Re)creates an empty copy of SpanRecords6, with its indexes and
+// constraints while SpanRecords6 is empty; the caller commits
+bool createStagingTable(SQLHDBC hDbc, const std::wstring& staging);
+// Moves the staged rows into SpanRecords6, by ALTER TABLE ... SWITCH when it
+// is empty, and drops the staging table; the caller commits, which makes all
+// the rows visible at once
+bool publishStagingTable(SQLHDBC hDbc, const std::wstring& staging, RiskEncoding encoding);
+// Drops the staging table if it exists and commits; a failure is only logged
+void dropStagingTable(ConnectionPool& pool, int i, const std::wstring& staging);
+
+#endif // PARALLEL_LOADER_H
@@ -0,0 +1,108 @@
+#include "parallel-parser.h"
+#include "span-tokenizer.h"
+#include "bounded-queue.h"
+#include "load-checkpoint.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+void parseSpanParallel(std::string_view data, int threads, bool ordered, SpanRecordStore& store, BlockQuarantine* quarantine) {
+    std::string_view block;
+    size_t pos = 0;
+
+    if (threads <= 1) {
+        for (size_t index = 0; nextPortfolioBlock(data, pos, block); ++index) {
+            try {
+                parseSpanXmlBlock(block, store);
+            }
+            catch (const std::exception& e) {
+                if (!quarantine)
+                    throw;
+                quarantine->add(index, pos, block, e.what());
+            }
+        }
+        return;
+    }
+
+    BoundedQueue<PortfolioBlock> queue((size_t)threads * 4);
+    std::vector<std::vector<ParsedBlock>> parsed(threads);
+    std::vector<SpanRecordStore> unorderedParts(threads);
+    std::atomic<bool> failed(false);
+    std::exception_ptr firstError;
+    std::mutex errorMutex;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            PortfolioBlock item;
+            while (queue.pop(item)) {
+                if (failed)
+                    continue;   // drain so the reader never blocks on a full queue
+                try {
+                    if (ordered) {
+                        ParsedBlock out;
+                        out.index = item.index;
+                        parseSpanXmlBlock(item.text, out.records);
+                        parsed[t].push_back(std::move(out));
+                    }
+                    else {
+                        parseSpanXmlBlock(item.text, unorderedParts[t]);
+                    }
+                }
+                catch (const std::exception& e) {
+                    if (quarantine) {
+                        quarantine->add(item.index, item.endOffset, item.text, e.what());
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!firstError)
+                        firstError = std::current_exception();
+                    failed = true;
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!firstError)
+                        firstError = std::current_exception();
+                    failed = true;
+                }
+            }
+        });
+    }
+
+    size_t index = 0;
+    while (!failed && nextPortfolioBlock(data, pos, block))
+        queue.push(PortfolioBlock{ index++, block, pos, nullptr });
+    queue.close();
+    for (auto& w : workers)
+        w.join();
+
+    if (firstError)
+        std::rethrow_exception(firstError);
+
+    if (!ordered) {
+        for (auto& part : unorderedParts)
+            store.append(std::move(part));
+        return;
+    }
+
+    // Ordered merge: gather every worker's blocks and put them back in file order
+    std::vector<ParsedBlock> all;
+    all.reserve(index);
+    for (auto& part : parsed) {
+        for (auto& pb : part)
+            all.push_back(std::move(pb));
+    }
+    std::sort(all.begin(), all.end(), [](const ParsedBlock& a, const ParsedBlock& b) { return a.index < b.index; });
+
+    size_t records = store.size(), riskValues = store.riskSize();
+    for (const auto& pb : all) {
+        records += pb.records.size();
+        riskValues += pb.records.riskSize();
+    }
+    store.reserve(records, riskValues);
+    for (auto& pb : all)
+        store.append(std::move(pb.records));
+}
@@ -0,0 +1,37 @@
+#pragma once
+#ifndef PARALLEL_PARSER_H
+#define PARALLEL_PARSER_H
+
+#include "span-parser.h"
+#include "span-record-store.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class BlockQuarantine;
+
+// A raw portfolio block and its position in the file
+struct PortfolioBlock {
+    size_t index = 0;
+    std::string_view text;
+    size_t endOffset = 0;       // byte offset just past the block in the input text
+    std::shared_ptr<const std::string> owner;  // buffer text points into, unless it is the mapped file
+};
+
+// Records parsed from one PortfolioBlock
+struct ParsedBlock {
+    size_t index = 0;
+    size_t endOffset = 0;       // byte offset just past the block in the file
+    SpanRecordStore records;
+};
+
+// Splits a SPAN buffer into portfolio blocks on the calling thread and parses
+// them on a pool of threads workers. With ordered set the records come back in
+// file order, otherwise in whatever order the workers finish. threads <= 1
+// parses inline. Malformed blocks go to quarantine if there is one; otherwise
+// the first parse error is rethrown after all workers stopped.
+void parseSpanParallel(std::string_view data, int threads, bool ordered, SpanRecordStore& store,
+    BlockQuarantine* quarantine = nullptr);
+
+#endif // PARALLEL_PARSER_H
@@ -0,0 +1,152 @@
+#pragma once
+#ifndef PARAM_ROWS_H
+#define PARAM_ROWS_H
+
+#include "span-parser.h"
+#include "record-sink.h"
+#include "fixed-text.h"
+#include "logger.h"
+#include "metrics.h"
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+
+// Row-wise INSERTs of small tables (section records, load summaries): one
+// parameter array and one SQLExecDirect per table
+
+extern Logger logger;
+
+inline bool sqlSucceeded(SQLRETURN ret) {
+    return ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO;
+}
+
+enum class ParamKind { Text, Int, Double };
+
+struct ParamSpec {
+    ParamKind kind;
+    SQLULEN size;               // Text: declared column size
+};
+
+// Row-wise parameter array: each parameter has a fixed slot in every row,
+// the slots followed by one length/NULL indicator per parameter
+class ParamRows {
+public:
+    static const size_t slot = 48;      // widest text column (40) plus NUL, 8-byte aligned
+
+    ParamRows(const ParamSpec* specs, size_t params, size_t capacity)
+        : specs(specs), params(params), rowBytes(params * (slot + sizeof(SQLLEN))), data(rowBytes * capacity) {}
+
+    size_t rowSize() const { return rowBytes; }
+    char* value(size_t row, size_t p) { return data.data() + row * rowBytes + p * slot; }
+    SQLLEN* indicator(size_t row, size_t p) { return (SQLLEN*)(data.data() + row * rowBytes + params * slot) + p; }
+
+    // false if the value does not fit its column
+    template <size_t N>
+    bool text(size_t row, size_t p, const FixedText<N>& value) {
+        return !value.truncated && text(row, p, value.view());
+    }
+    bool text(size_t row, size_t p, std::string_view v) {
+        if (v.size() > specs[p].size)
+            return false;
+        std::memcpy(value(row, p), v.data(), v.size());
+        value(row, p)[v.size()] = '\0';
+        *indicator(row, p) = (SQLLEN)v.size();
+        return true;
+    }
+    void integer(size_t row, size_t p, int v) {
+        SQLINTEGER x = v;
+        std::memcpy(value(row, p), &x, sizeof(x));
+        *indicator(row, p) = 0;
+    }
+    void real(size_t row, size_t p, double v) {
+        std::memcpy(value(row, p), &v, sizeof(v));
+        *indicator(row, p) = 0;
+    }
+    void null(size_t row, size_t p) {
+        *indicator(row, p) = SQL_NULL_DATA;
+    }
+
+private:
+    const ParamSpec* specs;
+    size_t params;
+    size_t rowBytes;
+    std::vector<char> data;
+};
+
+// Sends records to table in one SQLExecDirect; fill(rows, row, record) returns
+// false for a record with a value too long for its column, which is skipped
+template <typename Record, typename Fill, size_t P>
+bool insertTable(SQLHDBC hDbc, const wchar_t* table, const wchar_t* columns, const ParamSpec (&specs)[P],
+    const std::vector<Record>& records, Fill fill, InsertStats& counters) {
+    if (records.empty())
+        return true;
+
+    ParamRows rows(specs, P, records.size());
+    size_t n = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (fill(rows, n, records[i])) {
+            ++n;
+            continue;
+        }
+        logger.log("Rejected " + std::string(table, table + std::wcslen(table)) + " record " + std::to_string(i) +
+            ": value exceeds column size", LogLevel::ERRORS);
+        counters.rowsFailed++;
+    }
+    if (n == 0)
+        return true;
+
+    SQLHSTMT hStmt = SQL_NULL_HANDLE;
+    if (!sqlSucceeded(SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt))) {
+        logger.log("hStmt SQLAllocHandle failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_DBC, hDbc, "SQLAllocHandle");
+        return false;
+    }
+    bool ok = sqlSucceeded(SQLSetStmtAttr(hStmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)(SQLULEN)rows.rowSize(), 0)) &&
+        sqlSucceeded(SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)n, 0));
+    if (!ok)
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLSetStmtAttr");
+
+    std::wstring marks;
+    for (size_t p = 0; ok && p < P; ++p) {
+        marks += p ? L", ?" : L"?";
+        SQLRETURN ret;
+        if (specs[p].kind == ParamKind::Text)
+            ret = SQLBindParameter(hStmt, (SQLUSMALLINT)(p + 1), SQL_PARAM_INPUT, SQL_C_CHAR, SQL_WVARCHAR, specs[p].size, 0,
+                (SQLPOINTER)rows.value(0, p), (SQLLEN)ParamRows::slot, rows.indicator(0, p));
+        else if (specs[p].kind == ParamKind::Int)
+            ret = SQLBindParameter(hStmt, (SQLUSMALLINT)(p + 1), SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0,
+                (SQLPOINTER)rows.value(0, p), 0, rows.indicator(0, p));
+        else
+            ret = SQLBindParameter(hStmt, (SQLUSMALLINT)(p + 1), SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0,
+                (SQLPOINTER)rows.value(0, p), 0, rows.indicator(0, p));
+        if (!sqlSucceeded(ret)) {
+            handleError(SQL_HANDLE_STMT, hStmt, "SQLBindParameter", (int)p + 1);
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        std::wstring sql = std::wstring(L"INSERT INTO ") + table + L" (" + columns + L") VALUES (" + marks + L")";
+        ScopedTimer timer(metrics.statementNs);
+        metrics.roundTrips.add();
+        if (!sqlSucceeded(SQLExecDirectW(hStmt, (SQLWCHAR*)sql.c_str(), SQL_NTS))) {
+            logger.log("Inserting rows into " + std::string(table, table + std::wcslen(table)) + " failed.", LogLevel::ERRORS);
+            handleError(SQL_HANDLE_STMT, hStmt, "SQLExecDirectW");
+            ok = false;
+        }
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+    if (ok) {
+        counters.rowsInserted += n;
+        counters.batches++;
+    }
+    return ok;
+}
+
+#endif // PARAM_ROWS_H
@@ -0,0 +1,10 @@
+#pragma once
+#ifndef PROCESS_MEMORY_H
+#define PROCESS_MEMORY_H
+
+#include <cstddef>
+
+// Peak resident set (working set on Windows) of this process in bytes, 0 if unknown
+size_t peakResidentBytes();
+
+#endif // PROCESS_MEMORY_H
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef RECORD_SINK_H
+#define RECORD_SINK_H
+
+#include "span-record-store.h"
+#include <cstddef>
+
+// Row counts of one sink
+struct InsertStats {
+    size_t rowsInserted = 0;
+    size_t rowsFailed = 0;
+    size_t batches = 0;         // SQLExecute round trips, retries included
+    size_t commits = 0;         // SQLEndTran calls made by the inserter
+    size_t bytes = 0;           // parameter bytes sent (see span-schema.h)
+};
+
+// Destination for parsed records. write() may be called once with a whole
+// file or once per portfolio block; finish() makes everything durable.
+// Both return false on a failure that should stop the load. A failed load
+// calls abort() instead of finish(): buffered records are dropped and
+// nothing more is made durable.
+class RecordSink {
+public:
+    virtual ~RecordSink() = default;
+
+    virtual bool write(const SpanRecordStore& records) = 0;
+    virtual bool finish() = 0;
+    virtual void abort() {}
+    virtual InsertStats stats() const = 0;
+};
+
+// Counts records and drops them, for timing the parser on its own
+class NullSink : public RecordSink {
+public:
+    bool write(const SpanRecordStore& records) override {
+        counters.rowsInserted += records.size();
+        counters.batches++;
+        return true;
+    }
+    bool finish() override { return true; }
+    InsertStats stats() const override { return counters; }
+
+private:
+    InsertStats counters;
+};
+
+// Writes every block to a primary sink and a second one (e.g. a snapshot
+// file next to a database load); stats() are the primary's
+class TeeSink : public RecordSink {
+public:
+    TeeSink(RecordSink& primary, RecordSink& secondary) : primary(primary), secondary(secondary) {}
+
+    bool write(const SpanRecordStore& records) override {
+        return primary.write(records) && secondary.write(records);
+    }
+    bool finish() override {
+        bool ok = primary.finish();
+        return secondary.finish() && ok;
+    }
+    void abort() override {
+        primary.abort();
+        secondary.abort();
+    }
+    InsertStats stats() const override { return primary.stats(); }
+
+private:
+    RecordSink& primary;
+    RecordSink& secondary;
+};
+
+#endif // RECORD_SINK_H
@@ -0,0 +1,141 @@
+#include "risk-codec.h"
+#include <charconv>
+#include <cstring>
+
+bool parseRiskEncoding(std::string_view name, RiskEncoding& encoding) {
+    if (name == "legacy")
+        encoding = RiskEncoding::Legacy;
+    else if (name == "text")
+        encoding = RiskEncoding::Text;
+    else if (name == "binary")
+        encoding = RiskEncoding::Binary;
+    else
+        return false;
+    return true;
+}
+
+const char* riskEncodingName(RiskEncoding encoding) {
+    switch (encoding) {
+    case RiskEncoding::Text: return "text";
+    case RiskEncoding::Binary: return "binary";
+    default: return "legacy";
+    }
+}
+
+// Byte-wise so the layout does not depend on the host byte order
+static void putU32(char* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+        p[i] = (char)(v >> (8 * i));
+}
+
+static void putF64(char* p, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    for (int i = 0; i < 8; ++i)
+        p[i] = (char)(bits >> (8 * i));
+}
+
+static uint32_t getU32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= (uint32_t)(unsigned char)p[i] << (8 * i);
+    return v;
+}
+
+static double getF64(const char* p) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i)
+        bits |= (uint64_t)(unsigned char)p[i] << (8 * i);
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+void appendRiskArrayBinary(int r, const double* a, size_t count, double d, std::string& out) {
+    size_t start = out.size();
+    out.resize(start + riskBinaryHeaderSize + count * 8);
+    char* p = &out[start];
+    p[0] = 'R';
+    p[1] = 'A';
+    p[2] = (char)riskBinaryVersion;
+    p[3] = 0;
+    putU32(p + 4, (uint32_t)r);
+    putU32(p + 8, (uint32_t)count);
+    putF64(p + 12, d);
+    p += riskBinaryHeaderSize;
+    for (size_t i = 0; i < count; ++i, p += 8)
+        putF64(p, a[i]);
+}
+
+void appendRiskArrayLossless(int r, const double* a, size_t count, double d, std::string& out) {
+    char buf[32];
+    out.append(buf, (size_t)(std::to_chars(buf, buf + sizeof(buf), r).ptr - buf));
+    out += ';';
+    for (size_t i = 0; i < count; ++i) {
+        if (i)
+            out += ',';
+        out.append(buf, (size_t)(std::to_chars(buf, buf + sizeof(buf), a[i]).ptr - buf));
+    }
+    out += ';';
+    out.append(buf, (size_t)(std::to_chars(buf, buf + sizeof(buf), d).ptr - buf));
+}
+
+bool decodeRiskArrayBinary(std::string_view bytes, RiskArray& out) {
+    if (bytes.size() < riskBinaryHeaderSize || bytes[0] != 'R' || bytes[1] != 'A')
+        return false;
+    if ((uint8_t)bytes[2] != riskBinaryVersion)
+        return false;
+
+    const char* p = bytes.data();
+    uint32_t count = getU32(p + 8);
+    if ((bytes.size() - riskBinaryHeaderSize) / 8 != count || (bytes.size() - riskBinaryHeaderSize) % 8 != 0)
+        return false;
+
+    out.r = (int)getU32(p + 4);
+    out.d = getF64(p + 12);
+    out.a.resize(count);
+    p += riskBinaryHeaderSize;
+    for (uint32_t i = 0; i < count; ++i, p += 8)
+        out.a[i] = getF64(p);
+    return true;
+}
+
+bool decodeRiskArrayLossless(std::string_view text, RiskArray& out) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+
+    auto r = std::from_chars(p, end, out.r);
+    if (r.ec != std::errc() || r.ptr == end || *r.ptr != ';')
+        return false;
+    p = r.ptr + 1;
+
+    out.a.clear();
+    if (p != end && *p != ';') {
+        for (;;) {
+            double value;
+            auto v = std::from_chars(p, end, value);
+            if (v.ec != std::errc() || v.ptr == end)
+                return false;
+            out.a.push_back(value);
+            p = v.ptr + 1;
+            if (*v.ptr == ';')
+                break;
+            if (*v.ptr != ',')
+                return false;
+        }
+    }
+    else {
+        if (p == end)
+            return false;
+        ++p;
+    }
+
+    auto d = std::from_chars(p, end, out.d);
+    return d.ec == std::errc() && d.ptr == end;
+}
+
+bool decodeRiskArray(std::string_view value, RiskArray& out) {
+    if (value.size() >= 2 && value[0] == 'R' && value[1] == 'A')
+        return decodeRiskArrayBinary(value, out);
+    return decodeRiskArrayLossless(value, out);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef RISK_CODEC_H
+#define RISK_CODEC_H
+
+// Risk-array encodings for SpanRecords6 and their decoders. Self-contained
+// (no ODBC/Windows headers) so downstream readers can link just this file.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Risk array structure from <ra>
+struct RiskArray {
+    int r = 0;                  // <r>
+    std::vector<double> a;     // <a> values
+    double d = 0.0;            // <d>
+};
+
+enum class RiskEncoding {
+    Legacy,     // "%d" r, "%g," per value, "%g" d into RiskArray (not reversible)
+    Text,       // "r;a0,a1,...;d" with shortest round-trip doubles into RiskArray
+    Binary      // packed little-endian header + doubles into RiskArrayBin
+};
+
+bool parseRiskEncoding(std::string_view name, RiskEncoding& encoding);
+const char* riskEncodingName(RiskEncoding encoding);
+
+// Binary layout, all fields little-endian:
+//   0  'R' 'A'       magic
+//   2  uint8         version (riskBinaryVersion)
+//   3  uint8         reserved, 0
+//   4  int32         r
+//   8  uint32        n, number of <a> values
+//  12  float64       d
+//  20  float64[n]    a values
+const uint8_t riskBinaryVersion = 1;
+const size_t riskBinaryHeaderSize = 20;
+
+void appendRiskArrayBinary(int r, const double* a, size_t count, double d, std::string& out);
+void appendRiskArrayLossless(int r, const double* a, size_t count, double d, std::string& out);
+
+// Decoders return false on malformed input and leave out unspecified
+bool decodeRiskArrayBinary(std::string_view bytes, RiskArray& out);
+bool decodeRiskArrayLossless(std::string_view text, RiskArray& out);
+
+// Picks the decoder from the value itself: binary magic, else lossless text.
+// Legacy text has no separator after r and is rejected.
+bool decodeRiskArray(std::string_view value, RiskArray& out);
+
+#endif // RISK_CODEC_H
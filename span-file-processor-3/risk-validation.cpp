@@ -0,0 +1,568 @@
+#include "risk-validation.h"
+#include "cpu-features.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+
+extern Logger logger;
+
+// Price moves of 0, 1/3, 2/3 and 3/3 of the scan range, each with the
+// volatility up and down, then the two extreme moves at 3 ranges
+const SpanScenario spanScenarios[scanScenarios] = {
+    {  0.0,       1.0, 1.0 }, {  0.0,       -1.0, 1.0 },
+    {  1.0 / 3.0, 1.0, 1.0 }, {  1.0 / 3.0, -1.0, 1.0 },
+    { -1.0 / 3.0, 1.0, 1.0 }, { -1.0 / 3.0, -1.0, 1.0 },
+    {  2.0 / 3.0, 1.0, 1.0 }, {  2.0 / 3.0, -1.0, 1.0 },
+    { -2.0 / 3.0, 1.0, 1.0 }, { -2.0 / 3.0, -1.0, 1.0 },
+    {  1.0,       1.0, 1.0 }, {  1.0,       -1.0, 1.0 },
+    { -1.0,       1.0, 1.0 }, { -1.0,       -1.0, 1.0 },
+    {  3.0,       0.0, 0.35 }, { -3.0,      0.0, 0.35 },
+};
+
+// A scenario can move the future or the volatility through zero; price at a floor instead
+static const double minFuture = 1e-8;
+static const double minVolatility = 1e-8;
+
+static double normCdf(double x) {
+    return 0.5 * std::erfc(-x * 0.70710678118654752440);
+}
+
+double black76Price(bool call, double future, double strike, double years, double rate, double volatility) {
+    const double sd = volatility * std::sqrt(years);
+    const double d1 = (std::log(future / strike) + 0.5 * sd * sd) / sd;
+    const double d2 = d1 - sd;
+    const double discount = std::exp(-rate * years);
+    return call ? discount * (future * normCdf(d1) - strike * normCdf(d2))
+                : discount * (strike * normCdf(-d2) - future * normCdf(-d1));
+}
+
+void black76RiskArray(bool call, double future, double strike, double years, double rate, double volatility,
+    double priceScan, double volScan, double* out) {
+    const double base = black76Price(call, future, strike, years, rate, volatility);
+    for (int s = 0; s < scanScenarios; ++s) {
+        const SpanScenario& sc = spanScenarios[s];
+        const double f = std::max(future + sc.priceMove * priceScan, minFuture);
+        const double v = std::max(volatility + sc.volMove * volScan, minVolatility);
+        out[s] = sc.weight * (base - black76Price(call, f, strike, years, rate, v));
+    }
+}
+
+void UnderlyingPrices::add(const SpanRecordStore& store) {
+    for (size_t i = 0; i < store.size(); ++i) {
+        const CompactRecord& rec = store.record(i);
+        if (rec.optContractId == 0)
+            prices.emplace(ContractKey{ store.portfolio(rec.portfolio).pfId, rec.contractId, 0 }, rec.price);
+    }
+}
+
+bool UnderlyingPrices::find(int pfId, int contractId, double& price) const {
+    auto it = prices.find(ContractKey{ pfId, contractId, 0 });
+    if (it == prices.end())
+        return false;
+    price = it->second;
+    return true;
+}
+
+void ValidationStats::add(const ValidationStats& other) {
+    options += other.options;
+    flagged += other.flagged;
+    skipped += other.skipped;
+    noUnderlying += other.noUnderlying;
+    maxDeviation = std::max(maxDeviation, other.maxDeviation);
+    seconds += other.seconds;
+}
+
+// Inputs of up to one block of options, one array per field so a kernel loads
+// four options per register. The count is padded to a multiple of four with
+// copies of the last option; the kernels write results for count options only.
+struct OptionBlock {
+    std::vector<double> future, strike, years, rate, volatility, priceScan, volScan, call;
+    std::vector<double> published;     // point s of option j at [s * stride + j]
+    size_t count = 0;
+    size_t stride = 0;
+
+    void resize(size_t capacity) {
+        stride = (capacity + 3) & ~(size_t)3;
+        for (std::vector<double>* v : { &future, &strike, &years, &rate, &volatility, &priceScan, &volScan, &call })
+            v->resize(stride);
+        published.resize(stride * scanScenarios);
+    }
+};
+
+// Per option: the point with the largest deviation and whether any point is out of tolerance
+struct OptionResult {
+    double deviation;
+    double published;
+    double recomputed;
+    int scenario;
+    bool flagged;
+};
+
+using ValidationKernel = void (*)(const OptionBlock&, double absTolerance, double relTolerance, OptionResult* out);
+
+static void validateScalar(const OptionBlock& block, double absTolerance, double relTolerance, OptionResult* out) {
+    double values[scanScenarios];
+    for (size_t j = 0; j < block.count; ++j) {
+        black76RiskArray(block.call[j] != 0.0, block.future[j], block.strike[j], block.years[j], block.rate[j],
+            block.volatility[j], block.priceScan[j], block.volScan[j], values);
+        OptionResult& r = out[j];
+        r = OptionResult{ -1.0, 0.0, 0.0, 0, false };
+        for (int s = 0; s < scanScenarios; ++s) {
+            const double published = block.published[s * block.stride + j];
+            const double deviation = std::fabs(values[s] - published);
+            if (!(deviation <= absTolerance + relTolerance * std::fabs(published)))
+                r.flagged = true;
+            if (deviation > r.deviation || r.scenario == 0) {
+                r.deviation = deviation;
+                r.published = published;
+                r.recomputed = values[s];
+                r.scenario = s + 1;
+            }
+        }
+    }
+}
+
+// erfc(z) = exp(-z^2) * h(t) with t = 2 / (2 + z); h is smooth on the t of
+// 0 <= z <= erfcMaxZ and is fitted there once with a Chebyshev series. Past
+// erfcMaxZ, erfc is below 1e-17 and the z is clamped.
+static const double erfcMaxZ = 6.0;
+static const int erfcTerms = 24;
+
+struct ErfcSeries {
+    double lo, hi;                  // t range
+    double c[erfcTerms];
+
+    ErfcSeries() {
+        lo = 2.0 / (2.0 + erfcMaxZ);
+        hi = 1.0;
+        const double pi = 3.14159265358979323846;
+        double f[erfcTerms];
+        for (int k = 0; k < erfcTerms; ++k) {
+            const double u = std::cos(pi * (k + 0.5) / erfcTerms);
+            const double t = 0.5 * (hi - lo) * u + 0.5 * (hi + lo);
+            const double z = 2.0 / t - 2.0;
+            f[k] = std::erfc(z) * std::exp(z * z);
+        }
+        for (int j = 0; j < erfcTerms; ++j) {
+            double sum = 0.0;
+            for (int k = 0; k < erfcTerms; ++k)
+                sum += f[k] * std::cos(pi * j * (k + 0.5) / erfcTerms);
+            c[j] = 2.0 * sum / erfcTerms;
+        }
+    }
+};
+
+static const ErfcSeries& erfcSeries() {
+    static const ErfcSeries series;
+    return series;
+}
+
+#if SPAN_HAVE_X86
+// exp, log and the normal distribution on four lanes. exp: x = n ln2 + r with
+// |r| <= ln2 / 2, e^r by its Taylor series to r^13, 2^n built in the exponent
+// bits. log: x = 2^e m with m in [sqrt(1/2), sqrt(2)), log m = 2 atanh(s) with
+// s = (m - 1) / (m + 1) to s^21. Both are within a few ulp on the ranges the
+// pricer feeds them, so the AVX2 and scalar risk arrays agree to ~1e-12.
+static const double ln2Hi = 6.93145751953125E-1;
+static const double ln2Lo = 1.42860682030941723212E-6;
+
+// even + odd * r
+SPAN_TARGET_AVX2 static inline __m256d termPair(__m256d r, double even, double odd) {
+    return _mm256_add_pd(_mm256_set1_pd(even), _mm256_mul_pd(r, _mm256_set1_pd(odd)));
+}
+
+SPAN_TARGET_AVX2 static inline __m256d expAvx2(__m256d x) {
+    x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(700.0)), _mm256_set1_pd(-700.0));
+    const __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.44269504088896340736)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const __m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(ln2Hi))),
+        _mm256_mul_pd(n, _mm256_set1_pd(ln2Lo)));
+
+    // Taylor series to r^13 as pairs of terms in r^2, two short chains instead of one long one
+    const __m256d r2 = _mm256_mul_pd(r, r);
+    __m256d p = termPair(r, 1.0 / 479001600.0, 1.0 / 6227020800.0);
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), termPair(r, 1.0 / 3628800.0, 1.0 / 39916800.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), termPair(r, 1.0 / 40320.0, 1.0 / 362880.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), termPair(r, 1.0 / 720.0, 1.0 / 5040.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), termPair(r, 1.0 / 24.0, 1.0 / 120.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), termPair(r, 0.5, 1.0 / 6.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), termPair(r, 1.0, 1.0));
+
+    // n + 1.5 * 2^52 keeps n in the low mantissa bits; add the bias, shift into the exponent
+    __m256i bits = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(6755399441055744.0)));
+    bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+}
+
+// x > 0 and normal
+SPAN_TARGET_AVX2 static inline __m256d logAvx2(__m256d x) {
+    const __m256i bits = _mm256_castpd_si256(x);
+    __m256i exponent = _mm256_srli_epi64(bits, 52);
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm256_set1_epi64x(0x3FF0000000000000LL)));
+    const __m256d high = _mm256_cmp_pd(m, _mm256_set1_pd(1.41421356237309504880), _CMP_GE_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), high);
+    exponent = _mm256_sub_epi64(exponent, _mm256_castpd_si256(high));     // high lanes are -1: one more
+    // Small integer to double through the mantissa of 2^52
+    const __m256d e = _mm256_sub_pd(
+        _mm256_castsi256_pd(_mm256_or_si256(exponent, _mm256_set1_epi64x(0x4330000000000000LL))),
+        _mm256_set1_pd(4503599627370496.0 + 1023.0));
+
+    const __m256d s = _mm256_div_pd(_mm256_sub_pd(m, _mm256_set1_pd(1.0)), _mm256_add_pd(m, _mm256_set1_pd(1.0)));
+    const __m256d s2 = _mm256_mul_pd(s, s);
+    __m256d p = _mm256_set1_pd(1.0 / 21.0);
+    for (int k = 19; k >= 1; k -= 2)
+        p = _mm256_add_pd(_mm256_mul_pd(p, s2), _mm256_set1_pd(1.0 / k));
+    const __m256d atanh2 = _mm256_mul_pd(_mm256_add_pd(s, s), p);
+    return _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(ln2Hi)),
+        _mm256_add_pd(atanh2, _mm256_mul_pd(e, _mm256_set1_pd(ln2Lo))));
+}
+
+// The last two terms of the erfc series' Clenshaw recurrence at four vectors
+// of 2u. The four chains of dependent multiply-adds advance together, in
+// registers, so each step's latency is shared; c - dd is off the chain.
+SPAN_TARGET_AVX2 static inline void clenshaw4Avx2(const ErfcSeries& erfc, const __m256d* u2, __m256d* d, __m256d* dd) {
+    const __m256d w0 = u2[0], w1 = u2[1], w2 = u2[2], w3 = u2[3];
+    __m256d d0 = _mm256_setzero_pd(), d1 = d0, d2 = d0, d3 = d0;
+    __m256d e0 = d0, e1 = d0, e2 = d0, e3 = d0;
+    for (int j = erfcTerms - 1; j >= 1; --j) {
+        const __m256d c = _mm256_set1_pd(erfc.c[j]);
+        const __m256d n0 = _mm256_add_pd(_mm256_mul_pd(w0, d0), _mm256_sub_pd(c, e0));
+        const __m256d n1 = _mm256_add_pd(_mm256_mul_pd(w1, d1), _mm256_sub_pd(c, e1));
+        const __m256d n2 = _mm256_add_pd(_mm256_mul_pd(w2, d2), _mm256_sub_pd(c, e2));
+        const __m256d n3 = _mm256_add_pd(_mm256_mul_pd(w3, d3), _mm256_sub_pd(c, e3));
+        e0 = d0; e1 = d1; e2 = d2; e3 = d3;
+        d0 = n0; d1 = n1; d2 = n2; d3 = n3;
+    }
+    d[0] = d0; d[1] = d1; d[2] = d2; d[3] = d3;
+    dd[0] = e0; dd[1] = e1; dd[2] = e2; dd[3] = e3;
+}
+
+// N(x) and N(-x) = 1 - N(x) of four vectors, each from the one erfc of |x|
+SPAN_TARGET_AVX2 static inline void normCdf4Avx2(const __m256d* x, const ErfcSeries& erfc, __m256d* cdf, __m256d* complement) {
+    __m256d z[4], u2[4], d[4], dd[4];
+    for (int k = 0; k < 4; ++k) {
+        const __m256d absX = _mm256_andnot_pd(_mm256_set1_pd(-0.0), x[k]);
+        z[k] = _mm256_min_pd(_mm256_mul_pd(absX, _mm256_set1_pd(0.70710678118654752440)), _mm256_set1_pd(erfcMaxZ));
+        const __m256d t = _mm256_div_pd(_mm256_set1_pd(2.0), _mm256_add_pd(_mm256_set1_pd(2.0), z[k]));
+        // 2u, u = t mapped onto [-1, 1]
+        u2[k] = _mm256_mul_pd(_mm256_sub_pd(_mm256_add_pd(t, t), _mm256_set1_pd(erfc.lo + erfc.hi)),
+            _mm256_set1_pd(2.0 / (erfc.hi - erfc.lo)));
+    }
+    clenshaw4Avx2(erfc, u2, d, dd);
+    for (int k = 0; k < 4; ++k) {
+        const __m256d u = _mm256_mul_pd(u2[k], _mm256_set1_pd(0.5));
+        const __m256d h = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(u, d[k]), dd[k]), _mm256_set1_pd(0.5 * erfc.c[0]));
+        // 0.5 erfc(|x| / sqrt 2) = N(-|x|)
+        const __m256d tail = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), expAvx2(_mm256_sub_pd(_mm256_setzero_pd(),
+            _mm256_mul_pd(z[k], z[k])))), h);
+        const __m256d body = _mm256_sub_pd(_mm256_set1_pd(1.0), tail);
+        const __m256d negative = _mm256_cmp_pd(x[k], _mm256_setzero_pd(), _CMP_LT_OQ);
+        cdf[k] = _mm256_blendv_pd(body, tail, negative);
+        complement[k] = _mm256_blendv_pd(tail, body, negative);
+    }
+}
+
+// Black-76 of four options under two scenarios at once; logMoneyness is log(future / strike)
+SPAN_TARGET_AVX2 static inline void black76PairAvx2(__m256d call, const __m256d* future, __m256d strike, const __m256d* logMoneyness,
+    __m256d sqrtYears, __m256d discount, const __m256d* volatility, const ErfcSeries& erfc, __m256d* value) {
+    __m256d x[4], cdf[4], complement[4];
+    for (int i = 0; i < 2; ++i) {
+        const __m256d sd = _mm256_mul_pd(volatility[i], sqrtYears);
+        x[2 * i] = _mm256_div_pd(_mm256_add_pd(logMoneyness[i], _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(sd, sd))), sd);
+        x[2 * i + 1] = _mm256_sub_pd(x[2 * i], sd);
+    }
+    normCdf4Avx2(x, erfc, cdf, complement);
+    for (int i = 0; i < 2; ++i) {
+        const __m256d callValue = _mm256_sub_pd(_mm256_mul_pd(future[i], cdf[2 * i]), _mm256_mul_pd(strike, cdf[2 * i + 1]));
+        const __m256d putValue = _mm256_sub_pd(_mm256_mul_pd(strike, complement[2 * i + 1]), _mm256_mul_pd(future[i], complement[2 * i]));
+        value[i] = _mm256_mul_pd(discount, _mm256_blendv_pd(putValue, callValue, call));
+    }
+}
+
+// Four options per register through the 16 scenarios, priced two at a time
+// (the unmoved price first, then the scenarios; the last pair repeats the
+// last scenario). The two volatility moves of each price move share the log
+// of the moved future.
+SPAN_TARGET_AVX2 static void validateAvx2(const OptionBlock& block, double absTolerance, double relTolerance, OptionResult* out) {
+    const ErfcSeries& erfc = erfcSeries();
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m256d absTol = _mm256_set1_pd(absTolerance), relTol = _mm256_set1_pd(relTolerance);
+    const int pricings = scanScenarios + 1;
+
+    for (size_t j = 0; j < block.count; j += 4) {
+        const __m256d call = _mm256_cmp_pd(_mm256_loadu_pd(&block.call[j]), zero, _CMP_NEQ_OQ);
+        const __m256d future = _mm256_loadu_pd(&block.future[j]);
+        const __m256d strike = _mm256_loadu_pd(&block.strike[j]);
+        const __m256d years = _mm256_loadu_pd(&block.years[j]);
+        const __m256d volatility = _mm256_loadu_pd(&block.volatility[j]);
+        const __m256d priceScan = _mm256_loadu_pd(&block.priceScan[j]);
+        const __m256d volScan = _mm256_loadu_pd(&block.volScan[j]);
+        const __m256d sqrtYears = _mm256_sqrt_pd(years);
+        const __m256d discount = expAvx2(_mm256_sub_pd(zero, _mm256_mul_pd(_mm256_loadu_pd(&block.rate[j]), years)));
+        const __m256d logStrike = logAvx2(strike);
+
+        // Pricing 0 is the option as published, pricing s + 1 scenario s
+        __m256d f[pricings + 1], logMoneyness[pricings + 1], v[pricings + 1], value[pricings + 1];
+        for (int p = 0; p < pricings; ++p) {
+            const double priceMove = p ? spanScenarios[p - 1].priceMove : 0.0;
+            const double volMove = p ? spanScenarios[p - 1].volMove : 0.0;
+            f[p] = _mm256_max_pd(_mm256_add_pd(future, _mm256_mul_pd(_mm256_set1_pd(priceMove), priceScan)), _mm256_set1_pd(minFuture));
+            if (p == 0 || priceMove != (p > 1 ? spanScenarios[p - 2].priceMove : 0.0))
+                logMoneyness[p] = _mm256_sub_pd(logAvx2(f[p]), logStrike);
+            else
+                logMoneyness[p] = logMoneyness[p - 1];
+            v[p] = _mm256_max_pd(_mm256_add_pd(volatility, _mm256_mul_pd(_mm256_set1_pd(volMove), volScan)),
+                _mm256_set1_pd(minVolatility));
+        }
+        f[pricings] = f[pricings - 1];
+        logMoneyness[pricings] = logMoneyness[pricings - 1];
+        v[pricings] = v[pricings - 1];
+        for (int p = 0; p < pricings; p += 2)
+            black76PairAvx2(call, &f[p], strike, &logMoneyness[p], sqrtYears, discount, &v[p], erfc, &value[p]);
+
+        __m256d flagged = zero, worst = _mm256_set1_pd(-1.0), worstPublished = zero, worstValue = zero, worstPoint = zero;
+        for (int s = 0; s < scanScenarios; ++s) {
+            const __m256d loss = _mm256_mul_pd(_mm256_set1_pd(spanScenarios[s].weight), _mm256_sub_pd(value[0], value[s + 1]));
+
+            const __m256d published = _mm256_loadu_pd(&block.published[s * block.stride + j]);
+            const __m256d deviation = _mm256_and_pd(_mm256_sub_pd(loss, published), absMask);
+            const __m256d limit = _mm256_add_pd(absTol, _mm256_mul_pd(relTol, _mm256_and_pd(published, absMask)));
+            flagged = _mm256_or_pd(flagged, _mm256_cmp_pd(deviation, limit, _CMP_NLE_UQ));
+            const __m256d larger = _mm256_cmp_pd(deviation, worst, _CMP_GT_OQ);
+            worst = _mm256_blendv_pd(worst, deviation, larger);
+            worstPublished = _mm256_blendv_pd(worstPublished, published, larger);
+            worstValue = _mm256_blendv_pd(worstValue, loss, larger);
+            worstPoint = _mm256_blendv_pd(worstPoint, _mm256_set1_pd(s + 1), larger);
+        }
+
+        double lanes[4][4];
+        _mm256_storeu_pd(lanes[0], worst);
+        _mm256_storeu_pd(lanes[1], worstPublished);
+        _mm256_storeu_pd(lanes[2], worstValue);
+        _mm256_storeu_pd(lanes[3], worstPoint);
+        const int flaggedLanes = _mm256_movemask_pd(flagged);
+        for (size_t k = 0; k < 4 && j + k < block.count; ++k) {
+            OptionResult& r = out[j + k];
+            r.deviation = lanes[0][k];
+            r.published = lanes[1][k];
+            r.recomputed = lanes[2][k];
+            r.scenario = lanes[3][k] != 0.0 ? (int)lanes[3][k] : 1;
+            r.flagged = (flaggedLanes >> k) & 1;
+        }
+    }
+}
+#endif
+
+static ValidationKernel selectKernel(bool simd) {
+#if SPAN_HAVE_X86
+    if (simd && cpuHasAvx2())
+        return validateAvx2;
+#endif
+    return validateScalar;
+}
+
+// Options of one validation pass and where their underlying prices come from
+struct OptionInput {
+    uint32_t row;
+    double future;
+};
+
+static void gatherOptions(const SpanRecordStore& store, const UnderlyingPrices& prices, std::vector<OptionInput>& options,
+    ValidationStats& stats) {
+    for (size_t i = 0; i < store.size(); ++i) {
+        const CompactRecord& rec = store.record(i);
+        if (rec.optContractId == 0)
+            continue;
+        if (rec.riskCount != (uint32_t)scanScenarios || !(rec.timeToExpiry > 0.0) || !(rec.volatility > 0.0) ||
+            !(rec.strikePrice > 0.0)) {
+            stats.skipped++;
+            continue;
+        }
+        double future;
+        if (!prices.find(rec.underlyingPfId, rec.contractId, future)) {
+            stats.noUnderlying++;
+            continue;
+        }
+        if (!(future > 0.0)) {
+            stats.skipped++;
+            continue;
+        }
+        options.push_back(OptionInput{ (uint32_t)i, future });
+    }
+}
+
+static void fillBlock(const SpanRecordStore& store, const OptionInput* options, size_t count, OptionBlock& block) {
+    block.count = count;
+    const size_t padded = (count + 3) & ~(size_t)3;
+    for (size_t j = 0; j < padded; ++j) {
+        const OptionInput& in = options[std::min(j, count - 1)];
+        const CompactRecord& rec = store.record(in.row);
+        block.future[j] = in.future;
+        block.strike[j] = rec.strikePrice;
+        block.years[j] = rec.timeToExpiry;
+        block.rate[j] = rec.intraRate;
+        block.volatility[j] = rec.volatility;
+        block.priceScan[j] = rec.priceScan;
+        block.volScan[j] = rec.volScan;
+        block.call[j] = rec.optionType.view() == "C" ? 1.0 : 0.0;
+        const double* risk = store.risk(rec);
+        for (int s = 0; s < scanScenarios; ++s)
+            block.published[s * block.stride + j] = risk[s];
+    }
+}
+
+void validateRiskArrays(const SpanRecordStore& store, const UnderlyingPrices& prices, const ValidationOptions& opts,
+    std::vector<ValidationIssue>& issues, ValidationStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    ValidationStats pass;
+    std::vector<OptionInput> options;
+    gatherOptions(store, prices, options, pass);
+    if (options.empty()) {
+        stats.add(pass);
+        return;
+    }
+
+    std::vector<OptionResult> results(options.size());
+    const ValidationKernel kernel = selectKernel(opts.simd);
+    const size_t blockSize = std::max<size_t>(std::min(opts.blockOptions, options.size()), 4);
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        OptionBlock block;
+        block.resize(blockSize);
+        for (;;) {
+            size_t first = next.fetch_add(blockSize);
+            if (first >= options.size())
+                break;
+            size_t count = std::min(blockSize, options.size() - first);
+            fillBlock(store, &options[first], count, block);
+            kernel(block, opts.absTolerance, opts.relTolerance, &results[first]);
+        }
+    };
+    const size_t blocks = (options.size() + blockSize - 1) / blockSize;
+    const int threads = (int)std::min<size_t>(opts.threads > 1 ? (size_t)opts.threads : 1, blocks);
+    if (threads <= 1) {
+        work();
+    }
+    else {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back(work);
+        for (auto& w : workers)
+            w.join();
+    }
+
+    for (size_t i = 0; i < options.size(); ++i) {
+        const OptionResult& r = results[i];
+        if (r.deviation > pass.maxDeviation || std::isnan(r.deviation))
+            pass.maxDeviation = std::isnan(r.deviation) ? HUGE_VAL : r.deviation;
+        if (!r.flagged)
+            continue;
+        const CompactRecord& rec = store.record(options[i].row);
+        const PortfolioHeader& header = store.portfolio(rec.portfolio);
+        ValidationIssue issue;
+        issue.pfId = header.pfId;
+        issue.pfCode = header.pfCode;
+        issue.contractId = rec.contractId;
+        issue.optContractId = rec.optContractId;
+        issue.scenario = r.scenario;
+        issue.published = r.published;
+        issue.recomputed = r.recomputed;
+        issue.deviation = r.deviation;
+        issues.push_back(std::move(issue));
+        pass.flagged++;
+    }
+    pass.options = options.size();
+    pass.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.add(pass);
+}
+
+void validateRiskArrays(const SpanRecordStore& store, const ValidationOptions& opts, std::vector<ValidationIssue>& issues,
+    ValidationStats& stats) {
+    UnderlyingPrices prices;
+    prices.add(store);
+    validateRiskArrays(store, prices, opts, issues, stats);
+}
+
+bool writeValidationIssues(const std::string& path, const std::vector<ValidationIssue>& issues) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        logger.log("Failed to create " + path, LogLevel::ERRORS);
+        return false;
+    }
+    out << "pfId,pfCode,contractId,optContractId,scenario,published,recomputed,deviation\n";
+    char buf[96];
+    for (const ValidationIssue& issue : issues) {
+        std::snprintf(buf, sizeof(buf), "%.6f,%.6f,%.6f", issue.published, issue.recomputed, issue.deviation);
+        out << issue.pfId << ',' << issue.pfCode << ',' << issue.contractId << ',' << issue.optContractId << ','
+            << issue.scenario << ',' << buf << '\n';
+    }
+    out.close();
+    if (!out) {
+        logger.log("Failed to write " + path, LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+void benchRiskValidation(const SpanRecordStore& store, int maxThreads) {
+    UnderlyingPrices prices;
+    prices.add(store);
+    ValidationStats probe;
+    std::vector<OptionInput> options;
+    gatherOptions(store, prices, options, probe);
+    logger.log("bench-validate " + std::to_string(options.size()) + " options, " + std::to_string(probe.skipped) +
+        " skipped, " + std::to_string(probe.noUnderlying) + " without an underlying price", LogLevel::INFO);
+
+    std::vector<ValidationIssue> reference;
+    std::cout << "kernel  threads  options  seconds  options/s  speedup  flagged  maxDeviation\n";
+    const bool kernels[] = { false, true };
+    double baseSecs = 0.0;
+    for (bool simd : kernels) {
+        if (simd && !cpuHasAvx2()) {
+            std::cout << "avx2 not available on this CPU or build\n";
+            break;
+        }
+        for (int threads = 1; ; threads *= 2) {
+            if (threads > maxThreads)
+                threads = maxThreads;
+
+            ValidationOptions opts;
+            opts.threads = threads;
+            opts.simd = simd;
+            std::vector<ValidationIssue> issues;
+            ValidationStats stats;
+            validateRiskArrays(store, prices, opts, issues, stats);
+            const double secs = stats.seconds;
+            if (!simd && threads == 1) {
+                baseSecs = secs;
+                reference = issues;
+            }
+            bool same = std::equal(issues.begin(), issues.end(), reference.begin(), reference.end(),
+                [](const ValidationIssue& a, const ValidationIssue& b) {
+                    return a.pfId == b.pfId && a.contractId == b.contractId && a.optContractId == b.optContractId;
+                });
+
+            char deviation[32];
+            std::snprintf(deviation, sizeof(deviation), "%.3g", stats.maxDeviation);
+            std::string line = std::string(simd ? "avx2" : "scalar") + "  " + std::to_string(threads) + "  " +
+                std::to_string(stats.options) + "  " + std::to_string(secs) + "  " +
+                std::to_string(secs > 0 ? stats.options / secs : 0.0) + "  " +
+                std::to_string(secs > 0 ? baseSecs / secs : 0.0) + "  " + std::to_string(stats.flagged) + "  " +
+                deviation + (same ? "" : "  MISMATCH");
+            std::cout << line << "\n";
+            logger.log("bench-validate " + line, same ? LogLevel::INFO : LogLevel::ERRORS);
+
+            if (threads == maxThreads)
+                break;
+        }
+    }
+}
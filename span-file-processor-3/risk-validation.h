@@ -0,0 +1,124 @@
+#pragma once
+#ifndef RISK_VALIDATION_H
+#define RISK_VALIDATION_H
+
+#include "record-sink.h"
+#include "scan-risk.h"
+#include "span-record-store.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One of SPAN's 16 standard scenarios: the underlying moves by priceMove
+// times the price scan range and the volatility by volMove times the
+// volatility scan range; the extreme moves (15, 16) count at weight 0.35
+struct SpanScenario {
+    double priceMove;
+    double volMove;
+    double weight;
+};
+
+extern const SpanScenario spanScenarios[scanScenarios];
+
+// Black-76 value of a European option on a future
+double black76Price(bool call, double future, double strike, double years, double rate, double volatility);
+
+// Risk array of one long option: weight * (value now - value under the
+// scenario), i.e. losses positive, for each of the 16 scenarios. Like the
+// published arrays it is per unit of the underlying: cvf is not applied here
+// but by whoever sizes positions (scan-risk.h)
+void black76RiskArray(bool call, double future, double strike, double years, double rate, double volatility,
+    double priceScan, double volScan, double* out);
+
+struct ValidationOptions {
+    double absTolerance = 0.01;
+    double relTolerance = 0.0;  // plus this times |published value|
+    int threads = 1;            // <= 1 inline
+    bool simd = true;           // AVX2 pricer where cpuHasAvx2()
+    size_t blockOptions = 1024; // options per work item
+};
+
+// Settlement prices of futures and physicals, the underlyings of the options
+class UnderlyingPrices {
+public:
+    void add(const SpanRecordStore& store);
+    bool find(int pfId, int contractId, double& price) const;
+    size_t size() const { return prices.size(); }
+
+private:
+    std::unordered_map<ContractKey, double, ContractKeyHash> prices;    // optContractId 0
+};
+
+// An option whose published risk array is off by more than the tolerance
+struct ValidationIssue {
+    int pfId = 0;
+    std::string pfCode;
+    int contractId = 0;
+    int optContractId = 0;
+    int scenario = 0;           // 1-based point with the largest deviation
+    double published = 0.0;     // at that point
+    double recomputed = 0.0;
+    double deviation = 0.0;     // |published - recomputed| there
+};
+
+struct ValidationStats {
+    size_t options = 0;         // options repriced
+    size_t flagged = 0;
+    size_t skipped = 0;         // options without 16 risk points, or a positive time, volatility or strike
+    size_t noUnderlying = 0;    // options whose underlying price is unknown
+    double maxDeviation = 0.0;
+    double seconds = 0.0;       // pricing and comparison, wall clock
+
+    void add(const ValidationStats& other);
+};
+
+// Reprices every option of store under the 16 scenarios with Black-76 from
+// its strike, type, series volatility, rate and time, and its underlying's
+// settlement price, and appends the options whose recomputed risk array
+// differs from the published one at any point by more than absTolerance +
+// relTolerance * |published| (a NaN differs). Options go to opts.threads
+// workers in blocks of opts.blockOptions. stats are added to.
+void validateRiskArrays(const SpanRecordStore& store, const UnderlyingPrices& prices, const ValidationOptions& opts,
+    std::vector<ValidationIssue>& issues, ValidationStats& stats);
+
+// Same, with the underlyings taken from store itself (a whole file)
+void validateRiskArrays(const SpanRecordStore& store, const ValidationOptions& opts, std::vector<ValidationIssue>& issues,
+    ValidationStats& stats);
+
+// CSV: pfId,pfCode,contractId,optContractId,scenario,published,recomputed,deviation
+bool writeValidationIssues(const std::string& path, const std::vector<ValidationIssue>& issues);
+
+// Streaming loads: validates each block inline as it is written, against the
+// underlyings of the blocks written before it (SPAN files list futures ahead
+// of their options; with --unordered some options may count as noUnderlying)
+class ValidationSink : public RecordSink {
+public:
+    explicit ValidationSink(const ValidationOptions& options) : options(options) { this->options.threads = 1; }
+
+    bool write(const SpanRecordStore& records) override {
+        prices.add(records);
+        validateRiskArrays(records, prices, options, found, totals);
+        counters.rowsInserted += records.size();
+        counters.batches++;
+        return true;
+    }
+    bool finish() override { return true; }
+    InsertStats stats() const override { return counters; }
+
+    const std::vector<ValidationIssue>& issues() const { return found; }
+    const ValidationStats& validationStats() const { return totals; }
+
+private:
+    ValidationOptions options;
+    UnderlyingPrices prices;
+    std::vector<ValidationIssue> found;
+    ValidationStats totals;
+    InsertStats counters;
+};
+
+// Options repriced per second, scalar and AVX2, at 1, 2, 4 ... maxThreads threads
+void benchRiskValidation(const SpanRecordStore& store, int maxThreads);
+
+#endif // RISK_VALIDATION_H
@@ -0,0 +1,329 @@
+#include "scan-risk.h"
+#include "cpu-features.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+
+extern Logger logger;
+
+void ScanRiskModel::build(const SpanRecordStore& store) {
+    index.clear();
+    pfIds.clear();
+    values.clear();
+    truncated = 0;
+    index.reserve(store.size());
+    pfIds.reserve(store.size());
+    values.reserve(store.size() * scanScenarios);
+
+    size_t duplicates = 0;
+    for (size_t i = 0; i < store.size(); ++i) {
+        const CompactRecord& rec = store.record(i);
+        const PortfolioHeader& header = store.portfolio(rec.portfolio);
+        ContractKey key{ header.pfId, rec.contractId, rec.optContractId };
+        if (!index.emplace(key, (uint32_t)pfIds.size()).second) {
+            ++duplicates;               // keep the first occurrence
+            continue;
+        }
+        pfIds.push_back(header.pfId);
+
+        const double* a = store.risk(rec);
+        size_t count = rec.riskCount;
+        if (count > (size_t)scanScenarios) {
+            count = scanScenarios;
+            ++truncated;
+        }
+        for (size_t s = 0; s < count; ++s)
+            values.push_back(a[s] * header.cvf);
+        values.resize(values.size() + (scanScenarios - count), 0.0);
+    }
+
+    if (duplicates)
+        logger.log("scan risk: " + std::to_string(duplicates) + " duplicate contracts ignored", LogLevel::WARNING);
+    if (truncated)
+        logger.log("scan risk: " + std::to_string(truncated) + " risk arrays longer than " +
+            std::to_string(scanScenarios) + " values cut", LogLevel::WARNING);
+}
+
+bool ScanRiskModel::find(int pfId, int contractId, int optContractId, uint32_t& row) const {
+    auto it = index.find(ContractKey{ pfId, contractId, optContractId });
+    if (it == index.end())
+        return false;
+    row = it->second;
+    return true;
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+        s.remove_suffix(1);
+    return s;
+}
+
+static void sortByPortfolio(const ScanRiskModel& model, ScanAccount& account) {
+    std::stable_sort(account.positions.begin(), account.positions.end(), [&](const ScanPosition& a, const ScanPosition& b) {
+        return model.pfId(a.row) < model.pfId(b.row);
+    });
+}
+
+bool readPositions(const std::string& path, const ScanRiskModel& model, std::vector<ScanAccount>& accounts, size_t& unmatched) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        logger.log("Failed to open positions file " + path, LogLevel::ERRORS);
+        return false;
+    }
+
+    std::unordered_map<std::string, size_t> byName;
+    std::string line;
+    size_t lineNo = 0;
+    unmatched = 0;
+    while (std::getline(file, line)) {
+        ++lineNo;
+        std::string_view rest = trim(line);
+        if (rest.empty() || rest.front() == '#')
+            continue;
+
+        std::string_view fields[5];
+        int n = 0;
+        while (n < 5) {
+            size_t comma = rest.find(',');
+            fields[n++] = trim(rest.substr(0, comma));
+            if (comma == std::string_view::npos)
+                break;
+            rest.remove_prefix(comma + 1);
+        }
+        int pfId, contractId, optContractId;
+        double quantity;
+        try {
+            if (n != 5 || fields[0].empty())
+                throw std::invalid_argument("expected 5 fields");
+            pfId = std::stoi(std::string(fields[1]));
+            contractId = std::stoi(std::string(fields[2]));
+            optContractId = fields[3].empty() ? 0 : std::stoi(std::string(fields[3]));
+            quantity = std::stod(std::string(fields[4]));
+        }
+        catch (const std::exception&) {
+            logger.log(path + ":" + std::to_string(lineNo) + ": expected account,pfId,contractId,optContractId,quantity",
+                LogLevel::ERRORS);
+            return false;
+        }
+
+        ScanPosition pos;
+        pos.quantity = quantity;
+        if (!model.find(pfId, contractId, optContractId, pos.row)) {
+            ++unmatched;
+            continue;
+        }
+        auto it = byName.emplace(std::string(fields[0]), accounts.size()).first;
+        if (it->second == accounts.size()) {
+            accounts.emplace_back();
+            accounts.back().name = it->first;
+        }
+        accounts[it->second].positions.push_back(pos);
+    }
+
+    for (ScanAccount& account : accounts)
+        sortByPortfolio(model, account);
+    if (unmatched)
+        logger.log("scan risk: " + std::to_string(unmatched) + " positions in contracts not in the SPAN file skipped",
+            LogLevel::WARNING);
+    return true;
+}
+
+void makeSyntheticAccounts(const ScanRiskModel& model, size_t count, int positionsPerAccount, uint64_t seed,
+    std::vector<ScanAccount>& accounts) {
+    accounts.clear();
+    if (model.rows() == 0)
+        return;
+    uint64_t state = seed;
+    auto next = [&state] {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+    accounts.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        ScanAccount& account = accounts[i];
+        account.name = "ACC" + std::to_string(i + 1);
+        account.positions.resize((size_t)positionsPerAccount);
+        for (ScanPosition& pos : account.positions) {
+            pos.row = (uint32_t)(next() % model.rows());
+            pos.quantity = (double)((int)(next() % 201) - 100);    // -100 .. 100 lots
+        }
+        sortByPortfolio(model, account);
+    }
+}
+
+// Worst scenario loss of positions [p, end), all in one portfolio
+static double portfolioLossScalar(const ScanRiskModel& model, const ScanPosition* p, const ScanPosition* end) {
+    double acc[scanScenarios] = {};
+    for (; p != end; ++p) {
+        const double* lane = model.lanes(p->row);
+        for (int s = 0; s < scanScenarios; ++s)
+            acc[s] += p->quantity * lane[s];
+    }
+    double worst = acc[0];
+    for (int s = 1; s < scanScenarios; ++s)
+        worst = acc[s] > worst ? acc[s] : worst;
+    return worst;
+}
+
+#if SPAN_HAVE_X86
+// Same arithmetic as the scalar kernel (multiply, then add, in position order
+// per lane), four scenarios per register
+SPAN_TARGET_AVX2 static double portfolioLossAvx2(const ScanRiskModel& model, const ScanPosition* p, const ScanPosition* end) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    __m256d a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+    for (; p != end; ++p) {
+        const double* lane = model.lanes(p->row);
+        __m256d q = _mm256_set1_pd(p->quantity);
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(q, _mm256_loadu_pd(lane)));
+        a1 = _mm256_add_pd(a1, _mm256_mul_pd(q, _mm256_loadu_pd(lane + 4)));
+        a2 = _mm256_add_pd(a2, _mm256_mul_pd(q, _mm256_loadu_pd(lane + 8)));
+        a3 = _mm256_add_pd(a3, _mm256_mul_pd(q, _mm256_loadu_pd(lane + 12)));
+    }
+    __m256d m = _mm256_max_pd(_mm256_max_pd(a0, a1), _mm256_max_pd(a2, a3));
+    __m128d h = _mm_max_pd(_mm256_castpd256_pd128(m), _mm256_extractf128_pd(m, 1));
+    h = _mm_max_sd(h, _mm_unpackhi_pd(h, h));
+    return _mm_cvtsd_f64(h);
+}
+#endif
+
+bool scanRiskAvx2Available() {
+    return cpuHasAvx2();
+}
+
+using PortfolioKernel = double (*)(const ScanRiskModel&, const ScanPosition*, const ScanPosition*);
+
+static ScanResult accountScanRisk(const ScanRiskModel& model, const ScanAccount& account, PortfolioKernel kernel) {
+    ScanResult result;
+    double worstRisk = 0.0;
+    const ScanPosition* p = account.positions.data();
+    const ScanPosition* end = p + account.positions.size();
+    while (p != end) {
+        int pfId = model.pfId(p->row);
+        const ScanPosition* group = p;
+        while (p != end && model.pfId(p->row) == pfId)
+            ++p;
+        double risk = kernel(model, group, p);
+        if (risk < 0.0)
+            risk = 0.0;
+        result.scanRisk += risk;
+        result.portfolios++;
+        if (risk > worstRisk || result.worstPfId == 0) {
+            worstRisk = risk;
+            result.worstPfId = pfId;
+        }
+    }
+    return result;
+}
+
+void computeScanRisk(const ScanRiskModel& model, const std::vector<ScanAccount>& accounts, int threads, bool simd,
+    std::vector<ScanResult>& results) {
+    PortfolioKernel kernel = portfolioLossScalar;
+#if SPAN_HAVE_X86
+    if (simd && scanRiskAvx2Available())
+        kernel = portfolioLossAvx2;
+#endif
+    results.assign(accounts.size(), ScanResult());
+
+    if (threads <= 1) {
+        for (size_t i = 0; i < accounts.size(); ++i)
+            results[i] = accountScanRisk(model, accounts[i], kernel);
+        return;
+    }
+
+    // Accounts vary in size: hand them out in small chunks
+    const size_t chunk = 64;
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (;;) {
+                size_t first = next.fetch_add(chunk);
+                if (first >= accounts.size())
+                    break;
+                size_t last = std::min(first + chunk, accounts.size());
+                for (size_t i = first; i < last; ++i)
+                    results[i] = accountScanRisk(model, accounts[i], kernel);
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+}
+
+bool writeScanResults(const std::string& path, const std::vector<ScanAccount>& accounts, const std::vector<ScanResult>& results) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        logger.log("Failed to create " + path, LogLevel::ERRORS);
+        return false;
+    }
+    out << "account,positions,portfolios,scanRisk,worstPfId\n";
+    char buf[64];
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        std::snprintf(buf, sizeof(buf), "%.2f", results[i].scanRisk);
+        out << accounts[i].name << ',' << accounts[i].positions.size() << ',' << results[i].portfolios << ','
+            << buf << ',' << results[i].worstPfId << '\n';
+    }
+    out.close();
+    if (!out) {
+        logger.log("Failed to write " + path, LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+void benchScanRisk(const ScanRiskModel& model, const std::vector<ScanAccount>& accounts, int maxThreads) {
+    size_t positions = 0;
+    for (const ScanAccount& account : accounts)
+        positions += account.positions.size();
+    logger.log("bench-scan " + std::to_string(accounts.size()) + " accounts, " + std::to_string(positions) +
+        " positions, " + std::to_string(model.rows()) + " contracts", LogLevel::INFO);
+
+    std::vector<ScanResult> reference;
+    std::cout << "kernel  threads  accounts  seconds  accounts/s  speedup\n";
+    const bool kernels[] = { false, true };
+    double baseSecs = 0.0;
+    for (bool simd : kernels) {
+        if (simd && !scanRiskAvx2Available()) {
+            std::cout << "avx2 not available on this CPU or build\n";
+            break;
+        }
+        for (int threads = 1; ; threads *= 2) {
+            if (threads > maxThreads)
+                threads = maxThreads;
+
+            std::vector<ScanResult> results;
+            auto start = std::chrono::steady_clock::now();
+            computeScanRisk(model, accounts, threads, simd, results);
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!simd && threads == 1) {
+                baseSecs = secs;
+                reference = results;
+            }
+            bool same = std::equal(results.begin(), results.end(), reference.begin(), [](const ScanResult& a, const ScanResult& b) {
+                return a.scanRisk == b.scanRisk && a.worstPfId == b.worstPfId;
+            });
+
+            std::string line = std::string(simd ? "avx2" : "scalar") + "  " + std::to_string(threads) + "  " +
+                std::to_string(accounts.size()) + "  " + std::to_string(secs) + "  " +
+                std::to_string(secs > 0 ? accounts.size() / secs : 0.0) + "  " +
+                std::to_string(secs > 0 ? baseSecs / secs : 0.0) + (same ? "" : "  MISMATCH");
+            std::cout << line << "\n";
+            logger.log("bench-scan " + line, same ? LogLevel::INFO : LogLevel::ERRORS);
+
+            if (threads == maxThreads)
+                break;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef SCAN_RISK_H
+#define SCAN_RISK_H
+
+#include "span-record-store.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// SPAN scan risk from parsed risk arrays. A contract's risk array holds the
+// loss of one long position per unit of the underlying under each of the 16
+// price/volatility scenarios; cvf converts it to one contract.
+// The loss of a portfolio under scenario s is sum(quantity * cvf * a[s]) over
+// its positions and its scan risk the worst of those losses, floored at 0.
+// An account's scan risk is the sum over the portfolios (pfId) it holds.
+const int scanScenarios = 16;
+
+// Risk arrays of a SpanRecordStore, pre-multiplied by cvf, one row of
+// scanScenarios doubles per record (shorter arrays padded with 0, longer cut)
+class ScanRiskModel {
+public:
+    void build(const SpanRecordStore& store);
+
+    // Row of the contract, optContractId 0 for futures and physicals
+    bool find(int pfId, int contractId, int optContractId, uint32_t& row) const;
+
+    size_t rows() const { return pfIds.size(); }
+    int pfId(uint32_t row) const { return pfIds[row]; }
+    const double* lanes(uint32_t row) const { return values.data() + (size_t)row * scanScenarios; }
+    size_t truncatedArrays() const { return truncated; }
+
+private:
+    std::unordered_map<ContractKey, uint32_t, ContractKeyHash> index;
+    std::vector<int> pfIds;
+    std::vector<double> values;
+    size_t truncated = 0;
+};
+
+struct ScanPosition {
+    uint32_t row = 0;
+    double quantity = 0.0;
+};
+
+// Positions of one account, grouped by portfolio (sorted by pfId)
+struct ScanAccount {
+    std::string name;
+    std::vector<ScanPosition> positions;
+};
+
+struct ScanResult {
+    double scanRisk = 0.0;
+    int portfolios = 0;
+    int worstPfId = 0;          // portfolio with the largest scan risk, 0 if none
+};
+
+// CSV, one position per line: account,pfId,contractId,optContractId,quantity
+// ('#' comments and blank lines skipped). Positions in contracts the model
+// does not know are skipped and counted in unmatched.
+bool readPositions(const std::string& path, const ScanRiskModel& model, std::vector<ScanAccount>& accounts, size_t& unmatched);
+
+// Deterministic accounts of positionsPerAccount random contracts, for benchmarks
+void makeSyntheticAccounts(const ScanRiskModel& model, size_t count, int positionsPerAccount, uint64_t seed,
+    std::vector<ScanAccount>& accounts);
+
+// Whether the AVX2 kernel is compiled in and the CPU and OS support it
+bool scanRiskAvx2Available();
+
+// Scan risk of every account on threads workers (<= 1 inline). simd picks the
+// AVX2 kernel when available; both kernels give bit-identical results.
+void computeScanRisk(const ScanRiskModel& model, const std::vector<ScanAccount>& accounts, int threads, bool simd,
+    std::vector<ScanResult>& results);
+
+// account,positions,portfolios,scanRisk,worstPfId
+bool writeScanResults(const std::string& path, const std::vector<ScanAccount>& accounts, const std::vector<ScanResult>& results);
+
+// Accounts per second, scalar and AVX2, at 1, 2, 4 ... maxThreads threads
+void benchScanRisk(const ScanRiskModel& model, const std::vector<ScanAccount>& accounts, int maxThreads);
+
+#endif // SCAN_RISK_H
@@ -0,0 +1,62 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "section-inserter.h"
+#include "param-rows.h"
+
+namespace {
+
+const char* spreadKindName(SpreadKind kind) {
+    return kind == SpreadKind::Inter ? "inter" : "intra";
+}
+
+const ParamSpec conversionParams[] = { { ParamKind::Text, 10 }, { ParamKind::Text, 10 }, { ParamKind::Double, 0 } };
+const ParamSpec commodityParams[] = {
+    { ParamKind::Text, 10 }, { ParamKind::Text, 40 }, { ParamKind::Text, 10 }, { ParamKind::Int, 0 }, { ParamKind::Text, 10 } };
+const ParamSpec linkParams[] = {
+    { ParamKind::Text, 10 }, { ParamKind::Int, 0 }, { ParamKind::Text, 20 }, { ParamKind::Text, 10 }, { ParamKind::Double, 0 } };
+const ParamSpec spreadParams[] = {
+    { ParamKind::Text, 5 }, { ParamKind::Text, 10 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 }, { ParamKind::Double, 0 } };
+const ParamSpec legParams[] = {
+    { ParamKind::Text, 5 }, { ParamKind::Text, 10 }, { ParamKind::Int, 0 }, { ParamKind::Text, 10 }, { ParamKind::Int, 0 },
+    { ParamKind::Text, 10 }, { ParamKind::Text, 1 }, { ParamKind::Double, 0 } };
+
+}
+
+bool SectionInserter::write(const SpanSections& sections) {
+    if (hDbc == SQL_NULL_HANDLE)
+        return false;
+
+    return insertTable(hDbc, L"SpanCurrencyConversions", L"FromCur, ToCur, Factor", conversionParams, sections.conversions,
+            [](ParamRows& rows, size_t r, const CurrencyConversion& c) {
+                rows.real(r, 2, c.factor);
+                return rows.text(r, 0, c.fromCur) && rows.text(r, 1, c.toCur);
+            }, counters) &&
+        insertTable(hDbc, L"SpanCombinedCommodities", L"CcCode, Name, Currency, RiskExponent, MarginMeth", commodityParams, sections.commodities,
+            [](ParamRows& rows, size_t r, const CombinedCommodity& c) {
+                rows.integer(r, 3, c.riskExponent);
+                return rows.text(r, 0, c.ccCode) && rows.text(r, 1, c.name) && rows.text(r, 2, c.currency) && rows.text(r, 4, c.marginMeth);
+            }, counters) &&
+        insertTable(hDbc, L"SpanCommodityLinks", L"CcCode, PfId, PfCode, PfType, Sc", linkParams, sections.links,
+            [](ParamRows& rows, size_t r, const CommodityLink& l) {
+                rows.integer(r, 1, l.pfId);
+                rows.real(r, 4, l.sc);
+                return rows.text(r, 0, l.ccCode) && rows.text(r, 2, l.pfCode) && rows.text(r, 3, l.pfType);
+            }, counters) &&
+        insertTable(hDbc, L"SpanSpreads", L"SpreadKind, CcCode, Spread, ChargeMeth, Rate", spreadParams, sections.spreads,
+            [](ParamRows& rows, size_t r, const SpreadDef& s) {
+                rows.integer(r, 2, s.spread);
+                rows.integer(r, 3, s.chargeMeth);
+                rows.real(r, 4, s.rate);
+                return rows.text(r, 0, spreadKindName(s.kind)) && rows.text(r, 1, s.ccCode);
+            }, counters) &&
+        insertTable(hDbc, L"SpanSpreadLegs", L"SpreadKind, SpreadCc, Spread, CcCode, Tier, Expiry, Side, Ratio", legParams, sections.legs,
+            [](ParamRows& rows, size_t r, const SpreadLeg& l) {
+                rows.integer(r, 2, l.spread);
+                rows.integer(r, 4, l.tier);
+                rows.real(r, 7, l.ratio);
+                return rows.text(r, 0, spreadKindName(l.kind)) && rows.text(r, 1, l.spreadCc) && rows.text(r, 3, l.ccCode) &&
+                    rows.text(r, 5, l.expiry) && rows.text(r, 6, l.side);
+            }, counters);
+}
+
+#endif // SPAN_WITH_ODBC
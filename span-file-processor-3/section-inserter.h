@@ -0,0 +1,42 @@
+#pragma once
+#ifndef SECTION_INSERTER_H
+#define SECTION_INSERTER_H
+
+#include "span-sections.h"
+#include "record-sink.h"
+#include <windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+
+// Tables the section records go to (created by the DBA like SpanRecords6):
+//   SpanCurrencyConversions (FromCur NVARCHAR(10), ToCur NVARCHAR(10), Factor FLOAT)
+//   SpanCombinedCommodities (CcCode NVARCHAR(10), Name NVARCHAR(40), Currency NVARCHAR(10), RiskExponent INT, MarginMeth NVARCHAR(10))
+//   SpanCommodityLinks (CcCode NVARCHAR(10), PfId INT, PfCode NVARCHAR(20), PfType NVARCHAR(10), Sc FLOAT)
+//   SpanSpreads (SpreadKind NVARCHAR(5), CcCode NVARCHAR(10), Spread INT, ChargeMeth INT, Rate FLOAT)
+//   SpanSpreadLegs (SpreadKind NVARCHAR(5), SpreadCc NVARCHAR(10), Spread INT, CcCode NVARCHAR(10), Tier INT,
+//                   Expiry NVARCHAR(10), Side NVARCHAR(1), Ratio FLOAT)
+// SpreadKind is 'intra' or 'inter'.
+//
+// Sections are small next to the portfolios, so each write sends every table's
+// new rows as one row-wise parameter array: one SQLExecDirect per table.
+class SectionInserter {
+public:
+    void open(SQLHDBC dbc) {
+        hDbc = dbc;
+        counters = InsertStats();
+    }
+
+    // false on a statement-level failure; records with a value too long for
+    // their column are logged and counted as rejected
+    bool write(const SpanSections& sections);
+
+    const InsertStats& stats() const { return counters; }
+    void resetStats() { counters = InsertStats(); }
+
+private:
+    SQLHDBC hDbc = SQL_NULL_HANDLE;
+    InsertStats counters;
+};
+
+#endif // SECTION_INSERTER_H
@@ -0,0 +1,386 @@
+#include "self-test.h"
+#include "risk-codec.h"
+#include "span-schema.h"
+#include "compressed-input.h"
+#include "logger.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <string>
+#include <vector>
+
+extern Logger logger;
+
+namespace {
+
+class SelfTest {
+public:
+    void check(bool ok, const std::string& what) {
+        std::cout << (ok ? "ok    " : "FAIL  ") << what << "\n";
+        if (ok) {
+            ++passed;
+        }
+        else {
+            ++failed;
+            logger.log("self-test failed: " + what, LogLevel::ERRORS);
+        }
+    }
+
+    bool finish() const {
+        std::string total = std::to_string(passed) + " passed, " + std::to_string(failed) + " failed";
+        std::cout << "self-test: " << total << "\n";
+        logger.log("self-test: " + total, failed ? LogLevel::ERRORS : LogLevel::INFO);
+        return failed == 0;
+    }
+
+private:
+    int passed = 0;
+    int failed = 0;
+};
+
+bool sameBits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Text keeps every value but not a NaN's payload
+bool sameValue(double a, double b) {
+    return (std::isnan(a) && std::isnan(b)) || sameBits(a, b);
+}
+
+bool sameArray(const RiskArray& decoded, int r, const std::vector<double>& a, double d, bool exactNaN) {
+    if (decoded.r != r || decoded.a.size() != a.size())
+        return false;
+    auto same = exactNaN ? sameBits : sameValue;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!same(decoded.a[i], a[i]))
+            return false;
+    }
+    return same(decoded.d, d);
+}
+
+void riskCodecRoundTrips(SelfTest& t) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const std::vector<double> values = { 0.0, -0.0, 1.5, -2.25, 0.1, 1e-300, -5e-324, 1.7976931348623157e308, inf, -inf,
+        std::numeric_limits<double>::quiet_NaN(), -std::numeric_limits<double>::quiet_NaN(), 123456.789 };
+    struct Case {
+        const char* name;
+        int r;
+        std::vector<double> a;
+        double d;
+    };
+    const Case cases[] = {
+        { "special values", -7, values, -0.0 },
+        { "empty array", 0, {}, std::numeric_limits<double>::quiet_NaN() },
+        { "one value", 2147483647, { -0.0 }, inf },
+    };
+
+    for (const Case& c : cases) {
+        const std::vector<double>& a = c.a;
+        std::string bytes;
+        appendRiskArrayBinary(c.r, a.data(), a.size(), c.d, bytes);
+        RiskArray decoded;
+        t.check(bytes.size() == riskBinaryHeaderSize + 8 * a.size() && decodeRiskArrayBinary(bytes, decoded) &&
+            sameArray(decoded, c.r, a, c.d, true), std::string("risk binary round trip, ") + c.name);
+        decoded = RiskArray();
+        t.check(decodeRiskArray(bytes, decoded) && sameArray(decoded, c.r, a, c.d, true),
+            std::string("risk binary detected by decodeRiskArray, ") + c.name);
+
+        std::string text;
+        appendRiskArrayLossless(c.r, a.data(), a.size(), c.d, text);
+        decoded = RiskArray();
+        t.check(decodeRiskArrayLossless(text, decoded) && sameArray(decoded, c.r, a, c.d, false),
+            std::string("risk text round trip, ") + c.name + " (" + text.substr(0, 40) + (text.size() > 40 ? "..." : "") + ")");
+        decoded = RiskArray();
+        t.check(decodeRiskArray(text, decoded) && sameArray(decoded, c.r, a, c.d, false),
+            std::string("risk text detected by decodeRiskArray, ") + c.name);
+    }
+}
+
+void riskCodecRejects(SelfTest& t) {
+    const double a[] = { 1.5, -0.0, 2.0 };
+    std::string bytes;
+    appendRiskArrayBinary(3, a, 3, 0.25, bytes);
+    RiskArray decoded;
+
+    bool prefixes = true;
+    for (size_t n = 0; n < bytes.size(); ++n)
+        prefixes = prefixes && !decodeRiskArrayBinary(std::string_view(bytes.data(), n), decoded);
+    t.check(prefixes, "risk binary: every truncation rejected");
+    t.check(!decodeRiskArrayBinary(bytes + '\0', decoded), "risk binary: trailing byte rejected");
+
+    std::string corrupt = bytes;
+    corrupt[1] = 'B';
+    t.check(!decodeRiskArrayBinary(corrupt, decoded), "risk binary: bad magic rejected");
+    corrupt = bytes;
+    corrupt[2] = (char)(riskBinaryVersion + 1);
+    t.check(!decodeRiskArrayBinary(corrupt, decoded), "risk binary: unknown version rejected");
+    corrupt = bytes;
+    corrupt[8] = 4;                     // count says 4 values, 3 follow
+    t.check(!decodeRiskArrayBinary(corrupt, decoded), "risk binary: count larger than the value rejected");
+    corrupt[8] = (char)0xff;
+    corrupt[11] = (char)0xff;           // count near 2^32
+    t.check(!decodeRiskArrayBinary(corrupt, decoded), "risk binary: huge count rejected");
+
+    const char* const badText[] = { "", "3", "3;", "3;1.5", "3;1.5,", "3;1.5,2", "3;1.5,2;", "3;1.5,x;0", "x;1.5;0",
+        "3;1.5;0;", "3;1.5;0x", "3;1.5,,2;0", "3;;", "3,1.5;0", "99999999999;1;0" };
+    for (const char* text : badText) {
+        decoded = RiskArray();
+        t.check(!decodeRiskArrayLossless(text, decoded), std::string("risk text: '") + text + "' rejected");
+    }
+
+    std::string legacy;
+    appendRiskArray(RiskEncoding::Legacy, 3, a, 3, 0.25, legacy);
+    t.check(!decodeRiskArray(legacy, decoded), "risk text: legacy value '" + legacy + "' rejected");
+}
+
+// Text of sampleGzip: 40 <futPf> blocks in a SPAN file
+std::string sampleSpanText() {
+    std::string text = "<spanFile><pointInTime><date>20240105</date><clearingOrg><ec>CME</ec><exchange><exch>CME</exch>\n";
+    for (int i = 0; i < 40; ++i)
+        text += "<futPf><pfId>" + std::to_string(i) + "</pfId><pfCode>F" + std::to_string(i % 7) + "</pfCode><fut><cId>" +
+            std::to_string(1000 + i) + "</cId><pe>202403</pe><p>" + std::to_string(4850 + i) + ".25</p></fut></futPf>\n";
+    return text + "</exchange></clearingOrg></pointInTime></spanFile>\n";
+}
+
+// sampleSpanText() as zlib writes it at level 9: one gzip member, one block
+// with dynamic Huffman codes
+const unsigned char sampleGzip[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0x8d, 0x98, 0xcd, 0x4a, 0xc3, 0x40,
+    0x14, 0x46, 0xf7, 0x3e, 0x8c, 0x33, 0xf7, 0xde, 0xf9, 0x0b, 0x0c, 0xd9, 0x88, 0x82, 0x0b, 0xd1,
+    0x85, 0x2f, 0x50, 0xda, 0xb4, 0x16, 0x34, 0x16, 0xad, 0xe0, 0xe3, 0x3b, 0x8d, 0xa2, 0x34, 0xc4,
+    0x8f, 0x6f, 0x95, 0xc9, 0x64, 0x9a, 0x33, 0x8b, 0xd3, 0x43, 0x3b, 0xf5, 0xfd, 0xb0, 0x1a, 0x6f,
+    0xf6, 0xcf, 0x43, 0x5f, 0x0f, 0xaf, 0xfb, 0xf1, 0x78, 0x3b, 0x3e, 0xee, 0x5f, 0xda, 0xcd, 0x66,
+    0x75, 0x1c, 0x7a, 0xf5, 0x1a, 0xbc, 0xf8, 0x58, 0xdd, 0x74, 0x5b, 0xd7, 0xcf, 0xc3, 0xea, 0x6d,
+    0x3f, 0xee, 0xee, 0xdf, 0x76, 0x7d, 0x1d, 0xd6, 0xfd, 0xd5, 0xdd, 0x75, 0x75, 0xed, 0x5a, 0x87,
+    0xcf, 0xf5, 0xd3, 0x6a, 0xdc, 0x0d, 0xdf, 0xa3, 0x9f, 0xf9, 0xd3, 0xe8, 0xa2, 0x6e, 0x3f, 0x8e,
+    0x0f, 0xdb, 0xf6, 0xf2, 0xed, 0xed, 0xa6, 0xf7, 0xd5, 0x4d, 0xd7, 0x76, 0x77, 0xf5, 0xba, 0x19,
+    0xfa, 0x9b, 0x69, 0x62, 0x1a, 0x9e, 0xd6, 0x35, 0x40, 0x7b, 0x28, 0xde, 0xb7, 0xe9, 0xf5, 0xb4,
+    0xec, 0x67, 0x0b, 0xd6, 0x96, 0x9d, 0x36, 0xd8, 0x87, 0x12, 0xfd, 0xa5, 0xb6, 0xfd, 0x1c, 0xfa,
+    0xea, 0xa6, 0x4f, 0xb8, 0xef, 0xf7, 0x9f, 0x73, 0x64, 0xce, 0x91, 0x65, 0x8e, 0x00, 0x8e, 0x10,
+    0x1c, 0x9d, 0x73, 0x74, 0x99, 0xa3, 0x80, 0xa3, 0x04, 0xc7, 0xe6, 0x1c, 0x5b, 0xe6, 0x18, 0xe0,
+    0x18, 0xc1, 0x09, 0x73, 0x4e, 0x58, 0xe6, 0x04, 0xc0, 0x09, 0x04, 0x27, 0xce, 0x39, 0x71, 0x99,
+    0x13, 0x01, 0x27, 0x12, 0x9c, 0x34, 0xe7, 0xa4, 0x65, 0x4e, 0x02, 0x9c, 0x44, 0x70, 0x32, 0xe9,
+    0x75, 0x06, 0x9c, 0x4c, 0x70, 0x0a, 0xe9, 0x75, 0x01, 0x9c, 0x42, 0x70, 0x3a, 0xd2, 0xeb, 0x0e,
+    0x70, 0x3a, 0xe6, 0x7b, 0xea, 0x39, 0xb1, 0x05, 0x04, 0x21, 0x51, 0x41, 0x10, 0xce, 0x6c, 0x01,
+    0x45, 0x48, 0x4c, 0x11, 0x44, 0x39, 0xb5, 0x05, 0x24, 0x21, 0x31, 0x49, 0x10, 0xe3, 0xdc, 0x16,
+    0xd0, 0x84, 0xc4, 0x34, 0x41, 0x02, 0x27, 0xb7, 0x80, 0x28, 0x24, 0x26, 0x0a, 0x12, 0x39, 0xbb,
+    0x05, 0x54, 0x21, 0x31, 0x55, 0x90, 0xc4, 0xe9, 0x2d, 0x20, 0x0b, 0x89, 0xc9, 0x82, 0x64, 0x52,
+    0x6f, 0xd0, 0x85, 0xc4, 0x74, 0x41, 0x0a, 0xa9, 0x37, 0x08, 0x43, 0x62, 0xc2, 0x20, 0x1d, 0xa9,
+    0x37, 0x28, 0x43, 0x62, 0xca, 0xa0, 0x9e, 0xd3, 0x5b, 0x41, 0x19, 0x32, 0x53, 0x06, 0x15, 0x4e,
+    0x6f, 0x05, 0x65, 0xc8, 0xd4, 0x6f, 0x05, 0xe5, 0xf4, 0x56, 0x50, 0x86, 0xcc, 0x94, 0x41, 0x8d,
+    0xd3, 0x5b, 0x41, 0x19, 0x32, 0x53, 0x06, 0x0d, 0x9c, 0xde, 0x0a, 0xca, 0x90, 0x99, 0x32, 0x68,
+    0xe4, 0xf4, 0x56, 0x50, 0x86, 0xcc, 0x94, 0x41, 0x13, 0xa7, 0xb7, 0x82, 0x32, 0x64, 0xa6, 0x0c,
+    0x9a, 0x49, 0xbd, 0x41, 0x19, 0x32, 0x53, 0x06, 0x2d, 0xa4, 0xde, 0xa0, 0x0c, 0x99, 0x29, 0x83,
+    0x76, 0xa4, 0xde, 0xa0, 0x0c, 0x99, 0x29, 0x83, 0x79, 0x4e, 0x6f, 0x03, 0x65, 0x28, 0x4c, 0x19,
+    0x4c, 0x38, 0xbd, 0x0d, 0x94, 0xa1, 0x30, 0x65, 0x30, 0xe5, 0xf4, 0x36, 0x50, 0x86, 0x42, 0xfd,
+    0x8d, 0x30, 0x4e, 0x6f, 0x03, 0x65, 0x28, 0x4c, 0x19, 0x2c, 0x70, 0x7a, 0x1b, 0x28, 0x43, 0x61,
+    0xca, 0x60, 0x91, 0xd3, 0xdb, 0x40, 0x19, 0x0a, 0x53, 0x06, 0x4b, 0x9c, 0xde, 0x06, 0xca, 0x50,
+    0x98, 0x32, 0x58, 0x26, 0xf5, 0x06, 0x65, 0x28, 0x4c, 0x19, 0xac, 0x90, 0x7a, 0x83, 0x32, 0x14,
+    0xa6, 0x0c, 0xd6, 0x91, 0x7a, 0x83, 0x32, 0x94, 0xff, 0xca, 0xe0, 0xfe, 0x4e, 0x1e, 0xdc, 0xd9,
+    0xe9, 0x84, 0x3b, 0x3b, 0xcd, 0x70, 0xbf, 0xa7, 0x1c, 0x17, 0x5f, 0x09, 0xe7, 0x67, 0x79, 0xf1,
+    0x10, 0x00, 0x00,
+};
+
+void putLe16(std::string& out, uint32_t v) {
+    out += (char)(v & 0xff);
+    out += (char)((v >> 8) & 0xff);
+}
+
+void putLe32(std::string& out, uint32_t v) {
+    putLe16(out, v & 0xffff);
+    putLe16(out, v >> 16);
+}
+
+// One final stored deflate block; text up to 64 KB
+std::string storedDeflate(const std::string& text) {
+    std::string out(1, '\x01');
+    putLe16(out, (uint32_t)text.size());
+    putLe16(out, (uint32_t)~text.size() & 0xffff);
+    return out + text;
+}
+
+// A gzip member; with a name the header carries FNAME
+std::string gzipMember(const std::string& deflated, const std::string& text, const std::string& name = std::string()) {
+    std::string out = { '\x1f', '\x8b', '\x08', name.empty() ? '\0' : '\x08', '\0', '\0', '\0', '\0', '\0', '\xff' };
+    if (!name.empty())
+        out.append(name.c_str(), name.size() + 1);
+    out += deflated;
+    putLe32(out, crc32Update(0, text.data(), text.size()));
+    putLe32(out, (uint32_t)text.size());
+    return out;
+}
+
+struct ZipEntry {
+    std::string name;
+    std::string data;           // as stored in the archive
+    std::string text;           // after decompression
+    uint16_t method = 0;        // 0 stored, 8 deflated
+    uint16_t flags = 0;
+};
+
+// A zip archive with the entries in order, central directory and end record
+std::string zipArchive(const std::vector<ZipEntry>& entries) {
+    std::string out, directory;
+    for (const ZipEntry& e : entries) {
+        const uint32_t crc = crc32Update(0, e.text.data(), e.text.size());
+        const uint32_t local = (uint32_t)out.size();
+        std::string fields;         // version, flags, method, time, date, crc and sizes
+        putLe16(fields, 20);
+        putLe16(fields, e.flags);
+        putLe16(fields, e.method);
+        putLe32(fields, 0);
+        putLe32(fields, crc);
+        putLe32(fields, (uint32_t)e.data.size());
+        putLe32(fields, (uint32_t)e.text.size());
+        putLe16(fields, (uint32_t)e.name.size());
+
+        putLe32(out, 0x04034b50);
+        out += fields;
+        putLe16(out, 0);            // extra
+        out += e.name + e.data;
+
+        putLe32(directory, 0x02014b50);
+        putLe16(directory, 20);     // made by
+        directory += fields;
+        putLe16(directory, 0);      // extra
+        putLe16(directory, 0);      // comment
+        putLe32(directory, 0);      // disk, internal attributes
+        putLe32(directory, 0);      // external attributes
+        putLe32(directory, local);
+        directory += e.name;
+    }
+    const uint32_t dirOffset = (uint32_t)out.size();
+    out += directory;
+    putLe32(out, 0x06054b50);
+    putLe32(out, 0);                // disk numbers
+    putLe16(out, (uint32_t)entries.size());
+    putLe16(out, (uint32_t)entries.size());
+    putLe32(out, (uint32_t)directory.size());
+    putLe32(out, dirOffset);
+    putLe16(out, 0);                // comment
+    return out;
+}
+
+bool decompress(std::string_view data, InputFormat format, std::string& text, std::string& error, size_t chunkSize = 64) {
+    text.clear();
+    return decompressSpan(data, format, chunkSize, [&text](const char* p, size_t n) {
+        text.append(p, n);
+        return true;
+    }, error);
+}
+
+// Every strict prefix of data fails with an error
+bool truncationsRejected(const std::string& data, InputFormat format) {
+    std::string text, error;
+    for (size_t n = 0; n < data.size(); ++n) {
+        if (decompress(std::string_view(data.data(), n), format, text, error) || error.empty())
+            return false;
+    }
+    return true;
+}
+
+void compressedInput(SelfTest& t) {
+    const std::string text = sampleSpanText();
+    const std::string gzip((const char*)sampleGzip, sizeof(sampleGzip));
+    const std::string deflated = gzip.substr(10, gzip.size() - 18);
+    const std::string stored = gzipMember(storedDeflate(text), text, "sample.spn");
+    std::string out, error;
+    // Fails with an error that mentions expected
+    auto rejected = [&t](const std::string& data, InputFormat format, const char* expected, const std::string& what) {
+        std::string text, error;
+        bool ok = !decompress(data, format, text, error) && error.find(expected) != std::string::npos;
+        t.check(ok, what + " (" + error + ")");
+    };
+
+    t.check(detectInputFormat(gzip) == InputFormat::Gzip && detectInputFormat(text) == InputFormat::Plain &&
+        detectInputFormat(zipArchive({ { "a.spn", text, text } })) == InputFormat::Zip, "input format detected by magic");
+    t.check(decompress(gzip, InputFormat::Gzip, out, error, 64) && out == text, "gzip: dynamic Huffman member, 64-byte chunks");
+    t.check(decompress(gzip, InputFormat::Gzip, out, error, 1 << 20) && out == text, "gzip: dynamic Huffman member, one chunk");
+    t.check(decompress(stored, InputFormat::Gzip, out, error) && out == text, "gzip: stored member with a file name");
+    t.check(decompress(gzip + stored + std::string(16, '\0'), InputFormat::Gzip, out, error) && out == text + text,
+        "gzip: two members and zero padding");
+
+    t.check(truncationsRejected(gzip, InputFormat::Gzip), "gzip: every truncation rejected");
+    t.check(truncationsRejected(stored.substr(0, 40), InputFormat::Gzip), "gzip: every truncated header rejected");
+    std::string corrupt = gzip;
+    corrupt[gzip.size() - 8] ^= 1;
+    rejected(corrupt, InputFormat::Gzip, "CRC", "gzip: CRC mismatch rejected");
+    corrupt = gzip;
+    corrupt[gzip.size() - 1] ^= 1;
+    rejected(corrupt, InputFormat::Gzip, "length", "gzip: length mismatch rejected");
+    corrupt = stored;
+    corrupt[stored.size() - 100] ^= 0x20;
+    rejected(corrupt, InputFormat::Gzip, "CRC", "gzip: changed stored byte rejected");
+    corrupt = gzip;
+    corrupt[200] ^= 0x10;
+    rejected(corrupt, InputFormat::Gzip, "", "gzip: changed Huffman-coded byte rejected");
+    corrupt = gzip;
+    corrupt[2] = 7;
+    rejected(corrupt, InputFormat::Gzip, "method", "gzip: unknown method rejected");
+
+    const ZipEntry storedEntry = { "stored.spn", text, text, 0, 0 };
+    const ZipEntry deflatedEntry = { "deflated.spn", deflated, text, 8, 0 };
+    const std::string zip = zipArchive({ storedEntry, deflatedEntry });
+    t.check(decompress(zip, InputFormat::Zip, out, error) && out == text + text, "zip: stored and deflated entries in order");
+    t.check(truncationsRejected(zip, InputFormat::Zip), "zip: every truncation rejected");
+    corrupt = zip;
+    corrupt[zip.rfind("deflated.spn") - 30] ^= 1;     // CRC in its central directory entry
+    rejected(corrupt, InputFormat::Zip, "CRC", "zip: CRC mismatch rejected");
+    corrupt = zip;
+    corrupt[100] ^= 0x20;
+    rejected(corrupt, InputFormat::Zip, "CRC", "zip: changed stored byte rejected");
+    ZipEntry entry = storedEntry;
+    entry.method = 99;
+    rejected(zipArchive({ entry }), InputFormat::Zip, "method", "zip: unknown method rejected");
+    entry = storedEntry;
+    entry.flags = 1;
+    rejected(zipArchive({ entry }), InputFormat::Zip, "encrypted", "zip: encrypted entry rejected");
+}
+
+// The reader cuts whole blocks out of 64-byte chunks and reports a bad archive
+void compressedBlocks(SelfTest& t) {
+    const std::string text = sampleSpanText();
+    const std::string gzip((const char*)sampleGzip, sizeof(sampleGzip));
+    std::string_view block;
+    std::shared_ptr<const std::string> owner;
+    size_t endOffset = 0, lastEnd = 0;
+    int blocks = 0;
+    bool whole = true;
+    {
+        CompressedBlockReader reader(gzip, InputFormat::Gzip, 64, 2);
+        while (reader.next(block, owner, endOffset)) {
+            ++blocks;
+            lastEnd = endOffset;
+            whole = whole && block.substr(0, 7) == "<futPf>" && block.size() > 8 && block.substr(block.size() - 8) == "</futPf>" &&
+                text.compare(endOffset - block.size(), block.size(), block) == 0;
+        }
+        reader.close();
+        t.check(!reader.failed() && blocks == 40 && whole && lastEnd == text.rfind("</futPf>") + 8,
+            "compressed reader: 40 blocks at their offsets (" + std::to_string(blocks) + " read)");
+    }
+
+    std::string corrupt = gzip;
+    corrupt[gzip.size() - 8] ^= 1;
+    const std::pair<const char*, std::string> bad[] = { { "CRC mismatch", corrupt }, { "truncated archive", gzip.substr(0, gzip.size() / 2) } };
+    for (const auto& b : bad) {
+        CompressedBlockReader reader(b.second, InputFormat::Gzip, 64, 2);
+        while (reader.next(block, owner, endOffset))
+            ;
+        reader.close();
+        t.check(reader.failed(), std::string("compressed reader: ") + b.first + " reported (" + reader.error() + ")");
+    }
+}
+
+} // namespace
+
+bool runSelfTest() {
+    SelfTest t;
+    riskCodecRoundTrips(t);
+    riskCodecRejects(t);
+    compressedInput(t);
+    compressedBlocks(t);
+    return t.finish();
+}
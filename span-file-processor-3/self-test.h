@@ -0,0 +1,13 @@
+#pragma once
+#ifndef SELF_TEST_H
+#define SELF_TEST_H
+
+// Checks that need neither a database nor an input file: binary and lossless
+// text risk arrays decode to the bits that were encoded, -0, NaN and the
+// infinities included; gzip and zip archives built in memory decompress and
+// are cut into blocks; truncated or corrupt values and archives (bad CRC,
+// length, header) are rejected. Prints a line per check and a total; false if
+// any check failed. Run by --self-test.
+bool runSelfTest();
+
+#endif // SELF_TEST_H
@@ -0,0 +1,205 @@
+#include "span-diff.h"
+#include "cpu-features.h"
+#include "logger.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+extern Logger logger;
+
+using RiskCompare = bool (*)(const double*, const double*, size_t, double, double, double&);
+
+static bool differs(double a, double b, double absTol, double relTol) {
+    return !(std::fabs(a - b) <= absTol + relTol * std::fabs(b));
+}
+
+// Whether any point differs; maxDelta is the largest |a[i] - b[i]|
+static bool riskDiffScalar(const double* a, const double* b, size_t n, double absTol, double relTol, double& maxDelta) {
+    bool changed = false;
+    maxDelta = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double d = std::fabs(a[i] - b[i]);
+        changed |= !(d <= absTol + relTol * std::fabs(b[i]));
+        maxDelta = d > maxDelta ? d : maxDelta;
+    }
+    return changed;
+}
+
+#if SPAN_HAVE_X86
+// Same test four points at a time; the compare is "not less or equal,
+// unordered", so a NaN differs as in the scalar kernel
+SPAN_TARGET_AVX2 static bool riskDiffAvx2(const double* a, const double* b, size_t n, double absTol, double relTol, double& maxDelta) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d absv = _mm256_set1_pd(absTol);
+    const __m256d relv = _mm256_set1_pd(relTol);
+    __m256d exceeded = _mm256_setzero_pd();
+    __m256d mx = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d va = _mm256_loadu_pd(a + i);
+        __m256d vb = _mm256_loadu_pd(b + i);
+        __m256d d = _mm256_andnot_pd(sign, _mm256_sub_pd(va, vb));
+        __m256d limit = _mm256_add_pd(absv, _mm256_mul_pd(relv, _mm256_andnot_pd(sign, vb)));
+        exceeded = _mm256_or_pd(exceeded, _mm256_cmp_pd(d, limit, _CMP_NLE_UQ));
+        mx = _mm256_max_pd(d, mx);
+    }
+    __m128d h = _mm_max_pd(_mm256_castpd256_pd128(mx), _mm256_extractf128_pd(mx, 1));
+    h = _mm_max_sd(h, _mm_unpackhi_pd(h, h));
+    double tailMax = 0.0;
+    bool changed = _mm256_movemask_pd(exceeded) != 0;
+    if (i < n)
+        changed |= riskDiffScalar(a + i, b + i, n - i, absTol, relTol, tailMax);
+    maxDelta = _mm_cvtsd_f64(h);
+    maxDelta = tailMax > maxDelta ? tailMax : maxDelta;
+    return changed;
+}
+#endif
+
+static unsigned changedFields(const SpanRecordStore& older, const CompactRecord& o, const SpanRecordStore& newer,
+    const CompactRecord& n, const DiffOptions& opts, RiskCompare riskCompare, double& maxRiskDelta) {
+    const double absTol = opts.absTolerance, relTol = opts.relTolerance;
+    unsigned fields = 0;
+    const size_t common = o.riskCount < n.riskCount ? o.riskCount : n.riskCount;
+    if (riskCompare(older.risk(o), newer.risk(n), common, absTol, relTol, maxRiskDelta) || o.riskCount != n.riskCount ||
+        o.riskR != n.riskR || differs(o.riskD, n.riskD, absTol, relTol))
+        fields |= DIFF_RISK;
+    if (differs(o.volatility, n.volatility, absTol, relTol))
+        fields |= DIFF_VOLATILITY;
+    if (differs(o.optionValue, n.optionValue, absTol, relTol))
+        fields |= DIFF_VALUE;
+    if (differs(o.price, n.price, absTol, relTol))
+        fields |= DIFF_PRICE;
+    if (differs(o.strikePrice, n.strikePrice, absTol, relTol))
+        fields |= DIFF_STRIKE;
+    if (differs(o.priceScan, n.priceScan, absTol, relTol) || differs(o.volScan, n.volScan, absTol, relTol))
+        fields |= DIFF_SCAN;
+    if (differs(o.intraRate, n.intraRate, absTol, relTol))
+        fields |= DIFF_RATE;
+    if (o.expiry.view() != n.expiry.view() || o.settleDate.view() != n.settleDate.view())
+        fields |= DIFF_DATES;
+    return fields;
+}
+
+void diffSpanStores(const SpanRecordStore& older, const SpanRecordStore& newer, const DiffOptions& opts,
+    std::vector<DiffEntry>& entries, DiffStats& stats) {
+    entries.clear();
+    stats = DiffStats();
+    stats.oldRecords = older.size();
+    stats.newRecords = newer.size();
+
+    RiskCompare riskCompare = riskDiffScalar;
+#if SPAN_HAVE_X86
+    if (opts.simd && cpuHasAvx2())
+        riskCompare = riskDiffAvx2;
+#endif
+
+    // state of each older record: a repeated key, the first of its key, or matched by a newer record
+    enum : char { REPEATED, UNMATCHED, MATCHED };
+    std::vector<char> state(older.size(), REPEATED);
+    std::unordered_map<ContractKey, uint32_t, ContractKeyHash> index;
+    index.reserve(older.size());
+    for (size_t i = 0; i < older.size(); ++i) {
+        const CompactRecord& rec = older.record(i);
+        if (index.emplace(ContractKey{ older.portfolio(rec.portfolio).pfId, rec.contractId, rec.optContractId }, (uint32_t)i).second)
+            state[i] = UNMATCHED;
+        else
+            ++stats.duplicates;
+    }
+
+    std::unordered_map<ContractKey, uint32_t, ContractKeyHash> seen;
+    for (size_t i = 0; i < newer.size(); ++i) {
+        const CompactRecord& rec = newer.record(i);
+        const ContractKey key{ newer.portfolio(rec.portfolio).pfId, rec.contractId, rec.optContractId };
+        auto it = index.find(key);
+        if (it == index.end()) {
+            // A key repeated within newer is added once
+            if (!seen.emplace(key, (uint32_t)i).second) {
+                ++stats.duplicates;
+                continue;
+            }
+            DiffEntry entry;
+            entry.change = DiffChange::Added;
+            entry.newRow = (uint32_t)i;
+            entries.push_back(entry);
+            ++stats.added;
+            continue;
+        }
+        if (state[it->second] == MATCHED) {
+            ++stats.duplicates;
+            continue;
+        }
+        state[it->second] = MATCHED;
+
+        DiffEntry entry;
+        entry.fields = changedFields(older, older.record(it->second), newer, rec, opts, riskCompare, entry.maxRiskDelta);
+        if (!entry.fields) {
+            ++stats.unchanged;
+            continue;
+        }
+        entry.oldRow = it->second;
+        entry.newRow = (uint32_t)i;
+        entries.push_back(entry);
+        ++stats.changed;
+    }
+
+    for (size_t i = 0; i < older.size(); ++i) {
+        if (state[i] != UNMATCHED)
+            continue;
+        DiffEntry entry;
+        entry.change = DiffChange::Removed;
+        entry.oldRow = (uint32_t)i;
+        entries.push_back(entry);
+        ++stats.removed;
+    }
+}
+
+static std::string fieldNames(unsigned fields) {
+    static const std::pair<unsigned, const char*> names[] = { { DIFF_RISK, "risk" }, { DIFF_VOLATILITY, "volatility" },
+        { DIFF_VALUE, "value" }, { DIFF_STRIKE, "strike" }, { DIFF_SCAN, "scan" }, { DIFF_RATE, "rate" }, { DIFF_DATES, "dates" },
+        { DIFF_PRICE, "price" } };
+    std::string out;
+    for (const auto& n : names) {
+        if (fields & n.first)
+            out += (out.empty() ? "" : "|") + std::string(n.second);
+    }
+    return out;
+}
+
+bool writeSpanDiff(const std::string& path, const SpanRecordStore& older, const SpanRecordStore& newer,
+    const std::vector<DiffEntry>& entries) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        logger.log("Failed to create " + path, LogLevel::ERRORS);
+        return false;
+    }
+    out << "change,pfId,pfCode,contractId,optContractId,fields,maxRiskDelta,oldVolatility,newVolatility,oldValue,newValue,oldPrice,newPrice\n";
+    char buf[256];
+    for (const DiffEntry& entry : entries) {
+        const bool hasOld = entry.oldRow != UINT32_MAX, hasNew = entry.newRow != UINT32_MAX;
+        const SpanRecordStore& store = hasNew ? newer : older;
+        const CompactRecord& rec = store.record(hasNew ? entry.newRow : entry.oldRow);
+        const PortfolioHeader& pf = store.portfolio(rec.portfolio);
+        const char* change = entry.change == DiffChange::Added ? "added" : entry.change == DiffChange::Removed ? "removed" : "changed";
+        out << change << ',' << pf.pfId << ',' << pf.pfCode << ',' << rec.contractId << ',' << rec.optContractId << ','
+            << fieldNames(entry.fields) << ',';
+        if (hasOld && hasNew) {
+            const CompactRecord& o = older.record(entry.oldRow);
+            std::snprintf(buf, sizeof(buf), "%.10g,%.10g,%.10g,%.10g,%.10g,%.10g,%.10g", entry.maxRiskDelta, o.volatility,
+                rec.volatility, o.optionValue, rec.optionValue, o.price, rec.price);
+        }
+        else if (hasNew) {
+            std::snprintf(buf, sizeof(buf), ",,%.10g,,%.10g,,%.10g", rec.volatility, rec.optionValue, rec.price);
+        }
+        else {
+            std::snprintf(buf, sizeof(buf), ",%.10g,,%.10g,,%.10g,", rec.volatility, rec.optionValue, rec.price);
+        }
+        out << buf << '\n';
+    }
+    out.close();
+    if (!out) {
+        logger.log("Failed to write " + path, LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef SPAN_DIFF_H
+#define SPAN_DIFF_H
+
+#include "span-record-store.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Two values differ when |old - new| > absTolerance + relTolerance * |new|
+// (NaN against anything differs)
+struct DiffOptions {
+    double absTolerance = 1e-6;
+    double relTolerance = 0.0;
+    bool simd = true;           // AVX2 risk-array comparison where cpuHasAvx2()
+};
+
+// What moved in a changed contract
+enum DiffField : unsigned {
+    DIFF_RISK = 1,              // risk array values, length or d
+    DIFF_VOLATILITY = 2,
+    DIFF_VALUE = 4,             // option settlement value
+    DIFF_STRIKE = 8,
+    DIFF_SCAN = 16,             // price or volatility scan range
+    DIFF_RATE = 32,             // intra-commodity rate
+    DIFF_DATES = 64,            // expiry or settlement date
+    DIFF_PRICE = 128,           // settlement price <p>
+};
+
+enum class DiffChange { Changed, Added, Removed };
+
+struct DiffEntry {
+    DiffChange change = DiffChange::Changed;
+    uint32_t oldRow = UINT32_MAX;   // record in the older store, UINT32_MAX when added
+    uint32_t newRow = UINT32_MAX;   // record in the newer store, UINT32_MAX when removed
+    unsigned fields = 0;            // DiffField bits, Changed only
+    double maxRiskDelta = 0.0;      // largest |old - new| over the common risk points
+};
+
+struct DiffStats {
+    size_t oldRecords = 0;
+    size_t newRecords = 0;
+    size_t unchanged = 0;
+    size_t changed = 0;
+    size_t added = 0;
+    size_t removed = 0;
+    size_t duplicates = 0;          // repeated keys; the first record of a key is compared
+};
+
+// Joins newer against older on (pfId, contractId, optContractId) through a
+// hash index of older and lists the changed and added contracts in newer's
+// order, then the removed ones in older's order. Unchanged contracts are
+// only counted.
+void diffSpanStores(const SpanRecordStore& older, const SpanRecordStore& newer, const DiffOptions& opts,
+    std::vector<DiffEntry>& entries, DiffStats& stats);
+
+// CSV: change,pfId,pfCode,contractId,optContractId,fields,maxRiskDelta,
+// oldVolatility,newVolatility,oldValue,newValue,oldPrice,newPrice (old/new empty
+// where absent)
+bool writeSpanDiff(const std::string& path, const SpanRecordStore& older, const SpanRecordStore& newer,
+    const std::vector<DiffEntry>& entries);
+
+#endif // SPAN_DIFF_H
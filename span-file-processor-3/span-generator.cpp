@@ -0,0 +1,234 @@
+#include "span-generator.h"
+#include "logger.h"
+#include "risk-validation.h"
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+extern Logger logger;
+
+namespace {
+
+// splitmix64; the standard distributions are not portable across libraries
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    double uniform(double lo, double hi) {
+        return lo + (hi - lo) * (double)(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    int range(int lo, int hi) {
+        return lo + (int)(next() % (uint64_t)(hi - lo + 1));
+    }
+
+private:
+    uint64_t state;
+};
+
+void appendf(std::string& out, const char* fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = std::vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n > 0)
+        out.append(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+void appendRiskArray(std::string& out, Random& rng, int points, const char* indent) {
+    appendf(out, "%s<ra>\n%s  <r>1</r>\n", indent, indent);
+    for (int i = 0; i < points; ++i)
+        appendf(out, "%s  <a>%.6f</a>\n", indent, rng.uniform(-500, 500));
+    appendf(out, "%s  <d>%.4f</d>\n%s</ra>\n", indent, rng.uniform(0, 1), indent);
+}
+
+void appendRiskArray(std::string& out, Random& rng, const double* values, int points, const char* indent) {
+    appendf(out, "%s<ra>\n%s  <r>1</r>\n", indent, indent);
+    for (int i = 0; i < points; ++i)
+        appendf(out, "%s  <a>%.6f</a>\n", indent, values[i]);
+    appendf(out, "%s  <d>%.4f</d>\n%s</ra>\n", indent, rng.uniform(0, 1), indent);
+}
+
+// The value a parser reads back for v written with fmt
+double printed(const char* fmt, double v) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), fmt, v);
+    return std::strtod(buf, nullptr);
+}
+
+// A future's price, kept as printed for the options on it
+double drawPrice(Random& rng, std::vector<double>& prices) {
+    double price = rng.uniform(100, 900);
+    prices.push_back(printed("%.2f", price));
+    return price;
+}
+
+// A series on the future (futPfId, futCId) at price future: strikes from 80%
+// to 120% of it, and option prices and risk arrays from the values as printed
+void appendPricedSeries(std::string& out, Random& rng, const GeneratorOptions& opts, int month, int futPfId, int futCId,
+    double future, int& cId) {
+    const double volatility = printed("%.4f", rng.uniform(0.1, 0.5));
+    const double years = printed("%.4f", month / 12.0);
+    const int ratePercent = rng.range(1, 9);
+    const double rate = ratePercent / 100.0;
+    const double priceScan = printed("%.2f", future * rng.uniform(0.03, 0.12));
+    const double volScan = 0.04;
+    appendf(out, "  <series>\n    <pe>2025%02d28</pe>\n    <v>%.4f</v>\n    <setlDate>2025%02d28</setlDate>\n    <t>%.4f</t>\n"
+        "    <undC><pfId>%d</pfId><cId>%d</cId></undC>\n    <intrRate><val>0.0%d</val></intrRate>\n"
+        "    <scanRate><r>1</r><priceScan>%.2f</priceScan><volScan>0.04</volScan></scanRate>\n",
+        month, volatility, month, years, futPfId, futCId, ratePercent, priceScan);
+    ++cId;
+    double values[scanScenarios];
+    for (int o = 0; o < opts.optionsPerSeries; ++o, ++cId) {
+        const bool call = o % 2 == 0;
+        const double share = opts.optionsPerSeries > 1 ? (double)o / (opts.optionsPerSeries - 1) : 0.5;
+        const int strike = std::max(1, (int)std::lround(future * (0.8 + 0.4 * share)));
+        const double price = black76Price(call, future, strike, years, rate, volatility);
+        black76RiskArray(call, future, strike, years, rate, volatility, priceScan, volScan, values);
+        appendf(out, "    <opt>\n      <cId>%d</cId>\n      <o>%c</o>\n      <k>%d</k>\n      <p>%.2f</p>\n      <v>%.4f</v>\n"
+            "      <val>%.3f</val>\n", cId, call ? 'C' : 'P', strike, price, volatility, price);
+        appendRiskArray(out, rng, values, scanScenarios, "      ");
+        out += "    </opt>\n";
+    }
+    out += "  </series>\n";
+}
+
+// Contract sizes of priced portfolios, so that anything applying cvf to the
+// per-unit risk arrays twice (or not at all) shows
+const char* pricedCvf(int portfolio) {
+    static const char* const sizes[] = { "50", "25", "100", "0.5" };
+    return sizes[portfolio % 4];
+}
+
+}
+
+size_t generatedRecordCount(const GeneratorOptions& opts) {
+    size_t p = (size_t)opts.portfolios;
+    size_t s = (size_t)opts.seriesPerPortfolio;
+    return p + p * s + p * s * (size_t)opts.optionsPerSeries;
+}
+
+void generateSpanFile(const GeneratorOptions& opts, std::string& out) {
+    Random rng(opts.seed);
+    int pfId = 1;
+    int cId = 1000;
+
+    out.clear();
+    out.reserve(generatedRecordCount(opts) * (200 + 24 * (size_t)opts.riskPoints));
+    out += "<?xml version=\"1.0\"?>\n<spanFile>\n<definitions>\n"
+        "<currencyDef><currency>INR</currency><symbol>Rs</symbol></currencyDef>\n";
+
+    for (int p = 0; p < opts.portfolios; ++p, ++pfId, ++cId) {
+        appendf(out, "<phyPf>\n  <pfId>%d</pfId>\n  <pfCode>EQ%d</pfCode>\n  <name>Stock %d</name>\n  <currency>INR</currency>\n"
+            "  <cvf>1</cvf>\n  <priceDl>2</priceDl>\n  <valueMeth>EQTY</valueMeth>\n  <priceMeth>STD</priceMeth>\n  <setlMeth>CASH</setlMeth>\n",
+            pfId, p, p);
+        appendf(out, "  <phy>\n    <cId>%d</cId>\n    <pe>00000000</pe>\n    <p>%.2f</p>\n    <v>%.4f</v>\n"
+            "    <scanRate><r>1</r><priceScan>%.3f</priceScan><volScan>0.04</volScan></scanRate>\n",
+            cId, rng.uniform(10, 5000), rng.uniform(0.1, 0.9), rng.uniform(1, 100));
+        appendRiskArray(out, rng, opts.riskPoints, "    ");
+        out += "  </phy>\n</phyPf>\n";
+    }
+    out += "</definitions>\n<pointInTime>\n<clearingOrg>\n<ec>NSCCL</ec>\n";
+
+    // Priced options refer to these futures, futPf p's futures at p * seriesPerPortfolio
+    const int firstFutPfId = pfId;
+    const int firstFutCId = cId;
+    std::vector<double> futurePrices;
+    for (int p = 0; p < opts.portfolios; ++p, ++pfId) {
+        appendf(out, "<futPf>\n  <pfId>%d</pfId>\n  <pfCode>FUT%d</pfCode>\n  <currency>INR</currency>\n  <cvf>%s</cvf>\n"
+            "  <valueMeth>FUT</valueMeth>\n  <priceMeth>STD</priceMeth>\n  <setlMeth>FUT</setlMeth>\n", pfId, p,
+            opts.pricedOptions ? pricedCvf(p) : "1.0");
+        for (int f = 0; f < opts.seriesPerPortfolio; ++f, ++cId) {
+            int month = f % 12 + 1;
+            appendf(out, "  <fut>\n    <cId>%d</cId>\n    <pe>2025%02d28</pe>\n    <p>%.2f</p>\n    <v>%.5f</v>\n"
+                "    <setlDate>2025%02d28</setlDate>\n    <t>%.4f</t>\n    <intrRate><val>0.%d</val><rl>1</rl></intrRate>\n"
+                "    <scanRate><r>1</r><priceScan>%.2f</priceScan><volScan>0</volScan></scanRate>\n",
+                cId, month, drawPrice(rng, futurePrices), rng.uniform(0.1, 0.5), month, opts.pricedOptions ? month / 12.0 : 0.0822,
+                rng.range(1, 99), rng.uniform(10, 99));
+            appendRiskArray(out, rng, opts.riskPoints, "    ");
+            out += "  </fut>\n";
+        }
+        out += "</futPf>\n";
+    }
+
+    for (int p = 0; p < opts.portfolios; ++p, ++pfId) {
+        appendf(out, "<oofPf>\n  <pfId>%d</pfId>\n  <pfCode>OPT%d</pfCode>\n  <currency>INR</currency>\n  <cvf>%s</cvf>\n  <svf>1.5</svf>\n"
+            "  <valueMeth>PREM</valueMeth>\n  <priceMeth>STD</priceMeth>\n  <setlMeth>PREM</setlMeth>\n", pfId, p,
+            opts.pricedOptions ? pricedCvf(p) : "1");
+        for (int s = 0; s < opts.seriesPerPortfolio; ++s) {
+            int month = s % 12 + 1;
+            if (opts.pricedOptions) {
+                appendPricedSeries(out, rng, opts, month, firstFutPfId + p, firstFutCId + p * opts.seriesPerPortfolio + s,
+                    futurePrices[(size_t)p * opts.seriesPerPortfolio + s], cId);
+                continue;
+            }
+            appendf(out, "  <series>\n    <pe>2025%02d28</pe>\n    <v>%.4f</v>\n    <setlDate>2025%02d28</setlDate>\n"
+                "    <undC><pfId>%d</pfId><cId>%d</cId></undC>\n    <intrRate><val>0.0%d</val></intrRate>\n"
+                "    <scanRate><r>1</r><priceScan>%.2f</priceScan><volScan>0.04</volScan></scanRate>\n",
+                month, rng.uniform(0.1, 0.5), month, pfId, cId, rng.range(1, 9), rng.uniform(10, 99));
+            ++cId;
+            for (int o = 0; o < opts.optionsPerSeries; ++o, ++cId) {
+                appendf(out, "    <opt>\n      <cId>%d</cId>\n      <o>%c</o>\n      <k>%d</k>\n      <p>%.2f</p>\n      <v>0.2</v>\n"
+                    "      <val>%.3f</val>\n", cId, "CP"[o % 2], 100 + o * 10, rng.uniform(1, 50), rng.uniform(0, 50));
+                appendRiskArray(out, rng, opts.riskPoints, "      ");
+                out += "    </opt>\n";
+            }
+            out += "  </series>\n";
+        }
+        out += "</oofPf>\n";
+    }
+    // Sections: a currency conversion, one combined commodity per underlying
+    // (its stock, futures and options portfolios) with an intra-commodity
+    // spread between tiers, and inter-commodity spreads between neighbours
+    appendf(out, "<curConv>\n  <fromCur>USD</fromCur>\n  <toCur>INR</toCur>\n  <factor>%.4f</factor>\n</curConv>\n",
+        rng.uniform(80, 90));
+    for (int p = 0; p < opts.portfolios; ++p) {
+        appendf(out, "<ccDef>\n  <cc>CC%d</cc>\n  <name>Combined %d</name>\n  <currency>INR</currency>\n"
+            "  <riskExponent>0</riskExponent>\n  <marginMeth>SPAN</marginMeth>\n", p, p);
+        const char* types[] = { "PHY", "FUT", "OOF" };
+        const char* codes[] = { "EQ", "FUT", "OPT" };
+        for (int t = 0; t < 3; ++t)
+            appendf(out, "  <pfLink>\n    <exch>NSE</exch>\n    <pfId>%d</pfId>\n    <pfCode>%s%d</pfCode>\n"
+                "    <pfType>%s</pfType>\n    <sc>1</sc>\n  </pfLink>\n", 1 + t * opts.portfolios + p, codes[t], p, types[t]);
+        appendf(out, "  <intraTiers>\n    <tier><tn>1</tn></tier>\n    <tier><tn>2</tn></tier>\n  </intraTiers>\n"
+            "  <dSpread>\n    <spread>1</spread>\n    <chargeMeth>10</chargeMeth>\n"
+            "    <rate><r>1</r><val>%.2f</val></rate>\n"
+            "    <tLeg><cc>CC%d</cc><tn>1</tn><rs>A</rs><i>1</i></tLeg>\n"
+            "    <tLeg><cc>CC%d</cc><tn>2</tn><rs>B</rs><i>1</i></tLeg>\n  </dSpread>\n</ccDef>\n",
+            rng.uniform(100, 900), p, p);
+    }
+    out += "<interSpreads>\n";
+    for (int p = 0; p + 1 < opts.portfolios; ++p)
+        appendf(out, "  <dSpread>\n    <spread>%d</spread>\n    <chargeMeth>10</chargeMeth>\n"
+            "    <rate><r>1</r><val>%.2f</val></rate>\n"
+            "    <tLeg><cc>CC%d</cc><tn>0</tn><rs>A</rs><i>1</i></tLeg>\n"
+            "    <tLeg><cc>CC%d</cc><tn>0</tn><rs>B</rs><i>%.2f</i></tLeg>\n  </dSpread>\n",
+            p + 1, rng.uniform(0.3, 0.8), p, p + 1, rng.uniform(0.5, 2));
+    out += "</interSpreads>\n</clearingOrg>\n</pointInTime>\n</spanFile>\n";
+}
+
+bool writeSpanFile(const std::string& path, const GeneratorOptions& opts) {
+    std::string text;
+    generateSpanFile(opts, text);
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        logger.log("Failed to create " + path, LogLevel::ERRORS);
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok)
+        logger.log("Failed to write " + path, LogLevel::ERRORS);
+    else
+        logger.log("generated " + path + ": " + std::to_string(text.size()) + " bytes, " +
+            std::to_string(generatedRecordCount(opts)) + " records", LogLevel::INFO);
+    return ok;
+}
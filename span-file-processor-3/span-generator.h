@@ -0,0 +1,30 @@
+#pragma once
+#ifndef SPAN_GENERATOR_H
+#define SPAN_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+// Shape of a synthetic SPAN file. Each segment gets `portfolios` blocks:
+// phyPf with one <phy>, futPf with seriesPerPortfolio <fut>, oofPf with
+// seriesPerPortfolio <series> of optionsPerSeries <opt> each.
+struct GeneratorOptions {
+    int portfolios = 1000;
+    int seriesPerPortfolio = 3;
+    int optionsPerSeries = 10;
+    int riskPoints = 16;        // <a> values per <ra>
+    uint64_t seed = 1;
+    // Options on the futures of the matching futPf, with strikes around the
+    // future, times to expiry and 16-point risk arrays priced with Black-76,
+    // so --validate-risk finds them consistent
+    bool pricedOptions = false;
+};
+
+// Same options and seed give the same bytes on every platform
+void generateSpanFile(const GeneratorOptions& opts, std::string& out);
+bool writeSpanFile(const std::string& path, const GeneratorOptions& opts);
+
+// Records parseSpanXmlBlock produces for a generated file
+size_t generatedRecordCount(const GeneratorOptions& opts);
+
+#endif // SPAN_GENERATOR_H
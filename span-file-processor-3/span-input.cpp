@@ -0,0 +1,84 @@
+#include "span-input.h"
+#include "logger.h"
+#include "metrics.h"
+#include <chrono>
+
+extern Logger logger;
+
+bool SpanInput::open(const std::string& filePath) {
+    path = filePath;
+    if (!file.open(path))
+        return false;
+    inputFormat = detectInputFormat(file.view());
+    if (compressed())
+        logger.log(path + " is a " + inputFormatName(inputFormat) + " archive, decompressing in memory", LogLevel::INFO);
+    return true;
+}
+
+void SpanInput::logInflate(double seconds) const {
+    metrics.decompressNs.add((uint64_t)(seconds * 1e9));
+    double megaBytes = inflatedBytes / (1024.0 * 1024.0);
+    logger.log("decompressed " + std::to_string(megaBytes) + " MB from " + std::to_string(file.size() / (1024.0 * 1024.0)) +
+        " MB " + inputFormatName(inputFormat) + " in " + std::to_string(seconds) + " s (" +
+        std::to_string(seconds > 0 ? megaBytes / seconds : 0.0) + " MB/s decompressed)", LogLevel::INFO);
+}
+
+bool SpanInput::text(std::string_view& data) {
+    if (!compressed()) {
+        data = file.view();
+        return true;
+    }
+    if (!inflatedDone) {
+        auto start = std::chrono::steady_clock::now();
+        std::string error;
+        inflated.clear();
+        bool ok = decompressSpan(file.view(), inputFormat, 4 << 20, [this](const char* p, size_t n) {
+            inflated.append(p, n);
+            return true;
+        }, error);
+        if (!ok) {
+            logger.log("Failed to decompress " + path + ": " + error, LogLevel::ERRORS);
+            return false;
+        }
+        inflatedDone = true;
+        inflatedBytes = inflated.size();
+        logInflate(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    data = inflated;
+    return true;
+}
+
+bool SpanInput::stream(RecordSink& sink, PipelineOptions opts, PipelineStats& stats) {
+    if (!compressed()) {
+        opts.onConsumed = [this](size_t offset) { file.releaseBefore(offset); };
+        return runStreamingLoad(file.view(), sink, opts, stats);
+    }
+    if (inflatedDone) {
+        opts.onConsumed = nullptr;
+        return runStreamingLoad(inflated, sink, opts, stats);
+    }
+
+    // A few chunks in flight keep the inflate thread ahead of the parsers.
+    // Resuming still inflates the text before startOffset, but its blocks are
+    // only cut out, not parsed.
+    CompressedBlockReader reader(file.view(), inputFormat);
+    opts.onConsumed = nullptr;
+    const size_t startOffset = opts.startOffset;
+    opts.sourceFailed = [&reader] { return reader.failed(); };
+    bool ok = runStreamingLoad([&reader, startOffset](PortfolioBlock& block) {
+        while (reader.next(block.text, block.owner, block.endOffset)) {
+            if (block.endOffset > startOffset)
+                return true;
+        }
+        return false;
+    }, sink, opts, stats);
+
+    reader.close();
+    inflatedBytes = (size_t)reader.decompressedBytes();
+    if (reader.failed()) {
+        logger.log("Failed to decompress " + path + ": " + reader.error(), LogLevel::ERRORS);
+        return false;
+    }
+    logInflate(reader.decompressSeconds());
+    return ok;
+}
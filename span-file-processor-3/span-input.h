@@ -0,0 +1,49 @@
+#pragma once
+#ifndef SPAN_INPUT_H
+#define SPAN_INPUT_H
+
+#include "mapped-file.h"
+#include "compressed-input.h"
+#include "span-pipeline.h"
+#include <string>
+#include <string_view>
+
+// The <span-file> argument: plain SPAN text, used in place through a memory
+// mapping, or a gzip/zip archive that is decompressed in memory, never to disk
+class SpanInput {
+public:
+    bool open(const std::string& path);
+
+    const std::string& name() const { return path; }
+    InputFormat format() const { return inputFormat; }
+    bool compressed() const { return inputFormat != InputFormat::Plain; }
+    size_t fileBytes() const { return file.size(); }
+
+    // The file as stored (still compressed for archives), e.g. to fingerprint it
+    std::string_view fileView() const { return file.view(); }
+
+    // Decompressed size once text() or stream() ran; the file size for plain text
+    size_t textBytes() const { return compressed() ? inflatedBytes : file.size(); }
+
+    // The whole text: the mapping itself, or the archive inflated into memory
+    // on the first call
+    bool text(std::string_view& data);
+
+    // Streams the file through runStreamingLoad. Plain text releases mapped
+    // pages behind the pipeline; an archive is inflated on its own thread and
+    // its blocks fed to the parsers as they come out. opts.startOffset is an
+    // offset in the (decompressed) text.
+    bool stream(RecordSink& sink, PipelineOptions opts, PipelineStats& stats);
+
+private:
+    void logInflate(double seconds) const;
+
+    std::string path;
+    MappedFile file;
+    InputFormat inputFormat = InputFormat::Plain;
+    std::string inflated;
+    bool inflatedDone = false;
+    size_t inflatedBytes = 0;
+};
+
+#endif // SPAN_INPUT_H
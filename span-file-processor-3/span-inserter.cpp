@@ -0,0 +1,444 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "span-inserter.h"
+#include "span-schema.h"
+#include "logger.h"
+#include "metrics.h"
+#include <cstring>
+#include <utility>
+
+extern Logger logger;
+
+// Binary risk arrays need: ALTER TABLE SpanRecords6 ADD RiskArrayBin VARBINARY(MAX) NULL
+std::wstring spanInsertColumns(RiskEncoding encoding) {
+    return std::wstring(L"Segment, PfId, PfCode, Currency, CVF, SVF, ValueMeth, PriceMeth, SetlMeth,ContractId, Expiry, Volatility, SettleDate, IntraRate, PriceScan, VolScan, OptContractId, OptionType, StrikePrice, OptionValue, ") +
+        (encoding == RiskEncoding::Binary ? L"RiskArrayBin" : L"RiskArray");
+}
+
+static const SQLLEN initialRiskWidth = 1024;
+
+static bool sqlOk(SQLRETURN ret) {
+    return ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO;
+}
+
+bool SpanInserter::open(SQLHDBC dbc, const InserterOptions& options) {
+    close();
+    hDbc = dbc;
+    capacity = options.batchSize ? options.batchSize : 1;
+    riskEncoding = options.riskEncoding;
+    commitRows = options.commitRows;
+    commitBytes = options.commitBytes;
+    rows = 0;
+    batchBytes = 0;
+    uncommittedRows = 0;
+    uncommittedBytes = 0;
+    counters = InsertStats();
+
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt);
+    if (!sqlOk(ret)) {
+        logger.log("hStmt SQLAllocHandle failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_DBC, hDbc, "SQLAllocHandle");
+        hStmt = SQL_NULL_HANDLE;
+        return false;
+    }
+
+    std::wstring sql = L"INSERT INTO " + options.table + L" (" + spanInsertColumns(riskEncoding) + L") "
+        L"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+    ScopedTimer prepareTimer(metrics.insertPrepareNs);
+    metrics.roundTrips.add();
+    ret = SQLPrepareW(hStmt, (SQLWCHAR*)sql.c_str(), SQL_NTS);
+    if (!sqlOk(ret)) {
+        logger.log("hStmt SQLPrepareW failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLPrepareW");
+        return false;
+    }
+
+    // Column sizes match the per-row binding this replaced; slots leave room for a NUL
+    segment.init(10, 11, capacity);
+    pfCode.init(50, 51, capacity);
+    currency.init(10, 11, capacity);
+    valueMeth.init(20, 21, capacity);
+    priceMeth.init(20, 21, capacity);
+    setlMeth.init(20, 21, capacity);
+    expiry.init(10, 11, capacity);
+    settleDate.init(10, 11, capacity);
+    optionType.init(1, 2, capacity);
+    riskArray.init(0, initialRiskWidth, capacity);
+
+    pfId.assign(capacity, 0);
+    contractId.assign(capacity, 0);
+    optContractId.assign(capacity, 0);
+    cvf.assign(capacity, 0.0);
+    svf.assign(capacity, 0.0);
+    volatility.assign(capacity, 0.0);
+    intraRate.assign(capacity, 0.0);
+    priceScan.assign(capacity, 0.0);
+    volScan.assign(capacity, 0.0);
+    strikePrice.assign(capacity, 0.0);
+    optionValue.assign(capacity, 0.0);
+    paramStatus.assign(capacity, SQL_PARAM_UNUSED);
+
+    return bindColumns();
+}
+
+bool SpanInserter::bindColumns() {
+    SQLRETURN k[25];
+    int n = 0;
+
+    k[n++] = SQLSetStmtAttr(hStmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0);
+    k[n++] = SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)capacity, 0);
+    k[n++] = SQLSetStmtAttr(hStmt, SQL_ATTR_PARAM_STATUS_PTR, paramStatus.data(), 0);
+    k[n++] = SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &paramsProcessed, 0);
+    for (int i = 0; i < n; i++) {
+        if (!sqlOk(k[i])) {
+            logger.log("hStmt SQLSetStmtAttr failed.", LogLevel::ERRORS);
+            handleError(SQL_HANDLE_STMT, hStmt, "SQLSetStmtAttr");
+            return false;
+        }
+    }
+    paramsetSize = capacity;
+
+    auto bindText = [this](SQLUSMALLINT param, CharColumn& col) {
+        return SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_WVARCHAR, col.columnSize, 0,
+            (SQLPOINTER)col.data.data(), col.width, col.ind.data());
+    };
+    auto bindInt = [this](SQLUSMALLINT param, std::vector<SQLINTEGER>& col) {
+        return SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0,
+            (SQLPOINTER)col.data(), 0, NULL);
+    };
+    auto bindDouble = [this](SQLUSMALLINT param, std::vector<double>& col) {
+        return SQLBindParameter(hStmt, param, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0,
+            (SQLPOINTER)col.data(), 0, NULL);
+    };
+
+    k[0] = bindText(1, segment);
+    k[1] = bindInt(2, pfId);
+    k[2] = bindText(3, pfCode);
+    k[3] = bindText(4, currency);
+    k[4] = bindDouble(5, cvf);
+    k[5] = bindDouble(6, svf);
+    k[6] = bindText(7, valueMeth);
+    k[7] = bindText(8, priceMeth);
+    k[8] = bindText(9, setlMeth);
+    k[9] = bindInt(10, contractId);
+    k[10] = bindText(11, expiry);
+    k[11] = bindDouble(12, volatility);
+    k[12] = bindText(13, settleDate);
+    k[13] = bindDouble(14, intraRate);
+    k[14] = bindDouble(15, priceScan);
+    k[15] = bindDouble(16, volScan);
+    k[16] = bindInt(17, optContractId);
+    k[17] = bindText(18, optionType);
+    k[18] = bindDouble(19, strikePrice);
+    k[19] = bindDouble(20, optionValue);
+
+    // Check all return values
+    for (int i = 0; i < 20; i++) {
+        if (!sqlOk(k[i])) {
+            handleError(SQL_HANDLE_STMT, hStmt, "SQLBindParameter", i + 1);
+            return false;
+        }
+    }
+    return bindRiskColumn();
+}
+
+// Column 21 is re-bound on its own when a wider risk-array slot is needed.
+// Lossless text is plain ASCII, so it goes as VARCHAR rather than UTF-16.
+bool SpanInserter::bindRiskColumn() {
+    SQLSMALLINT cType = SQL_C_CHAR;
+    SQLSMALLINT sqlType = SQL_WVARCHAR;
+    if (riskEncoding == RiskEncoding::Binary) {
+        cType = SQL_C_BINARY;
+        sqlType = SQL_VARBINARY;
+    }
+    else if (riskEncoding == RiskEncoding::Text) {
+        sqlType = SQL_VARCHAR;
+    }
+    SQLRETURN ret = SQLBindParameter(hStmt, 21, SQL_PARAM_INPUT, cType, sqlType, riskArray.columnSize, 0,
+        (SQLPOINTER)riskArray.data.data(), riskArray.width, riskArray.ind.data());
+    if (!sqlOk(ret)) {
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLBindParameter", 21);
+        return false;
+    }
+    return true;
+}
+
+void SpanInserter::setText(CharColumn& col, size_t row, std::string_view value) {
+    std::memcpy(col.slot(row), value.data(), value.size());
+    col.slot(row)[value.size()] = '\0';
+    col.ind[row] = (SQLLEN)value.size();
+}
+
+bool SpanInserter::addAll(const SpanRecordStore& store) {
+    for (size_t i = 0; i < store.size(); ++i) {
+        if (!add(store.ref(i)))
+            return false;
+    }
+    return true;
+}
+
+bool SpanInserter::add(const SpanRecordRef& rec) {
+    if (hStmt == SQL_NULL_HANDLE)
+        return false;
+
+    // A value wider than its column would be rejected by the server anyway
+    const std::pair<std::string_view, CharColumn*> texts[] = {
+        { rec.segment, &segment }, { rec.pfCode, &pfCode }, { rec.currency, &currency },
+        { rec.valueMeth, &valueMeth }, { rec.priceMeth, &priceMeth }, { rec.setlMeth, &setlMeth },
+        { rec.expiry, &expiry }, { rec.settleDate, &settleDate }, { rec.optionType, &optionType },
+    };
+    std::string reason;
+    if (rec.truncatedField)
+        reason = std::string(rec.truncatedField) + " was truncated in the record store";
+    for (size_t i = 0; reason.empty() && i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        if ((SQLLEN)texts[i].first.size() >= texts[i].second->width)
+            reason = "value '" + std::string(texts[i].first) + "' exceeds column size";
+    }
+    if (!reason.empty()) {
+        logger.log("Rejected record pfId=" + std::to_string(rec.pfId) + " contractId=" + std::to_string(rec.contractId) +
+            " optContractId=" + std::to_string(rec.optContractId) + ": " + reason, LogLevel::ERRORS);
+        counters.rowsFailed++;
+        return true;
+    }
+
+    riskText.clear();
+    appendRiskArray(riskEncoding, rec.riskR, rec.riskValues, rec.riskCount, rec.riskD, riskText);
+    if ((SQLLEN)riskText.size() >= riskArray.width) {
+        // Flush what is bound to the narrow buffers, then widen the slot and re-bind
+        if (!flush())
+            return false;
+        SQLLEN width = riskArray.width;
+        while (width <= (SQLLEN)riskText.size())
+            width *= 2;
+        riskArray.init(0, width, capacity);
+        if (!bindRiskColumn())
+            return false;
+    }
+
+    size_t row = rows;
+    setText(segment, row, rec.segment);
+    setText(pfCode, row, rec.pfCode);
+    setText(currency, row, rec.currency);
+    setText(valueMeth, row, rec.valueMeth);
+    setText(priceMeth, row, rec.priceMeth);
+    setText(setlMeth, row, rec.setlMeth);
+    setText(expiry, row, rec.expiry);
+    setText(settleDate, row, rec.settleDate);
+    setText(optionType, row, rec.optionType);
+    setText(riskArray, row, riskText);
+    batchBytes += wideRowBytes(rec, riskText.size());
+
+    pfId[row] = rec.pfId;
+    contractId[row] = rec.contractId;
+    optContractId[row] = rec.optContractId;
+    cvf[row] = rec.cvf;
+    svf[row] = rec.svf;
+    volatility[row] = rec.volatility;
+    intraRate[row] = rec.intraRate;
+    priceScan[row] = rec.priceScan;
+    volScan[row] = rec.volScan;
+    strikePrice[row] = rec.strikePrice;
+    optionValue[row] = rec.optionValue;
+
+    if (++rows == capacity)
+        return flush();
+    return true;
+}
+
+bool SpanInserter::flush() {
+    if (rows == 0)
+        return true;
+    size_t count = rows;
+    rows = 0;
+    uncommittedRows += count;
+    uncommittedBytes += batchBytes;
+    counters.bytes += batchBytes;
+    batchBytes = 0;
+    const size_t insertedBefore = counters.rowsInserted, failedBefore = counters.rowsFailed;
+    const bool executed = execute(count);
+    metrics.rowsPerBatch.record(count);
+    metrics.rowsInserted.add(counters.rowsInserted - insertedBefore);
+    metrics.rowsRejected.add(counters.rowsFailed - failedBefore);
+    if (!executed)
+        return false;
+
+    if ((commitRows && uncommittedRows >= commitRows) || (commitBytes && uncommittedBytes >= commitBytes))
+        return commit();
+    return true;
+}
+
+bool SpanInserter::commit() {
+    if (hStmt == SQL_NULL_HANDLE || !flush())
+        return false;
+    if (uncommittedRows == 0)
+        return true;
+    SQLRETURN ret;
+    {
+        ScopedTimer timer(metrics.commitNs);
+        ret = SQLEndTran(SQL_HANDLE_DBC, hDbc, SQL_COMMIT);
+    }
+    counters.commits++;
+    metrics.roundTrips.add();
+    metrics.rowsPerCommit.record(uncommittedRows);
+    if (!sqlOk(ret)) {
+        logger.log("SQLEndTran commit failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_DBC, hDbc, "SQLEndTran");
+        return false;
+    }
+    uncommittedRows = 0;
+    uncommittedBytes = 0;
+    return true;
+}
+
+// Sends rows [0, count). Rows the driver reports as failed are counted; rows it
+// never got to (batch aborted by a data error) are re-sent one at a time.
+bool SpanInserter::execute(size_t count) {
+    if (!setParamsetSize(count))
+        return false;
+    for (size_t i = 0; i < count; ++i)
+        paramStatus[i] = SQL_PARAM_UNUSED;
+    paramsProcessed = 0;
+
+    SQLRETURN ret;
+    {
+        ScopedTimer timer(metrics.insertExecuteNs);
+        ret = SQLExecute(hStmt);
+    }
+    counters.batches++;
+    metrics.roundTrips.add();
+    if (!sqlOk(ret))
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLExecute");
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && ret != SQL_ERROR) {
+        logger.log("hStmt SQLExecute failed.", LogLevel::ERRORS);
+        return false;
+    }
+    if (ret == SQL_ERROR && !rowsAtFault())
+        return false;
+
+    std::vector<size_t> retry;
+    for (size_t i = 0; i < count; ++i) {
+        switch (paramStatus[i]) {
+        case SQL_PARAM_SUCCESS:
+        case SQL_PARAM_SUCCESS_WITH_INFO:
+            counters.rowsInserted++;
+            break;
+        case SQL_PARAM_ERROR:
+            logRejectedRow(i);
+            counters.rowsFailed++;
+            break;
+        default:
+            // SQL_PARAM_UNUSED / SQL_PARAM_DIAG_UNAVAILABLE: outcome unknown
+            if (ret == SQL_ERROR)
+                retry.push_back(i);
+            else
+                counters.rowsInserted++;
+            break;
+        }
+    }
+
+    if (retry.empty())
+        return true;
+
+    logger.log("Batch of " + std::to_string(count) + " rows aborted, re-sending " +
+        std::to_string(retry.size()) + " rows individually", LogLevel::WARNING);
+    if (!setParamsetSize(1))
+        return false;
+    for (size_t row : retry) {
+        if (!executeSingleRow(row))
+            return false;
+    }
+    return true;
+}
+
+// Only when the size changes. A failed call would leave the next execute
+// sending the old number of rows, partly from stale buffers.
+bool SpanInserter::setParamsetSize(size_t size) {
+    if (size == paramsetSize)
+        return true;
+    if (!sqlOk(SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)size, 0))) {
+        logger.log("hStmt SQLSetStmtAttr(SQL_ATTR_PARAMSET_SIZE) failed.", LogLevel::ERRORS);
+        handleError(SQL_HANDLE_STMT, hStmt, "SQLSetStmtAttr");
+        paramsetSize = 0;
+        return false;
+    }
+    paramsetSize = size;
+    return true;
+}
+
+// After SQL_ERROR: only data errors (SQLSTATE 22xxx, 23xxx) make rows rejects.
+// Anything else - a lost connection (08xxx), deadlock victim (40001), timeout
+// (HYT00) - fails the load rather than re-sending and rejecting every row.
+bool SpanInserter::rowsAtFault() {
+    std::string sqlState;
+    if (isDataError(SQL_HANDLE_STMT, hStmt, sqlState))
+        return true;
+    logger.log("hStmt SQLExecute failed" + (sqlState.empty() ? std::string(".") : ", SQLSTATE " + sqlState + "."),
+        LogLevel::ERRORS);
+    return false;
+}
+
+// Retries are ascending, so slot 0 is always free to hold the row being re-sent
+bool SpanInserter::executeSingleRow(size_t row) {
+    if (row != 0)
+        copyRow(0, row);
+    paramStatus[0] = SQL_PARAM_UNUSED;
+
+    SQLRETURN ret;
+    {
+        ScopedTimer timer(metrics.insertExecuteNs);
+        ret = SQLExecute(hStmt);
+    }
+    counters.batches++;
+    metrics.roundTrips.add();
+    if (sqlOk(ret)) {
+        counters.rowsInserted++;
+        return true;
+    }
+    handleError(SQL_HANDLE_STMT, hStmt, "SQLExecute");
+    if (ret != SQL_ERROR) {
+        logger.log("hStmt SQLExecute failed.", LogLevel::ERRORS);
+        return false;
+    }
+    if (!rowsAtFault())
+        return false;
+    logRejectedRow(0);
+    counters.rowsFailed++;
+    return true;
+}
+
+void SpanInserter::copyRow(size_t dst, size_t src) {
+    CharColumn* texts[] = { &segment, &pfCode, &currency, &valueMeth, &priceMeth, &setlMeth,
+        &expiry, &settleDate, &optionType, &riskArray };
+    for (CharColumn* col : texts) {
+        std::memcpy(col->slot(dst), col->slot(src), (size_t)col->width);
+        col->ind[dst] = col->ind[src];
+    }
+    pfId[dst] = pfId[src];
+    contractId[dst] = contractId[src];
+    optContractId[dst] = optContractId[src];
+    cvf[dst] = cvf[src];
+    svf[dst] = svf[src];
+    volatility[dst] = volatility[src];
+    intraRate[dst] = intraRate[src];
+    priceScan[dst] = priceScan[src];
+    volScan[dst] = volScan[src];
+    strikePrice[dst] = strikePrice[src];
+    optionValue[dst] = optionValue[src];
+}
+
+void SpanInserter::logRejectedRow(size_t row) {
+    logger.log("Rejected record pfId=" + std::to_string(pfId[row]) + " contractId=" + std::to_string(contractId[row]) +
+        " optContractId=" + std::to_string(optContractId[row]), LogLevel::ERRORS);
+}
+
+void SpanInserter::close() {
+    if (hStmt != SQL_NULL_HANDLE) {
+        SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+        hStmt = SQL_NULL_HANDLE;
+    }
+    hDbc = SQL_NULL_HANDLE;
+    rows = 0;
+    paramsetSize = 0;
+}
+
+#endif // SPAN_WITH_ODBC
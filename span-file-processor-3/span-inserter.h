@@ -0,0 +1,114 @@
+#pragma once
+#ifndef SPAN_INSERTER_H
+#define SPAN_INSERTER_H
+
+#include "span-parser.h"
+#include "span-record-store.h"
+#include "record-sink.h"
+#include "span-schema.h"
+#include <string>
+#include <vector>
+#include <windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+
+// Narrow-char (or binary) parameter column: batchSize fixed-width slots plus length indicators
+struct CharColumn {
+    SQLULEN columnSize = 0;     // declared SQL column size (0 = unbounded)
+    SQLLEN width = 0;           // bytes per slot
+    std::vector<char> data;
+    std::vector<SQLLEN> ind;
+
+    void init(SQLULEN size, SQLLEN slotWidth, size_t rows) {
+        columnSize = size;
+        width = slotWidth;
+        data.assign((size_t)slotWidth * rows, 0);
+        ind.assign(rows, 0);
+    }
+    char* slot(size_t row) { return data.data() + row * (size_t)width; }
+};
+
+struct InserterOptions {
+    size_t batchSize = 1000;            // rows per SQLExecute
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;
+    std::wstring table = L"SpanRecords6";
+    OutputSchema schema = OutputSchema::Wide;  // OdbcSink: SpanRecords6 or the normalized tables
+
+    // Commit after this many rows / parameter bytes (checked per batch).
+    // 0 for both leaves transactions to the caller or to autocommit.
+    size_t commitRows = 0;
+    size_t commitBytes = 0;
+};
+
+// Column list of the insert statement, also used to copy staged rows
+std::wstring spanInsertColumns(RiskEncoding encoding);
+
+// Inserts SpanRecords into SpanRecords6 with column-wise parameter arrays.
+// Parameters are bound once to the batch buffers; add() fills the next row and
+// sends the batch when it is full. A row the server rejects is logged and
+// counted, the rest of the batch and the load carry on.
+// The risk array goes to RiskArray as text (legacy or lossless) or, with
+// RiskEncoding::Binary, to a RiskArrayBin VARBINARY(MAX) column.
+class SpanInserter {
+public:
+    SpanInserter() = default;
+    ~SpanInserter() { close(); }
+
+    SpanInserter(const SpanInserter&) = delete;
+    SpanInserter& operator=(const SpanInserter&) = delete;
+
+    bool open(SQLHDBC hDbc, const InserterOptions& options);
+    bool open(SQLHDBC hDbc, size_t batchSize, RiskEncoding encoding = RiskEncoding::Legacy) {
+        InserterOptions options;
+        options.batchSize = batchSize;
+        options.riskEncoding = encoding;
+        return open(hDbc, options);
+    }
+    bool add(const SpanRecordRef& rec); // false only on a statement-level failure
+    bool add(const SpanRecord& rec) { return add(makeRecordRef(rec)); }
+    bool addAll(const SpanRecordStore& store);
+    bool flush();
+    bool commit();                      // flush() first; commits the connection's transaction
+    void discard() { rows = 0; batchBytes = 0; }    // drops the rows not sent yet
+    void close();
+
+    const InsertStats& stats() const { return counters; }
+    void resetStats() { counters = InsertStats(); }
+
+private:
+    bool bindColumns();
+    bool bindRiskColumn();
+    bool execute(size_t count);
+    bool executeSingleRow(size_t row);
+    bool rowsAtFault();
+    bool setParamsetSize(size_t size);
+    void copyRow(size_t dst, size_t src);
+    void logRejectedRow(size_t row);
+    void setText(CharColumn& col, size_t row, std::string_view value);
+
+    SQLHDBC hDbc = SQL_NULL_HANDLE;
+    SQLHSTMT hStmt = SQL_NULL_HANDLE;
+    size_t capacity = 0;
+    size_t rows = 0;                    // rows filled in the current batch
+    size_t paramsetSize = 0;            // SQL_ATTR_PARAMSET_SIZE as last set
+
+    CharColumn segment, pfCode, currency, valueMeth, priceMeth, setlMeth;
+    CharColumn expiry, settleDate, optionType, riskArray;
+    std::vector<SQLINTEGER> pfId, contractId, optContractId;
+    std::vector<double> cvf, svf, volatility, intraRate, priceScan, volScan, strikePrice, optionValue;
+
+    std::vector<SQLUSMALLINT> paramStatus;
+    SQLULEN paramsProcessed = 0;
+    RiskEncoding riskEncoding = RiskEncoding::Legacy;
+    size_t commitRows = 0;
+    size_t commitBytes = 0;
+    size_t batchBytes = 0;              // parameter bytes of the rows in the current batch
+    size_t uncommittedRows = 0;
+    size_t uncommittedBytes = 0;
+    std::string riskText;               // scratch buffer for the encoded risk array
+
+    InsertStats counters;
+};
+
+#endif // SPAN_INSERTER_H
@@ -1,17 +1,26 @@
 // Updated span-parser.cpp
 #include "span-parser.h"
 #include "logger.h"
+#include "span-tokenizer.h"
+#include "span-record-store.h"
+#include "span-sections.h"
+#include "tag-hash.h"
+#include "metrics.h"
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <fstream>
-#include <regex>
+#include <stdexcept>
 #include <map>
+#if SPAN_WITH_ODBC
+#include "span-inserter.h"
 #include <windows.h>
 #include <sqlext.h>
 #include <sqltypes.h>
 #include <sql.h>
+#endif
 
 extern Logger logger;  // use the shared logger
 
@@ -49,160 +58,355 @@ bool readConnectionString(const std::string& filePath, std::wstring& connStr) {
     return true;
 }
 
-std::string extractTag(const std::string& block, const std::string& tag) {
-    std::string open = "<" + tag + ">";
-    std::string close = "</" + tag + ">";
-    auto start = block.find(open);
-    auto end = block.find(close);
-    if (start != std::string::npos && end != std::string::npos && end > start) {
-        start += open.length();
+// Locates "<tag>" (or "</tag>") without building the markup string
+static size_t findTag(std::string_view block, std::string_view tag, bool closing) {
+    const size_t prefix = closing ? 2 : 1;
+    size_t from = 0;
+    while ((from = block.find(tag, from)) != std::string_view::npos) {
+        size_t after = from + tag.size();
+        if (from >= prefix && block[from - prefix] == '<' && (!closing || block[from - 1] == '/') &&
+            after < block.size() && block[after] == '>')
+            return from - prefix;
+        ++from;
+    }
+    return std::string_view::npos;
+}
+
+std::string_view extractTag(std::string_view block, std::string_view tag) {
+    auto start = findTag(block, tag, false);
+    auto end = findTag(block, tag, true);
+    if (start != std::string_view::npos && end != std::string_view::npos && end > start) {
+        start += tag.size() + 2;
         return block.substr(start, end - start);
     }
-    return "";
+    return std::string_view();
 }
 
-RiskArray extractRiskArray(const std::string& block) {
+RiskArray extractRiskArray(std::string_view block) {
     RiskArray riskArray;
     size_t raStart = block.find("<ra>");
     size_t raEnd = block.find("</ra>");
-    if (raStart != std::string::npos && raEnd != std::string::npos && raEnd > raStart) {
-        std::string raContent = block.substr(raStart, raEnd - raStart + 5);
-        riskArray.r = std::stoi(extractTag(raContent, "r"));
-        riskArray.d = std::stod(extractTag(raContent, "d"));
+    if (raStart != std::string_view::npos && raEnd != std::string_view::npos && raEnd > raStart) {
+        std::string_view raContent = block.substr(raStart, raEnd - raStart + 5);
+        riskArray.r = parseInt(extractTag(raContent, "r"));
+        riskArray.d = parseDouble(extractTag(raContent, "d"));
         size_t pos = 0;
 
-        while ((pos = raContent.find("<a>", pos)) != std::string::npos) {
+        while ((pos = raContent.find("<a>", pos)) != std::string_view::npos) {
             size_t end = raContent.find("</a>", pos);
-            if (end == std::string::npos)
+            if (end == std::string_view::npos)
                 break;
-            std::string val = raContent.substr(pos + 3, end - pos - 3);
-            riskArray.a.push_back(std::stod(val));
+            riskArray.a.push_back(parseDouble(raContent.substr(pos + 3, end - pos - 3)));
             pos = end + 4;
         }
     }
     return riskArray;
 }
 
-void parseSpanXmlBlock(const std::string& block, std::vector<SpanRecord>& recs) {
-    std::string segment;
+// Tags the block parser maps onto SpanRecord
+enum SpanTag {
+    TAG_PFID, TAG_PFCODE, TAG_CURRENCY, TAG_CVF, TAG_SVF, TAG_VALUEMETH, TAG_PRICEMETH, TAG_SETLMETH,
+    TAG_CID, TAG_PE, TAG_V, TAG_SETLDATE, TAG_VAL, TAG_PRICESCAN, TAG_VOLSCAN, TAG_O, TAG_K,
+    TAG_R, TAG_A, TAG_D, TAG_P, TAG_T,
+    TAG_COUNT, TAG_OTHER = TAG_COUNT
+};
+
+// Names in SpanTag order, hashed at compile time
+constexpr TagTable<TAG_COUNT> spanTags({
+    "pfId", "pfCode", "currency", "cvf", "svf", "valueMeth", "priceMeth", "setlMeth",
+    "cId", "pe", "v", "setlDate", "val", "priceScan", "volScan", "o", "k",
+    "r", "a", "d", "p", "t" });
+
+static SpanTag lookupTag(std::string_view name) {
+    int tag = spanTags.find(name);
+    return tag < 0 ? TAG_OTHER : (SpanTag)tag;
+}
 
-    if (block.find("<phyPf>") != std::string::npos)
-        segment = "phypf";
-    else if (block.find("<futPf>") != std::string::npos)
-        segment = "futpf";
-    else
-        segment = "oofpf";
+// Fields older files leave out (<p>, <t>, <undC><pfId>) read as 0
+static double optionalDouble(std::string_view value) {
+    return value.empty() ? 0.0 : parseDouble(value);
+}
 
+static int optionalInt(std::string_view value) {
+    return value.empty() ? 0 : parseInt(value);
+}
 
-    // Common root-level tags
-    int pfId = std::stoi(extractTag(block, "pfId"));
-    std::string pfCode = extractTag(block, "pfCode");
-    std::string currency = extractTag(block, "currency");
-    double cvf = std::stod(extractTag(block, "cvf"));
-    std::string valueMeth = extractTag(block, "valueMeth");
-    std::string priceMeth = extractTag(block, "priceMeth");
-    std::string setlMeth = extractTag(block, "setlMeth");
-
-    SpanRecord rec;
-    rec.segment = segment;
-    rec.pfId = pfId;
-    rec.pfCode = pfCode;
-    rec.currency = currency;
-    rec.cvf = cvf;
-    rec.valueMeth = valueMeth;
-    rec.priceMeth = priceMeth;
-    rec.setlMeth = setlMeth;
-
-    if (segment == "phypf") {
-        std::smatch m;
-        std::regex_search(block, m, std::regex("<phy>[\\s\\S]*?</phy>"));
-        std::string phyBlock = m[0];
-
-        rec.contractId = std::stoi(extractTag(phyBlock, "cId"));
-        rec.expiry = extractTag(phyBlock, "pe");
-        rec.volatility = std::stod(extractTag(phyBlock, "v"));
-        rec.priceScan = std::stod(extractTag(phyBlock, "priceScan"));
-        rec.volScan = std::stod(extractTag(phyBlock, "volScan"));
-        rec.riskArray = extractRiskArray(phyBlock);
-
-        recs.push_back(rec);
+// Leaf values seen inside one element (portfolio, phy/fut/series, opt). Each slot
+// keeps the first occurrence of its tag anywhere in the element, which is what
+// the per-field extractTag() lookups used to return.
+struct TagScope {
+    std::string_view values[TAG_COUNT];
+    unsigned int seen = 0;
+
+    void reset() { seen = 0; }
+    void offer(SpanTag tag, std::string_view value) {
+        if (!(seen & (1u << tag))) {
+            values[tag] = value;
+            seen |= 1u << tag;
+        }
+    }
+    std::string_view get(SpanTag tag) const {
+        return (seen & (1u << tag)) ? values[tag] : std::string_view();
+    }
+};
+
+// First <ra> inside a phy/fut/opt element; its <a> values go straight into the store's arena
+struct RiskScope {
+    bool taken = false;
+    std::string_view r, d;
+    bool hasR = false, hasD = false;
+    int riskR = 0;
+    double riskD = 0.0;
+    size_t offset = 0;
+    size_t count = 0;
+
+    void reset() {
+        taken = hasR = hasD = false;
+        r = d = std::string_view();
+        riskR = 0;
+        riskD = 0.0;
+        offset = count = 0;
+    }
+    void applyTo(CompactRecord& rec) const {
+        rec.riskR = riskR;
+        rec.riskD = riskD;
+        rec.riskOffset = offset;
+        rec.riskCount = (uint32_t)count;
+    }
+};
+
+// Single forward pass over a portfolio block; produces the same records the
+// regex/extractTag implementation did. Section blocks go to parseSectionBlock.
+void parseSpanXmlBlock(std::string_view block, SpanRecordStore& store) {
+    const SpanRecordStore::Mark first = store.mark();
+
+    SpanTokenizer tokenizer(block);
+    SpanToken tok;
+    if (!tokenizer.next(tok) || tok.type != SpanTokenType::OpenTag)
+        return;
+    if (isSectionBlockTag(tok.name)) {
+        parseSectionBlock(block, store.sections());
+        return;
     }
-    else if (rec.segment == "futpf") {
-        std::regex rgx("<fut>([\\s\\S]*?)</fut>");
-        auto futBegin = std::sregex_iterator(block.begin(), block.end(), rgx);
-        auto futEnd = std::sregex_iterator();
-
-        for (auto it = futBegin; it != futEnd; ++it) {
-            std::string fut = (*it)[0];
-
-            rec.contractId = std::stoi(extractTag(fut, "cId"));
-            rec.expiry = extractTag(fut, "pe");
-            rec.volatility = std::stod(extractTag(fut, "v"));
-            rec.settleDate = extractTag(fut, "setlDate");
 
-            //val two tags, choosing 2nd one
-            std::string intrBlock = extractTag(fut, "intrRate");
-            rec.intraRate = std::stod(extractTag(intrBlock, "val"));
+    const char* segment;
+    std::string_view contractTag;
+    int segmentSlot;
+    if (tok.name == "phyPf") {
+        segment = "phypf";
+        contractTag = "phy";
+        segmentSlot = 0;
+    }
+    else if (tok.name == "futPf") {
+        segment = "futpf";
+        contractTag = "fut";
+        segmentSlot = 1;
+    }
+    else {
+        segment = "oofpf";
+        contractTag = "series";
+        segmentSlot = 2;
+    }
+    ScopedTimer timer(metrics.parseBlockNs[segmentSlot]);
+    const bool isPhy = contractTag == "phy";
+    const bool isFut = contractTag == "fut";
+    const bool isOof = contractTag == "series";
+
+    TagScope pf, contract, opt;
+    RiskScope contractRisk, optRisk;
+    RiskScope* risk = nullptr;         // <ra> currently being collected
+    bool inContract = false, inOpt = false;
+    bool phyDone = false;              // only the first <phy> is used
+    bool inIntrRate = false, intrRateSeen = false;
+    std::string_view futIntraRate;
+    size_t seriesFirst = 0;
+
+    std::string_view openName;         // last open tag, cleared by any close tag
+    size_t openEnd = 0;
+
+    try {
+        const uint32_t pfIndex = store.addPortfolio();
+
+        while (tokenizer.next(tok)) {
+            if (tok.type == SpanTokenType::OpenTag) {
+                openName = tok.name;
+                openEnd = tok.end;
+
+                if (tok.name == contractTag && !inContract && !phyDone) {
+                    inContract = true;
+                    contract.reset();
+                    contractRisk.reset();
+                    intrRateSeen = false;
+                    futIntraRate = std::string_view();
+                    seriesFirst = store.size();
+                }
+                else if (inContract && isOof && tok.name == "opt" && !inOpt) {
+                    inOpt = true;
+                    opt.reset();
+                    optRisk.reset();
+                }
+                else if (tok.name == "ra" && risk == nullptr) {
+                    RiskScope* owner = inOpt ? &optRisk : (inContract && !isOof) ? &contractRisk : nullptr;
+                    if (owner && !owner->taken) {
+                        owner->taken = true;
+                        owner->offset = store.riskSize();
+                        risk = owner;
+                    }
+                }
+                else if (tok.name == "intrRate" && inContract && isFut && !intrRateSeen) {
+                    inIntrRate = true;
+                    intrRateSeen = true;
+                }
+                continue;
+            }
 
-            rec.priceScan = std::stod(extractTag(fut, "priceScan"));
-            rec.volScan = std::stod(extractTag(fut, "volScan"));
-            rec.riskArray = extractRiskArray(fut);
+            // Close tag: a leaf when it matches the open tag right before it
+            if (openName.data() && tok.name == openName) {
+                std::string_view value = block.substr(openEnd, tok.begin - openEnd);
+                SpanTag tag = lookupTag(tok.name);
+                if (tag != TAG_OTHER) {
+                    pf.offer(tag, value);
+                    if (inContract)
+                        contract.offer(tag, value);
+                    if (inOpt)
+                        opt.offer(tag, value);
+                    if (inIntrRate && tag == TAG_VAL && !futIntraRate.data())
+                        futIntraRate = value;
+                    if (risk) {
+                        if (tag == TAG_R && !risk->hasR) {
+                            risk->r = value;
+                            risk->hasR = true;
+                        }
+                        else if (tag == TAG_D && !risk->hasD) {
+                            risk->d = value;
+                            risk->hasD = true;
+                        }
+                        else if (tag == TAG_A) {
+                            store.pushRisk(parseDouble(value));
+                            risk->count++;
+                        }
+                    }
+                }
+            }
+            openName = std::string_view();
 
-            recs.push_back(rec);
+            if (risk && tok.name == "ra") {
+                risk->riskR = parseInt(risk->r);
+                risk->riskD = parseDouble(risk->d);
+                risk = nullptr;
+            }
+            else if (inIntrRate && tok.name == "intrRate") {
+                inIntrRate = false;
+            }
+            else if (inOpt && tok.name == "opt") {
+                CompactRecord& rec = store.addRecord(pfIndex);
+                rec.optContractId = parseInt(opt.get(TAG_CID));
+                rec.optionType.assign(opt.get(TAG_O));
+                rec.strikePrice = parseDouble(opt.get(TAG_K));
+                rec.optionValue = parseDouble(opt.get(TAG_VAL));
+                rec.price = optionalDouble(opt.get(TAG_P));
+                optRisk.applyTo(rec);
+                inOpt = false;
+            }
+            else if (inContract && tok.name == contractTag) {
+                if (isOof) {
+                    std::string_view expiry = contract.get(TAG_PE);
+                    std::string_view settleDate = contract.get(TAG_SETLDATE);
+                    double volatility = parseDouble(contract.get(TAG_V));
+                    double intraRate = parseDouble(contract.get(TAG_VAL));   // first <val> in the series
+                    double priceScan = parseDouble(contract.get(TAG_PRICESCAN));
+                    double volScan = parseDouble(contract.get(TAG_VOLSCAN));
+                    int contractId = parseInt(contract.get(TAG_CID));     // of the underlying (<undC>)
+                    int underlyingPfId = optionalInt(contract.get(TAG_PFID));
+                    double timeToExpiry = optionalDouble(contract.get(TAG_T));
+                    const uint32_t series = seriesFirst < store.size() ? store.addSeries() : 0;
+                    for (size_t i = seriesFirst; i < store.size(); ++i) {
+                        CompactRecord& rec = store.record(i);
+                        rec.series = series;
+                        rec.expiry.assign(expiry);
+                        rec.settleDate.assign(settleDate);
+                        rec.volatility = volatility;
+                        rec.intraRate = intraRate;
+                        rec.priceScan = priceScan;
+                        rec.volScan = volScan;
+                        rec.contractId = contractId;
+                        rec.underlyingPfId = underlyingPfId;
+                        rec.timeToExpiry = timeToExpiry;
+                    }
+                }
+                else {
+                    CompactRecord& rec = store.addRecord(pfIndex);
+                    rec.series = store.addSeries();
+                    rec.contractId = parseInt(contract.get(TAG_CID));
+                    rec.expiry.assign(contract.get(TAG_PE));
+                    rec.volatility = parseDouble(contract.get(TAG_V));
+                    rec.price = optionalDouble(contract.get(TAG_P));
+                    if (isFut) {
+                        rec.settleDate.assign(contract.get(TAG_SETLDATE));
+                        rec.intraRate = parseDouble(futIntraRate);
+                        rec.timeToExpiry = optionalDouble(contract.get(TAG_T));
+                    }
+                    rec.priceScan = parseDouble(contract.get(TAG_PRICESCAN));
+                    rec.volScan = parseDouble(contract.get(TAG_VOLSCAN));
+                    contractRisk.applyTo(rec);
+                    phyDone = isPhy;
+                }
+                inContract = false;
+            }
         }
 
+        if (isPhy && !phyDone)
+            throw std::invalid_argument("parseSpanXmlBlock: <phyPf> without <phy>");
+
+        // Portfolio header, first occurrence anywhere in the block, stored once
+        PortfolioHeader& header = store.portfolio(pfIndex);
+        header.segment = segment;
+        header.pfId = parseInt(pf.get(TAG_PFID));
+        header.cvf = parseDouble(pf.get(TAG_CVF));
+        header.svf = isOof ? parseDouble(pf.get(TAG_SVF)) : 0.0;
+        header.pfCode = pf.get(TAG_PFCODE);
+        header.currency = pf.get(TAG_CURRENCY);
+        header.valueMeth = pf.get(TAG_VALUEMETH);
+        header.priceMeth = pf.get(TAG_PRICEMETH);
+        header.setlMeth = pf.get(TAG_SETLMETH);
+
+        metrics.blocks[segmentSlot].add();
+        metrics.records[segmentSlot].add(store.size() - first.records);
     }
-    else if (segment == "oofpf") {
-
-        // Common root-level tags
-        rec.svf = std::stod(extractTag(block, "svf"));
-
-        std::regex seriesRgx("<series>([\\s\\S]*?)</series>");
-        auto seriesBegin = std::sregex_iterator(block.begin(), block.end(), seriesRgx);
-        auto seriesEnd = std::sregex_iterator();
-
-        for (auto sit = seriesBegin; sit != seriesEnd; ++sit) {
-            std::string series = (*sit)[0];
-
-            rec.expiry = extractTag(series, "pe");
-            rec.settleDate = extractTag(series, "setlDate");
-            rec.volatility = std::stod(extractTag(series, "v"));
-            rec.intraRate = std::stod(extractTag(series, "val")); // it will find interRate as 1st appear
-            rec.priceScan = std::stod(extractTag(series, "priceScan"));
-            rec.volScan = std::stod(extractTag(series, "volScan"));
-            rec.contractId = std::stoi(extractTag(series, "cId"));
-
-            std::regex optRgx("<opt>([\\s\\S]*?)</opt>");
-            auto optBegin = std::sregex_iterator(series.begin(), series.end(), optRgx);
-            auto optEnd = std::sregex_iterator();
-            for (auto oit = optBegin; oit != optEnd; ++oit) {
-                std::string opt = (*oit)[0];
-
-                rec.optContractId = std::stoi(extractTag(opt, "cId"));
-                rec.optionType = extractTag(opt, "o");
-                rec.strikePrice = std::stod(extractTag(opt, "k"));
-                rec.optionValue = std::stod(extractTag(opt, "val"));
-                rec.riskArray = extractRiskArray(opt);
-
-                recs.push_back(rec);
-            }
-        }
+    catch (...) {
+        store.rollback(first);   // never leave half a portfolio behind
+        throw;
     }
 }
 
-std::wstring joinRiskArray(RiskArray riskArray) {
-    std::wstringstream ss;
-    ss << riskArray.r;
+void parseSpanXmlBlock(std::string_view block, std::vector<SpanRecord>& recs) {
+    SpanRecordStore store;
+    parseSpanXmlBlock(block, store);
+    store.appendTo(recs);
+}
 
-    for (size_t i = 0; i < riskArray.a.size(); ++i) {
-        ss << riskArray.a[i];
-        ss << L",";
+// Text layout stored in SpanRecords6.RiskArray, formatted like the default ostream output
+void appendRiskArrayText(int r, const double* a, size_t count, double d, std::string& out) {
+    char buf[32];
+    out.append(buf, (size_t)std::snprintf(buf, sizeof(buf), "%d", r));
+    for (size_t i = 0; i < count; ++i) {
+        out.append(buf, (size_t)std::snprintf(buf, sizeof(buf), "%g", a[i]));
+        out += ',';
     }
-    ss << riskArray.d;
+    out.append(buf, (size_t)std::snprintf(buf, sizeof(buf), "%g", d));
+}
 
-    return ss.str();
+void appendRiskArrayText(const RiskArray& riskArray, std::string& out) {
+    appendRiskArrayText(riskArray.r, riskArray.a.data(), riskArray.a.size(), riskArray.d, out);
 }
 
+std::wstring joinRiskArray(const RiskArray& riskArray) {
+    std::string text;
+    appendRiskArrayText(riskArray, text);
+    return std::wstring(text.begin(), text.end());
+}
+
+#if SPAN_WITH_ODBC
 bool connectToMSSQL(SQLHENV& hEnv, SQLHDBC& hDbc, const std::wstring& connStr) {
     SQLRETURN ret;
     ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &hEnv);
@@ -238,85 +442,44 @@ bool connectToMSSQL(SQLHENV& hEnv, SQLHDBC& hDbc, const std::wstring& connStr) {
     return true;
 }
 
-bool insertSpanRecords(SQLHDBC hDbc, const std::vector<SpanRecord>& records) {
-    SQLHSTMT hStmt;
-    SQLRETURN ret;
-    ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt);
-    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
-        logger.log("hStmt SQLAllocHandle failed.", LogLevel::ERRORS);
-        handleError(SQL_HANDLE_STMT, hStmt, "SQLAllocHandle");
-        return false;
-    }
+static bool finishInsert(SpanInserter& inserter, bool ok, size_t batchSize, InsertStats* stats) {
+    if (ok)
+        ok = inserter.flush();
 
-    const wchar_t* insertSQL =
-        L"INSERT INTO SpanRecords6 (Segment, PfId, PfCode, Currency, CVF, SVF, ValueMeth, PriceMeth, SetlMeth,ContractId, Expiry, Volatility, SettleDate, IntraRate, PriceScan, VolScan, OptContractId, OptionType, StrikePrice, OptionValue, RiskArray) "
-        L"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+    const InsertStats& counters = inserter.stats();
+    logger.log("inserted " + std::to_string(counters.rowsInserted) + " rows, " + std::to_string(counters.rowsFailed) +
+        " rejected, " + std::to_string(counters.batches) + " round trips (batch size " + std::to_string(batchSize) + ")", LogLevel::INFO);
+    if (stats)
+        *stats = counters;
+    return ok && counters.rowsFailed == 0;
+}
 
-    ret = SQLPrepareW(hStmt, (SQLWCHAR*)insertSQL, SQL_NTS);
-    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
-        logger.log("hStmt SQLAllocHandle failed.", LogLevel::ERRORS);
-        handleError(SQL_HANDLE_STMT, hStmt, "SQLAllocHandle");
+bool insertSpanRecords(SQLHDBC hDbc, const std::vector<SpanRecord>& records, size_t batchSize, InsertStats* stats,
+    RiskEncoding riskEncoding) {
+    SpanInserter inserter;
+    if (!inserter.open(hDbc, batchSize, riskEncoding))
         return false;
-    }
 
+    bool ok = true;
     for (const auto& rec : records) {
-
-        // printSpanRecords(rec);
-        std::wstring segment(rec.segment.begin(), rec.segment.end());
-        std::wstring pfCode(rec.pfCode.begin(), rec.pfCode.end());
-        std::wstring currency(rec.currency.begin(), rec.currency.end());
-        std::wstring valueMeth(rec.valueMeth.begin(), rec.valueMeth.end());
-        std::wstring priceMeth(rec.priceMeth.begin(), rec.priceMeth.end());
-        std::wstring setlMeth(rec.setlMeth.begin(), rec.setlMeth.end());
-        std::wstring expiry(rec.expiry.begin(), rec.expiry.end());
-        std::wstring settleDate(rec.settleDate.begin(), rec.settleDate.end());
-        std::wstring optionType(rec.optionType.begin(), rec.optionType.end());
-        std::wstring riskArray = joinRiskArray(rec.riskArray);
-
-        SQLRETURN k[21];
-
-        k[0] = SQLBindParameter(hStmt, 1, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 10, 0, (SQLPOINTER)segment.c_str(), 0, NULL);
-        k[1] = SQLBindParameter(hStmt, 2, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, (SQLPOINTER)&rec.pfId, 0, NULL);
-        k[2] = SQLBindParameter(hStmt, 3, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 50, 0, (SQLPOINTER)pfCode.c_str(), 0, NULL);
-        k[3] = SQLBindParameter(hStmt, 4, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 10, 0, (SQLPOINTER)currency.c_str(), 0, NULL);
-        k[4] = SQLBindParameter(hStmt, 5, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.cvf, 0, NULL);
-        k[5] = SQLBindParameter(hStmt, 6, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.svf, 0, NULL);
-        k[6] = SQLBindParameter(hStmt, 7, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 20, 0, (SQLPOINTER)valueMeth.c_str(), 0, NULL);
-        k[7] = SQLBindParameter(hStmt, 8, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 20, 0, (SQLPOINTER)priceMeth.c_str(), 0, NULL);
-        k[8] = SQLBindParameter(hStmt, 9, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 20, 0, (SQLPOINTER)setlMeth.c_str(), 0, NULL);
-        k[9] = SQLBindParameter(hStmt, 10, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, (SQLPOINTER)&rec.contractId, 0, NULL);
-        k[10] = SQLBindParameter(hStmt, 11, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 10, 0, (SQLPOINTER)expiry.c_str(), 0, NULL);
-        k[11] = SQLBindParameter(hStmt, 12, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.volatility, 0, NULL);
-        k[12] = SQLBindParameter(hStmt, 13, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 10, 0, (SQLPOINTER)settleDate.c_str(), 0, NULL);
-        k[13] = SQLBindParameter(hStmt, 14, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.intraRate, 0, NULL);
-        k[14] = SQLBindParameter(hStmt, 15, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.priceScan, 0, NULL);
-        k[15] = SQLBindParameter(hStmt, 16, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.volScan, 0, NULL);
-        k[16] = SQLBindParameter(hStmt, 17, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, (SQLPOINTER)&rec.optContractId, 0, NULL);
-        k[17] = SQLBindParameter(hStmt, 18, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 1, 0, (SQLPOINTER)optionType.c_str(), 0, NULL);
-        k[18] = SQLBindParameter(hStmt, 19, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.strikePrice, 0, NULL);
-        k[19] = SQLBindParameter(hStmt, 20, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_FLOAT, 0, 0, (SQLPOINTER)&rec.optionValue, 0, NULL);
-        k[20] = SQLBindParameter(hStmt, 21, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 0, 0, (SQLPOINTER)riskArray.c_str(), 0, NULL);
-
-        // Check all return values
-        for (int i = 0; i < 21; i++) {
-            if (k[i] != SQL_SUCCESS && k[i] != SQL_SUCCESS_WITH_INFO) {
-                handleError(SQL_HANDLE_STMT, hStmt, "SQLBindParameter", i + 1);
-                return false;
-            }
-        }
-
-        ret = SQLExecute(hStmt);
-        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
-            logger.log("hStmt SQLExecute failed.", LogLevel::ERRORS);
-            handleError(SQL_HANDLE_STMT, hStmt, "SQLExecute");
-            return false;
+        if (!inserter.add(rec)) {
+            ok = false;
+            break;
         }
-        SQLFreeStmt(hStmt, SQL_RESET_PARAMS);
     }
-    SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
-    return true;
+    return finishInsert(inserter, ok, batchSize, stats);
+}
+
+bool insertSpanRecords(SQLHDBC hDbc, const SpanRecordStore& store, size_t batchSize, InsertStats* stats,
+    RiskEncoding riskEncoding) {
+    SpanInserter inserter;
+    if (!inserter.open(hDbc, batchSize, riskEncoding))
+        return false;
+    return finishInsert(inserter, inserter.addAll(store), batchSize, stats);
 }
 
+#endif // SPAN_WITH_ODBC
+
 void printSpanRecords(const SpanRecord& rec) {
 
     std::cout << "Record " << 1 << ":\n";
@@ -352,6 +515,7 @@ void printSpanRecords(const SpanRecord& rec) {
 
 }
 
+#if SPAN_WITH_ODBC
 // Function to handle and log ODBC errors
 void handleError(SQLSMALLINT handleType, SQLHANDLE handle, const char* functionName, int paramNumber) {
     SQLWCHAR SQLState[6];         // error-code
@@ -372,4 +536,30 @@ void handleError(SQLSMALLINT handleType, SQLHANDLE handle, const char* functionN
             recNumber, wstrFunctionName.c_str(), paramNumber ? L" (Parameter " : L" ", paramNumber, SQLState, nativeError, message);
         recNumber++; // Move to next record
     }
-}
\ No newline at end of file
+}
+
+bool isDataError(SQLSMALLINT handleType, SQLHANDLE handle, std::string& sqlState) {
+    SQLWCHAR state[6];
+    SQLINTEGER nativeError;
+    SQLWCHAR message[1024];
+    SQLSMALLINT length;
+    bool dataError = false;
+    sqlState.clear();
+
+    for (SQLSMALLINT recNumber = 1;; ++recNumber) {
+        SQLRETURN ret = SQLGetDiagRecW(handleType, handle, recNumber, state, &nativeError, message,
+            sizeof(message) / sizeof(SQLWCHAR), &length);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO)
+            break;
+        std::string code(state, state + 5);
+        if (code.compare(0, 2, "01") == 0)
+            continue;   // warning
+        if (sqlState.empty())
+            sqlState = code;
+        if (code.compare(0, 2, "22") != 0 && code.compare(0, 2, "23") != 0)
+            return false;
+        dataError = true;
+    }
+    return dataError;
+}
+#endif // SPAN_WITH_ODBC
@@ -3,18 +3,16 @@
 #define SPAN_PARSER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include "build-config.h"
+#include "risk-codec.h"
+#if SPAN_WITH_ODBC
 #include <windows.h>
 #include <sqlext.h>
 #include <sqltypes.h>
 #include <sql.h>
-
-// Risk array structure from <ra>
-struct RiskArray {
-    int r = 0;                  // <r>
-    std::vector<double> a;     // <a> values
-    double d = 0.0;            // <d>
-};
+#endif
 
 // Main record for all segments (phypf, futpf, oofpf)
 struct SpanRecord {
@@ -52,17 +50,32 @@ struct SpanRecord {
 
 
 
+class SpanRecordStore;
+
 // Tag extractors and XML parsing
 bool readConnectionString(const std::string& filePath, std::wstring& connStr);
-std::string extractTag(const std::string& block, const std::string& tag);
-RiskArray extractRiskArray(const std::string& block);
-void parseSpanXmlBlock(const std::string& block, std::vector<SpanRecord>& recs);
-std::wstring joinRiskArray(RiskArray riskArray);
+std::string_view extractTag(std::string_view block, std::string_view tag);
+RiskArray extractRiskArray(std::string_view block);
+void parseSpanXmlBlock(std::string_view block, SpanRecordStore& store);
+void parseSpanXmlBlock(std::string_view block, std::vector<SpanRecord>& recs);
+std::wstring joinRiskArray(const RiskArray& riskArray);
+void appendRiskArrayText(const RiskArray& riskArray, std::string& out);
+void appendRiskArrayText(int r, const double* a, size_t count, double d, std::string& out);
 
+#if SPAN_WITH_ODBC
 // DB functions
 bool connectToMSSQL(SQLHENV& hEnv, SQLHDBC& hDbc, const std::wstring& connStr);
-bool insertSpanRecords(SQLHDBC hDbc, const std::vector<SpanRecord>& records);
+struct InsertStats;
+bool insertSpanRecords(SQLHDBC hDbc, const std::vector<SpanRecord>& records, size_t batchSize = 1000, InsertStats* stats = nullptr,
+    RiskEncoding riskEncoding = RiskEncoding::Legacy);
+bool insertSpanRecords(SQLHDBC hDbc, const SpanRecordStore& store, size_t batchSize = 1000, InsertStats* stats = nullptr,
+    RiskEncoding riskEncoding = RiskEncoding::Legacy);
 void handleError(SQLSMALLINT handleType, SQLHANDLE handle, const char* functionName, int paramNumber = 0);
+// True when the diagnostics of the last call on handle are data errors only
+// (SQLSTATE class 22 or 23, warnings aside): the rows were bad, not the
+// connection or transaction. sqlState receives the first error's SQLSTATE.
+bool isDataError(SQLSMALLINT handleType, SQLHANDLE handle, std::string& sqlState);
+#endif // SPAN_WITH_ODBC
 
 void printSpanRecords(const SpanRecord& records);
 
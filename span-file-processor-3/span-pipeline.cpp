@@ -0,0 +1,189 @@
+#include "span-pipeline.h"
+#include "parallel-parser.h"
+#include "span-tokenizer.h"
+#include "bounded-queue.h"
+#include "load-checkpoint.h"
+#include "logger.h"
+#include "metrics.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern Logger logger;
+
+bool runStreamingLoad(std::string_view data, RecordSink& sink, const PipelineOptions& opts, PipelineStats& stats) {
+    size_t pos = opts.startOffset;
+    return runStreamingLoad([data, &pos](PortfolioBlock& item) {
+        if (!nextPortfolioBlock(data, pos, item.text))
+            return false;
+        item.endOffset = pos;
+        return true;
+    }, sink, opts, stats);
+}
+
+bool runStreamingLoad(const std::function<bool(PortfolioBlock&)>& nextBlock, RecordSink& sink, const PipelineOptions& opts,
+    PipelineStats& stats) {
+    stats = PipelineStats();
+    const int parseThreads = opts.parseThreads > 0 ? opts.parseThreads : 1;
+    const size_t window = opts.maxBlocksInFlight ? opts.maxBlocksInFlight : 1;
+
+    BoundedQueue<PortfolioBlock> blockQueue(window);
+    BoundedQueue<ParsedBlock> parsedQueue(window);
+
+    std::atomic<bool> stop(false);
+    std::exception_ptr parseError;
+    std::mutex errorMutex;
+
+    // Blocks handed out by the reader and not yet written
+    size_t inFlight = 0;
+    std::mutex gateMutex;
+    std::condition_variable gateCv;
+
+    auto abort = [&] {
+        stop = true;
+        blockQueue.close();
+        parsedQueue.close();
+        std::lock_guard<std::mutex> lock(gateMutex);
+        gateCv.notify_all();
+    };
+
+    std::thread reader([&] {
+        PortfolioBlock block;
+        size_t index = opts.firstIndex;
+        while (!stop && nextBlock(block)) {
+            {
+                std::unique_lock<std::mutex> lock(gateMutex);
+                gateCv.wait(lock, [&] { return stop || inFlight < window; });
+                if (stop)
+                    break;
+                ++inFlight;
+            }
+            block.index = index++;
+            if (!blockQueue.push(std::move(block)))
+                break;
+            block = PortfolioBlock();
+        }
+        blockQueue.close();
+    });
+
+    std::atomic<int> parsersLeft(parseThreads);
+    std::vector<std::thread> parsers;
+    for (int t = 0; t < parseThreads; ++t) {
+        parsers.emplace_back([&] {
+            PortfolioBlock item;
+            while (!stop && blockQueue.pop(item)) {
+                ParsedBlock out;
+                out.index = item.index;
+                out.endOffset = item.endOffset;
+                bool parsed = true;
+                auto keepError = [&] {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!parseError)
+                        parseError = std::current_exception();
+                    parsed = false;
+                };
+                try {
+                    parseSpanXmlBlock(item.text, out.records);
+                }
+                catch (const std::exception& e) {
+                    // The parser rolled the block back, so it goes on as an empty block
+                    if (opts.quarantine)
+                        opts.quarantine->add(item.index, item.endOffset, item.text, e.what());
+                    else
+                        keepError();
+                }
+                catch (...) {
+                    keepError();
+                }
+                if (!parsed) {
+                    abort();
+                    break;
+                }
+                if (!parsedQueue.push(std::move(out)))
+                    break;
+            }
+            if (--parsersLeft == 0)
+                parsedQueue.close();
+        });
+    }
+
+    // Sink stage on this thread
+    bool ok = true;
+    size_t nextIndex = opts.firstIndex;
+    std::map<size_t, ParsedBlock> pending;   // ordered mode: blocks that arrived early
+
+    auto insertBlock = [&](ParsedBlock& pb) {
+        {
+            ScopedTimer timer(metrics.sinkWriteNs);
+            if (!sink.write(pb.records))
+                return false;
+        }
+        stats.blocks++;
+        stats.records += pb.records.size();
+        {
+            std::lock_guard<std::mutex> lock(gateMutex);
+            --inFlight;
+        }
+        gateCv.notify_one();
+        return !opts.onWritten || opts.onWritten(pb);
+    };
+
+    // Blocks written out of order, index -> end offset, until the prefix before them is done
+    std::map<size_t, size_t> doneEnds;
+    size_t nextConsumed = opts.firstIndex;
+    auto markDone = [&](const ParsedBlock& done) {
+        if (!opts.onConsumed)
+            return;
+        doneEnds.emplace(done.index, done.endOffset);
+        size_t consumed = 0;
+        while (!doneEnds.empty() && doneEnds.begin()->first == nextConsumed) {
+            consumed = doneEnds.begin()->second;
+            doneEnds.erase(doneEnds.begin());
+            ++nextConsumed;
+        }
+        if (consumed)
+            opts.onConsumed(consumed);
+    };
+
+    ParsedBlock pb;
+    while (ok && parsedQueue.pop(pb)) {
+        if (!opts.ordered) {
+            ok = insertBlock(pb);
+            if (ok)
+                markDone(pb);
+            continue;
+        }
+        pending.emplace(pb.index, std::move(pb));
+        while (ok && !pending.empty() && pending.begin()->first == nextIndex) {
+            ok = insertBlock(pending.begin()->second);
+            if (ok)
+                markDone(pending.begin()->second);
+            pending.erase(pending.begin());
+            ++nextIndex;
+        }
+    }
+    if (!ok)
+        abort();
+
+    reader.join();
+    for (auto& p : parsers)
+        p.join();
+
+    // A parse error, a source that broke off or a failed write: the sink is
+    // aborted so the blocks written so far do not pass for a complete load
+    if (stop || parseError || (opts.sourceFailed && opts.sourceFailed()))
+        ok = false;
+    if (ok)
+        ok = sink.finish();
+    else
+        sink.abort();
+
+    stats.insert = sink.stats();
+    if (parseError)
+        std::rethrow_exception(parseError);
+    return ok;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef SPAN_PIPELINE_H
+#define SPAN_PIPELINE_H
+
+#include "span-parser.h"
+#include "record-sink.h"
+#include "parallel-parser.h"
+#include <functional>
+#include <string_view>
+
+class BlockQuarantine;
+
+struct PipelineOptions {
+    int parseThreads = 1;
+    bool ordered = true;            // write blocks in file order
+    size_t maxBlocksInFlight = 64;  // blocks read but not yet written
+
+    // Called with the offset up to which every block has been parsed and
+    // written, e.g. to release mapped pages
+    std::function<void(size_t)> onConsumed;
+
+    // Resuming: text before startOffset is skipped without being parsed and
+    // block indexes count on from firstIndex
+    size_t startOffset = 0;
+    size_t firstIndex = 0;
+
+    // Blocks that fail to parse are set aside here and written as empty
+    // blocks; without a quarantine the first parse error stops the load
+    BlockQuarantine* quarantine = nullptr;
+
+    // Called after each block was written to the sink (in file order unless
+    // unordered), e.g. to commit and checkpoint; false stops the load
+    std::function<bool(const ParsedBlock&)> onWritten;
+
+    // Asked once the reader is done: true if nextBlock returned false on an
+    // error (e.g. corrupt compressed input) rather than at the end
+    std::function<bool()> sourceFailed;
+};
+
+struct PipelineStats {
+    size_t blocks = 0;
+    size_t records = 0;
+    InsertStats insert;
+};
+
+// Streams a SPAN buffer into a sink: a reader thread splits portfolio blocks,
+// parseThreads workers parse them and the calling thread writes each block to
+// the sink as soon as it is parsed, then calls sink.finish(), or sink.abort()
+// if anything failed. Bounded queues plus the in-flight limit keep memory
+// independent of file size (as far as the sink itself does not collect).
+// Returns false if the sink or the source failed; rethrows the first parse
+// error unless blocks are quarantined.
+bool runStreamingLoad(std::string_view data, RecordSink& sink, const PipelineOptions& opts, PipelineStats& stats);
+
+// Same pipeline, with the reader thread pulling blocks from nextBlock (which
+// fills text, endOffset and owner) until it returns false, e.g. blocks cut from
+// a decompression stream. Each block's owner is held until it is parsed.
+bool runStreamingLoad(const std::function<bool(PortfolioBlock&)>& nextBlock, RecordSink& sink, const PipelineOptions& opts,
+    PipelineStats& stats);
+
+#endif // SPAN_PIPELINE_H
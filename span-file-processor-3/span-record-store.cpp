@@ -0,0 +1,210 @@
+#include "span-record-store.h"
+#include <utility>
+
+SpanRecordRef makeRecordRef(const SpanRecord& rec) {
+    SpanRecordRef ref;
+    ref.segment = rec.segment;
+    ref.pfId = rec.pfId;
+    ref.pfCode = rec.pfCode;
+    ref.currency = rec.currency;
+    ref.cvf = rec.cvf;
+    ref.svf = rec.svf;
+    ref.valueMeth = rec.valueMeth;
+    ref.priceMeth = rec.priceMeth;
+    ref.setlMeth = rec.setlMeth;
+    ref.contractId = rec.contractId;
+    ref.expiry = rec.expiry;
+    ref.volatility = rec.volatility;
+    ref.settleDate = rec.settleDate;
+    ref.intraRate = rec.intraRate;
+    ref.priceScan = rec.priceScan;
+    ref.volScan = rec.volScan;
+    ref.optContractId = rec.optContractId;
+    ref.optionType = rec.optionType;
+    ref.strikePrice = rec.strikePrice;
+    ref.optionValue = rec.optionValue;
+    ref.riskR = rec.riskArray.r;
+    ref.riskValues = rec.riskArray.a.data();
+    ref.riskCount = rec.riskArray.a.size();
+    ref.riskD = rec.riskArray.d;
+    return ref;
+}
+
+SpanRecordRef SpanRecordStore::ref(size_t i) const {
+    const CompactRecord& rec = records[i];
+    const PortfolioHeader& pf = portfolios[rec.portfolio];
+
+    SpanRecordRef ref;
+    ref.segment = pf.segment;
+    ref.pfId = pf.pfId;
+    ref.pfCode = pf.pfCode;
+    ref.currency = pf.currency;
+    ref.cvf = pf.cvf;
+    ref.svf = pf.svf;
+    ref.valueMeth = pf.valueMeth;
+    ref.priceMeth = pf.priceMeth;
+    ref.setlMeth = pf.setlMeth;
+    ref.contractId = rec.contractId;
+    ref.expiry = rec.expiry.view();
+    ref.volatility = rec.volatility;
+    ref.settleDate = rec.settleDate.view();
+    ref.intraRate = rec.intraRate;
+    ref.priceScan = rec.priceScan;
+    ref.volScan = rec.volScan;
+    ref.optContractId = rec.optContractId;
+    ref.optionType = rec.optionType.view();
+    ref.strikePrice = rec.strikePrice;
+    ref.optionValue = rec.optionValue;
+    ref.riskR = rec.riskR;
+    ref.riskValues = riskValues.data() + rec.riskOffset;
+    ref.riskCount = rec.riskCount;
+    ref.riskD = rec.riskD;
+    ref.truncatedField = rec.expiry.truncated ? "expiry" : rec.settleDate.truncated ? "settleDate" :
+        rec.optionType.truncated ? "optionType" : nullptr;
+    return ref;
+}
+
+SpanRecord SpanRecordStore::toRecord(size_t i) const {
+    SpanRecordRef r = ref(i);
+    SpanRecord rec;
+    rec.segment = r.segment;
+    rec.pfId = r.pfId;
+    rec.pfCode = r.pfCode;
+    rec.currency = r.currency;
+    rec.cvf = r.cvf;
+    rec.svf = r.svf;
+    rec.valueMeth = r.valueMeth;
+    rec.priceMeth = r.priceMeth;
+    rec.setlMeth = r.setlMeth;
+    rec.contractId = r.contractId;
+    rec.expiry = r.expiry;
+    rec.volatility = r.volatility;
+    rec.settleDate = r.settleDate;
+    rec.intraRate = r.intraRate;
+    rec.priceScan = r.priceScan;
+    rec.volScan = r.volScan;
+    rec.optContractId = r.optContractId;
+    rec.optionType = r.optionType;
+    rec.strikePrice = r.strikePrice;
+    rec.optionValue = r.optionValue;
+    rec.riskArray.r = r.riskR;
+    rec.riskArray.a.assign(r.riskValues, r.riskValues + r.riskCount);
+    rec.riskArray.d = r.riskD;
+    return rec;
+}
+
+void SpanRecordStore::appendTo(std::vector<SpanRecord>& out) const {
+    for (size_t i = 0; i < records.size(); ++i)
+        out.push_back(toRecord(i));
+}
+
+void SpanRecordStore::rollback(const Mark& m) {
+    portfolios.resize(m.portfolios);
+    records.resize(m.records);
+    riskValues.resize(m.riskValues);
+    seriesTotal = m.series;
+    sectionRecords.rollback(m.sections);
+}
+
+void SpanRecordStore::append(SpanRecordStore&& other) {
+    if (portfolios.empty() && sectionRecords.empty() && records.capacity() <= other.records.capacity() &&
+        riskValues.capacity() <= other.riskValues.capacity()) {
+        *this = std::move(other);
+        return;
+    }
+    const uint32_t pfBase = (uint32_t)portfolios.size();
+    const uint32_t seriesBase = seriesTotal;
+    const size_t riskBase = riskValues.size();
+
+    portfolios.insert(portfolios.end(), std::make_move_iterator(other.portfolios.begin()), std::make_move_iterator(other.portfolios.end()));
+    riskValues.insert(riskValues.end(), other.riskValues.begin(), other.riskValues.end());
+    records.reserve(records.size() + other.records.size());
+    for (const CompactRecord& rec : other.records) {
+        records.push_back(rec);
+        records.back().portfolio += pfBase;
+        records.back().series += seriesBase;
+        records.back().riskOffset += riskBase;
+    }
+    seriesTotal += other.seriesTotal;
+    sectionRecords.append(other.sectionRecords);
+    other.clear();
+}
+
+void SpanRecordStore::clear() {
+    portfolios.clear();
+    records.clear();
+    riskValues.clear();
+    seriesTotal = 0;
+    sectionRecords.clear();
+}
+
+void SpanRecordStore::reserve(size_t recordCount, size_t riskValueCount) {
+    records.reserve(recordCount);
+    riskValues.reserve(riskValueCount);
+}
+
+void SpanRecordStore::shrinkToFit() {
+    portfolios.shrink_to_fit();
+    records.shrink_to_fit();
+    riskValues.shrink_to_fit();
+}
+
+// Heap part of a std::string; short strings live inside the object (SSO)
+static size_t stringHeapBytes(const std::string& s) {
+    const char* p = s.data();
+    const char* self = (const char*)&s;
+    if (p >= self && p < self + sizeof(std::string))
+        return 0;
+    return s.capacity() + 1;
+}
+
+static size_t stringHeapBlocks(const std::string& s) {
+    return stringHeapBytes(s) ? 1 : 0;
+}
+
+static size_t headerHeapBytes(const PortfolioHeader& pf) {
+    return stringHeapBytes(pf.segment) + stringHeapBytes(pf.pfCode) + stringHeapBytes(pf.currency) +
+        stringHeapBytes(pf.valueMeth) + stringHeapBytes(pf.priceMeth) + stringHeapBytes(pf.setlMeth);
+}
+
+static size_t headerHeapBlocks(const PortfolioHeader& pf) {
+    return stringHeapBlocks(pf.segment) + stringHeapBlocks(pf.pfCode) + stringHeapBlocks(pf.currency) +
+        stringHeapBlocks(pf.valueMeth) + stringHeapBlocks(pf.priceMeth) + stringHeapBlocks(pf.setlMeth);
+}
+
+size_t SpanRecordStore::bytesUsed() const {
+    size_t bytes = portfolios.capacity() * sizeof(PortfolioHeader) + records.capacity() * sizeof(CompactRecord) +
+        riskValues.capacity() * sizeof(double) + sectionRecords.bytesUsed();
+    for (const auto& pf : portfolios)
+        bytes += headerHeapBytes(pf);
+    return bytes;
+}
+
+size_t SpanRecordStore::heapBlocks() const {
+    size_t blocks = (portfolios.capacity() ? 1 : 0) + (records.capacity() ? 1 : 0) + (riskValues.capacity() ? 1 : 0);
+    for (const auto& pf : portfolios)
+        blocks += headerHeapBlocks(pf);
+    return blocks;
+}
+
+size_t recordVectorBytes(const std::vector<SpanRecord>& recs) {
+    size_t bytes = recs.capacity() * sizeof(SpanRecord);
+    for (const auto& rec : recs) {
+        bytes += stringHeapBytes(rec.segment) + stringHeapBytes(rec.pfCode) + stringHeapBytes(rec.currency) +
+            stringHeapBytes(rec.valueMeth) + stringHeapBytes(rec.priceMeth) + stringHeapBytes(rec.setlMeth) +
+            stringHeapBytes(rec.expiry) + stringHeapBytes(rec.settleDate) + stringHeapBytes(rec.optionType);
+        bytes += rec.riskArray.a.capacity() * sizeof(double);
+    }
+    return bytes;
+}
+
+size_t recordVectorHeapBlocks(const std::vector<SpanRecord>& recs) {
+    size_t blocks = recs.capacity() ? 1 : 0;
+    for (const auto& rec : recs) {
+        blocks += stringHeapBlocks(rec.segment) + stringHeapBlocks(rec.pfCode) + stringHeapBlocks(rec.currency) +
+            stringHeapBlocks(rec.valueMeth) + stringHeapBlocks(rec.priceMeth) + stringHeapBlocks(rec.setlMeth) +
+            stringHeapBlocks(rec.expiry) + stringHeapBlocks(rec.settleDate) + stringHeapBlocks(rec.optionType);
+        blocks += rec.riskArray.a.capacity() ? 1 : 0;
+    }
+    return blocks;
+}
@@ -0,0 +1,172 @@
+#pragma once
+#ifndef SPAN_RECORD_STORE_H
+#define SPAN_RECORD_STORE_H
+
+#include "span-parser.h"
+#include "fixed-text.h"
+#include "span-sections.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Portfolio header shared by every record of one <phyPf>/<futPf>/<oofPf> block
+struct PortfolioHeader {
+    std::string segment;
+    int pfId = 0;
+    std::string pfCode;
+    std::string currency;
+    double cvf = 0.0;
+    double svf = 0.0;
+    std::string valueMeth;
+    std::string priceMeth;
+    std::string setlMeth;
+};
+
+// Per-contract/option part of a SpanRecord; strings live in the header,
+// risk-array values in the store's arena
+struct CompactRecord {
+    uint32_t portfolio = 0;
+    int contractId = 0;
+    int optContractId = 0;
+    int riskR = 0;
+    size_t riskOffset = 0;
+    uint32_t riskCount = 0;
+    uint32_t series = 0;        // contract/option series within the store, shared by its options
+    int underlyingPfId = 0;     // options: portfolio of the underlying contractId (<undC>)
+
+    double volatility = 0.0;
+    double intraRate = 0.0;
+    double priceScan = 0.0;
+    double volScan = 0.0;
+    double strikePrice = 0.0;
+    double optionValue = 0.0;
+    double riskD = 0.0;
+    double price = 0.0;         // <p>: settlement price of the physical, future or option
+    double timeToExpiry = 0.0;  // <t> of the future or option series, in years
+
+    FixedText<10> expiry;
+    FixedText<10> settleDate;
+    FixedText<1> optionType;
+};
+
+// A contract or option across files: optContractId is 0 for futures and physicals
+struct ContractKey {
+    int pfId, contractId, optContractId;
+    bool operator==(const ContractKey& o) const {
+        return pfId == o.pfId && contractId == o.contractId && optContractId == o.optContractId;
+    }
+};
+
+struct ContractKeyHash {
+    size_t operator()(const ContractKey& k) const {
+        uint64_t h = (uint64_t)(uint32_t)k.pfId * 0x9E3779B97F4A7C15ULL;
+        h ^= ((uint64_t)(uint32_t)k.contractId << 32 | (uint32_t)k.optContractId) * 0xBF58476D1CE4E5B9ULL;
+        return (size_t)(h ^ (h >> 29));
+    }
+};
+
+// Read-only view of one record, whichever representation it comes from
+struct SpanRecordRef {
+    std::string_view segment;
+    int pfId = 0;
+    std::string_view pfCode;
+    std::string_view currency;
+    double cvf = 0.0;
+    double svf = 0.0;
+    std::string_view valueMeth;
+    std::string_view priceMeth;
+    std::string_view setlMeth;
+    int contractId = 0;
+    std::string_view expiry;
+    double volatility = 0.0;
+    std::string_view settleDate;
+    double intraRate = 0.0;
+    double priceScan = 0.0;
+    double volScan = 0.0;
+    int optContractId = 0;
+    std::string_view optionType;
+    double strikePrice = 0.0;
+    double optionValue = 0.0;
+    int riskR = 0;
+    const double* riskValues = nullptr;
+    size_t riskCount = 0;
+    double riskD = 0.0;
+    const char* truncatedField = nullptr;   // name of a fixed-width field that did not fit
+};
+
+SpanRecordRef makeRecordRef(const SpanRecord& rec);
+
+// Records of one or more portfolio blocks: headers once per portfolio, records
+// as a flat array, risk-array values in one contiguous arena. Section blocks
+// (ccDef, spreads, currency conversions) land in sections().
+class SpanRecordStore {
+public:
+    struct Mark {
+        size_t portfolios = 0;
+        size_t records = 0;
+        size_t riskValues = 0;
+        uint32_t series = 0;
+        SpanSections::Mark sections;
+    };
+
+    size_t size() const { return records.size(); }
+    bool empty() const { return records.empty(); }
+    size_t portfolioCount() const { return portfolios.size(); }
+
+    uint32_t addPortfolio() {
+        portfolios.emplace_back();
+        return (uint32_t)(portfolios.size() - 1);
+    }
+    PortfolioHeader& portfolio(uint32_t index) { return portfolios[index]; }
+    const PortfolioHeader& portfolio(uint32_t index) const { return portfolios[index]; }
+
+    // Series are numbered as the parser opens them; records carry the number
+    uint32_t addSeries() { return seriesTotal++; }
+    uint32_t seriesCount() const { return seriesTotal; }
+
+    CompactRecord& addRecord(uint32_t portfolioIndex) {
+        records.emplace_back();
+        records.back().portfolio = portfolioIndex;
+        return records.back();
+    }
+    CompactRecord& record(size_t i) { return records[i]; }
+    const CompactRecord& record(size_t i) const { return records[i]; }
+
+    size_t riskSize() const { return riskValues.size(); }
+    void pushRisk(double value) { riskValues.push_back(value); }
+    const double* risk(const CompactRecord& rec) const { return riskValues.data() + rec.riskOffset; }
+
+    SpanSections& sections() { return sectionRecords; }
+    const SpanSections& sections() const { return sectionRecords; }
+
+    SpanRecordRef ref(size_t i) const;
+    SpanRecord toRecord(size_t i) const;
+    void appendTo(std::vector<SpanRecord>& out) const;
+
+    // Drop everything added since mark (used when a block fails to parse)
+    Mark mark() const { return Mark{ portfolios.size(), records.size(), riskValues.size(), seriesTotal, sectionRecords.mark() }; }
+    void rollback(const Mark& m);
+
+    void append(SpanRecordStore&& other);
+    void clear();
+    void reserve(size_t recordCount, size_t riskValueCount);
+    void shrinkToFit();
+
+    // Owned heap bytes and heap blocks, for comparison with std::vector<SpanRecord>
+    size_t bytesUsed() const;
+    size_t heapBlocks() const;
+
+private:
+    std::vector<PortfolioHeader> portfolios;
+    std::vector<CompactRecord> records;
+    std::vector<double> riskValues;
+    uint32_t seriesTotal = 0;
+    SpanSections sectionRecords;
+};
+
+// Same accounting for the one-struct-per-record representation
+size_t recordVectorBytes(const std::vector<SpanRecord>& recs);
+size_t recordVectorHeapBlocks(const std::vector<SpanRecord>& recs);
+
+#endif // SPAN_RECORD_STORE_H
@@ -0,0 +1,75 @@
+#include "span-schema.h"
+#include "span-parser.h"
+
+// INT columns are 4 bytes, FLOAT and BIGINT 8
+static const size_t intBytes = 4;
+static const size_t floatBytes = 8;
+
+bool parseOutputSchema(const std::string& name, OutputSchema& schema) {
+    if (name == "wide")
+        schema = OutputSchema::Wide;
+    else if (name == "normalized")
+        schema = OutputSchema::Normalized;
+    else
+        return false;
+    return true;
+}
+
+void appendRiskArray(RiskEncoding encoding, int r, const double* a, size_t count, double d, std::string& out) {
+    switch (encoding) {
+    case RiskEncoding::Binary:
+        appendRiskArrayBinary(r, a, count, d, out);
+        break;
+    case RiskEncoding::Text:
+        appendRiskArrayLossless(r, a, count, d, out);
+        break;
+    default:
+        appendRiskArrayText(r, a, count, d, out);
+        break;
+    }
+}
+
+size_t wideRowBytes(const SpanRecordRef& rec, size_t riskBytes) {
+    return rec.segment.size() + rec.pfCode.size() + rec.currency.size() + rec.valueMeth.size() + rec.priceMeth.size() +
+        rec.setlMeth.size() + rec.expiry.size() + rec.settleDate.size() + rec.optionType.size() +
+        3 * intBytes + 8 * floatBytes + riskBytes;
+}
+
+size_t portfolioRowBytes(const PortfolioHeader& pf) {
+    return pf.segment.size() + pf.pfCode.size() + pf.currency.size() + pf.valueMeth.size() + pf.priceMeth.size() +
+        pf.setlMeth.size() + intBytes + 3 * floatBytes;
+}
+
+size_t seriesRowBytes(const CompactRecord& rec) {
+    return rec.expiry.view().size() + rec.settleDate.view().size() + intBytes + 6 * floatBytes;
+}
+
+size_t optionRowBytes(const CompactRecord& rec, size_t riskBytes) {
+    return rec.optionType.view().size() + intBytes + 3 * floatBytes + riskBytes;
+}
+
+SchemaFootprint measureSchemas(const SpanRecordStore& store, RiskEncoding encoding) {
+    SchemaFootprint fp;
+    std::string risk;
+    for (size_t i = 0; i < store.size(); ++i) {
+        const CompactRecord& rec = store.record(i);
+        risk.clear();
+        appendRiskArray(encoding, rec.riskR, store.risk(rec), rec.riskCount, rec.riskD, risk);
+
+        fp.wideRows++;
+        fp.wideBytes += wideRowBytes(store.ref(i), risk.size());
+
+        // A portfolio's records, and a series' records, are contiguous
+        if (i == 0 || rec.portfolio != store.record(i - 1).portfolio) {
+            fp.portfolioRows++;
+            fp.normalizedBytes += portfolioRowBytes(store.portfolio(rec.portfolio));
+        }
+        if (i == 0 || rec.series != store.record(i - 1).series) {
+            fp.seriesRows++;
+            fp.normalizedBytes += seriesRowBytes(rec);
+        }
+        fp.optionRows++;
+        fp.normalizedBytes += optionRowBytes(rec, risk.size());
+    }
+    return fp;
+}
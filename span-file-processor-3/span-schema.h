@@ -0,0 +1,49 @@
+#pragma once
+#ifndef SPAN_SCHEMA_H
+#define SPAN_SCHEMA_H
+
+#include "span-record-store.h"
+#include "risk-codec.h"
+#include <cstddef>
+#include <string>
+
+// Output schemas of the ODBC load. Wide is SpanRecords6, one row per contract
+// or option with the portfolio header and series fields repeated on each.
+// Normalized (--schema normalized) writes every header once, linked by
+// surrogate keys the loader assigns in memory (created by the DBA):
+//   SpanPortfolios (PfKey BIGINT PRIMARY KEY, Segment NVARCHAR(10), PfId INT, PfCode NVARCHAR(50), Currency NVARCHAR(10),
+//                   CVF FLOAT, SVF FLOAT, ValueMeth NVARCHAR(20), PriceMeth NVARCHAR(20), SetlMeth NVARCHAR(20))
+//   SpanSeries (SeriesKey BIGINT PRIMARY KEY, PfKey BIGINT REFERENCES SpanPortfolios, ContractId INT, Expiry NVARCHAR(10),
+//               Volatility FLOAT, SettleDate NVARCHAR(10), IntraRate FLOAT, PriceScan FLOAT, VolScan FLOAT)
+//   SpanOptions (SeriesKey BIGINT REFERENCES SpanSeries, OptContractId INT, OptionType NVARCHAR(1), StrikePrice FLOAT,
+//                OptionValue FLOAT, RiskArray NVARCHAR(MAX) or, with --risk-format binary, RiskArrayBin VARBINARY(MAX))
+// A series is one <phy>/<fut> contract or one <series> of options. SpanOptions
+// has one row per SpanRecords6 row (OptContractId 0 for contracts), so joining
+// the three tables on their keys gives back the SpanRecords6 rows.
+enum class OutputSchema { Wide, Normalized };
+
+bool parseOutputSchema(const std::string& name, OutputSchema& schema);
+
+// The risk array as the inserters send it
+void appendRiskArray(RiskEncoding encoding, int r, const double* a, size_t count, double d, std::string& out);
+
+// Parameter bytes of one row, counted the same way for both schemas: text
+// length, 4 per INT, 8 per FLOAT/BIGINT, plus the encoded risk array
+size_t wideRowBytes(const SpanRecordRef& rec, size_t riskBytes);
+size_t portfolioRowBytes(const PortfolioHeader& pf);
+size_t seriesRowBytes(const CompactRecord& rec);
+size_t optionRowBytes(const CompactRecord& rec, size_t riskBytes);
+
+struct SchemaFootprint {
+    size_t wideRows = 0;
+    size_t wideBytes = 0;
+    size_t portfolioRows = 0;
+    size_t seriesRows = 0;
+    size_t optionRows = 0;
+    size_t normalizedBytes = 0;
+};
+
+// What each schema would send for the records of store
+SchemaFootprint measureSchemas(const SpanRecordStore& store, RiskEncoding encoding);
+
+#endif // SPAN_SCHEMA_H
@@ -0,0 +1,232 @@
+#include "span-sections.h"
+#include "span-tokenizer.h"
+#include "tag-hash.h"
+#include "metrics.h"
+
+void SpanSections::rollback(const Mark& m) {
+    conversions.resize(m.conversions);
+    commodities.resize(m.commodities);
+    links.resize(m.links);
+    spreads.resize(m.spreads);
+    legs.resize(m.legs);
+}
+
+void SpanSections::append(const SpanSections& other) {
+    conversions.insert(conversions.end(), other.conversions.begin(), other.conversions.end());
+    commodities.insert(commodities.end(), other.commodities.begin(), other.commodities.end());
+    links.insert(links.end(), other.links.begin(), other.links.end());
+    spreads.insert(spreads.end(), other.spreads.begin(), other.spreads.end());
+    legs.insert(legs.end(), other.legs.begin(), other.legs.end());
+}
+
+void SpanSections::clear() {
+    conversions.clear();
+    commodities.clear();
+    links.clear();
+    spreads.clear();
+    legs.clear();
+}
+
+size_t SpanSections::bytesUsed() const {
+    return conversions.capacity() * sizeof(CurrencyConversion) + commodities.capacity() * sizeof(CombinedCommodity) +
+        links.capacity() * sizeof(CommodityLink) + spreads.capacity() * sizeof(SpreadDef) + legs.capacity() * sizeof(SpreadLeg);
+}
+
+namespace {
+
+// Elements that open a record (or, for rate, a value of the enclosing spread)
+enum SectionElement {
+    EL_CURCONV, EL_CCDEF, EL_INTERSPREADS, EL_PFLINK, EL_DSPREAD, EL_RATE, EL_TLEG, EL_PLEG,
+    EL_COUNT, EL_ROOT = EL_COUNT
+};
+
+constexpr TagTable<EL_COUNT> sectionElements({ "curConv", "ccDef", "interSpreads", "pfLink", "dSpread", "rate", "tLeg", "pLeg" });
+
+// Where each element is recognized: bit p set if it may be a direct child of element p
+constexpr unsigned allowedParents[EL_COUNT] = {
+    1u << EL_ROOT,                              // curConv
+    1u << EL_ROOT,                              // ccDef
+    1u << EL_ROOT,                              // interSpreads
+    1u << EL_CCDEF,                             // pfLink
+    (1u << EL_CCDEF) | (1u << EL_INTERSPREADS), // dSpread
+    1u << EL_DSPREAD,                           // rate
+    1u << EL_DSPREAD,                           // tLeg
+    1u << EL_DSPREAD,                           // pLeg
+};
+
+// <rate> of a spread: tier r and the charge val
+struct SpreadRate {
+    int r = 0;
+    double val = 0.0;
+};
+
+constexpr auto curConvFields = makeFieldTable<CurrencyConversion>({
+    { "fromCur", [](CurrencyConversion& c, std::string_view v) { c.fromCur.assign(v); } },
+    { "toCur", [](CurrencyConversion& c, std::string_view v) { c.toCur.assign(v); } },
+    { "factor", [](CurrencyConversion& c, std::string_view v) { c.factor = parseDouble(v); } },
+});
+
+constexpr auto ccDefFields = makeFieldTable<CombinedCommodity>({
+    { "cc", [](CombinedCommodity& c, std::string_view v) { c.ccCode.assign(v); } },
+    { "name", [](CombinedCommodity& c, std::string_view v) { c.name.assign(v); } },
+    { "currency", [](CombinedCommodity& c, std::string_view v) { c.currency.assign(v); } },
+    { "riskExponent", [](CombinedCommodity& c, std::string_view v) { c.riskExponent = parseInt(v); } },
+    { "marginMeth", [](CombinedCommodity& c, std::string_view v) { c.marginMeth.assign(v); } },
+});
+
+constexpr auto pfLinkFields = makeFieldTable<CommodityLink>({
+    { "pfId", [](CommodityLink& l, std::string_view v) { l.pfId = parseInt(v); } },
+    { "pfCode", [](CommodityLink& l, std::string_view v) { l.pfCode.assign(v); } },
+    { "pfType", [](CommodityLink& l, std::string_view v) { l.pfType.assign(v); } },
+    { "sc", [](CommodityLink& l, std::string_view v) { l.sc = parseDouble(v); } },
+});
+
+constexpr auto spreadFields = makeFieldTable<SpreadDef>({
+    { "spread", [](SpreadDef& s, std::string_view v) { s.spread = parseInt(v); } },
+    { "chargeMeth", [](SpreadDef& s, std::string_view v) { s.chargeMeth = parseInt(v); } },
+});
+
+constexpr auto rateFields = makeFieldTable<SpreadRate>({
+    { "r", [](SpreadRate& r, std::string_view v) { r.r = parseInt(v); } },
+    { "val", [](SpreadRate& r, std::string_view v) { r.val = parseDouble(v); } },
+});
+
+// Tier and period legs share one record; each fills the fields it has
+constexpr auto legFields = makeFieldTable<SpreadLeg>({
+    { "cc", [](SpreadLeg& l, std::string_view v) { l.ccCode.assign(v); } },
+    { "tn", [](SpreadLeg& l, std::string_view v) { l.tier = parseInt(v); } },
+    { "pe", [](SpreadLeg& l, std::string_view v) { l.expiry.assign(v); } },
+    { "rs", [](SpreadLeg& l, std::string_view v) { l.side.assign(v); } },
+    { "i", [](SpreadLeg& l, std::string_view v) { l.ratio = parseDouble(v); } },
+});
+
+}
+
+bool isSectionBlockTag(std::string_view name) {
+    int el = sectionElements.find(name);
+    return el >= 0 && (allowedParents[el] & (1u << EL_ROOT));
+}
+
+// One forward pass like parseSpanXmlBlock: a leaf (close tag right after its
+// open tag) goes to the field table of the innermost open section element if
+// it is a direct child of it; leaves of anything else (tiers, scan settings ...)
+// are skipped.
+void parseSectionBlock(std::string_view block, SpanSections& sections) {
+    const SpanSections::Mark first = sections.mark();
+
+    struct Open {
+        int element;
+        int depth;
+        size_t index;           // the element's record
+    };
+    Open stack[8];
+    int top = -1;
+    int depth = 0;
+    std::string_view openName;
+    size_t openEnd = 0;
+
+    size_t ccLinks = 0, ccSpreads = 0, ccLegs = 0;   // first records of the current <ccDef>
+    size_t spreadLegs = 0;                          // first leg of the current <dSpread>
+    SpreadRate rate;
+    bool rateTaken = false;
+
+    SpanTokenizer tokenizer(block);
+    SpanToken tok;
+    try {
+        while (tokenizer.next(tok)) {
+            if (tok.type == SpanTokenType::OpenTag) {
+                ++depth;
+                openName = tok.name;
+                openEnd = tok.end;
+
+                int el = sectionElements.find(tok.name);
+                int parent = top < 0 ? EL_ROOT : stack[top].depth == depth - 1 ? stack[top].element : -1;
+                if (el < 0 || parent < 0 || !(allowedParents[el] & (1u << parent)) || top + 1 == (int)(sizeof(stack) / sizeof(stack[0])))
+                    continue;
+
+                size_t index = 0;
+                switch (el) {
+                case EL_CURCONV:
+                    index = sections.conversions.size();
+                    sections.conversions.emplace_back();
+                    break;
+                case EL_CCDEF:
+                    index = sections.commodities.size();
+                    sections.commodities.emplace_back();
+                    ccLinks = sections.links.size();
+                    ccSpreads = sections.spreads.size();
+                    ccLegs = sections.legs.size();
+                    break;
+                case EL_PFLINK:
+                    index = sections.links.size();
+                    sections.links.emplace_back();
+                    break;
+                case EL_DSPREAD:
+                    index = sections.spreads.size();
+                    sections.spreads.emplace_back();
+                    sections.spreads.back().kind = parent == EL_CCDEF ? SpreadKind::Intra : SpreadKind::Inter;
+                    spreadLegs = sections.legs.size();
+                    rateTaken = false;
+                    break;
+                case EL_RATE:
+                    rate = SpreadRate();
+                    break;
+                case EL_TLEG:
+                case EL_PLEG:
+                    index = sections.legs.size();
+                    sections.legs.emplace_back();
+                    sections.legs.back().kind = sections.spreads[stack[top].index].kind;
+                    break;
+                }
+                stack[++top] = Open{ el, depth, index };
+                continue;
+            }
+
+            // Close tag: a leaf when it matches the open tag right before it
+            if (openName.data() && tok.name == openName && top >= 0 && stack[top].depth == depth - 1) {
+                std::string_view value = block.substr(openEnd, tok.begin - openEnd);
+                size_t index = stack[top].index;
+                switch (stack[top].element) {
+                case EL_CURCONV: curConvFields.set(sections.conversions[index], tok.name, value); break;
+                case EL_CCDEF: ccDefFields.set(sections.commodities[index], tok.name, value); break;
+                case EL_PFLINK: pfLinkFields.set(sections.links[index], tok.name, value); break;
+                case EL_DSPREAD: spreadFields.set(sections.spreads[index], tok.name, value); break;
+                case EL_RATE: rateFields.set(rate, tok.name, value); break;
+                case EL_TLEG:
+                case EL_PLEG: legFields.set(sections.legs[index], tok.name, value); break;
+                }
+            }
+            openName = std::string_view();
+
+            if (top >= 0 && stack[top].depth == depth) {
+                const Open& done = stack[top--];
+                if (done.element == EL_RATE && !rateTaken) {
+                    sections.spreads[stack[top].index].rate = rate.val;
+                    rateTaken = true;
+                }
+                else if (done.element == EL_DSPREAD) {
+                    for (size_t i = spreadLegs; i < sections.legs.size(); ++i)
+                        sections.legs[i].spread = sections.spreads[done.index].spread;
+                }
+                else if (done.element == EL_CCDEF) {
+                    // <cc> may come after the links and spreads it owns
+                    const FixedText<10>& cc = sections.commodities[done.index].ccCode;
+                    for (size_t i = ccLinks; i < sections.links.size(); ++i)
+                        sections.links[i].ccCode = cc;
+                    for (size_t i = ccSpreads; i < sections.spreads.size(); ++i)
+                        sections.spreads[i].ccCode = cc;
+                    for (size_t i = ccLegs; i < sections.legs.size(); ++i)
+                        sections.legs[i].spreadCc = cc;
+                }
+            }
+            --depth;
+        }
+
+        metrics.sectionBlocks.add();
+        metrics.sectionRecords.add(sections.size() - (first.conversions + first.commodities + first.links + first.spreads + first.legs));
+    }
+    catch (...) {
+        sections.rollback(first);   // never leave half a section behind
+        throw;
+    }
+}
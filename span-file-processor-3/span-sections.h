@@ -0,0 +1,100 @@
+#pragma once
+#ifndef SPAN_SECTIONS_H
+#define SPAN_SECTIONS_H
+
+#include "fixed-text.h"
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Typed records of the SPAN sections outside the portfolios. They are plain
+// fixed-size structs, written as they are into columnar files (see column-file.h).
+
+// <curConv>: rate that converts amounts in fromCur into toCur
+struct CurrencyConversion {
+    FixedText<10> fromCur;
+    FixedText<10> toCur;
+    double factor = 0.0;
+};
+
+// <ccDef>: a combined commodity, the unit scan risk and spreads are charged on
+struct CombinedCommodity {
+    FixedText<10> ccCode;
+    FixedText<40> name;
+    FixedText<10> currency;
+    int riskExponent = 0;
+    FixedText<10> marginMeth;
+};
+
+// <pfLink> of a <ccDef>: one portfolio of the combined commodity
+struct CommodityLink {
+    FixedText<10> ccCode;
+    int pfId = 0;
+    FixedText<20> pfCode;
+    FixedText<10> pfType;
+    double sc = 0.0;            // contract scaling factor
+};
+
+enum class SpreadKind : int32_t { Intra = 1, Inter = 2 };
+
+// <dSpread> of a <ccDef> (intra-commodity) or of <interSpreads> (inter-commodity)
+struct SpreadDef {
+    SpreadKind kind = SpreadKind::Intra;
+    FixedText<10> ccCode;       // owning combined commodity, empty for inter-commodity
+    int spread = 0;             // <spread>, the priority the spreads are formed in
+    int chargeMeth = 0;
+    double rate = 0.0;          // <val> of the first <rate>
+};
+
+// <tLeg> (tier) or <pLeg> (period) of a spread; kind, spreadCc and spread
+// repeat the owning SpreadDef's key
+struct SpreadLeg {
+    SpreadKind kind = SpreadKind::Intra;
+    FixedText<10> spreadCc;
+    int spread = 0;
+    FixedText<10> ccCode;
+    int tier = 0;               // <tn>, tier legs
+    FixedText<10> expiry;       // <pe>, period legs
+    FixedText<1> side;          // <rs>: A or B
+    double ratio = 0.0;         // <i>: delta per spread
+};
+
+static_assert(std::is_trivially_copyable<CurrencyConversion>::value && std::is_trivially_copyable<CombinedCommodity>::value &&
+    std::is_trivially_copyable<CommodityLink>::value && std::is_trivially_copyable<SpreadDef>::value &&
+    std::is_trivially_copyable<SpreadLeg>::value, "section records are written to columnar files as they are");
+
+// Section records of one or more blocks, in file order
+struct SpanSections {
+    struct Mark {
+        size_t conversions = 0;
+        size_t commodities = 0;
+        size_t links = 0;
+        size_t spreads = 0;
+        size_t legs = 0;
+    };
+
+    std::vector<CurrencyConversion> conversions;
+    std::vector<CombinedCommodity> commodities;
+    std::vector<CommodityLink> links;
+    std::vector<SpreadDef> spreads;
+    std::vector<SpreadLeg> legs;
+
+    size_t size() const { return conversions.size() + commodities.size() + links.size() + spreads.size() + legs.size(); }
+    bool empty() const { return size() == 0; }
+
+    Mark mark() const { return Mark{ conversions.size(), commodities.size(), links.size(), spreads.size(), legs.size() }; }
+    void rollback(const Mark& m);
+    void append(const SpanSections& other);
+    void clear();
+    size_t bytesUsed() const;
+};
+
+// True for the first tag of a block parseSectionBlock handles
+bool isSectionBlockTag(std::string_view name);
+
+// Parses one <curConv>, <ccDef> or <interSpreads> block into sections; on a
+// malformed value nothing of the block is kept and the exception propagates
+void parseSectionBlock(std::string_view block, SpanSections& sections);
+
+#endif // SPAN_SECTIONS_H
@@ -0,0 +1,190 @@
+#include "span-snapshot.h"
+#include "parallel-parser.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+extern Logger logger;
+
+bool SpanSnapshot::open(const std::string& path) {
+    if (!file.open(path))
+        return false;
+    ixPfCode = file.index("ix.pfCode");
+    ixContractId = file.index("ix.contractId");
+    ixOptContractId = file.index("ix.optContract");
+    ixOption = file.index("ix.option");
+    contractId = file.int32Column("contractId");
+    optContractId = file.int32Column("optContractId");
+    strikePrice = file.float64Column("strikePrice");
+    if (!ixPfCode || !ixContractId || !ixOptContractId || !ixOption || !contractId || !optContractId || !strikePrice ||
+        !file.textColumn("pfCode", pfCode) || !file.textColumn("expiry", expiry) || !file.textColumn("optionType", optionType)) {
+        logger.log("Snapshot " + path + " has no lookup indexes (write it with --snapshot)", LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+// Rows of index from the first whose key is not below the probe up to the
+// first whose key is above it; index order makes both predicates partitions
+template <typename Below, typename NotAbove>
+static RowRange indexRange(const uint32_t* index, size_t rows, Below below, NotAbove notAbove) {
+    RowRange range;
+    range.first = std::partition_point(index, index + rows, below);
+    range.last = std::partition_point(range.first, index + rows, notAbove);
+    return range;
+}
+
+RowRange SpanSnapshot::byPfCode(std::string_view code) const {
+    return indexRange(ixPfCode, rows(),
+        [&](uint32_t r) { return pfCode.at(r) < code; },
+        [&](uint32_t r) { return pfCode.at(r) <= code; });
+}
+
+RowRange SpanSnapshot::byContractId(int id) const {
+    return byContractIds(id, id);
+}
+
+RowRange SpanSnapshot::byContractIds(int lo, int hi) const {
+    return indexRange(ixContractId, rows(),
+        [&](uint32_t r) { return contractId[r] < lo; },
+        [&](uint32_t r) { return contractId[r] <= hi; });
+}
+
+RowRange SpanSnapshot::byOptContractId(int id) const {
+    return byOptContractIds(id, id);
+}
+
+RowRange SpanSnapshot::byOptContractIds(int lo, int hi) const {
+    return indexRange(ixOptContractId, rows(),
+        [&](uint32_t r) { return optContractId[r] < lo; },
+        [&](uint32_t r) { return optContractId[r] <= hi; });
+}
+
+RowRange SpanSnapshot::byOption(std::string_view code, std::string_view exp, double strike, std::string_view type) const {
+    // -1, 0, 1 as the row's (pfCode, expiry, strike, optionType) is below, equal or above the probe
+    auto compare = [&](uint32_t r) {
+        if (int c = pfCode.at(r).compare(code))
+            return c < 0 ? -1 : 1;
+        if (int c = expiry.at(r).compare(exp))
+            return c < 0 ? -1 : 1;
+        if (strikePrice[r] != strike)
+            return strikePrice[r] < strike ? -1 : 1;
+        int c = optionType.at(r).compare(type);
+        return c < 0 ? -1 : c > 0 ? 1 : 0;
+    };
+    return indexRange(ixOption, rows(),
+        [&](uint32_t r) { return compare(r) < 0; },
+        [&](uint32_t r) { return compare(r) <= 0; });
+}
+
+RowRange SpanSnapshot::byStrikes(std::string_view code, std::string_view exp, double lo, double hi) const {
+    // Compares (pfCode, expiry, strike) only, so all option types of a strike fall in the range
+    auto compare = [&](uint32_t r, double strike) {
+        if (int c = pfCode.at(r).compare(code))
+            return c < 0 ? -1 : 1;
+        if (int c = expiry.at(r).compare(exp))
+            return c < 0 ? -1 : 1;
+        return strikePrice[r] < strike ? -1 : strikePrice[r] > strike ? 1 : 0;
+    };
+    return indexRange(ixOption, rows(),
+        [&](uint32_t r) { return compare(r, lo) < 0; },
+        [&](uint32_t r) { return compare(r, hi) <= 0; });
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const std::string& step, double seconds, size_t ops, size_t matches) {
+    std::string line = step + "  " + std::to_string(seconds) + "  " + std::to_string(ops) + "  " +
+        std::to_string(ops ? seconds * 1e9 / ops : 0.0) + "  " + std::to_string(matches);
+    std::cout << line << "\n";
+    logger.log("bench-snapshot " + line, LogLevel::INFO);
+}
+
+void benchSnapshot(std::string_view data, const std::string& path, int parseThreads, size_t lookups) {
+    std::cout << "step  seconds  ops  ns/op  matches\n";
+
+    // What a consumer without the snapshot does: parse, then scan
+    auto start = std::chrono::steady_clock::now();
+    SpanRecordStore store;
+    parseSpanParallel(data, parseThreads, true, store);
+    report("reparse-xml", secondsSince(start), 1, store.size());
+    if (store.empty())
+        return;
+
+    start = std::chrono::steady_clock::now();
+    ColumnFileSink sink(path, true);
+    if (!sink.write(store) || !sink.finish())
+        return;
+    report("write-snapshot", secondsSince(start), 1, store.size());
+
+    const int opens = 50;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < opens; ++i) {
+        SpanSnapshot probe;
+        if (!probe.open(path))
+            return;
+    }
+    report("open-snapshot", secondsSince(start), opens, 0);
+
+    SpanSnapshot snap;
+    if (!snap.open(path))
+        return;
+    const ColumnFile& cols = snap.columns();
+    const int32_t* contractId = cols.int32Column("contractId");
+    const int32_t* optContractId = cols.int32Column("optContractId");
+    const double* strike = cols.float64Column("strikePrice");
+    TextColumnView pfCode, expiry, optionType;
+    cols.textColumn("pfCode", pfCode);
+    cols.textColumn("expiry", expiry);
+    cols.textColumn("optionType", optionType);
+
+    // Probe keys taken from evenly spread rows, so every lookup has a match
+    std::vector<uint32_t> probes(lookups);
+    for (size_t i = 0; i < lookups; ++i)
+        probes[i] = (uint32_t)((i * 2654435761ULL) % snap.rows());
+
+    size_t matches = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r : probes)
+        matches += snap.byPfCode(pfCode.at(r)).size();
+    report("lookup-pfCode", secondsSince(start), lookups, matches);
+
+    matches = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r : probes)
+        matches += snap.byContractId(contractId[r]).size();
+    report("lookup-contractId", secondsSince(start), lookups, matches);
+
+    matches = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r : probes)
+        matches += snap.byOptContractId(optContractId[r]).size();
+    report("lookup-optContractId", secondsSince(start), lookups, matches);
+
+    matches = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r : probes)
+        matches += snap.byOption(pfCode.at(r), expiry.at(r), strike[r], optionType.at(r)).size();
+    report("lookup-option", secondsSince(start), lookups, matches);
+
+    matches = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r : probes)
+        matches += snap.byStrikes(pfCode.at(r), expiry.at(r), strike[r] - 50.0, strike[r] + 50.0).size();
+    report("range-strikes", secondsSince(start), lookups, matches);
+
+    // The same contractId lookups against the parsed records, by scanning
+    const size_t scans = std::min<size_t>(lookups, 200);
+    matches = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < scans; ++i) {
+        int id = contractId[probes[i]];
+        for (size_t r = 0; r < store.size(); ++r)
+            matches += store.record(r).contractId == id;
+    }
+    report("scan-contractId-parsed", secondsSince(start), scans, matches);
+}
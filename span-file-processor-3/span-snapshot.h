@@ -0,0 +1,57 @@
+#pragma once
+#ifndef SPAN_SNAPSHOT_H
+#define SPAN_SNAPSHOT_H
+
+#include "column-file.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Row numbers of a lookup, in index order; points into the mapping
+struct RowRange {
+    const uint32_t* first = nullptr;
+    const uint32_t* last = nullptr;
+
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    size_t size() const { return (size_t)(last - first); }
+    bool empty() const { return first == last; }
+};
+
+// Reader for a columnar file written with indexes (--snapshot). open() maps
+// the file and checks the directory; nothing is parsed or copied, lookups are
+// binary searches over the mapped index sections.
+class SpanSnapshot {
+public:
+    bool open(const std::string& path);
+
+    size_t rows() const { return file.rows(); }
+    const ColumnFile& columns() const { return file; }
+    SpanRecord record(uint32_t row) const { return file.record(row); }
+
+    RowRange byPfCode(std::string_view pfCode) const;
+    RowRange byContractId(int contractId) const;
+    RowRange byContractIds(int lo, int hi) const;           // lo <= contractId <= hi
+    RowRange byOptContractId(int optContractId) const;
+    RowRange byOptContractIds(int lo, int hi) const;
+    RowRange byOption(std::string_view pfCode, std::string_view expiry, double strike, std::string_view optionType) const;
+    // Every option type of one pfCode and expiry with lo <= strike <= hi
+    RowRange byStrikes(std::string_view pfCode, std::string_view expiry, double lo, double hi) const;
+
+private:
+    ColumnFile file;
+    const uint32_t* ixPfCode = nullptr;
+    const uint32_t* ixContractId = nullptr;
+    const uint32_t* ixOptContractId = nullptr;
+    const uint32_t* ixOption = nullptr;
+    TextColumnView pfCode, expiry, optionType;
+    const int32_t* contractId = nullptr;
+    const int32_t* optContractId = nullptr;
+    const double* strikePrice = nullptr;
+};
+
+// Startup and lookup cost of a snapshot of data against re-parsing the XML.
+// Writes the snapshot to path first.
+void benchSnapshot(std::string_view data, const std::string& path, int parseThreads, size_t lookups);
+
+#endif // SPAN_SNAPSHOT_H
@@ -0,0 +1,299 @@
+#include "span-summary.h"
+#include "logger.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <tuple>
+
+extern Logger logger;
+
+bool parseSummaryKinds(const std::string& text, unsigned& kinds) {
+    kinds = 0;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string name = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        if (name == "portfolio")
+            kinds |= SUMMARY_PORTFOLIO;
+        else if (name == "expiry")
+            kinds |= SUMMARY_EXPIRY;
+        else if (name == "series")
+            kinds |= SUMMARY_SERIES;
+        else if (name == "all")
+            kinds |= SUMMARY_ALL;
+        else
+            return false;
+        if (comma == std::string::npos)
+            break;
+        start = comma + 1;
+    }
+    return kinds != 0;
+}
+
+void WorstScenario::offer(double value, int contract, int optContract, int point) {
+    if (std::isnan(value))
+        return;
+    if (scenario) {
+        if (value < loss)
+            return;
+        if (value == loss && std::tie(contract, optContract, point) >= std::tie(contractId, optContractId, scenario))
+            return;
+    }
+    loss = value;
+    contractId = contract;
+    optContractId = optContract;
+    scenario = point;
+}
+
+// New rows start from empty extremes, so merging into them copies the first part
+static PortfolioSummary emptyPortfolio(const std::string& pfCode) {
+    PortfolioSummary p;
+    p.pfCode = pfCode;
+    p.pfId = INT_MAX;
+    p.maxPriceScan = p.maxVolScan = -HUGE_VAL;
+    return p;
+}
+
+static ExpirySummary emptyExpiry(const std::string& pfCode, std::string_view expiry) {
+    ExpirySummary e;
+    e.pfCode = pfCode;
+    e.expiry.assign(expiry);
+    e.maxPriceScan = e.maxVolScan = e.maxVolatility = -HUGE_VAL;
+    e.minVolatility = HUGE_VAL;
+    return e;
+}
+
+void SpanSummary::mergePortfolio(PortfolioSummary& into, const PortfolioSummary& from) {
+    into.pfId = std::min(into.pfId, from.pfId);
+    into.records += from.records;
+    into.futures += from.futures;
+    into.options += from.options;
+    into.maxPriceScan = std::fmax(into.maxPriceScan, from.maxPriceScan);
+    into.maxVolScan = std::fmax(into.maxVolScan, from.maxVolScan);
+    into.worst.merge(from.worst);
+}
+
+void SpanSummary::mergeExpiry(ExpirySummary& into, const ExpirySummary& from) {
+    into.records += from.records;
+    into.options += from.options;
+    into.maxPriceScan = std::fmax(into.maxPriceScan, from.maxPriceScan);
+    into.maxVolScan = std::fmax(into.maxVolScan, from.maxVolScan);
+    into.minVolatility = std::fmin(into.minVolatility, from.minVolatility);
+    into.maxVolatility = std::fmax(into.maxVolatility, from.maxVolatility);
+    into.worst.merge(from.worst);
+}
+
+void SpanSummary::mergeSeries(SeriesSummary& into, const SeriesSummary& from) {
+    if (!into.options) {
+        into = from;
+        return;
+    }
+    into.options += from.options;
+    into.calls += from.calls;
+    into.puts += from.puts;
+    into.minStrike = std::fmin(into.minStrike, from.minStrike);
+    into.maxStrike = std::fmax(into.maxStrike, from.maxStrike);
+    into.worst.merge(from.worst);
+}
+
+SpanSummary::PortfolioEntry& SpanSummary::entryOf(const std::string& pfCode) {
+    auto it = portfolios.find(pfCode);
+    if (it == portfolios.end())
+        it = portfolios.emplace(pfCode, PortfolioEntry{ emptyPortfolio(pfCode), {} }).first;
+    return it->second;
+}
+
+ExpirySummary& SpanSummary::expiryOf(PortfolioEntry& entry, std::string_view expiry) {
+    for (size_t i = entry.expiries.size(); i-- > 0;) {
+        if (entry.expiries[i].expiry == expiry)
+            return entry.expiries[i];
+    }
+    ++expiryTotal;
+    entry.expiries.push_back(emptyExpiry(entry.total.pfCode, expiry));
+    return entry.expiries.back();
+}
+
+void SpanSummary::add(const SpanRecordStore& store) {
+    recordTotal += store.size();
+    PortfolioEntry* entry = nullptr;
+    uint32_t pfIndex = UINT32_MAX;
+
+    // Records of one series are adjacent and share its expiry, so each run is
+    // aggregated on its own and looked up once per kind
+    for (size_t i = 0, end; i < store.size(); i = end) {
+        const CompactRecord& first = store.record(i);
+        for (end = i + 1; end < store.size(); ++end) {
+            const CompactRecord& rec = store.record(end);
+            if (rec.series != first.series || rec.portfolio != first.portfolio)
+                break;
+        }
+        const PortfolioHeader& header = store.portfolio(first.portfolio);
+        if (first.portfolio != pfIndex) {
+            entry = &entryOf(header.pfCode);
+            pfIndex = first.portfolio;
+        }
+
+        ExpirySummary run = emptyExpiry(std::string(), std::string_view());
+        SeriesSummary options;
+        run.records = end - i;
+        options.minStrike = HUGE_VAL;
+        options.maxStrike = -HUGE_VAL;
+        for (size_t r = i; r < end; ++r) {
+            const CompactRecord& rec = store.record(r);
+            run.maxPriceScan = std::fmax(run.maxPriceScan, rec.priceScan);
+            run.maxVolScan = std::fmax(run.maxVolScan, rec.volScan);
+            run.minVolatility = std::fmin(run.minVolatility, rec.volatility);
+            run.maxVolatility = std::fmax(run.maxVolatility, rec.volatility);
+            if (rec.optContractId) {
+                ++options.options;
+                const char type = rec.optionType.view().empty() ? ' ' : rec.optionType.view()[0];
+                options.calls += type == 'C' || type == 'c';
+                options.puts += type == 'P' || type == 'p';
+                options.minStrike = std::fmin(options.minStrike, rec.strikePrice);
+                options.maxStrike = std::fmax(options.maxStrike, rec.strikePrice);
+            }
+
+            const double* risk = store.risk(rec);
+            uint32_t point = 0;
+            for (uint32_t k = 0; k < rec.riskCount; ++k) {
+                if (risk[k] > risk[point] || std::isnan(risk[point]))
+                    point = k;
+            }
+            if (rec.riskCount)
+                run.worst.offer(risk[point], rec.contractId, rec.optContractId, (int)point + 1);
+        }
+        run.options = options.options;
+
+        PortfolioSummary& total = entry->total;
+        total.pfId = std::min(total.pfId, header.pfId);
+        total.records += run.records;
+        total.futures += run.records - run.options;
+        total.options += run.options;
+        total.maxPriceScan = std::fmax(total.maxPriceScan, run.maxPriceScan);
+        total.maxVolScan = std::fmax(total.maxVolScan, run.maxVolScan);
+        total.worst.merge(run.worst);
+        if (kinds & SUMMARY_EXPIRY)
+            mergeExpiry(expiryOf(*entry, first.expiry.view()), run);
+        if ((kinds & SUMMARY_SERIES) && options.options) {
+            options.pfId = header.pfId;
+            options.pfCode = header.pfCode;
+            options.contractId = first.contractId;
+            options.expiry.assign(first.expiry.view());
+            options.worst = run.worst;
+            mergeSeries(series[ContractKey{ header.pfId, first.contractId, 0 }], options);
+        }
+    }
+}
+
+void SpanSummary::merge(const SpanSummary& other) {
+    recordTotal += other.recordTotal;
+    for (const auto& p : other.portfolios) {
+        PortfolioEntry& entry = entryOf(p.first);
+        mergePortfolio(entry.total, p.second.total);
+        for (const ExpirySummary& e : p.second.expiries)
+            mergeExpiry(expiryOf(entry, e.expiry), e);
+    }
+    for (const auto& s : other.series)
+        mergeSeries(series[s.first], s.second);
+}
+
+void SpanSummary::clear() {
+    recordTotal = 0;
+    expiryTotal = 0;
+    portfolios.clear();
+    series.clear();
+}
+
+std::vector<PortfolioSummary> SpanSummary::portfolioRows() const {
+    std::vector<PortfolioSummary> rows;
+    rows.reserve(portfolios.size());
+    for (const auto& p : portfolios)
+        rows.push_back(p.second.total);
+    std::sort(rows.begin(), rows.end(), [](const PortfolioSummary& a, const PortfolioSummary& b) { return a.pfCode < b.pfCode; });
+    return rows;
+}
+
+std::vector<ExpirySummary> SpanSummary::expiryRows() const {
+    std::vector<ExpirySummary> rows;
+    rows.reserve(expiryTotal);
+    for (const auto& p : portfolios)
+        rows.insert(rows.end(), p.second.expiries.begin(), p.second.expiries.end());
+    std::sort(rows.begin(), rows.end(), [](const ExpirySummary& a, const ExpirySummary& b) {
+        return std::tie(a.pfCode, a.expiry) < std::tie(b.pfCode, b.expiry);
+    });
+    return rows;
+}
+
+std::vector<SeriesSummary> SpanSummary::seriesRows() const {
+    std::vector<SeriesSummary> rows;
+    rows.reserve(series.size());
+    for (const auto& s : series)
+        rows.push_back(s.second);
+    std::sort(rows.begin(), rows.end(), [](const SeriesSummary& a, const SeriesSummary& b) {
+        return std::tie(a.pfId, a.contractId) < std::tie(b.pfId, b.contractId);
+    });
+    return rows;
+}
+
+// worstLoss,worstContractId,worstOptContractId,worstScenario; empty without risk arrays
+static std::string worstFields(const WorstScenario& w) {
+    if (!w.scenario)
+        return ",,,";
+    char buf[96];
+    std::snprintf(buf, sizeof(buf), "%.10g,%d,%d,%d", w.loss, w.contractId, w.optContractId, w.scenario);
+    return buf;
+}
+
+template <typename Row, typename Format>
+static bool writeSummaryFile(const std::string& path, const char* header, const std::vector<Row>& rows, Format format) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        logger.log("Failed to create " + path, LogLevel::ERRORS);
+        return false;
+    }
+    out << header << '\n';
+    char buf[256];
+    for (const Row& row : rows) {
+        format(buf, sizeof(buf), row);
+        out << buf << worstFields(row.worst) << '\n';
+    }
+    out.close();
+    if (!out) {
+        logger.log("Failed to write " + path, LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+bool writeSummaryFiles(const std::string& base, const SpanSummary& summary) {
+    bool ok = true;
+    if (summary.selected() & SUMMARY_PORTFOLIO) {
+        ok = writeSummaryFile(base + ".portfolio.csv",
+            "pfCode,pfId,records,futures,options,maxPriceScan,maxVolScan,worstLoss,worstContractId,worstOptContractId,worstScenario",
+            summary.portfolioRows(), [](char* buf, size_t size, const PortfolioSummary& p) {
+                std::snprintf(buf, size, "%s,%d,%zu,%zu,%zu,%.10g,%.10g,", p.pfCode.c_str(), p.pfId, p.records, p.futures, p.options,
+                    p.maxPriceScan, p.maxVolScan);
+            }) && ok;
+    }
+    if (summary.selected() & SUMMARY_EXPIRY) {
+        ok = writeSummaryFile(base + ".expiry.csv",
+            "pfCode,expiry,records,options,maxPriceScan,maxVolScan,minVolatility,maxVolatility,worstLoss,worstContractId,"
+            "worstOptContractId,worstScenario",
+            summary.expiryRows(), [](char* buf, size_t size, const ExpirySummary& e) {
+                std::snprintf(buf, size, "%s,%s,%zu,%zu,%.10g,%.10g,%.10g,%.10g,", e.pfCode.c_str(), e.expiry.c_str(), e.records,
+                    e.options, e.maxPriceScan, e.maxVolScan, e.minVolatility, e.maxVolatility);
+            }) && ok;
+    }
+    if (summary.selected() & SUMMARY_SERIES) {
+        ok = writeSummaryFile(base + ".series.csv",
+            "pfId,pfCode,contractId,expiry,options,calls,puts,minStrike,maxStrike,worstLoss,worstContractId,worstOptContractId,"
+            "worstScenario",
+            summary.seriesRows(), [](char* buf, size_t size, const SeriesSummary& s) {
+                std::snprintf(buf, size, "%d,%s,%d,%s,%zu,%zu,%zu,%.10g,%.10g,", s.pfId, s.pfCode.c_str(), s.contractId, s.expiry.c_str(),
+                    s.options, s.calls, s.puts, s.minStrike, s.maxStrike);
+            }) && ok;
+    }
+    return ok;
+}
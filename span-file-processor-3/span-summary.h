@@ -0,0 +1,143 @@
+#pragma once
+#ifndef SPAN_SUMMARY_H
+#define SPAN_SUMMARY_H
+
+#include "record-sink.h"
+#include "span-record-store.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Aggregates a load can write next to its detail rows
+enum SummaryKind : unsigned {
+    SUMMARY_PORTFOLIO = 1,      // per pfCode
+    SUMMARY_EXPIRY = 2,         // per pfCode and expiry
+    SUMMARY_SERIES = 4,         // per option series (pfId, contractId)
+    SUMMARY_ALL = 7,
+};
+
+// "portfolio,expiry,series" or "all" to SummaryKind bits; false on an unknown name
+bool parseSummaryKinds(const std::string& text, unsigned& kinds);
+
+// Largest risk-array value, i.e. the worst loss of one long unit, and where it
+// is. Ties go to the lowest (contractId, optContractId, scenario), so the
+// result does not depend on the order records or partial summaries arrive in.
+struct WorstScenario {
+    double loss = 0.0;
+    int contractId = 0;
+    int optContractId = 0;
+    int scenario = 0;           // 1-based risk-array point, 0 while no record had one
+
+    void offer(double value, int contract, int optContract, int point);
+    void merge(const WorstScenario& other) {
+        if (other.scenario)
+            offer(other.loss, other.contractId, other.optContractId, other.scenario);
+    }
+};
+
+struct PortfolioSummary {
+    std::string pfCode;
+    int pfId = 0;               // lowest pfId seen with this pfCode
+    size_t records = 0;
+    size_t futures = 0;         // records without an option (futures and physicals)
+    size_t options = 0;
+    double maxPriceScan = 0.0;
+    double maxVolScan = 0.0;
+    WorstScenario worst;
+};
+
+struct ExpirySummary {
+    std::string pfCode;
+    std::string expiry;
+    size_t records = 0;
+    size_t options = 0;
+    double maxPriceScan = 0.0;
+    double maxVolScan = 0.0;
+    double minVolatility = 0.0;
+    double maxVolatility = 0.0;
+    WorstScenario worst;
+};
+
+struct SeriesSummary {
+    int pfId = 0;
+    std::string pfCode;
+    int contractId = 0;
+    std::string expiry;
+    size_t options = 0;
+    size_t calls = 0;
+    size_t puts = 0;
+    double minStrike = 0.0;
+    double maxStrike = 0.0;
+    WorstScenario worst;
+};
+
+// Counts, extremes and worst scenarios of the selected kinds, built block by
+// block as records are parsed. Every aggregate is a count, min or max, so
+// summaries of disjoint parts of a load merge into the summary of the whole
+// in any order (parallel workers, file chunks, several files).
+class SpanSummary {
+public:
+    explicit SpanSummary(unsigned kinds = SUMMARY_ALL) : kinds(kinds) {}
+
+    unsigned selected() const { return kinds; }
+    size_t records() const { return recordTotal; }
+    bool empty() const { return recordTotal == 0; }
+
+    void add(const SpanRecordStore& store);
+    void merge(const SpanSummary& other);
+    void clear();
+
+    // Rows in key order
+    std::vector<PortfolioSummary> portfolioRows() const;
+    std::vector<ExpirySummary> expiryRows() const;
+    std::vector<SeriesSummary> seriesRows() const;
+    size_t rowCount() const {
+        return (kinds & SUMMARY_PORTFOLIO ? portfolios.size() : 0) + expiryTotal + series.size();
+    }
+
+private:
+    // A pfCode's totals and its expiries, which are few enough to search in order
+    struct PortfolioEntry {
+        PortfolioSummary total;
+        std::vector<ExpirySummary> expiries;
+    };
+
+    static void mergePortfolio(PortfolioSummary& into, const PortfolioSummary& from);
+    static void mergeExpiry(ExpirySummary& into, const ExpirySummary& from);
+    static void mergeSeries(SeriesSummary& into, const SeriesSummary& from);
+    PortfolioEntry& entryOf(const std::string& pfCode);
+    ExpirySummary& expiryOf(PortfolioEntry& entry, std::string_view expiry);
+
+    unsigned kinds;
+    size_t recordTotal = 0;
+    size_t expiryTotal = 0;
+    std::unordered_map<std::string, PortfolioEntry> portfolios;         // by pfCode
+    std::unordered_map<ContractKey, SeriesSummary, ContractKeyHash> series;  // optContractId 0
+};
+
+// CSV files base.portfolio.csv, base.expiry.csv and base.series.csv, one per
+// selected kind
+bool writeSummaryFiles(const std::string& base, const SpanSummary& summary);
+
+// Adds every block written to it to a SpanSummary; teed next to the real sink
+class SummarySink : public RecordSink {
+public:
+    explicit SummarySink(SpanSummary& summary) : summary(summary) {}
+
+    bool write(const SpanRecordStore& records) override {
+        summary.add(records);
+        counters.rowsInserted += records.size();
+        counters.batches++;
+        return true;
+    }
+    bool finish() override { return true; }
+    InsertStats stats() const override { return counters; }
+
+private:
+    SpanSummary& summary;
+    InsertStats counters;
+};
+
+#endif // SPAN_SUMMARY_H
@@ -0,0 +1,126 @@
+#include "span-tokenizer.h"
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static bool isXmlSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool SpanTokenizer::next(SpanToken& tok) {
+    const char* base = data.data();
+    const size_t size = data.size();
+
+    if (pendingClose) {
+        tok.type = SpanTokenType::CloseTag;
+        tok.name = pendingName;
+        tok.begin = pos;
+        tok.end = pos;
+        pendingClose = false;
+        return true;
+    }
+
+    while (pos < size) {
+        const char* lt = (const char*)std::memchr(base + pos, '<', size - pos);
+        if (lt == nullptr)
+            break;
+        size_t begin = lt - base;
+        if (begin + 1 >= size)
+            break;
+
+        char c = base[begin + 1];
+        // Declarations, comments and CDATA carry nothing we map
+        if (c == '?' || c == '!') {
+            std::string_view terminator = "?>";
+            if (c == '!')
+                terminator = data.compare(begin, 4, "<!--") == 0 ? "-->" :
+                             data.compare(begin, 9, "<![CDATA[") == 0 ? "]]>" : ">";
+            size_t skip = data.find(terminator, begin + 2);
+            if (skip == std::string_view::npos)
+                break;
+            pos = skip + terminator.size();
+            continue;
+        }
+
+        const char* gt = (const char*)std::memchr(lt, '>', size - begin);
+        if (gt == nullptr)
+            break;
+        size_t end = gt - base + 1;
+
+        size_t nameStart = begin + (c == '/' ? 2 : 1);
+        size_t nameEnd = nameStart;
+        while (nameEnd < end - 1 && !isXmlSpace(base[nameEnd]) && base[nameEnd] != '/')
+            ++nameEnd;
+
+        tok.name = data.substr(nameStart, nameEnd - nameStart);
+        tok.begin = begin;
+        tok.end = end;
+
+        tok.type = c == '/' ? SpanTokenType::CloseTag : SpanTokenType::OpenTag;
+        pos = end;
+        // <tag/> is reported as an open tag immediately followed by its close tag
+        if (c != '/' && base[end - 2] == '/') {
+            pendingClose = true;
+            pendingName = tok.name;
+        }
+        return true;
+    }
+
+    pos = size;
+    tok = SpanToken();
+    return false;
+}
+
+bool nextPortfolioBlock(std::string_view data, size_t& pos, std::string_view& block) {
+    while (pos < data.size()) {
+        size_t lt = data.find('<', pos);
+        if (lt == std::string_view::npos)
+            break;
+
+        for (const SpanBlockTag& tag : spanBlockTags) {
+            if (data.compare(lt, tag.open.size(), tag.open) != 0)
+                continue;
+            size_t close = data.find(tag.close, lt + tag.open.size());
+            if (close == std::string_view::npos) {
+                pos = data.size();   // unterminated block, nothing more to hand out
+                return false;
+            }
+            size_t end = close + tag.close.size();
+            block = data.substr(lt, end - lt);
+            pos = end;
+            return true;
+        }
+        pos = lt + 1;
+    }
+    pos = data.size();
+    return false;
+}
+
+static std::string_view trimNumber(std::string_view text) {
+    size_t i = 0;
+    while (i < text.size() && isXmlSpace(text[i]))
+        ++i;
+    // std::stod accepts a leading '+', std::from_chars does not
+    if (i < text.size() && text[i] == '+')
+        ++i;
+    return text.substr(i);
+}
+
+int parseInt(std::string_view text) {
+    std::string_view t = trimNumber(text);
+    int value = 0;
+    auto res = std::from_chars(t.data(), t.data() + t.size(), value);
+    if (res.ec != std::errc())
+        throw std::invalid_argument("parseInt: invalid number '" + std::string(text) + "'");
+    return value;
+}
+
+double parseDouble(std::string_view text) {
+    std::string_view t = trimNumber(text);
+    double value = 0.0;
+    auto res = std::from_chars(t.data(), t.data() + t.size(), value);
+    if (res.ec != std::errc())
+        throw std::invalid_argument("parseDouble: invalid number '" + std::string(text) + "'");
+    return value;
+}
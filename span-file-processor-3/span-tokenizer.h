@@ -0,0 +1,55 @@
+#pragma once
+#ifndef SPAN_TOKENIZER_H
+#define SPAN_TOKENIZER_H
+
+#include <string_view>
+#include <cstddef>
+
+enum class SpanTokenType { OpenTag, CloseTag, End };
+
+// One markup token; begin/end are byte offsets of the whole "<...>" in the buffer
+struct SpanToken {
+    SpanTokenType type = SpanTokenType::End;
+    std::string_view name;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// Forward-only tokenizer over a SPAN buffer. Character data is skipped,
+// callers slice it out of the buffer between an open tag's end and the
+// matching close tag's begin, so nothing is ever copied.
+class SpanTokenizer {
+public:
+    explicit SpanTokenizer(std::string_view data) : data(data) {}
+
+    bool next(SpanToken& tok);
+    std::string_view buffer() const { return data; }
+    size_t position() const { return pos; }
+
+private:
+    std::string_view data;
+    size_t pos = 0;
+    bool pendingClose = false;
+    std::string_view pendingName;
+};
+
+// Top-level elements nextPortfolioBlock hands out: the portfolios, then the
+// sections parseSectionBlock reads (none of them nests in another)
+struct SpanBlockTag {
+    std::string_view open;
+    std::string_view close;
+};
+inline constexpr SpanBlockTag spanBlockTags[] = {
+    { "<phyPf>", "</phyPf>" }, { "<futPf>", "</futPf>" }, { "<oofPf>", "</oofPf>" },
+    { "<ccDef>", "</ccDef>" }, { "<interSpreads>", "</interSpreads>" }, { "<curConv>", "</curConv>" },
+};
+inline constexpr size_t spanBlockTagMaxSize = 14;   // "<interSpreads>"
+
+// Finds the next block of spanBlockTags at or after pos and advances pos past it
+bool nextPortfolioBlock(std::string_view data, size_t& pos, std::string_view& block);
+
+// In-place number parsing (std::from_chars), throws std::invalid_argument like std::stoi/std::stod
+int parseInt(std::string_view text);
+double parseDouble(std::string_view text);
+
+#endif // SPAN_TOKENIZER_H
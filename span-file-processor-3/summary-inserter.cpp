@@ -0,0 +1,84 @@
+#include "build-config.h"
+#if SPAN_WITH_ODBC
+#include "summary-inserter.h"
+#include "param-rows.h"
+
+namespace {
+
+const ParamSpec portfolioParams[] = { { ParamKind::Text, 20 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 },
+    { ParamKind::Int, 0 }, { ParamKind::Double, 0 }, { ParamKind::Double, 0 }, { ParamKind::Double, 0 }, { ParamKind::Int, 0 },
+    { ParamKind::Int, 0 }, { ParamKind::Int, 0 } };
+const ParamSpec expiryParams[] = { { ParamKind::Text, 20 }, { ParamKind::Text, 10 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 },
+    { ParamKind::Double, 0 }, { ParamKind::Double, 0 }, { ParamKind::Double, 0 }, { ParamKind::Double, 0 }, { ParamKind::Double, 0 },
+    { ParamKind::Int, 0 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 } };
+const ParamSpec seriesParams[] = { { ParamKind::Int, 0 }, { ParamKind::Text, 20 }, { ParamKind::Int, 0 }, { ParamKind::Text, 10 },
+    { ParamKind::Int, 0 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 }, { ParamKind::Double, 0 }, { ParamKind::Double, 0 },
+    { ParamKind::Double, 0 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 }, { ParamKind::Int, 0 } };
+
+// WorstLoss, WorstContractId, WorstOptContractId, WorstScenario from parameter p on
+void worstParams(ParamRows& rows, size_t r, size_t p, const WorstScenario& w) {
+    if (!w.scenario) {
+        for (size_t i = 0; i < 4; ++i)
+            rows.null(r, p + i);
+        return;
+    }
+    rows.real(r, p, w.loss);
+    rows.integer(r, p + 1, w.contractId);
+    rows.integer(r, p + 2, w.optContractId);
+    rows.integer(r, p + 3, w.scenario);
+}
+
+}
+
+bool insertSummaryTables(SQLHDBC hDbc, const SpanSummary& summary, InsertStats& stats) {
+    const unsigned kinds = summary.selected();
+    bool ok = true;
+    if (kinds & SUMMARY_PORTFOLIO) {
+        ok = insertTable(hDbc, L"SpanPortfolioSummary",
+            L"PfCode, PfId, Records, Futures, Options, MaxPriceScan, MaxVolScan, WorstLoss, WorstContractId, WorstOptContractId, WorstScenario",
+            portfolioParams, summary.portfolioRows(), [](ParamRows& rows, size_t r, const PortfolioSummary& s) {
+                rows.integer(r, 1, s.pfId);
+                rows.integer(r, 2, (int)s.records);
+                rows.integer(r, 3, (int)s.futures);
+                rows.integer(r, 4, (int)s.options);
+                rows.real(r, 5, s.maxPriceScan);
+                rows.real(r, 6, s.maxVolScan);
+                worstParams(rows, r, 7, s.worst);
+                return rows.text(r, 0, s.pfCode);
+            }, stats);
+    }
+    if (ok && (kinds & SUMMARY_EXPIRY)) {
+        ok = insertTable(hDbc, L"SpanExpirySummary",
+            L"PfCode, Expiry, Records, Options, MaxPriceScan, MaxVolScan, MinVolatility, MaxVolatility, WorstLoss, WorstContractId, "
+            L"WorstOptContractId, WorstScenario",
+            expiryParams, summary.expiryRows(), [](ParamRows& rows, size_t r, const ExpirySummary& s) {
+                rows.integer(r, 2, (int)s.records);
+                rows.integer(r, 3, (int)s.options);
+                rows.real(r, 4, s.maxPriceScan);
+                rows.real(r, 5, s.maxVolScan);
+                rows.real(r, 6, s.minVolatility);
+                rows.real(r, 7, s.maxVolatility);
+                worstParams(rows, r, 8, s.worst);
+                return rows.text(r, 0, s.pfCode) && rows.text(r, 1, s.expiry);
+            }, stats);
+    }
+    if (ok && (kinds & SUMMARY_SERIES)) {
+        ok = insertTable(hDbc, L"SpanSeriesSummary",
+            L"PfId, PfCode, ContractId, Expiry, Options, Calls, Puts, MinStrike, MaxStrike, WorstLoss, WorstContractId, "
+            L"WorstOptContractId, WorstScenario",
+            seriesParams, summary.seriesRows(), [](ParamRows& rows, size_t r, const SeriesSummary& s) {
+                rows.integer(r, 0, s.pfId);
+                rows.integer(r, 2, s.contractId);
+                rows.integer(r, 4, (int)s.options);
+                rows.integer(r, 5, (int)s.calls);
+                rows.integer(r, 6, (int)s.puts);
+                rows.real(r, 7, s.minStrike);
+                rows.real(r, 8, s.maxStrike);
+                worstParams(rows, r, 9, s.worst);
+                return rows.text(r, 1, s.pfCode) && rows.text(r, 3, s.expiry);
+            }, stats);
+    }
+    return ok;
+}
+
+#endif // SPAN_WITH_ODBC
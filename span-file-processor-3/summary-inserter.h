@@ -0,0 +1,28 @@
+#pragma once
+#ifndef SUMMARY_INSERTER_H
+#define SUMMARY_INSERTER_H
+
+#include "span-summary.h"
+#include "record-sink.h"
+#include <windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+
+// Tables the load summaries go to (created by the DBA like SpanRecords6):
+//   SpanPortfolioSummary (PfCode NVARCHAR(20), PfId INT, Records INT, Futures INT, Options INT, MaxPriceScan FLOAT,
+//                         MaxVolScan FLOAT, WorstLoss FLOAT, WorstContractId INT, WorstOptContractId INT, WorstScenario INT)
+//   SpanExpirySummary (PfCode NVARCHAR(20), Expiry NVARCHAR(10), Records INT, Options INT, MaxPriceScan FLOAT, MaxVolScan FLOAT,
+//                      MinVolatility FLOAT, MaxVolatility FLOAT, WorstLoss FLOAT, WorstContractId INT, WorstOptContractId INT,
+//                      WorstScenario INT)
+//   SpanSeriesSummary (PfId INT, PfCode NVARCHAR(20), ContractId INT, Expiry NVARCHAR(10), Options INT, Calls INT, Puts INT,
+//                      MinStrike FLOAT, MaxStrike FLOAT, WorstLoss FLOAT, WorstContractId INT, WorstOptContractId INT,
+//                      WorstScenario INT)
+// The Worst* columns are NULL for rows without risk arrays.
+//
+// Inserts the selected kinds of summary, one statement per table, without
+// committing; rows with a value too long for its column are logged and
+// counted in stats.rowsFailed.
+bool insertSummaryTables(SQLHDBC hDbc, const SpanSummary& summary, InsertStats& stats);
+
+#endif // SUMMARY_INSERTER_H
@@ -0,0 +1,120 @@
+#pragma once
+#ifndef TAG_HASH_H
+#define TAG_HASH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+// Hash of a tag name from its length and first, middle and last characters,
+// mixed by a seed; cheap enough for every close tag of a block. Names that
+// agree on all four cannot share a table (the seed search below fails).
+constexpr uint32_t tagHash(std::string_view name, uint32_t seed) {
+    if (name.empty())
+        return 0;
+    uint32_t key = (uint32_t)name.size() | (uint32_t)(unsigned char)name[0] << 8 |
+        (uint32_t)(unsigned char)name[name.size() / 2] << 16 | (uint32_t)(unsigned char)name[name.size() - 1] << 24;
+    uint32_t h = (key ^ seed) * 0x9E3779B1u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    return h ^ (h >> 12);
+}
+
+// Perfect hash of a fixed list of tag names to their position in the list,
+// built at compile time: the constructor tries seeds until no two names share
+// a slot (no seed is a compile error when the table is constexpr). find() is
+// one hash, one slot and one compare.
+// Slots of a TagTable of n names: a power of two, at most a quarter full
+constexpr size_t tagTableSlots(size_t n) {
+    size_t slots = 8;
+    while (slots < 4 * n)
+        slots *= 2;
+    return slots;
+}
+
+template <size_t N>
+class TagTable {
+public:
+    static constexpr size_t slotCount() { return tagTableSlots(N); }
+
+    constexpr explicit TagTable(const std::array<std::string_view, N>& names) : names(names) {
+        for (uint32_t s = 1; s < 65536; ++s) {
+            if (tryBuild(s)) {
+                seed = s;
+                return;
+            }
+        }
+        throw std::logic_error("TagTable: no collision-free seed");
+    }
+
+    // Position of name in the list, -1 if it is not one of them
+    int find(std::string_view name) const {
+        int i = slots[tagHash(name, seed) & (slotCount() - 1)];
+        return i >= 0 && names[(size_t)i] == name ? i : -1;
+    }
+
+private:
+    constexpr bool tryBuild(uint32_t s) {
+        for (size_t i = 0; i < slotCount(); ++i)
+            slots[i] = -1;
+        for (size_t i = 0; i < N; ++i) {
+            size_t slot = tagHash(names[i], s) & (slotCount() - 1);
+            if (slots[slot] >= 0)
+                return false;
+            slots[slot] = (int16_t)i;
+        }
+        return true;
+    }
+
+    std::array<std::string_view, N> names;
+    std::array<int16_t, tagTableSlots(N)> slots{};
+    uint32_t seed = 0;
+};
+
+// Leaf tag -> setter of one field of Record
+template <typename Record>
+struct FieldBinding {
+    std::string_view tag;
+    void (*set)(Record& rec, std::string_view value);
+};
+
+// Table-driven field dispatch: the tag of a leaf element picks the setter
+// through a TagTable, so adding a field is one line in the binding list
+template <typename Record, size_t N>
+class FieldTable {
+public:
+    constexpr explicit FieldTable(const std::array<FieldBinding<Record>, N>& bindings)
+        : tags(namesOf(bindings)), bindings(bindings) {}
+
+    // false if tag is not a field of Record
+    bool set(Record& rec, std::string_view tag, std::string_view value) const {
+        int i = tags.find(tag);
+        if (i < 0)
+            return false;
+        bindings[(size_t)i].set(rec, value);
+        return true;
+    }
+
+private:
+    static constexpr std::array<std::string_view, N> namesOf(const std::array<FieldBinding<Record>, N>& bindings) {
+        std::array<std::string_view, N> names{};
+        for (size_t i = 0; i < N; ++i)
+            names[i] = bindings[i].tag;
+        return names;
+    }
+
+    TagTable<N> tags;
+    std::array<FieldBinding<Record>, N> bindings;
+};
+
+template <typename Record, size_t N>
+constexpr FieldTable<Record, N> makeFieldTable(const FieldBinding<Record> (&bindings)[N]) {
+    std::array<FieldBinding<Record>, N> list{};
+    for (size_t i = 0; i < N; ++i)
+        list[i] = bindings[i];
+    return FieldTable<Record, N>(list);
+}
+
+#endif // TAG_HASH_H
@@ -0,0 +1,251 @@
+#include "watch-mode.h"
+#include "logger.h"
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <system_error>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+extern Logger logger;
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<bool> stopRequested(false);
+
+void stopWatch() {
+    stopRequested = true;
+}
+
+namespace {
+
+// Wakes the daemon when the inbox changes. Linux reports the names of files
+// closed after writing or moved in, which are complete at once; Windows only
+// says something changed. wait() returning without events is a rescan tick.
+class DirectoryWatcher {
+public:
+    ~DirectoryWatcher() { close(); }
+
+    bool open(const std::string& dir) {
+#ifdef _WIN32
+        handle = FindFirstChangeNotificationA(dir.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+        return handle != INVALID_HANDLE_VALUE;
+#elif defined(__linux__)
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+            return false;
+        if (inotify_add_watch(fd, dir.c_str(), IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            close();
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Waits up to timeoutMs; names of files known to be complete go to closed
+    void wait(int timeoutMs, std::vector<std::string>& closed) {
+#ifdef _WIN32
+        if (WaitForSingleObject(handle, (DWORD)timeoutMs) == WAIT_OBJECT_0)
+            FindNextChangeNotification(handle);
+#elif defined(__linux__)
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (::poll(&pfd, 1, timeoutMs) <= 0)
+            return;
+        alignas(inotify_event) char buf[16384];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + n; ) {
+                const inotify_event* ev = (const inotify_event*)p;
+                if (ev->len && (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+                    closed.emplace_back(ev->name);
+                p += sizeof(inotify_event) + ev->len;
+            }
+        }
+#else
+        (void)timeoutMs;
+        (void)closed;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (handle != INVALID_HANDLE_VALUE)
+            FindCloseChangeNotification(handle);
+        handle = INVALID_HANDLE_VALUE;
+#elif defined(__linux__)
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#elif defined(__linux__)
+    int fd = -1;
+#endif
+};
+
+// A file seen in the inbox but not loaded yet
+struct Pending {
+    uintmax_t size = 0;
+    fs::file_time_type modified;
+    Clock::time_point arrived;      // first seen
+    Clock::time_point changed;      // size or time last changed
+    bool closed = false;            // the writer closed it (inotify)
+};
+
+// Skips hidden files and the usual in-progress suffixes of copy tools
+bool ignoredName(const std::string& name) {
+    auto endsWith = [&](const char* suffix) {
+        size_t n = std::char_traits<char>::length(suffix);
+        return name.size() >= n && name.compare(name.size() - n, n, suffix) == 0;
+    };
+    return name.empty() || name[0] == '.' || endsWith(".tmp") || endsWith(".part") || endsWith(".partial");
+}
+
+void scanInbox(const fs::path& inbox, std::map<std::string, Pending>& pending) {
+    std::error_code ec;
+    Clock::time_point now = Clock::now();
+    std::map<std::string, Pending> seen;
+    for (fs::directory_iterator it(inbox, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code fileEc;
+        if (!it->is_regular_file(fileEc))
+            continue;
+        std::string name = it->path().filename().string();
+        if (ignoredName(name))
+            continue;
+        uintmax_t size = it->file_size(fileEc);
+        fs::file_time_type modified = it->last_write_time(fileEc);
+        if (fileEc)
+            continue;
+
+        auto old = pending.find(name);
+        Pending p = old != pending.end() ? old->second : Pending();
+        if (old == pending.end()) {
+            p.arrived = now;
+            p.changed = now;
+        }
+        else if (p.size != size || p.modified != modified) {
+            p.changed = now;
+            p.closed = false;
+        }
+        p.size = size;
+        p.modified = modified;
+        seen.emplace(name, p);
+    }
+    if (ec)
+        logger.log("watch: cannot list " + inbox.string() + ": " + ec.message(), LogLevel::ERRORS);
+    else
+        pending.swap(seen);     // files that disappeared are forgotten
+}
+
+// Moves file into dir, adding .1, .2 ... if the name is taken; copies across volumes
+bool moveInto(const fs::path& file, const fs::path& dir) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    fs::path target = dir / file.filename();
+    for (int n = 1; fs::exists(target, ec); ++n)
+        target = dir / (file.filename().string() + "." + std::to_string(n));
+    fs::rename(file, target, ec);
+    if (ec) {
+        ec.clear();
+        if (fs::copy_file(file, target, ec))
+            fs::remove(file, ec);
+    }
+    if (ec) {
+        logger.log("watch: cannot move " + file.string() + " to " + dir.string() + ": " + ec.message(), LogLevel::ERRORS);
+        return false;
+    }
+    return true;
+}
+
+}
+
+bool runWatch(const WatchOptions& opts, const WatchLoad& load) {
+    const fs::path inbox(opts.inbox);
+    const fs::path archive(opts.archive);
+    std::error_code ec;
+    if (!fs::is_directory(inbox, ec)) {
+        logger.log("watch: " + opts.inbox + " is not a directory", LogLevel::ERRORS);
+        return false;
+    }
+    fs::create_directories(archive, ec);
+
+    DirectoryWatcher watcher;
+    bool notified = !opts.polling && watcher.open(opts.inbox);
+    if (!opts.polling && !notified)
+        logger.log("watch: change notifications unavailable, polling every " + std::to_string(opts.pollMs) + " ms", LogLevel::WARNING);
+    logger.log("watch: waiting for files in " + opts.inbox + (notified ? " (notifications)" : " (polling)") +
+        ", archive " + opts.archive, LogLevel::INFO);
+
+    std::map<std::string, Pending> pending;
+    std::vector<std::string> closed;
+    while (!stopRequested) {
+        scanInbox(inbox, pending);
+        for (const std::string& name : closed) {
+            auto it = pending.find(name);
+            if (it != pending.end())
+                it->second.closed = true;
+        }
+        closed.clear();
+
+        // Oldest name first; SPAN drops carry their business date and time in the name
+        Clock::time_point now = Clock::now();
+        bool waiting = false;
+        for (auto it = pending.begin(); it != pending.end() && !stopRequested; ) {
+            const Pending& p = it->second;
+            if (!p.closed && now - p.changed < std::chrono::milliseconds(opts.settleMs)) {
+                waiting = true;
+                ++it;
+                continue;
+            }
+
+            fs::path file = inbox / it->first;
+            logger.log("watch: loading " + file.string() + " (" + std::to_string(p.size) + " bytes)", LogLevel::INFO);
+            bool ok = load(file.string());
+            double latency = std::chrono::duration<double>(Clock::now() - p.arrived).count();
+            if (ok) {
+                metrics.filesLoaded.add();
+                metrics.fileLatencyNs.record((uint64_t)(latency * 1e9));
+                logger.log("watch: committed " + it->first + " " + std::to_string(latency) + " s after arrival", LogLevel::INFO);
+                moveInto(file, archive);
+            }
+            else {
+                metrics.filesFailed.add();
+                logger.log("watch: failed to load " + it->first + ", moved to " + (archive / "failed").string(), LogLevel::ERRORS);
+                moveInto(file, archive / "failed");
+            }
+            // Rewritten after every file so scrapers follow a running daemon
+            writeMetrics(metrics, opts.metricsJsonPath, opts.metricsPromPath);
+            it = pending.erase(it);
+            now = Clock::now();
+        }
+
+        // Rescan soon while a file is still being written
+        int timeout = waiting && opts.settleMs < opts.pollMs ? opts.settleMs : opts.pollMs;
+        if (notified) {
+            watcher.wait(timeout, closed);
+        }
+        else {
+            for (int slept = 0; slept < timeout && !stopRequested; slept += 50)
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+    logger.log("watch: stopped", LogLevel::INFO);
+    return true;
+}
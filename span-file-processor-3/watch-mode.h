@@ -0,0 +1,30 @@
+#pragma once
+#ifndef WATCH_MODE_H
+#define WATCH_MODE_H
+
+#include <functional>
+#include <string>
+
+struct WatchOptions {
+    std::string inbox;
+    std::string archive;        // loaded files are moved here, failed ones to archive/failed
+    int pollMs = 2000;          // directory rescan interval, with or without notifications
+    int settleMs = 500;         // a file with no close notification must keep its size this long
+    bool polling = false;       // do not use inotify / change notifications
+    std::string metricsJsonPath;  // rewritten after every file, see writeMetrics
+    std::string metricsPromPath;
+};
+
+// Loads one file; returns true once its rows are committed
+using WatchLoad = std::function<bool(const std::string& path)>;
+
+// Watches opts.inbox until stopWatch() and hands every complete file to load,
+// oldest name first. New files are noticed through inotify on Linux and
+// directory change notifications on Windows, by rescanning every pollMs
+// otherwise. Records the arrival-to-commit latency of each file in metrics.
+bool runWatch(const WatchOptions& opts, const WatchLoad& load);
+
+// Ends runWatch after the current file; safe to call from a signal handler
+void stopWatch();
+
+#endif // WATCH_MODE_H
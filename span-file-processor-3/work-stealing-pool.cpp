@@ -0,0 +1,107 @@
+#include "work-stealing-pool.h"
+#include "logger.h"
+#include "metrics.h"
+#include <exception>
+#include <string>
+
+extern Logger logger;
+
+// Worker index of the calling thread in the pool that runs it, -1 elsewhere
+static thread_local const WorkStealingPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads < 1)
+        threads = 1;
+    for (int t = 0; t < threads; ++t)
+        workers.push_back(std::make_unique<Worker>());
+    for (int t = 0; t < threads; ++t)
+        this->threads.emplace_back([this, t] { run(t); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void WorkStealingPool::submit(Task task) {
+    const int self = currentPool == this ? currentWorker : -1;
+    const size_t target = self >= 0 ? (size_t)self : nextWorker.fetch_add(1) % workers.size();
+    pending.fetch_add(1);
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers[target]->mutex);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+    // Under idleMutex so a worker deciding to sleep cannot miss the task
+    std::lock_guard<std::mutex> lock(idleMutex);
+    wake.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(idleMutex);
+    idle.wait(lock, [this] { return pending.load() == 0; });
+}
+
+// Own deque from the back, then the others' from the front
+bool WorkStealingPool::take(int self, Task& task) {
+    {
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    const int n = (int)workers.size();
+    for (int i = 1; i < n; ++i) {
+        Worker& victim = *workers[(self + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            metrics.tasksStolen.add();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(int self) {
+    currentPool = this;
+    currentWorker = self;
+    Task task;
+    for (;;) {
+        if (take(self, task)) {
+            try {
+                task();
+            }
+            catch (const std::exception& e) {
+                logger.log(std::string("Task failed: ") + e.what(), LogLevel::ERRORS);
+            }
+            catch (...) {
+                logger.log("Task failed with an unknown exception", LogLevel::ERRORS);
+            }
+            task = nullptr;
+            if (pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(idleMutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleMutex);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0)
+            return;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own deque of tasks. A worker
+// runs its newest task first, so the chunks of a file it just split are
+// parsed while the file is still warm in its cache, and when its deque is
+// empty it steals the oldest task of another worker. Tasks may submit more
+// tasks; a task submitted from a worker goes to that worker's deque.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(int threads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(Task task);
+    // Returns once every submitted task, and every task they submitted, ran
+    void wait();
+
+    int size() const { return (int)workers.size(); }
+    uint64_t steals() const { return stolen.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int self);
+    bool take(int self, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex idleMutex;
+    std::condition_variable wake;       // a task was queued, or the pool stops
+    std::condition_variable idle;       // pending dropped to 0
+    std::atomic<size_t> queued{ 0 };    // tasks sitting in a deque
+    std::atomic<size_t> pending{ 0 };   // tasks submitted and not finished
+    std::atomic<size_t> nextWorker{ 0 };
+    std::atomic<uint64_t> stolen{ 0 };
+    bool stopping = false;
+};
+
+#endif // WORK_STEALING_POOL_H